@@ -105,11 +105,16 @@ static struct corosync_api_v1 apidef_corosync_api_v1 = {
 	.ipc_response_send = cs_ipcs_response_send,
 	.ipc_dispatch_send = cs_ipcs_dispatch_send,
 	.ipc_dispatch_iov_send = cs_ipcs_dispatch_iov_send,
+	.ipc_dispatch_iov_send_shared = cs_ipcs_dispatch_iov_send_shared,
+	.ipc_shared_msg_release = cs_ipcs_shared_msg_release,
+	.ipc_dispatch_pack_set = cs_ipcs_dispatch_pack_set,
+	.ipc_dispatch_send_exempt = cs_ipcs_dispatch_send_exempt,
 	.ipc_refcnt_inc =  cs_ipc_refcnt_inc,
 	.ipc_refcnt_dec = cs_ipc_refcnt_dec,
 	.totem_nodeid_get = totempg_my_nodeid_get,
 	.totem_family_get = totempg_my_family_get,
 	.totem_mcast = main_mcast,
+	.totem_mcast_multi = main_mcast_multi,
 	.totem_ifaces_get = totempg_ifaces_get,
 	.totem_ifaces_print = totempg_ifaces_print,
 	.totem_ip_print = totemip_print,
@@ -697,6 +697,11 @@ static void message_handler_req_exec_cfg_reload_config (
 	/* Tell interested listeners that we have started a reload */
 	icmap_set_uint8("config.reload_in_progress", 1);
 
+	/*
+	 * Changes below are one batch for coalescing trackers
+	 */
+	icmap_transaction_begin();
+
 	/* Detect deleted entries and remove them from the main icmap hashtable */
 	remove_deleted_entries(temp_map, "logging.");
 	remove_deleted_entries(temp_map, "totem.");
@@ -717,6 +722,8 @@ static void message_handler_req_exec_cfg_reload_config (
 		log_printf (LOGSYS_LEVEL_ERROR, "Error making new config live. cmap database may be inconsistent\n");
 	}
 
+	icmap_transaction_end();
+
 	/* All done - let clients know */
 	icmap_set_uint8("config.reload_in_progress", 0);
 
@@ -132,10 +132,59 @@ struct cmap_conn_info {
 typedef uint64_t cmap_iter_handle_t;
 typedef uint64_t cmap_track_handle_t;
 
+/*
+ * Iterator of a connection. A key read from the map iterator which didn't
+ * fit into the response of MESSAGE_REQ_CMAP_ITER_NEXT_BULK is kept as
+ * pending and returned first by the next request.
+ */
+struct cmap_iter_inst {
+	icmap_iter_t iter;
+	int pending;
+	char pending_key[CS_MAX_NAME_LENGTH];
+};
+
+/*
+ * Change of one key waiting to be sent to a coalescing track. old_val is
+ * value before the first change, new_val is value after the latest one.
+ */
+struct cmap_track_change {
+	char *key_name;
+	int32_t event;
+	struct icmap_notify_value new_val;
+	struct icmap_notify_value old_val;
+	struct qb_list_head list;
+};
+
 struct cmap_track_user_data {
 	void *conn;
 	cmap_track_handle_t track_handle;
 	uint64_t track_inst_handle;
+	/*
+	 * Track was added with CMAP_TRACK_COALESCE. Changes are kept in
+	 * changes (in order of the first change of key, changes_map indexes
+	 * them by key name) until the end of main loop iteration or icmap
+	 * transaction. Track with changes is linked into
+	 * cmap_track_pending_list_head by pending_list.
+	 */
+	int coalesce;
+	qb_map_t *changes_map;
+	struct qb_list_head changes;
+	struct qb_list_head pending_list;
+};
+
+QB_LIST_DECLARE (cmap_track_pending_list_head);
+
+static int cmap_track_flush_scheduled = 0;
+
+/*
+ * Previous value of a key changed by MESSAGE_REQ_CMAP_SET_MULTI, used to
+ * roll the request back
+ */
+struct cmap_multi_undo {
+	int existed;
+	void *value;
+	size_t value_len;
+	icmap_value_types_t type;
 };
 
 enum cmap_message_req_types {
@@ -165,6 +214,10 @@ static void message_handler_req_lib_cmap_iter_finalize(void *conn, const void *m
 static void message_handler_req_lib_cmap_track_add(void *conn, const void *message);
 static void message_handler_req_lib_cmap_track_delete(void *conn, const void *message);
 static void message_handler_req_lib_cmap_set_current_map(void *conn, const void *message);
+static void message_handler_req_lib_cmap_iter_next_bulk(void *conn, const void *message);
+static void message_handler_req_lib_cmap_get_multi(void *conn, const void *message);
+static void message_handler_req_lib_cmap_set_multi(void *conn, const void *message);
+static void message_handler_req_lib_cmap_delete_multi(void *conn, const void *message);
 
 static void cmap_notify_fn(int32_t event,
 		const char *key_name,
@@ -172,6 +225,10 @@ static void cmap_notify_fn(int32_t event,
 		struct icmap_notify_value old_val,
 		void *user_data);
 
+static void cmap_track_user_data_free(struct cmap_track_user_data *cmap_track_user_data);
+
+static void cmap_track_flush_all(void *user_data);
+
 static void message_handler_req_exec_cmap_mcast(
 		const void *message,
 		unsigned int nodeid);
@@ -250,6 +307,22 @@ static struct corosync_lib_handler cmap_lib_engine[] =
 		.lib_handler_fn				= message_handler_req_lib_cmap_set_current_map,
 		.flow_control				= CS_LIB_FLOW_CONTROL_NOT_REQUIRED
 	},
+	{ /* 10 */
+		.lib_handler_fn				= message_handler_req_lib_cmap_get_multi,
+		.flow_control				= CS_LIB_FLOW_CONTROL_NOT_REQUIRED
+	},
+	{ /* 11 */
+		.lib_handler_fn				= message_handler_req_lib_cmap_set_multi,
+		.flow_control				= CS_LIB_FLOW_CONTROL_NOT_REQUIRED
+	},
+	{ /* 12 */
+		.lib_handler_fn				= message_handler_req_lib_cmap_delete_multi,
+		.flow_control				= CS_LIB_FLOW_CONTROL_NOT_REQUIRED
+	},
+	{ /* 13 */
+		.lib_handler_fn				= message_handler_req_lib_cmap_iter_next_bulk,
+		.flow_control				= CS_LIB_FLOW_CONTROL_NOT_REQUIRED
+	},
 };
 
 static struct corosync_exec_handler cmap_exec_engine[] =
@@ -343,6 +416,8 @@ static int cmap_exec_exit_fn(void)
 		log_printf(LOGSYS_LEVEL_ERROR, "Can't delete config_version icmap tracker");
 	}
 
+	(void)icmap_transaction_end_notify_del(cmap_track_flush_all, NULL);
+
 	return 0;
 }
 
@@ -363,6 +438,11 @@ static char *cmap_exec_init_fn (
 		return ((char *)"Can't add config_version icmap tracker");
 	}
 
+	ret = icmap_transaction_end_notify_add(cmap_track_flush_all, NULL);
+	if (ret != CS_OK) {
+		return ((char *)"Can't add icmap transaction end notification");
+	}
+
 	return (NULL);
 }
 
@@ -386,7 +466,7 @@ static int cmap_lib_exit_fn (void *conn)
 {
 	struct cmap_conn_info *conn_info = (struct cmap_conn_info *)api->ipc_private_data_get (conn);
 	hdb_handle_t iter_handle = 0;
-	icmap_iter_t *iter;
+	struct cmap_iter_inst *iter;
 	hdb_handle_t track_handle = 0;
 	icmap_track_t *track;
 
@@ -396,7 +476,7 @@ static int cmap_lib_exit_fn (void *conn)
         while (hdb_iterator_next(&conn_info->iter_db,
                 (void*)&iter, &iter_handle) == 0) {
 
-		conn_info->map_fns.map_iter_finalize(*iter);
+		conn_info->map_fns.map_iter_finalize(iter->iter);
 
 		(void)hdb_handle_put (&conn_info->iter_db, iter_handle);
         }
@@ -407,7 +487,7 @@ static int cmap_lib_exit_fn (void *conn)
         while (hdb_iterator_next(&conn_info->track_db,
                 (void*)&track, &track_handle) == 0) {
 
-		free(conn_info->map_fns.map_track_get_user_data(*track));
+		cmap_track_user_data_free(conn_info->map_fns.map_track_get_user_data(*track));
 
 		conn_info->map_fns.map_track_delete(*track);
 
@@ -617,7 +697,7 @@ static void message_handler_req_lib_cmap_iter_init(void *conn, const void *messa
 	struct res_lib_cmap_iter_init res_lib_cmap_iter_init;
 	cs_error_t ret;
 	icmap_iter_t iter;
-	icmap_iter_t *hdb_iter;
+	struct cmap_iter_inst *hdb_iter;
 	cmap_iter_handle_t handle = 0ULL;
 	const char *prefix;
 	struct cmap_conn_info *conn_info = (struct cmap_conn_info *)api->ipc_private_data_get (conn);
@@ -634,7 +714,7 @@ static void message_handler_req_lib_cmap_iter_init(void *conn, const void *messa
 		goto reply_send;
 	}
 
-	ret = hdb_error_to_cs(hdb_handle_create(&conn_info->iter_db, sizeof(iter), &handle));
+	ret = hdb_error_to_cs(hdb_handle_create(&conn_info->iter_db, sizeof(*hdb_iter), &handle));
 	if (ret != CS_OK) {
 		goto reply_send;
 	}
@@ -644,7 +724,8 @@ static void message_handler_req_lib_cmap_iter_init(void *conn, const void *messa
 		goto reply_send;
 	}
 
-	*hdb_iter = iter;
+	memset(hdb_iter, 0, sizeof(*hdb_iter));
+	hdb_iter->iter = iter;
 
 	(void)hdb_handle_put (&conn_info->iter_db, handle);
 
@@ -658,12 +739,33 @@ reply_send:
 	api->ipc_response_send(conn, &res_lib_cmap_iter_init, sizeof(res_lib_cmap_iter_init));
 }
 
+/*
+ * Next key of iterator, pending key first. Value length and type of a
+ * pending key are looked up again, so NULL is never returned for a key
+ * which was deleted meanwhile unless the iterator is exhausted.
+ */
+static const char *cmap_iter_inst_next(
+	struct cmap_conn_info *conn_info,
+	struct cmap_iter_inst *iter,
+	size_t *value_len,
+	icmap_value_types_t *type)
+{
+	if (iter->pending) {
+		iter->pending = 0;
+		if (conn_info->map_fns.map_get(iter->pending_key, NULL, value_len, type) == CS_OK) {
+			return (iter->pending_key);
+		}
+	}
+
+	return (conn_info->map_fns.map_iter_next(iter->iter, value_len, type));
+}
+
 static void message_handler_req_lib_cmap_iter_next(void *conn, const void *message)
 {
 	const struct req_lib_cmap_iter_next *req_lib_cmap_iter_next = message;
 	struct res_lib_cmap_iter_next res_lib_cmap_iter_next;
 	cs_error_t ret;
-	icmap_iter_t *iter;
+	struct cmap_iter_inst *iter;
 	size_t value_len = 0;
 	icmap_value_types_t type = 0;
 	const char *res = NULL;
@@ -675,7 +777,7 @@ static void message_handler_req_lib_cmap_iter_next(void *conn, const void *messa
 		goto reply_send;
 	}
 
-	res = conn_info->map_fns.map_iter_next(*iter, &value_len, &type);
+	res = cmap_iter_inst_next(conn_info, iter, &value_len, &type);
 	if (res == NULL) {
 		ret = CS_ERR_NO_SECTIONS;
 	}
@@ -699,12 +801,130 @@ reply_send:
 	api->ipc_response_send(conn, &res_lib_cmap_iter_next, sizeof(res_lib_cmap_iter_next));
 }
 
+/*
+ * Fill one page of (key, type, value) records. The key which doesn't fit
+ * stays pending in the iterator, so the client resumes from it with the
+ * next request.
+ */
+static void message_handler_req_lib_cmap_iter_next_bulk(void *conn, const void *message)
+{
+	const struct req_lib_cmap_iter_next_bulk *req_lib_cmap_iter_next_bulk = message;
+	struct cmap_conn_info *conn_info = (struct cmap_conn_info *)api->ipc_private_data_get (conn);
+	struct res_lib_cmap_iter_next_bulk *res_lib_cmap_iter_next_bulk;
+	struct res_lib_cmap_iter_next_bulk error_res;
+	struct res_lib_cmap_iter_bulk_item *item;
+	struct cmap_iter_inst *iter;
+	const char *key_name;
+	icmap_value_types_t type;
+	size_t value_len;
+	size_t key_len;
+	size_t page_size;
+	size_t pos;
+	size_t record_len;
+	cs_error_t ret;
+
+	page_size = req_lib_cmap_iter_next_bulk->page_size;
+	if (page_size > CMAP_ITER_BULK_PAGE_MAX) {
+		page_size = CMAP_ITER_BULK_PAGE_MAX;
+	}
+	if (page_size < sizeof(*res_lib_cmap_iter_next_bulk)) {
+		ret = CS_ERR_INVALID_PARAM;
+		goto error_exit;
+	}
+
+	ret = hdb_error_to_cs(hdb_handle_get(&conn_info->iter_db,
+				req_lib_cmap_iter_next_bulk->iter_handle, (void *)&iter));
+	if (ret != CS_OK) {
+		goto error_exit;
+	}
+
+	res_lib_cmap_iter_next_bulk = malloc(page_size);
+	if (res_lib_cmap_iter_next_bulk == NULL) {
+		(void)hdb_handle_put (&conn_info->iter_db, req_lib_cmap_iter_next_bulk->iter_handle);
+		ret = CS_ERR_NO_MEMORY;
+		goto error_exit;
+	}
+	memset(res_lib_cmap_iter_next_bulk, 0, sizeof(*res_lib_cmap_iter_next_bulk));
+
+	pos = sizeof(*res_lib_cmap_iter_next_bulk);
+	while ((key_name = cmap_iter_inst_next(conn_info, iter, &value_len, &type)) != NULL) {
+		/*
+		 * Length from iterator is not exact for string stats
+		 */
+		if (conn_info->map_fns.map_get(key_name, NULL, &value_len, &type) != CS_OK) {
+			continue;
+		}
+
+		key_len = strlen(key_name);
+		record_len = CMAP_ITER_BULK_RECORD_LEN(key_len, value_len);
+
+		if (pos + record_len > page_size) {
+			if (res_lib_cmap_iter_next_bulk->no_items == 0) {
+				/*
+				 * Page can't hold even one record, client has to
+				 * ask with bigger page
+				 */
+				ret = CS_ERR_NO_SPACE;
+			}
+			if (key_name != iter->pending_key) {
+				memcpy(iter->pending_key, key_name, key_len + 1);
+			}
+			iter->pending = 1;
+			break;
+		}
+
+		item = (struct res_lib_cmap_iter_bulk_item *)((char *)res_lib_cmap_iter_next_bulk + pos);
+		memset(item, 0, record_len);
+		item->key_len = key_len;
+		memcpy(item->data, key_name, key_len);
+
+		if (conn_info->map_fns.map_get(key_name,
+		    item->data + CMAP_MULTI_ALIGNED(key_len + 1), &value_len, &type) != CS_OK) {
+			continue;
+		}
+		item->type = type;
+		item->value_len = value_len;
+
+		pos += record_len;
+		res_lib_cmap_iter_next_bulk->no_items++;
+	}
+
+	(void)hdb_handle_put (&conn_info->iter_db, req_lib_cmap_iter_next_bulk->iter_handle);
+
+	if (ret == CS_OK && res_lib_cmap_iter_next_bulk->no_items == 0) {
+		ret = CS_ERR_NO_SECTIONS;
+	}
+
+	if (ret != CS_OK) {
+		free(res_lib_cmap_iter_next_bulk);
+		goto error_exit;
+	}
+
+	res_lib_cmap_iter_next_bulk->header.size = pos;
+	res_lib_cmap_iter_next_bulk->header.id = MESSAGE_RES_CMAP_ITER_NEXT_BULK;
+	res_lib_cmap_iter_next_bulk->header.error = CS_OK;
+	res_lib_cmap_iter_next_bulk->last = (key_name == NULL);
+
+	api->ipc_response_send(conn, res_lib_cmap_iter_next_bulk, pos);
+	free(res_lib_cmap_iter_next_bulk);
+
+	return ;
+
+error_exit:
+	memset(&error_res, 0, sizeof(error_res));
+	error_res.header.size = sizeof(error_res);
+	error_res.header.id = MESSAGE_RES_CMAP_ITER_NEXT_BULK;
+	error_res.header.error = ret;
+
+	api->ipc_response_send(conn, &error_res, sizeof(error_res));
+}
+
 static void message_handler_req_lib_cmap_iter_finalize(void *conn, const void *message)
 {
 	const struct req_lib_cmap_iter_finalize *req_lib_cmap_iter_finalize = message;
 	struct res_lib_cmap_iter_finalize res_lib_cmap_iter_finalize;
 	cs_error_t ret;
-	icmap_iter_t *iter;
+	struct cmap_iter_inst *iter;
 	struct cmap_conn_info *conn_info = (struct cmap_conn_info *)api->ipc_private_data_get (conn);
 
 	ret = hdb_error_to_cs(hdb_handle_get(&conn_info->iter_db,
@@ -713,7 +933,7 @@ static void message_handler_req_lib_cmap_iter_finalize(void *conn, const void *m
 		goto reply_send;
 	}
 
-	conn_info->map_fns.map_iter_finalize(*iter);
+	conn_info->map_fns.map_iter_finalize(iter->iter);
 
 	(void)hdb_handle_destroy(&conn_info->iter_db, req_lib_cmap_iter_finalize->iter_handle);
 
@@ -728,13 +948,12 @@ reply_send:
 	api->ipc_response_send(conn, &res_lib_cmap_iter_finalize, sizeof(res_lib_cmap_iter_finalize));
 }
 
-static void cmap_notify_fn(int32_t event,
+static void cmap_notify_send(struct cmap_track_user_data *cmap_track_user_data,
+		int32_t event,
 		const char *key_name,
 		struct icmap_notify_value new_val,
-		struct icmap_notify_value old_val,
-		void *user_data)
+		struct icmap_notify_value old_val)
 {
-	struct cmap_track_user_data *cmap_track_user_data = (struct cmap_track_user_data *)user_data;
 	struct res_lib_cmap_notify_callback res_lib_cmap_notify_callback;
 	struct iovec iov[3];
 
@@ -764,6 +983,319 @@ static void cmap_notify_fn(int32_t event,
 	api->ipc_dispatch_iov_send(cmap_track_user_data->conn, iov, 3);
 }
 
+static int cmap_notify_value_copy(struct icmap_notify_value *dst,
+		const struct icmap_notify_value *src)
+{
+
+	dst->type = src->type;
+	dst->len = src->len;
+	dst->data = NULL;
+
+	if (src->len > 0) {
+		dst->data = malloc(src->len);
+		if (dst->data == NULL) {
+			return (-1);
+		}
+		memcpy((void *)dst->data, src->data, src->len);
+	}
+
+	return (0);
+}
+
+static void cmap_track_change_free(struct cmap_track_user_data *cmap_track_user_data,
+		struct cmap_track_change *change)
+{
+
+	qb_map_rm(cmap_track_user_data->changes_map, change->key_name);
+	qb_list_del(&change->list);
+
+	free(change->key_name);
+	free((void *)change->new_val.data);
+	free((void *)change->old_val.data);
+	free(change);
+
+	if (qb_list_empty(&cmap_track_user_data->changes)) {
+		qb_list_del(&cmap_track_user_data->pending_list);
+		qb_list_init(&cmap_track_user_data->pending_list);
+	}
+}
+
+static void cmap_track_changes_drop(struct cmap_track_user_data *cmap_track_user_data)
+{
+	struct qb_list_head *iter, *tmp_iter;
+	struct cmap_track_change *change;
+
+	qb_list_for_each_safe(iter, tmp_iter, &cmap_track_user_data->changes) {
+		change = qb_list_entry(iter, struct cmap_track_change, list);
+		cmap_track_change_free(cmap_track_user_data, change);
+	}
+}
+
+static void cmap_track_user_data_free(struct cmap_track_user_data *cmap_track_user_data)
+{
+
+	if (cmap_track_user_data == NULL) {
+		return ;
+	}
+
+	if (cmap_track_user_data->coalesce) {
+		cmap_track_changes_drop(cmap_track_user_data);
+
+		if (cmap_track_user_data->changes_map != NULL) {
+			qb_map_destroy(cmap_track_user_data->changes_map);
+		}
+	}
+
+	free(cmap_track_user_data);
+}
+
+static void cmap_notify_batch_send(struct cmap_track_user_data *cmap_track_user_data,
+		struct res_lib_cmap_notify_batch_callback *res_lib_cmap_notify_batch_callback,
+		size_t len)
+{
+
+	res_lib_cmap_notify_batch_callback->header.size = len;
+	res_lib_cmap_notify_batch_callback->header.id = MESSAGE_RES_CMAP_NOTIFY_BATCH_CALLBACK;
+	res_lib_cmap_notify_batch_callback->header.error = CS_OK;
+	res_lib_cmap_notify_batch_callback->track_inst_handle = cmap_track_user_data->track_inst_handle;
+
+	api->ipc_dispatch_send(cmap_track_user_data->conn, res_lib_cmap_notify_batch_callback, len);
+}
+
+/*
+ * Send all pending changes of track in as few
+ * MESSAGE_RES_CMAP_NOTIFY_BATCH_CALLBACK messages as possible
+ */
+static void cmap_track_changes_send(struct cmap_track_user_data *cmap_track_user_data)
+{
+	struct res_lib_cmap_notify_batch_callback *res_lib_cmap_notify_batch_callback;
+	struct res_lib_cmap_notify_batch_item *item;
+	struct qb_list_head *iter;
+	struct cmap_track_change *change;
+	size_t key_len;
+	size_t record_len;
+	size_t pos;
+	char *value;
+
+	if (qb_list_empty(&cmap_track_user_data->changes)) {
+		return ;
+	}
+
+	res_lib_cmap_notify_batch_callback = malloc(CMAP_NOTIFY_BATCH_MAX);
+	if (res_lib_cmap_notify_batch_callback == NULL) {
+		/*
+		 * Deliver changes one by one instead of losing them
+		 */
+		qb_list_for_each(iter, &cmap_track_user_data->changes) {
+			change = qb_list_entry(iter, struct cmap_track_change, list);
+			cmap_notify_send(cmap_track_user_data, change->event, change->key_name,
+			    change->new_val, change->old_val);
+		}
+		cmap_track_changes_drop(cmap_track_user_data);
+
+		return ;
+	}
+
+	memset(res_lib_cmap_notify_batch_callback, 0, sizeof(*res_lib_cmap_notify_batch_callback));
+	pos = sizeof(*res_lib_cmap_notify_batch_callback);
+
+	qb_list_for_each(iter, &cmap_track_user_data->changes) {
+		change = qb_list_entry(iter, struct cmap_track_change, list);
+
+		key_len = strlen(change->key_name);
+		record_len = CMAP_NOTIFY_BATCH_RECORD_LEN(key_len, change->new_val.len, change->old_val.len);
+
+		if (pos + record_len > CMAP_NOTIFY_BATCH_MAX && res_lib_cmap_notify_batch_callback->no_items > 0) {
+			cmap_notify_batch_send(cmap_track_user_data, res_lib_cmap_notify_batch_callback, pos);
+
+			memset(res_lib_cmap_notify_batch_callback, 0, sizeof(*res_lib_cmap_notify_batch_callback));
+			pos = sizeof(*res_lib_cmap_notify_batch_callback);
+		}
+
+		item = (struct res_lib_cmap_notify_batch_item *)((char *)res_lib_cmap_notify_batch_callback + pos);
+		memset(item, 0, record_len);
+
+		item->event = change->event;
+		item->key_len = key_len;
+		item->new_value_type = change->new_val.type;
+		item->old_value_type = change->old_val.type;
+		item->new_value_len = change->new_val.len;
+		item->old_value_len = change->old_val.len;
+
+		memcpy(item->data, change->key_name, key_len);
+		value = item->data + CMAP_MULTI_ALIGNED(key_len + 1);
+		if (change->new_val.len > 0) {
+			memcpy(value, change->new_val.data, change->new_val.len);
+		}
+		value += CMAP_MULTI_ALIGNED(change->new_val.len);
+		if (change->old_val.len > 0) {
+			memcpy(value, change->old_val.data, change->old_val.len);
+		}
+
+		pos += record_len;
+		res_lib_cmap_notify_batch_callback->no_items++;
+	}
+
+	cmap_notify_batch_send(cmap_track_user_data, res_lib_cmap_notify_batch_callback, pos);
+
+	free(res_lib_cmap_notify_batch_callback);
+
+	cmap_track_changes_drop(cmap_track_user_data);
+}
+
+/*
+ * Send changes of all coalescing tracks. Called from main loop job and at
+ * the end of icmap transaction.
+ */
+static void cmap_track_flush_all(void *user_data)
+{
+	struct qb_list_head *iter, *tmp_iter;
+	struct cmap_track_user_data *cmap_track_user_data;
+
+	qb_list_for_each_safe(iter, tmp_iter, &cmap_track_pending_list_head) {
+		cmap_track_user_data = qb_list_entry(iter, struct cmap_track_user_data, pending_list);
+		cmap_track_changes_send(cmap_track_user_data);
+	}
+}
+
+static void cmap_track_flush_job(void *data)
+{
+
+	cmap_track_flush_scheduled = 0;
+
+	/*
+	 * Changes made inside of transaction are sent when it ends
+	 */
+	if (icmap_transaction_in_progress()) {
+		return ;
+	}
+
+	cmap_track_flush_all(NULL);
+}
+
+static void cmap_track_flush_schedule(void)
+{
+
+	if (cmap_track_flush_scheduled || icmap_transaction_in_progress()) {
+		return ;
+	}
+
+	if (qb_loop_job_add(api->poll_handle_get(), QB_LOOP_LOW, NULL, cmap_track_flush_job) != 0) {
+		log_printf(LOGSYS_LEVEL_WARNING, "Can't schedule flush of cmap notifications");
+		cmap_track_flush_all(NULL);
+		return ;
+	}
+
+	cmap_track_flush_scheduled = 1;
+}
+
+/*
+ * Merge change into pending changes of coalescing track. Newest value of key
+ * wins, old value is kept from the first change and events are combined, so
+ * key added and deleted meanwhile is not reported at all.
+ */
+static void cmap_track_change_add(struct cmap_track_user_data *cmap_track_user_data,
+		int32_t event,
+		const char *key_name,
+		struct icmap_notify_value new_val,
+		struct icmap_notify_value old_val)
+{
+	struct cmap_track_change *change;
+	struct icmap_notify_value new_val_copy;
+
+	if (cmap_track_user_data->changes_map == NULL) {
+		cmap_track_user_data->changes_map = qb_hashtable_create(32);
+		if (cmap_track_user_data->changes_map == NULL) {
+			goto send_now;
+		}
+	}
+
+	change = qb_map_get(cmap_track_user_data->changes_map, key_name);
+	if (change != NULL) {
+		if (change->event == ICMAP_TRACK_ADD && event == ICMAP_TRACK_DELETE) {
+			cmap_track_change_free(cmap_track_user_data, change);
+			return ;
+		}
+
+		if (cmap_notify_value_copy(&new_val_copy, &new_val) != 0) {
+			goto send_now;
+		}
+
+		if (change->event == ICMAP_TRACK_DELETE && event == ICMAP_TRACK_ADD) {
+			change->event = ICMAP_TRACK_MODIFY;
+		} else if (change->event != ICMAP_TRACK_ADD) {
+			change->event = event;
+		}
+
+		free((void *)change->new_val.data);
+		change->new_val = new_val_copy;
+
+		/*
+		 * Key was set back to the value it had, e.g. by rollback
+		 */
+		if (change->event == ICMAP_TRACK_MODIFY &&
+		    change->new_val.type == change->old_val.type &&
+		    change->new_val.len == change->old_val.len &&
+		    (change->new_val.len == 0 ||
+		     memcmp(change->new_val.data, change->old_val.data, change->new_val.len) == 0)) {
+			cmap_track_change_free(cmap_track_user_data, change);
+		}
+
+		return ;
+	}
+
+	change = malloc(sizeof(*change));
+	if (change == NULL) {
+		goto send_now;
+	}
+	memset(change, 0, sizeof(*change));
+
+	change->key_name = strdup(key_name);
+	if (change->key_name == NULL ||
+	    cmap_notify_value_copy(&change->new_val, &new_val) != 0 ||
+	    cmap_notify_value_copy(&change->old_val, &old_val) != 0) {
+		free(change->key_name);
+		free((void *)change->new_val.data);
+		free(change);
+		goto send_now;
+	}
+	change->event = event;
+
+	qb_list_init(&change->list);
+	qb_list_add_tail(&change->list, &cmap_track_user_data->changes);
+	qb_map_put(cmap_track_user_data->changes_map, change->key_name, change);
+
+	if (qb_list_empty(&cmap_track_user_data->pending_list)) {
+		qb_list_add_tail(&cmap_track_user_data->pending_list, &cmap_track_pending_list_head);
+	}
+
+	cmap_track_flush_schedule();
+
+	return ;
+
+send_now:
+	/*
+	 * Keep order of notifications, pending changes go first
+	 */
+	cmap_track_changes_send(cmap_track_user_data);
+	cmap_notify_send(cmap_track_user_data, event, key_name, new_val, old_val);
+}
+
+static void cmap_notify_fn(int32_t event,
+		const char *key_name,
+		struct icmap_notify_value new_val,
+		struct icmap_notify_value old_val,
+		void *user_data)
+{
+	struct cmap_track_user_data *cmap_track_user_data = (struct cmap_track_user_data *)user_data;
+
+	if (cmap_track_user_data->coalesce) {
+		cmap_track_change_add(cmap_track_user_data, event, key_name, new_val, old_val);
+	} else {
+		cmap_notify_send(cmap_track_user_data, event, key_name, new_val, old_val);
+	}
+}
+
 static void message_handler_req_lib_cmap_track_add(void *conn, const void *message)
 {
 	const struct req_lib_cmap_track_add *req_lib_cmap_track_add = message;
@@ -784,6 +1316,9 @@ static void message_handler_req_lib_cmap_track_add(void *conn, const void *messa
 		goto reply_send;
 	}
 	memset(cmap_track_user_data, 0, sizeof(*cmap_track_user_data));
+	cmap_track_user_data->coalesce = ((req_lib_cmap_track_add->track_type & CMAP_TRACK_COALESCE_FLAG) != 0);
+	qb_list_init(&cmap_track_user_data->changes);
+	qb_list_init(&cmap_track_user_data->pending_list);
 
 	if (req_lib_cmap_track_add->key_name.length > 0) {
 		key_name = (char *)req_lib_cmap_track_add->key_name.value;
@@ -792,7 +1327,7 @@ static void message_handler_req_lib_cmap_track_add(void *conn, const void *messa
 	}
 
 	ret = conn_info->map_fns.map_track_add(key_name,
-					       req_lib_cmap_track_add->track_type,
+					       req_lib_cmap_track_add->track_type & ~CMAP_TRACK_COALESCE_FLAG,
 					       cmap_notify_fn,
 					       cmap_track_user_data,
 					       &track);
@@ -851,7 +1386,7 @@ static void message_handler_req_lib_cmap_track_delete(void *conn, const void *me
 	track_inst_handle = ((struct cmap_track_user_data *)
 	    conn_info->map_fns.map_track_get_user_data(*track))->track_inst_handle;
 
-	free(conn_info->map_fns.map_track_get_user_data(*track));
+	cmap_track_user_data_free(conn_info->map_fns.map_track_get_user_data(*track));
 
 	ret = conn_info->map_fns.map_track_delete(*track);
 
@@ -877,7 +1412,7 @@ static void message_handler_req_lib_cmap_set_current_map(void *conn, const void
 	struct cmap_conn_info *conn_info = (struct cmap_conn_info *)api->ipc_private_data_get (conn);
 	int handles_open = 0;
 	hdb_handle_t iter_handle = 0;
-	icmap_iter_t *iter;
+	struct cmap_iter_inst *iter;
 	hdb_handle_t track_handle = 0;
 	icmap_track_t *track;
 
@@ -919,6 +1454,329 @@ reply_send:
 	api->ipc_response_send(conn, &res, sizeof(res));
 }
 
+/*
+ * Copy key name of a multi request item to key_name, which must have room
+ * for CS_MAX_NAME_LENGTH bytes
+ */
+static cs_error_t cmap_multi_key_name_get(const mar_name_t *name, char *key_name)
+{
+
+	if (name->length >= CS_MAX_NAME_LENGTH) {
+		return (CS_ERR_NAME_TOO_LONG);
+	}
+
+	memcpy(key_name, name->value, name->length);
+	key_name[name->length] = '\0';
+
+	return (CS_OK);
+}
+
+static void cmap_multi_error_send(void *conn, int id, cs_error_t error)
+{
+	struct res_lib_cmap_multi res_lib_cmap_multi;
+
+	memset(&res_lib_cmap_multi, 0, sizeof(res_lib_cmap_multi));
+	res_lib_cmap_multi.header.size = sizeof(res_lib_cmap_multi);
+	res_lib_cmap_multi.header.id = id;
+	res_lib_cmap_multi.header.error = error;
+
+	api->ipc_response_send(conn, &res_lib_cmap_multi, sizeof(res_lib_cmap_multi));
+}
+
+static void message_handler_req_lib_cmap_get_multi(void *conn, const void *message)
+{
+	const struct req_lib_cmap_get_multi *req_lib_cmap_get_multi = message;
+	struct cmap_conn_info *conn_info = (struct cmap_conn_info *)api->ipc_private_data_get (conn);
+	struct res_lib_cmap_get_multi *res_lib_cmap_get_multi;
+	struct res_lib_cmap_get_multi_item *res_item;
+	const struct req_lib_cmap_get_multi_item *req_item;
+	char key_name[CS_MAX_NAME_LENGTH];
+	icmap_value_types_t type;
+	size_t value_len;
+	size_t res_size;
+	uint32_t no_items;
+	uint32_t i;
+	char *pos;
+
+	no_items = req_lib_cmap_get_multi->no_items;
+	if (no_items > CMAP_MULTI_ITEMS_MAX ||
+	    req_lib_cmap_get_multi->header.size < sizeof(*req_lib_cmap_get_multi) +
+	    no_items * sizeof(*req_item)) {
+		cmap_multi_error_send(conn, MESSAGE_RES_CMAP_GET_MULTI, CS_ERR_INVALID_PARAM);
+		return ;
+	}
+
+	/*
+	 * Every item gets the value area requested by the library, so it can
+	 * find items without walking the response
+	 */
+	res_size = sizeof(*res_lib_cmap_get_multi);
+	for (i = 0; i < no_items; i++) {
+		req_item = &req_lib_cmap_get_multi->items[i];
+		if (req_item->value_len > CMAP_MULTI_VALUE_LEN_MAX) {
+			cmap_multi_error_send(conn, MESSAGE_RES_CMAP_GET_MULTI, CS_ERR_INVALID_PARAM);
+			return ;
+		}
+		res_size += sizeof(*res_item) + CMAP_MULTI_ALIGNED(req_item->value_len);
+	}
+
+	res_lib_cmap_get_multi = malloc(res_size);
+	if (res_lib_cmap_get_multi == NULL) {
+		cmap_multi_error_send(conn, MESSAGE_RES_CMAP_GET_MULTI, CS_ERR_NO_MEMORY);
+		return ;
+	}
+	memset(res_lib_cmap_get_multi, 0, res_size);
+
+	pos = (char *)res_lib_cmap_get_multi + sizeof(*res_lib_cmap_get_multi);
+	for (i = 0; i < no_items; i++) {
+		req_item = &req_lib_cmap_get_multi->items[i];
+		res_item = (struct res_lib_cmap_get_multi_item *)pos;
+		pos += sizeof(*res_item) + CMAP_MULTI_ALIGNED(req_item->value_len);
+
+		res_item->error = cmap_multi_key_name_get(&req_item->key_name, key_name);
+		if (res_item->error != CS_OK) {
+			continue;
+		}
+
+		value_len = req_item->value_len;
+		type = 0;
+		res_item->error = conn_info->map_fns.map_get(key_name,
+		    (value_len > 0 ? res_item->value : NULL), &value_len, &type);
+		if (res_item->error == CS_OK) {
+			res_item->type = type;
+			res_item->value_len = value_len;
+		}
+	}
+
+	res_lib_cmap_get_multi->header.size = res_size;
+	res_lib_cmap_get_multi->header.id = MESSAGE_RES_CMAP_GET_MULTI;
+	res_lib_cmap_get_multi->header.error = CS_OK;
+	res_lib_cmap_get_multi->no_items = no_items;
+
+	api->ipc_response_send(conn, res_lib_cmap_get_multi, res_size);
+	free(res_lib_cmap_get_multi);
+}
+
+static cs_error_t cmap_multi_undo_save(
+	struct cmap_conn_info *conn_info,
+	const char *key_name,
+	struct cmap_multi_undo *undo)
+{
+	cs_error_t ret;
+
+	memset(undo, 0, sizeof(*undo));
+
+	if (conn_info->map_fns.map_get(key_name, NULL, &undo->value_len, &undo->type) != CS_OK) {
+		return (CS_OK);
+	}
+
+	/*
+	 * Binary values may be empty
+	 */
+	undo->value = malloc(undo->value_len + 1);
+	if (undo->value == NULL) {
+		return (CS_ERR_NO_MEMORY);
+	}
+
+	ret = conn_info->map_fns.map_get(key_name, undo->value, &undo->value_len, &undo->type);
+	if (ret != CS_OK) {
+		free(undo->value);
+		undo->value = NULL;
+		return (ret);
+	}
+	undo->existed = 1;
+
+	return (CS_OK);
+}
+
+/*
+ * Keys are validated before the first one is changed. If a change still
+ * fails, keys changed so far get their previous value back, so the request
+ * is applied either completely or not at all. Trackers see changes of a
+ * rejected request only if it had to be rolled back.
+ */
+static void message_handler_req_lib_cmap_set_multi(void *conn, const void *message)
+{
+	const struct req_lib_cmap_set_multi *req_lib_cmap_set_multi = message;
+	struct cmap_conn_info *conn_info = (struct cmap_conn_info *)api->ipc_private_data_get (conn);
+	struct res_lib_cmap_multi *res_lib_cmap_multi = NULL;
+	const struct req_lib_cmap_set_multi_item **items = NULL;
+	const struct req_lib_cmap_set_multi_item *item;
+	struct cmap_multi_undo *undo = NULL;
+	char key_name[CS_MAX_NAME_LENGTH];
+	size_t offset;
+	size_t res_size;
+	uint32_t no_items;
+	uint32_t applied = 0;
+	uint32_t i;
+	cs_error_t ret = CS_OK;
+
+	no_items = req_lib_cmap_set_multi->no_items;
+	if (no_items > CMAP_MULTI_ITEMS_MAX) {
+		cmap_multi_error_send(conn, MESSAGE_RES_CMAP_SET_MULTI, CS_ERR_INVALID_PARAM);
+		return ;
+	}
+
+	res_size = sizeof(*res_lib_cmap_multi) + no_items * sizeof(mar_int32_t);
+	res_lib_cmap_multi = malloc(res_size);
+	items = malloc(no_items * sizeof(*items) + 1);
+	undo = calloc(no_items + 1, sizeof(*undo));
+	if (res_lib_cmap_multi == NULL || items == NULL || undo == NULL) {
+		free(res_lib_cmap_multi);
+		free(items);
+		free(undo);
+		cmap_multi_error_send(conn, MESSAGE_RES_CMAP_SET_MULTI, CS_ERR_NO_MEMORY);
+		return ;
+	}
+	memset(res_lib_cmap_multi, 0, res_size);
+
+	offset = sizeof(*req_lib_cmap_set_multi);
+	for (i = 0; i < no_items; i++) {
+		if (req_lib_cmap_set_multi->header.size < offset + sizeof(*item)) {
+			ret = CS_ERR_INVALID_PARAM;
+			goto reply_send;
+		}
+		item = (const struct req_lib_cmap_set_multi_item *)((const char *)message + offset);
+		if (item->value_len > req_lib_cmap_set_multi->header.size - offset - sizeof(*item)) {
+			ret = CS_ERR_INVALID_PARAM;
+			goto reply_send;
+		}
+		offset += sizeof(*item) + CMAP_MULTI_ALIGNED(item->value_len);
+		items[i] = item;
+
+		res_lib_cmap_multi->errors[i] = cmap_multi_key_name_get(&item->key_name, key_name);
+		if (res_lib_cmap_multi->errors[i] == CS_OK &&
+		    conn_info->map_fns.map_is_key_ro(key_name)) {
+			res_lib_cmap_multi->errors[i] = CS_ERR_ACCESS;
+		}
+		if (res_lib_cmap_multi->errors[i] == CS_OK &&
+		    (item->type < ICMAP_VALUETYPE_INT8 || item->type > ICMAP_VALUETYPE_BINARY ||
+		     (icmap_get_valuetype_len(item->type) != 0 &&
+		      icmap_get_valuetype_len(item->type) != item->value_len))) {
+			res_lib_cmap_multi->errors[i] = CS_ERR_INVALID_PARAM;
+		}
+		if (ret == CS_OK) {
+			ret = res_lib_cmap_multi->errors[i];
+		}
+	}
+
+	if (ret != CS_OK) {
+		goto reply_send;
+	}
+
+	/*
+	 * Coalescing tracks get the whole request as one batch, changes of a
+	 * rolled back request cancel out
+	 */
+	icmap_transaction_begin();
+
+	for (i = 0; i < no_items; i++) {
+		item = items[i];
+		(void)cmap_multi_key_name_get(&item->key_name, key_name);
+
+		ret = cmap_multi_undo_save(conn_info, key_name, &undo[i]);
+		if (ret == CS_OK) {
+			ret = conn_info->map_fns.map_set(key_name, item->value, item->value_len,
+			    item->type);
+		}
+		if (ret != CS_OK) {
+			res_lib_cmap_multi->errors[i] = ret;
+			break;
+		}
+		applied++;
+	}
+
+	if (ret != CS_OK) {
+		while (applied > 0) {
+			applied--;
+			(void)cmap_multi_key_name_get(&items[applied]->key_name, key_name);
+			if (undo[applied].existed) {
+				(void)conn_info->map_fns.map_set(key_name, undo[applied].value,
+				    undo[applied].value_len, undo[applied].type);
+			} else {
+				(void)conn_info->map_fns.map_delete(key_name);
+			}
+		}
+	}
+
+	icmap_transaction_end();
+
+reply_send:
+	res_lib_cmap_multi->header.size = res_size;
+	res_lib_cmap_multi->header.id = MESSAGE_RES_CMAP_SET_MULTI;
+	res_lib_cmap_multi->header.error = ret;
+	res_lib_cmap_multi->no_items = no_items;
+
+	api->ipc_response_send(conn, res_lib_cmap_multi, res_size);
+
+	for (i = 0; i < no_items; i++) {
+		free(undo[i].value);
+	}
+	free(undo);
+	free(items);
+	free(res_lib_cmap_multi);
+}
+
+/*
+ * Nothing is deleted if any of the keys is read only. Keys which don't
+ * exist are reported but don't stop deleting the others.
+ */
+static void message_handler_req_lib_cmap_delete_multi(void *conn, const void *message)
+{
+	const struct req_lib_cmap_delete_multi *req_lib_cmap_delete_multi = message;
+	struct cmap_conn_info *conn_info = (struct cmap_conn_info *)api->ipc_private_data_get (conn);
+	struct res_lib_cmap_multi *res_lib_cmap_multi;
+	char key_name[CS_MAX_NAME_LENGTH];
+	size_t res_size;
+	uint32_t no_items;
+	uint32_t i;
+	cs_error_t ret = CS_OK;
+
+	no_items = req_lib_cmap_delete_multi->no_items;
+	if (no_items > CMAP_MULTI_ITEMS_MAX ||
+	    req_lib_cmap_delete_multi->header.size < sizeof(*req_lib_cmap_delete_multi) +
+	    no_items * sizeof(mar_name_t)) {
+		cmap_multi_error_send(conn, MESSAGE_RES_CMAP_DELETE_MULTI, CS_ERR_INVALID_PARAM);
+		return ;
+	}
+
+	res_size = sizeof(*res_lib_cmap_multi) + no_items * sizeof(mar_int32_t);
+	res_lib_cmap_multi = malloc(res_size);
+	if (res_lib_cmap_multi == NULL) {
+		cmap_multi_error_send(conn, MESSAGE_RES_CMAP_DELETE_MULTI, CS_ERR_NO_MEMORY);
+		return ;
+	}
+	memset(res_lib_cmap_multi, 0, res_size);
+
+	for (i = 0; i < no_items; i++) {
+		res_lib_cmap_multi->errors[i] =
+		    cmap_multi_key_name_get(&req_lib_cmap_delete_multi->key_names[i], key_name);
+		if (res_lib_cmap_multi->errors[i] == CS_OK &&
+		    conn_info->map_fns.map_is_key_ro(key_name)) {
+			res_lib_cmap_multi->errors[i] = CS_ERR_ACCESS;
+		}
+		if (ret == CS_OK) {
+			ret = res_lib_cmap_multi->errors[i];
+		}
+	}
+
+	if (ret == CS_OK) {
+		for (i = 0; i < no_items; i++) {
+			(void)cmap_multi_key_name_get(&req_lib_cmap_delete_multi->key_names[i],
+			    key_name);
+			res_lib_cmap_multi->errors[i] = conn_info->map_fns.map_delete(key_name);
+		}
+	}
+
+	res_lib_cmap_multi->header.size = res_size;
+	res_lib_cmap_multi->header.id = MESSAGE_RES_CMAP_DELETE_MULTI;
+	res_lib_cmap_multi->header.error = ret;
+	res_lib_cmap_multi->no_items = no_items;
+
+	api->ipc_response_send(conn, res_lib_cmap_multi, res_size);
+	free(res_lib_cmap_multi);
+}
+
 static cs_error_t cmap_mcast_send(enum cmap_mcast_reason reason, int argc, char *argv[])
 {
 	int i;
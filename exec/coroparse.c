@@ -708,6 +708,8 @@ static int main_config_parser_cb(const char *path,
 			    (strcmp(path, "totem.miss_count_const") == 0) ||
 			    (strcmp(path, "totem.knet_pmtud_interval") == 0) ||
 			    (strcmp(path, "totem.knet_compression_threshold") == 0) ||
+			    (strcmp(path, "totem.frame_pool_low_watermark") == 0) ||
+			    (strcmp(path, "totem.frame_pool_high_watermark") == 0) ||
 			    (strcmp(path, "totem.netmtu") == 0)) {
 				val_type = ICMAP_VALUETYPE_UINT32;
 				if (safe_atoq(value, &val, val_type) != 0) {
@@ -808,6 +810,46 @@ static int main_config_parser_cb(const char *path,
 					return (0);
 				}
 			}
+			if (strcmp(path, "system.state_page") == 0) {
+				if ((strcmp(value, "yes") != 0) &&
+				    (strcmp(value, "no") != 0)) {
+					*error_string = "Invalid system.state_page";
+
+					return (0);
+				}
+			}
+			/*
+			 * system.ipc_outq.* and system.ipc_outq.<service>.*
+			 */
+			if (strncmp(path, "system.ipc_outq.", strlen("system.ipc_outq.")) == 0) {
+				if (strcmp(key, "max_bytes") == 0) {
+					if (str_to_ull(value, &ull) != 0) {
+						goto atoi_error;
+					}
+					if ((cs_err = icmap_set_uint64_r(config_map, path, ull)) != CS_OK) {
+						goto icmap_set_error;
+					}
+					add_as_string = 0;
+				}
+				if (strcmp(key, "max_msgs") == 0) {
+					val_type = ICMAP_VALUETYPE_UINT32;
+					if (safe_atoq(value, &val, val_type) != 0) {
+						goto atoi_error;
+					}
+					if ((cs_err = icmap_set_uint32_r(config_map, path, val)) != CS_OK) {
+						goto icmap_set_error;
+					}
+					add_as_string = 0;
+				}
+				if (strcmp(key, "overflow") == 0) {
+					if ((strcmp(value, "drop") != 0) &&
+					    (strcmp(value, "disconnect") != 0)) {
+						*error_string = "Invalid system.ipc_outq overflow value";
+
+						return (0);
+					}
+				}
+			}
 			break;
 
 		case MAIN_CP_CB_DATA_STATE_INTERFACE:
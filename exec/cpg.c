@@ -49,6 +49,7 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <errno.h>
+#include <inttypes.h>
 #include <time.h>
 #include <assert.h>
 #include <arpa/inet.h>
@@ -71,6 +72,7 @@
 #endif
 
 #include "service.h"
+#include "statepage.h"
 
 LOGSYS_DECLARE_SUBSYS ("CPG");
 
@@ -91,6 +93,46 @@ struct zcb_mapped {
 	void *addr;
 	size_t size;
 };
+
+/*
+ * Receive side zero copy. Deliveries of at least min_size bytes to a
+ * connection which enabled it are written into a ring of chunks in a
+ * mapping shared with the library, only their offset is sent over IPC.
+ * Sizes, offsets and ownership are kept here. The released flag in the
+ * shared chunk header is written by the library, so it is only a hint
+ * and is honoured only for chunks which were delivered.
+ */
+enum zcb_recv_chunk_state {
+	ZCB_RECV_CHUNK_ASSEMBLING,
+	ZCB_RECV_CHUNK_DELIVERED,
+	ZCB_RECV_CHUNK_DROPPED
+};
+
+struct zcb_recv_chunk {
+	struct qb_list_head list;
+	size_t offset;
+	size_t size; /* Includes space skipped at the end of the pool */
+	enum zcb_recv_chunk_state state;
+};
+
+struct zcb_recv_assembly {
+	struct qb_list_head list;
+	unsigned int nodeid;
+	uint32_t pid;
+	struct zcb_recv_chunk *chunk;
+	uint32_t msglen;
+	uint32_t filled;
+};
+
+struct zcb_recv_pool {
+	char *addr;
+	size_t size;
+	size_t head;
+	size_t used;
+	uint32_t min_size;
+	struct qb_list_head chunk_list_head;
+	struct qb_list_head assembly_list_head;
+};
 /*
  * state`		exec deliver
  * match group name, pid -> if matched deliver for YES:
@@ -142,6 +184,8 @@ enum cpg_sync_state {
 
 static struct qb_list_head joinlist_messages_head;
 
+struct cpg_group;
+
 struct cpg_pd {
 	void *conn;
  	mar_cpg_name_t group_name;
@@ -151,9 +195,17 @@ struct cpg_pd {
 	int initial_totem_conf_sent;
 	uint64_t transition_counter; /* These two are used when sending fragmented messages */
 	uint64_t initial_transition_counter;
+	uint32_t partial_next_seq; /* Next fragment expected by pipelined partial mcast */
+	uint32_t async_window; /* Completion of mcasts is reported when set */
+	uint32_t async_completed;
+	uint32_t async_failed;
+	cs_error_t async_error;
 	struct qb_list_head list;
+	struct cpg_group *group; /* set while group_name is set */
+	struct qb_list_head group_list;
 	struct qb_list_head iteration_instance_list_head;
 	struct qb_list_head zcb_mapped_list_head;
+	struct zcb_recv_pool *zcb_recv;
 };
 
 struct cpg_iteration_instance {
@@ -186,9 +238,29 @@ struct process_info {
 	uint32_t pid;
 	mar_cpg_name_t group;
 	struct qb_list_head list; /* on the group_info members list */
+	struct cpg_group *cpg_group;
+	struct qb_list_head group_list;
 };
 QB_LIST_DECLARE (process_info_list_head);
 
+/*
+ * Index of groups by name. Each group holds the local connections with
+ * group_name set to it and the process_info entries of its members, kept
+ * in the same (nodeid, pid) order as process_info_list_head. A group is
+ * freed as soon as both lists are empty.
+ */
+#define CPG_GROUP_HASH_BITS	8
+#define CPG_GROUP_HASH_BUCKETS	(1 << CPG_GROUP_HASH_BITS)
+
+struct cpg_group {
+	mar_cpg_name_t name;
+	struct cpg_group *hash_next;
+	struct qb_list_head pd_list_head;
+	struct qb_list_head pi_list_head;
+};
+
+static struct cpg_group *cpg_group_hash[CPG_GROUP_HASH_BUCKETS];
+
 struct join_list_entry {
 	uint32_t pid;
 	mar_cpg_name_t group_name;
@@ -259,6 +331,16 @@ static void message_handler_req_lib_cpg_mcast (void *conn, const void *message);
 
 static void message_handler_req_lib_cpg_partial_mcast (void *conn, const void *message);
 
+static void message_handler_req_lib_cpg_partial_mcast_pipelined (void *conn, const void *message);
+
+static void message_handler_req_lib_cpg_zc_recv_enable (void *conn, const void *message);
+
+static void message_handler_req_lib_cpg_mcast_batch (void *conn, const void *message);
+
+static void message_handler_req_lib_cpg_mcast_async_enable (void *conn, const void *message);
+
+static void message_refused_req_lib_cpg_mcast (void *conn, const void *message, cs_error_t error);
+
 static void message_handler_req_lib_cpg_membership (void *conn,
 						    const void *message);
 
@@ -335,6 +417,30 @@ static int notify_lib_totem_membership (
 static inline int zcb_all_free (
 	struct cpg_pd *cpd);
 
+static void zcb_recv_free (
+	struct cpg_pd *cpd);
+
+static int zcb_recv_deliver (
+	struct cpg_pd *cpd,
+	const mar_cpg_name_t *group_name,
+	unsigned int nodeid,
+	uint32_t pid,
+	const void *msg,
+	uint32_t msglen);
+
+struct req_exec_cpg_partial_mcast;
+
+static int zcb_recv_partial_deliver (
+	struct cpg_pd *cpd,
+	const struct req_exec_cpg_partial_mcast *req_exec_cpg_mcast,
+	unsigned int nodeid,
+	const void *fragment);
+
+static void zcb_recv_senders_left (
+	struct cpg_pd *cpd,
+	int left_list_entries,
+	const mar_cpg_address_t *left_list);
+
 static char *cpg_print_group_name (
 	const mar_cpg_name_t *group);
 
@@ -353,7 +459,8 @@ static struct corosync_lib_handler cpg_lib_engine[] =
 	},
 	{ /* 2 - MESSAGE_REQ_CPG_MCAST */
 		.lib_handler_fn				= message_handler_req_lib_cpg_mcast,
-		.flow_control				= CS_LIB_FLOW_CONTROL_REQUIRED
+		.flow_control				= CS_LIB_FLOW_CONTROL_REQUIRED,
+		.lib_refused_fn				= message_refused_req_lib_cpg_mcast
 	},
 	{ /* 3 - MESSAGE_REQ_CPG_MEMBERSHIP */
 		.lib_handler_fn				= message_handler_req_lib_cpg_membership,
@@ -395,6 +502,22 @@ static struct corosync_lib_handler cpg_lib_engine[] =
 		.lib_handler_fn				= message_handler_req_lib_cpg_partial_mcast,
 		.flow_control				= CS_LIB_FLOW_CONTROL_REQUIRED
 	},
+	{ /* 13 */
+		.lib_handler_fn				= message_handler_req_lib_cpg_partial_mcast_pipelined,
+		.flow_control				= CS_LIB_FLOW_CONTROL_REQUIRED
+	},
+	{ /* 14 */
+		.lib_handler_fn				= message_handler_req_lib_cpg_zc_recv_enable,
+		.flow_control				= CS_LIB_FLOW_CONTROL_NOT_REQUIRED
+	},
+	{ /* 15 */
+		.lib_handler_fn				= message_handler_req_lib_cpg_mcast_batch,
+		.flow_control				= CS_LIB_FLOW_CONTROL_REQUIRED
+	},
+	{ /* 16 */
+		.lib_handler_fn				= message_handler_req_lib_cpg_mcast_async_enable,
+		.flow_control				= CS_LIB_FLOW_CONTROL_NOT_REQUIRED
+	},
 
 };
 
@@ -507,6 +630,136 @@ struct joinlist_msg {
 
 static struct req_exec_cpg_downlist g_req_exec_cpg_downlist;
 
+/*
+ * FNV-1a hash of the group name folded into a bucket index
+ */
+static unsigned int cpg_group_hash_bucket (const mar_cpg_name_t *name)
+{
+	uint32_t hash = 2166136261U;
+	uint32_t length;
+	uint32_t i;
+
+	length = name->length;
+	if (length > CPG_MAX_NAME_LENGTH) {
+		length = CPG_MAX_NAME_LENGTH;
+	}
+	for (i = 0; i < length; i++) {
+		hash = (hash ^ (unsigned char)name->value[i]) * 16777619U;
+	}
+	return ((hash ^ (hash >> CPG_GROUP_HASH_BITS)) & (CPG_GROUP_HASH_BUCKETS - 1));
+}
+
+static struct cpg_group *cpg_group_find (const mar_cpg_name_t *name)
+{
+	struct cpg_group *group;
+
+	for (group = cpg_group_hash[cpg_group_hash_bucket (name)];
+		group != NULL; group = group->hash_next) {
+
+		if (mar_name_compare (&group->name, name) == 0) {
+			return (group);
+		}
+	}
+	return (NULL);
+}
+
+static struct cpg_group *cpg_group_get (const mar_cpg_name_t *name)
+{
+	struct cpg_group *group;
+	unsigned int bucket;
+
+	group = cpg_group_find (name);
+	if (group != NULL) {
+		return (group);
+	}
+
+	group = malloc (sizeof (struct cpg_group));
+	if (group == NULL) {
+		return (NULL);
+	}
+	memcpy (&group->name, name, sizeof (mar_cpg_name_t));
+	qb_list_init (&group->pd_list_head);
+	qb_list_init (&group->pi_list_head);
+
+	bucket = cpg_group_hash_bucket (name);
+	group->hash_next = cpg_group_hash[bucket];
+	cpg_group_hash[bucket] = group;
+	cs_state_page_cpg_groups_add (1);
+
+	return (group);
+}
+
+/*
+ * Free group once nothing refers to it
+ */
+static void cpg_group_put (struct cpg_group *group)
+{
+	struct cpg_group **prev;
+
+	if (!qb_list_empty (&group->pd_list_head) ||
+	    !qb_list_empty (&group->pi_list_head)) {
+		return ;
+	}
+
+	prev = &cpg_group_hash[cpg_group_hash_bucket (&group->name)];
+	while (*prev != group) {
+		prev = &(*prev)->hash_next;
+	}
+	*prev = group->hash_next;
+	free (group);
+	cs_state_page_cpg_groups_add (-1);
+}
+
+static void cpd_group_detach (struct cpg_pd *cpd)
+{
+	struct cpg_group *group = cpd->group;
+
+	if (group == NULL) {
+		return ;
+	}
+	qb_list_del (&cpd->group_list);
+	qb_list_init (&cpd->group_list);
+	cpd->group = NULL;
+	cpg_group_put (group);
+}
+
+static int cpd_group_attach (struct cpg_pd *cpd)
+{
+	cpd_group_detach (cpd);
+
+	cpd->group = cpg_group_get (&cpd->group_name);
+	if (cpd->group == NULL) {
+		return (-1);
+	}
+	qb_list_add_tail (&cpd->group_list, &cpd->group->pd_list_head);
+	return (0);
+}
+
+static void process_info_free (struct process_info *pi)
+{
+	qb_list_del (&pi->list);
+	qb_list_del (&pi->group_list);
+	cpg_group_put (pi->cpg_group);
+	free (pi);
+}
+
+/*
+ * Returns non-zero if any process of nodeid is member of group
+ */
+static int cpg_group_node_known (const struct cpg_group *group, unsigned int nodeid)
+{
+	struct qb_list_head *iter;
+
+	qb_list_for_each(iter, &group->pi_list_head) {
+		struct process_info *pi = qb_list_entry (iter, struct process_info, group_list);
+
+		if (pi->nodeid == nodeid) {
+			return (1);
+		}
+	}
+	return (0);
+}
+
 /*
  * Function print group name. It's not reentrant
  */
@@ -667,6 +920,7 @@ static void notify_lib_joinlist_fill_member_list(
 	int *member_list_entries,
 	mar_cpg_address_t **member_list)
 {
+	struct cpg_group *group;
 	struct qb_list_head *iter;
 	int i;
 
@@ -674,30 +928,32 @@ static void notify_lib_joinlist_fill_member_list(
 		*member_list_entries = 0;
 	}
 
-	qb_list_for_each(iter, &process_info_list_head) {
-		struct process_info *pi = qb_list_entry (iter, struct process_info, list);
+	group = cpg_group_find (group_name);
+	if (group == NULL) {
+		return ;
+	}
 
-		if (mar_name_compare (&pi->group, group_name) == 0) {
-			int in_left_list = 0;
+	qb_list_for_each(iter, &group->pi_list_head) {
+		struct process_info *pi = qb_list_entry (iter, struct process_info, group_list);
+		int in_left_list = 0;
 
-			for (i = 0; i < left_list_entries; i++) {
-				if (left_list[i].nodeid == pi->nodeid && left_list[i].pid == pi->pid) {
-					in_left_list = 1;
-					break ;
-				}
+		for (i = 0; i < left_list_entries; i++) {
+			if (left_list[i].nodeid == pi->nodeid && left_list[i].pid == pi->pid) {
+				in_left_list = 1;
+				break ;
 			}
+		}
 
-			if (!in_left_list) {
-				if (member_list_entries != NULL) {
-					(*member_list_entries)++;
-				}
+		if (!in_left_list) {
+			if (member_list_entries != NULL) {
+				(*member_list_entries)++;
+			}
 
-				if (member_list != NULL) {
-					(*member_list)->nodeid = pi->nodeid;
-					(*member_list)->pid = pi->pid;
-					(*member_list)->reason = CPG_REASON_UNDEFINED;
-					(*member_list)++;
-				}
+			if (member_list != NULL) {
+				(*member_list)->nodeid = pi->nodeid;
+				(*member_list)->pid = pi->pid;
+				(*member_list)->reason = CPG_REASON_UNDEFINED;
+				(*member_list)++;
 			}
 		}
 	}
@@ -714,11 +970,16 @@ static int notify_lib_joinlist(
 	int size;
 	char *buf;
 	struct qb_list_head *iter;
+	struct cpg_group *group;
+	struct iovec iov;
+	void *shared_msg = NULL;
 	int member_list_entries;
 	struct res_lib_cpg_confchg_callback *res;
 	mar_cpg_address_t *retgi;
 	int i;
 
+	group = cpg_group_find (group_name);
+
 	/*
 	 * Find size of member_list (use process_info_list but remove items in left_list)
 	 */
@@ -765,12 +1026,11 @@ static int notify_lib_joinlist(
 		/*
 		 * Update cpd_state for all local joined processes in group
 		 */
-		for (i = 0; i < joined_list_entries; i++) {
+		for (i = 0; i < joined_list_entries && group != NULL; i++) {
 			if (joined_list[i].nodeid == api->totem_nodeid_get()) {
-				qb_list_for_each(iter, &cpg_pd_list_head) {
-					struct cpg_pd *cpd = qb_list_entry (iter, struct cpg_pd, list);
-					if (joined_list[i].pid == cpd->pid &&
-					    mar_name_compare (&cpd->group_name, group_name) == 0) {
+				qb_list_for_each(iter, &group->pd_list_head) {
+					struct cpg_pd *cpd = qb_list_entry (iter, struct cpg_pd, group_list);
+					if (joined_list[i].pid == cpd->pid) {
 						cpd->cpd_state = CPD_STATE_JOIN_COMPLETED;
 					}
 				}
@@ -781,16 +1041,23 @@ static int notify_lib_joinlist(
 	/*
 	 * Send notification to all ipc clients joined in group_name
 	 */
-	qb_list_for_each(iter, &cpg_pd_list_head) {
-		struct cpg_pd *cpd = qb_list_entry (iter, struct cpg_pd, list);
-		if (mar_name_compare (&cpd->group_name, group_name) == 0) {
+	if (group != NULL) {
+		iov.iov_base = buf;
+		iov.iov_len = size;
+
+		qb_list_for_each(iter, &group->pd_list_head) {
+			struct cpg_pd *cpd = qb_list_entry (iter, struct cpg_pd, group_list);
 			if (cpd->cpd_state == CPD_STATE_JOIN_COMPLETED ||
 				cpd->cpd_state == CPD_STATE_LEAVE_STARTED) {
 
-				api->ipc_dispatch_send (cpd->conn, buf, size);
+				api->ipc_dispatch_iov_send_shared (cpd->conn, &iov, 1, &shared_msg);
 				cpd->transition_counter++;
+				if (cpd->zcb_recv != NULL) {
+					zcb_recv_senders_left (cpd, left_list_entries, left_list);
+				}
 			}
 		}
+		api->ipc_shared_msg_release (shared_msg);
 	}
 
 	if (left_list_entries) {
@@ -807,6 +1074,7 @@ static int notify_lib_joinlist(
 					struct cpg_pd *cpd = qb_list_entry (iter, struct cpg_pd, list);
 					if (left_list[i].pid == cpd->pid &&
 					    mar_name_compare (&cpd->group_name, group_name) == 0) {
+						cpd_group_detach (cpd);
 						cpd->pid = 0;
 						memset (&cpd->group_name, 0, sizeof(cpd->group_name));
 						cpd->cpd_state = CPD_STATE_UNJOINED;
@@ -893,8 +1161,7 @@ static void downlist_inform_clients (void)
 			pcd->left_list[size].pid = left_pi->pid;
 			pcd->left_list[size].reason = CONFCHG_CPG_REASON_NODEDOWN;
 			pcd->left_list_entries++;
-			qb_list_del (&left_pi->list);
-			free (left_pi);
+			process_info_free (left_pi);
 		}
 	}
 
@@ -1054,12 +1321,14 @@ static void cpg_pd_finalize (struct cpg_pd *cpd)
 	struct cpg_iteration_instance *cpii;
 
 	zcb_all_free(cpd);
+	zcb_recv_free(cpd);
 	qb_list_for_each_safe(iter, tmp_iter, &(cpd->iteration_instance_list_head)) {
 		cpii = qb_list_entry (iter, struct cpg_iteration_instance, list);
 
 		cpg_iteration_instance_finalize (cpii);
 	}
 
+	cpd_group_detach (cpd);
 	qb_list_del (&cpd->list);
 }
 
@@ -1170,12 +1439,17 @@ static void exec_cpg_partial_mcast_endian_convert (void *msg)
 
 static struct process_info *process_info_find(const mar_cpg_name_t *group_name, uint32_t pid, unsigned int nodeid) {
 	struct qb_list_head *iter;
+	struct cpg_group *group;
 
-	qb_list_for_each(iter, &process_info_list_head) {
-		struct process_info *pi = qb_list_entry (iter, struct process_info, list);
+	group = cpg_group_find (group_name);
+	if (group == NULL) {
+		return NULL;
+	}
 
-		if (pi->pid == pid && pi->nodeid == nodeid &&
-			mar_name_compare (&pi->group, group_name) == 0) {
+	qb_list_for_each(iter, &group->pi_list_head) {
+		struct process_info *pi = qb_list_entry (iter, struct process_info, group_list);
+
+		if (pi->pid == pid && pi->nodeid == nodeid) {
 				return pi;
 		}
 	}
@@ -1192,6 +1466,7 @@ static void do_proc_join(
 {
 	struct process_info *pi;
 	struct process_info *pi_entry;
+	struct cpg_group *group;
 	mar_cpg_address_t notify_info;
 	struct qb_list_head *list;
 	struct qb_list_head *list_to_add = NULL;
@@ -1200,15 +1475,23 @@ static void do_proc_join(
 	if (process_info_find (name, pid, nodeid) != NULL) {
 		return ;
  	}
+	group = cpg_group_get (name);
+	if (!group) {
+		log_printf(LOGSYS_LEVEL_WARNING, "Unable to allocate cpg_group struct");
+		return;
+	}
 	pi = malloc (sizeof (struct process_info));
 	if (!pi) {
 		log_printf(LOGSYS_LEVEL_WARNING, "Unable to allocate process_info struct");
+		cpg_group_put (group);
 		return;
 	}
 	pi->nodeid = nodeid;
 	pi->pid = pid;
 	memcpy(&pi->group, name, sizeof(*name));
 	qb_list_init(&pi->list);
+	pi->cpg_group = group;
+	qb_list_init(&pi->group_list);
 
 	/*
 	 * Insert new process in sorted order so synchronization works properly
@@ -1225,6 +1508,18 @@ static void do_proc_join(
 	}
 	qb_list_add (&pi->list, list_to_add);
 
+	list_to_add = &group->pi_list_head;
+	qb_list_for_each(list, &group->pi_list_head) {
+		pi_entry = qb_list_entry(list, struct process_info, group_list);
+		if (pi_entry->nodeid > pi->nodeid ||
+			(pi_entry->nodeid == pi->nodeid && pi_entry->pid > pi->pid)) {
+
+			break;
+		}
+		list_to_add = list;
+	}
+	qb_list_add (&pi->group_list, list_to_add);
+
 	notify_info.pid = pi->pid;
 	notify_info.nodeid = nodeid;
 	notify_info.reason = reason;
@@ -1256,7 +1551,6 @@ static void do_proc_leave(
 	int reason)
 {
 	struct process_info *pi;
-	struct qb_list_head *iter, *tmp_iter;
 	mar_cpg_address_t notify_info;
 
 	notify_info.pid = pid;
@@ -1268,14 +1562,9 @@ static void do_proc_leave(
 		1, &notify_info,
 		MESSAGE_RES_CPG_CONFCHG_CALLBACK);
 
-	qb_list_for_each_safe(iter, tmp_iter, &process_info_list_head) {
-		pi = qb_list_entry(iter, struct process_info, list);
-
-		if (pi->pid == pid && pi->nodeid == nodeid &&
-			mar_name_compare (&pi->group, name)==0) {
-			qb_list_del (&pi->list);
-			free (pi);
-		}
+	pi = process_info_find (name, pid, nodeid);
+	if (pi != NULL) {
+		process_info_free (pi);
 	}
 }
 
@@ -1363,9 +1652,11 @@ static void message_handler_req_exec_cpg_mcast (
 	const struct req_exec_cpg_mcast *req_exec_cpg_mcast = message;
 	struct res_lib_cpg_deliver_callback res_lib_cpg_mcast;
 	int msglen = req_exec_cpg_mcast->msglen;
-	struct qb_list_head *iter, *pi_iter, *tmp_iter;
+	struct qb_list_head *iter, *tmp_iter;
+	struct cpg_group *group;
 	struct cpg_pd *cpd;
 	struct iovec iovec[2];
+	void *shared_msg = NULL;
 	int known_node = 0;
 
 	res_lib_cpg_mcast.header.id = MESSAGE_RES_CPG_DELIVER_CALLBACK;
@@ -1382,32 +1673,35 @@ static void message_handler_req_exec_cpg_mcast (
 	iovec[1].iov_base = (char*)message+sizeof(*req_exec_cpg_mcast);
 	iovec[1].iov_len = msglen;
 
-	qb_list_for_each_safe(iter, tmp_iter, &cpg_pd_list_head) {
-		cpd = qb_list_entry(iter, struct cpg_pd, list);
-		if ((cpd->cpd_state == CPD_STATE_LEAVE_STARTED || cpd->cpd_state == CPD_STATE_JOIN_COMPLETED)
-			&& (mar_name_compare (&cpd->group_name, &req_exec_cpg_mcast->group_name) == 0)) {
+	group = cpg_group_find (&req_exec_cpg_mcast->group_name);
+	if (group == NULL) {
+		return ;
+	}
+
+	qb_list_for_each_safe(iter, tmp_iter, &group->pd_list_head) {
+		cpd = qb_list_entry(iter, struct cpg_pd, group_list);
+		if (cpd->cpd_state == CPD_STATE_LEAVE_STARTED || cpd->cpd_state == CPD_STATE_JOIN_COMPLETED) {
 
 			if (!known_node) {
 				/* Try to find, if we know the node */
-				qb_list_for_each(pi_iter, &process_info_list_head) {
-					struct process_info *pi = qb_list_entry (pi_iter, struct process_info, list);
-
-					if (pi->nodeid == nodeid &&
-						mar_name_compare (&pi->group, &req_exec_cpg_mcast->group_name) == 0) {
-						known_node = 1;
-						break;
-					}
-				}
+				known_node = cpg_group_node_known (group, nodeid);
 			}
 
 			if (!known_node) {
 				log_printf(LOGSYS_LEVEL_WARNING, "Unknown node -> we will not deliver message");
-				return ;
+				break;
 			}
 
-			api->ipc_dispatch_iov_send (cpd->conn, iovec, 2);
+			if (cpd->zcb_recv != NULL &&
+			    zcb_recv_deliver (cpd, &req_exec_cpg_mcast->group_name, nodeid,
+			    req_exec_cpg_mcast->pid, iovec[1].iov_base, msglen) == 0) {
+				continue;
+			}
+
+			api->ipc_dispatch_iov_send_shared (cpd->conn, iovec, 2, &shared_msg);
 		}
 	}
+	api->ipc_shared_msg_release (shared_msg);
 }
 
 static void message_handler_req_exec_cpg_partial_mcast (
@@ -1417,9 +1711,11 @@ static void message_handler_req_exec_cpg_partial_mcast (
 	const struct req_exec_cpg_partial_mcast *req_exec_cpg_mcast = message;
 	struct res_lib_cpg_partial_deliver_callback res_lib_cpg_mcast;
 	int msglen = req_exec_cpg_mcast->fraglen;
-	struct qb_list_head *iter, *pi_iter, *tmp_iter;
+	struct qb_list_head *iter, *tmp_iter;
+	struct cpg_group *group;
 	struct cpg_pd *cpd;
 	struct iovec iovec[2];
+	void *shared_msg = NULL;
 	int known_node = 0;
 
 	log_printf(LOGSYS_LEVEL_DEBUG, "Got fragmented message from node " CS_PRI_NODE_ID ", size = %d bytes\n", nodeid, msglen);
@@ -1440,33 +1736,35 @@ static void message_handler_req_exec_cpg_partial_mcast (
 	iovec[1].iov_base = (char*)message+sizeof(*req_exec_cpg_mcast);
 	iovec[1].iov_len = msglen;
 
-	qb_list_for_each_safe(iter, tmp_iter, &cpg_pd_list_head) {
-		cpd = qb_list_entry(iter, struct cpg_pd, list);
+	group = cpg_group_find (&req_exec_cpg_mcast->group_name);
+	if (group == NULL) {
+		return ;
+	}
 
-		if ((cpd->cpd_state == CPD_STATE_LEAVE_STARTED || cpd->cpd_state == CPD_STATE_JOIN_COMPLETED)
-		    && (mar_name_compare (&cpd->group_name, &req_exec_cpg_mcast->group_name) == 0)) {
+	qb_list_for_each_safe(iter, tmp_iter, &group->pd_list_head) {
+		cpd = qb_list_entry(iter, struct cpg_pd, group_list);
+		if (cpd->cpd_state == CPD_STATE_LEAVE_STARTED || cpd->cpd_state == CPD_STATE_JOIN_COMPLETED) {
 
 			if (!known_node) {
 				/* Try to find, if we know the node */
-				qb_list_for_each(pi_iter, &process_info_list_head) {
-					struct process_info *pi = qb_list_entry (pi_iter, struct process_info, list);
-
-					if (pi->nodeid == nodeid &&
-					    mar_name_compare (&pi->group, &req_exec_cpg_mcast->group_name) == 0) {
-						known_node = 1;
-						break;
-					}
-				}
+				known_node = cpg_group_node_known (group, nodeid);
 			}
 
 			if (!known_node) {
 				log_printf(LOGSYS_LEVEL_WARNING, "Unknown node -> we will not deliver message");
-				return ;
+				break;
+			}
+
+			if (cpd->zcb_recv != NULL &&
+			    zcb_recv_partial_deliver (cpd, req_exec_cpg_mcast, nodeid,
+			    iovec[1].iov_base) == 0) {
+				continue;
 			}
 
-			api->ipc_dispatch_iov_send (cpd->conn, iovec, 2);
+			api->ipc_dispatch_iov_send_shared (cpd->conn, iovec, 2, &shared_msg);
 		}
 	}
+	api->ipc_shared_msg_release (shared_msg);
 }
 
 
@@ -1540,6 +1838,7 @@ static int cpg_lib_init_fn (void *conn)
 	memset (cpd, 0, sizeof(struct cpg_pd));
 	cpd->conn = conn;
 	qb_list_add (&cpd->list, &cpg_pd_list_head);
+	qb_list_init (&cpd->group_list);
 
 	qb_list_init (&cpd->iteration_instance_list_head);
 	qb_list_init (&cpd->zcb_mapped_list_head);
@@ -1593,12 +1892,21 @@ static void message_handler_req_lib_cpg_join (void *conn, const void *message)
 
 	switch (cpd->cpd_state) {
 	case CPD_STATE_UNJOINED:
+		memcpy (&cpd->group_name, &req_lib_cpg_join->group_name,
+			sizeof (cpd->group_name));
+		if (cpd_group_attach (cpd) != 0) {
+			memset (&cpd->group_name, 0, sizeof (cpd->group_name));
+			error = CS_ERR_NO_MEMORY;
+			break;
+		}
 		error = CS_OK;
 		cpd->cpd_state = CPD_STATE_JOIN_STARTED;
 		cpd->pid = req_lib_cpg_join->pid;
 		cpd->flags = req_lib_cpg_join->flags;
-		memcpy (&cpd->group_name, &req_lib_cpg_join->group_name,
-			sizeof (cpd->group_name));
+		if (cpd->flags & CPG_JOIN_FLAG_PACKED_EVENTS) {
+			api->ipc_dispatch_pack_set (conn, MESSAGE_RES_CPG_PACKED_CALLBACK,
+				CPG_PACKED_EVENT_SIZE_MAX);
+		}
 
 		cpg_node_joinleave_send (req_lib_cpg_join->pid,
 			&req_lib_cpg_join->group_name,
@@ -1674,6 +1982,7 @@ static void message_handler_req_lib_cpg_finalize (
 	 * We will just remove cpd from list. After this call, connection will be
 	 * closed on lib side, and cpg_lib_exit_fn will be called
 	 */
+	cpd_group_detach (cpd);
 	qb_list_del (&cpd->list);
 	qb_list_init (&cpd->list);
 
@@ -1826,6 +2135,96 @@ static void *serveraddr2void (uint64_t server_addr)
 	return (u.server_ptr);
 };
 
+/*
+ * Mcast a batch of messages from the library. The whole request passed one
+ * flow control check, all messages are handed to totem in one call.
+ */
+static void message_handler_req_lib_cpg_mcast_batch (void *conn, const void *message)
+{
+	const struct req_lib_cpg_mcast_batch *req_lib_cpg_mcast_batch = message;
+	struct cpg_pd *cpd = (struct cpg_pd *)api->ipc_private_data_get (conn);
+	struct req_exec_cpg_mcast req_exec_cpg_mcast[CPG_MCAST_BATCH_MSGS_MAX];
+	struct iovec req_exec_cpg_iovec[CPG_MCAST_BATCH_MSGS_MAX * 2];
+	unsigned int iov_lens[CPG_MCAST_BATCH_MSGS_MAX];
+	struct res_lib_cpg_mcast_batch res_lib_cpg_mcast_batch;
+	const struct cpg_mcast_batch_item *item;
+	size_t offset;
+	size_t size;
+	unsigned int msg_count = req_lib_cpg_mcast_batch->msg_count;
+	unsigned int i;
+	int queued = 0;
+	cs_error_t error = CS_ERR_NOT_EXIST;
+
+	log_printf(LOGSYS_LEVEL_TRACE, "got mcast batch request on %p", conn);
+
+	switch (cpd->cpd_state) {
+	case CPD_STATE_UNJOINED:
+		error = CS_ERR_NOT_EXIST;
+		break;
+	case CPD_STATE_LEAVE_STARTED:
+		error = CS_ERR_NOT_EXIST;
+		break;
+	case CPD_STATE_JOIN_STARTED:
+		error = CS_OK;
+		break;
+	case CPD_STATE_JOIN_COMPLETED:
+		error = CS_OK;
+		break;
+	}
+
+	if (error == CS_OK && (msg_count == 0 || msg_count > CPG_MCAST_BATCH_MSGS_MAX)) {
+		error = CS_ERR_INVALID_PARAM;
+	}
+
+	offset = sizeof (struct req_lib_cpg_mcast_batch);
+	size = req_lib_cpg_mcast_batch->header.size;
+	for (i = 0; error == CS_OK && i < msg_count; i++) {
+		item = (const struct cpg_mcast_batch_item *)((const char *)message + offset);
+		if (offset + sizeof (struct cpg_mcast_batch_item) > size ||
+		    item->msglen > size - offset - sizeof (struct cpg_mcast_batch_item)) {
+			error = CS_ERR_INVALID_PARAM;
+			break;
+		}
+
+		req_exec_cpg_mcast[i].header.size = sizeof(struct req_exec_cpg_mcast) + item->msglen;
+		req_exec_cpg_mcast[i].header.id = SERVICE_ID_MAKE(CPG_SERVICE,
+			MESSAGE_REQ_EXEC_CPG_MCAST);
+		req_exec_cpg_mcast[i].pid = cpd->pid;
+		req_exec_cpg_mcast[i].msglen = item->msglen;
+		api->ipc_source_set (&req_exec_cpg_mcast[i].source, conn);
+		memcpy(&req_exec_cpg_mcast[i].group_name, &cpd->group_name,
+			sizeof(mar_cpg_name_t));
+
+		req_exec_cpg_iovec[i * 2].iov_base = (char *)&req_exec_cpg_mcast[i];
+		req_exec_cpg_iovec[i * 2].iov_len = sizeof(struct req_exec_cpg_mcast);
+		req_exec_cpg_iovec[i * 2 + 1].iov_base = (char *)item->message;
+		req_exec_cpg_iovec[i * 2 + 1].iov_len = item->msglen;
+		iov_lens[i] = 2;
+
+		offset += sizeof (struct cpg_mcast_batch_item) + item->msglen;
+		offset = (offset + CPG_MCAST_BATCH_ALIGN - 1) & ~((size_t)CPG_MCAST_BATCH_ALIGN - 1);
+	}
+
+	if (error == CS_OK) {
+		queued = api->totem_mcast_multi (req_exec_cpg_iovec, iov_lens,
+			msg_count, TOTEM_AGREED);
+		if (queued != msg_count) {
+			error = CS_ERR_TRY_AGAIN;
+		}
+	} else {
+		log_printf(LOGSYS_LEVEL_ERROR, "*** %p can't mcast batch to group %s state:%d, error:%d",
+			conn, cpd->group_name.value, cpd->cpd_state, error);
+	}
+
+	res_lib_cpg_mcast_batch.header.size = sizeof(res_lib_cpg_mcast_batch);
+	res_lib_cpg_mcast_batch.header.id = MESSAGE_RES_CPG_MCAST_BATCH;
+	res_lib_cpg_mcast_batch.header.error = error;
+	res_lib_cpg_mcast_batch.msgs_queued = queued;
+
+	api->ipc_response_send (conn, &res_lib_cpg_mcast_batch,
+		sizeof (res_lib_cpg_mcast_batch));
+}
+
 static void message_handler_req_lib_cpg_zc_alloc (
 	void *conn,
 	const void *message)
@@ -1875,22 +2274,410 @@ static void message_handler_req_lib_cpg_zc_free (
 		res_header.size);
 }
 
-/* Fragmented mcast message from the library */
-static void message_handler_req_lib_cpg_partial_mcast (void *conn, const void *message)
+static struct cpg_zcb_recv_chunk_header *zcb_recv_chunk_header (
+	struct zcb_recv_pool *pool,
+	struct zcb_recv_chunk *chunk)
 {
-	const struct req_lib_cpg_partial_mcast *req_lib_cpg_mcast = message;
+	return ((struct cpg_zcb_recv_chunk_header *)(pool->addr + chunk->offset));
+}
+
+static size_t zcb_recv_chunk_data_offset (struct zcb_recv_chunk *chunk)
+{
+	return (chunk->offset + sizeof (struct cpg_zcb_recv_chunk_header));
+}
+
+/*
+ * Returns non-zero if chunk can be reused. A chunk still being assembled
+ * is never reused, whatever the library wrote into its header.
+ */
+static int zcb_recv_chunk_reclaimable (
+	struct zcb_recv_pool *pool,
+	struct zcb_recv_chunk *chunk)
+{
+	switch (chunk->state) {
+	case ZCB_RECV_CHUNK_DROPPED:
+		return (1);
+	case ZCB_RECV_CHUNK_DELIVERED:
+		return (__atomic_load_n (&zcb_recv_chunk_header (pool, chunk)->released,
+			__ATOMIC_ACQUIRE) != 0);
+	case ZCB_RECV_CHUNK_ASSEMBLING:
+	default:
+		return (0);
+	}
+}
+
+/*
+ * Free chunks at the tail of the ring which were released by the library
+ * or dropped by the daemon
+ */
+static void zcb_recv_reclaim (struct zcb_recv_pool *pool)
+{
+	struct zcb_recv_chunk *chunk;
+
+	while (!qb_list_empty (&pool->chunk_list_head)) {
+		chunk = qb_list_first_entry (&pool->chunk_list_head, struct zcb_recv_chunk, list);
+		if (!zcb_recv_chunk_reclaimable (pool, chunk)) {
+			break;
+		}
+		pool->used -= chunk->size;
+		qb_list_del (&chunk->list);
+		free (chunk);
+	}
+
+	if (qb_list_empty (&pool->chunk_list_head)) {
+		pool->head = 0;
+		pool->used = 0;
+	}
+}
+
+/*
+ * Returns NULL if the pool has no room, the message is then delivered
+ * the usual way
+ */
+static struct zcb_recv_chunk *zcb_recv_alloc (
+	struct zcb_recv_pool *pool,
+	uint32_t msglen)
+{
+	struct zcb_recv_chunk *chunk;
+	struct cpg_zcb_recv_chunk_header *header;
+	size_t need;
+	size_t skip = 0;
+	size_t offset = pool->head;
+
+	zcb_recv_reclaim (pool);
+
+	need = sizeof (struct cpg_zcb_recv_chunk_header) + msglen;
+	need = (need + CPG_ZCB_RECV_ALIGN - 1) & ~((size_t)CPG_ZCB_RECV_ALIGN - 1);
+	if (need > pool->size) {
+		return (NULL);
+	}
+
+	if (pool->head + need > pool->size) {
+		skip = pool->size - pool->head;
+		offset = 0;
+	}
+	if (pool->used + skip + need > pool->size) {
+		return (NULL);
+	}
+
+	chunk = malloc (sizeof (struct zcb_recv_chunk));
+	if (chunk == NULL) {
+		return (NULL);
+	}
+	chunk->offset = offset;
+	chunk->size = skip + need;
+	chunk->state = ZCB_RECV_CHUNK_ASSEMBLING;
+	qb_list_init (&chunk->list);
+	qb_list_add_tail (&chunk->list, &pool->chunk_list_head);
+
+	header = zcb_recv_chunk_header (pool, chunk);
+	header->msglen = msglen;
+	__atomic_store_n (&header->released, 0, __ATOMIC_RELEASE);
+
+	pool->head = (offset + need) % pool->size;
+	pool->used += chunk->size;
+
+	return (chunk);
+}
+
+/*
+ * Chunk which never reaches the library is released by the daemon
+ */
+static void zcb_recv_chunk_drop (
+	struct zcb_recv_pool *pool,
+	struct zcb_recv_chunk *chunk)
+{
+	chunk->state = ZCB_RECV_CHUNK_DROPPED;
+}
+
+static void zcb_recv_assembly_drop (
+	struct zcb_recv_pool *pool,
+	struct zcb_recv_assembly *assembly)
+{
+	zcb_recv_chunk_drop (pool, assembly->chunk);
+	qb_list_del (&assembly->list);
+	free (assembly);
+}
+
+static struct zcb_recv_assembly *zcb_recv_assembly_find (
+	struct zcb_recv_pool *pool,
+	unsigned int nodeid,
+	uint32_t pid)
+{
+	struct qb_list_head *iter;
+	struct zcb_recv_assembly *assembly;
+
+	qb_list_for_each(iter, &pool->assembly_list_head) {
+		assembly = qb_list_entry (iter, struct zcb_recv_assembly, list);
+		if (assembly->nodeid == nodeid && assembly->pid == pid) {
+			return (assembly);
+		}
+	}
+	return (NULL);
+}
+
+static void zcb_recv_deliver_send (
+	struct cpg_pd *cpd,
+	const mar_cpg_name_t *group_name,
+	unsigned int nodeid,
+	uint32_t pid,
+	struct zcb_recv_chunk *chunk,
+	uint32_t msglen)
+{
+	struct res_lib_cpg_zc_deliver_callback res_lib_cpg_zc_deliver;
+
+	res_lib_cpg_zc_deliver.header.id = MESSAGE_RES_CPG_ZC_DELIVER_CALLBACK;
+	res_lib_cpg_zc_deliver.header.size = sizeof (res_lib_cpg_zc_deliver);
+	res_lib_cpg_zc_deliver.header.error = CS_OK;
+	memcpy (&res_lib_cpg_zc_deliver.group_name, group_name, sizeof (mar_cpg_name_t));
+	res_lib_cpg_zc_deliver.msglen = msglen;
+	res_lib_cpg_zc_deliver.nodeid = nodeid;
+	res_lib_cpg_zc_deliver.pid = pid;
+	res_lib_cpg_zc_deliver.offset = zcb_recv_chunk_data_offset (chunk);
+
+	/*
+	 * A released flag set by the library before the chunk was handed
+	 * over is ignored
+	 */
+	__atomic_store_n (&zcb_recv_chunk_header (cpd->zcb_recv, chunk)->released, 0,
+		__ATOMIC_RELEASE);
+	chunk->state = ZCB_RECV_CHUNK_DELIVERED;
+	if (api->ipc_dispatch_send (cpd->conn, &res_lib_cpg_zc_deliver,
+		sizeof (res_lib_cpg_zc_deliver)) != 0) {
+
+		zcb_recv_chunk_drop (cpd->zcb_recv, chunk);
+	}
+}
+
+/*
+ * Returns 0 if the message was delivered through the receive pool
+ */
+static int zcb_recv_deliver (
+	struct cpg_pd *cpd,
+	const mar_cpg_name_t *group_name,
+	unsigned int nodeid,
+	uint32_t pid,
+	const void *msg,
+	uint32_t msglen)
+{
+	struct zcb_recv_pool *pool = cpd->zcb_recv;
+	struct zcb_recv_chunk *chunk;
+
+	if (msglen < pool->min_size) {
+		return (-1);
+	}
+
+	chunk = zcb_recv_alloc (pool, msglen);
+	if (chunk == NULL) {
+		return (-1);
+	}
+
+	memcpy (pool->addr + zcb_recv_chunk_data_offset (chunk), msg, msglen);
+	zcb_recv_deliver_send (cpd, group_name, nodeid, pid, chunk, msglen);
+
+	return (0);
+}
+
+/*
+ * Fragments are assembled straight in the receive pool. Returns 0 if the
+ * fragment was consumed, -1 if the message goes the usual way (it is too
+ * small, the pool had no room for it at its first fragment or it started
+ * before the pool was enabled).
+ */
+static int zcb_recv_partial_deliver (
+	struct cpg_pd *cpd,
+	const struct req_exec_cpg_partial_mcast *req_exec_cpg_mcast,
+	unsigned int nodeid,
+	const void *fragment)
+{
+	struct zcb_recv_pool *pool = cpd->zcb_recv;
+	struct zcb_recv_assembly *assembly;
+	struct zcb_recv_chunk *chunk;
+
+	assembly = zcb_recv_assembly_find (pool, nodeid, req_exec_cpg_mcast->pid);
+
+	if (req_exec_cpg_mcast->type == LIBCPG_PARTIAL_FIRST) {
+		/*
+		 * Previous message of the sender was interrupted
+		 */
+		if (assembly != NULL) {
+			zcb_recv_assembly_drop (pool, assembly);
+			assembly = NULL;
+		}
+
+		if (req_exec_cpg_mcast->msglen < pool->min_size) {
+			return (-1);
+		}
+
+		chunk = zcb_recv_alloc (pool, req_exec_cpg_mcast->msglen);
+		if (chunk == NULL) {
+			return (-1);
+		}
+
+		assembly = malloc (sizeof (struct zcb_recv_assembly));
+		if (assembly == NULL) {
+			zcb_recv_chunk_drop (pool, chunk);
+			return (-1);
+		}
+		assembly->nodeid = nodeid;
+		assembly->pid = req_exec_cpg_mcast->pid;
+		assembly->chunk = chunk;
+		assembly->msglen = req_exec_cpg_mcast->msglen;
+		assembly->filled = 0;
+		qb_list_init (&assembly->list);
+		qb_list_add (&assembly->list, &pool->assembly_list_head);
+	}
+
+	if (assembly == NULL) {
+		return (-1);
+	}
+
+	if (req_exec_cpg_mcast->fraglen > assembly->msglen - assembly->filled) {
+		log_printf(LOGSYS_LEVEL_WARNING,
+			"Fragment of node " CS_PRI_NODE_ID " pid %u overflows its message, dropping message",
+			nodeid, assembly->pid);
+		zcb_recv_assembly_drop (pool, assembly);
+		return (0);
+	}
+
+	memcpy (pool->addr + zcb_recv_chunk_data_offset (assembly->chunk) + assembly->filled,
+		fragment, req_exec_cpg_mcast->fraglen);
+	assembly->filled += req_exec_cpg_mcast->fraglen;
+
+	if (req_exec_cpg_mcast->type == LIBCPG_PARTIAL_LAST) {
+		zcb_recv_deliver_send (cpd, &req_exec_cpg_mcast->group_name, nodeid,
+			assembly->pid, assembly->chunk, assembly->filled);
+		qb_list_del (&assembly->list);
+		free (assembly);
+	}
+
+	return (0);
+}
+
+/*
+ * Messages of senders which left will never be completed
+ */
+static void zcb_recv_senders_left (
+	struct cpg_pd *cpd,
+	int left_list_entries,
+	const mar_cpg_address_t *left_list)
+{
+	struct zcb_recv_assembly *assembly;
+	int i;
+
+	for (i = 0; i < left_list_entries; i++) {
+		assembly = zcb_recv_assembly_find (cpd->zcb_recv, left_list[i].nodeid,
+			left_list[i].pid);
+		if (assembly != NULL) {
+			zcb_recv_assembly_drop (cpd->zcb_recv, assembly);
+		}
+	}
+}
+
+static void zcb_recv_free (
+	struct cpg_pd *cpd)
+{
+	struct zcb_recv_pool *pool = cpd->zcb_recv;
+	struct qb_list_head *iter, *tmp_iter;
+
+	if (pool == NULL) {
+		return ;
+	}
+
+	qb_list_for_each_safe(iter, tmp_iter, &pool->assembly_list_head) {
+		struct zcb_recv_assembly *assembly = qb_list_entry (iter, struct zcb_recv_assembly, list);
+
+		qb_list_del (&assembly->list);
+		free (assembly);
+	}
+	qb_list_for_each_safe(iter, tmp_iter, &pool->chunk_list_head) {
+		struct zcb_recv_chunk *chunk = qb_list_entry (iter, struct zcb_recv_chunk, list);
+
+		qb_list_del (&chunk->list);
+		free (chunk);
+	}
+
+	munmap (pool->addr, pool->size);
+	free (pool);
+	cpd->zcb_recv = NULL;
+}
+
+static void message_handler_req_lib_cpg_zc_recv_enable (
+	void *conn,
+	const void *message)
+{
+	const struct req_lib_cpg_zc_recv_enable *req_lib_cpg_zc_recv_enable = message;
+	struct res_lib_cpg_zc_recv_enable res_lib_cpg_zc_recv_enable;
 	struct cpg_pd *cpd = (struct cpg_pd *)api->ipc_private_data_get (conn);
+	struct zcb_recv_pool *pool;
+	char path[CPG_ZC_PATH_LEN];
+	void *addr;
+	cs_error_t error = CS_OK;
+
+	memcpy (path, req_lib_cpg_zc_recv_enable->path_to_file, CPG_ZC_PATH_LEN);
+	path[CPG_ZC_PATH_LEN - 1] = '\0';
+
+	log_printf(LOGSYS_LEVEL_DEBUG, "receive zero copy pool path: %s size: %"PRIu64,
+		path, (uint64_t)req_lib_cpg_zc_recv_enable->map_size);
+
+	if (cpd->zcb_recv != NULL) {
+		error = CS_ERR_EXIST;
+		goto response_send;
+	}
+
+	if (req_lib_cpg_zc_recv_enable->map_size < CPG_ZCB_RECV_ALIGN ||
+	    req_lib_cpg_zc_recv_enable->map_size > SIZE_MAX ||
+	    req_lib_cpg_zc_recv_enable->min_size == 0) {
+		error = CS_ERR_INVALID_PARAM;
+		goto response_send;
+	}
+
+	pool = malloc (sizeof (struct zcb_recv_pool));
+	if (pool == NULL) {
+		error = CS_ERR_NO_MEMORY;
+		goto response_send;
+	}
+
+	if (memory_map (path, req_lib_cpg_zc_recv_enable->map_size, &addr) == -1) {
+		free (pool);
+		error = CS_ERR_LIBRARY;
+		goto response_send;
+	}
+
+	memset (pool, 0, sizeof (struct zcb_recv_pool));
+	pool->addr = addr;
+	pool->size = req_lib_cpg_zc_recv_enable->map_size;
+	pool->min_size = req_lib_cpg_zc_recv_enable->min_size;
+	qb_list_init (&pool->chunk_list_head);
+	qb_list_init (&pool->assembly_list_head);
+	cpd->zcb_recv = pool;
+
+response_send:
+	res_lib_cpg_zc_recv_enable.header.size = sizeof (res_lib_cpg_zc_recv_enable);
+	res_lib_cpg_zc_recv_enable.header.id = MESSAGE_RES_CPG_ZC_RECV_ENABLE;
+	res_lib_cpg_zc_recv_enable.header.error = error;
+	api->ipc_response_send (conn, &res_lib_cpg_zc_recv_enable,
+		sizeof (res_lib_cpg_zc_recv_enable));
+}
+
+/* Fragmented mcast message from the library */
+static cs_error_t cpg_partial_mcast_send (
+	void *conn,
+	struct cpg_pd *cpd,
+	uint32_t msglen,
+	uint32_t fraglen,
+	uint32_t type,
+	const void *message)
+{
 	mar_cpg_name_t group_name = cpd->group_name;
 
 	struct iovec req_exec_cpg_iovec[2];
 	struct req_exec_cpg_partial_mcast req_exec_cpg_mcast;
-	struct res_lib_cpg_partial_send res_lib_cpg_partial_send;
-	int msglen = req_lib_cpg_mcast->fraglen;
 	int result;
 	cs_error_t error = CS_ERR_NOT_EXIST;
 
 	log_printf(LOGSYS_LEVEL_TRACE, "got fragmented mcast request on %p", conn);
-	log_printf(LOGSYS_LEVEL_DEBUG, "Sending fragmented message size = %d bytes\n", msglen);
+	log_printf(LOGSYS_LEVEL_DEBUG, "Sending fragmented message size = %d bytes\n", fraglen);
 
 	switch (cpd->cpd_state) {
 	case CPD_STATE_UNJOINED:
@@ -1907,10 +2694,7 @@ static void message_handler_req_lib_cpg_partial_mcast (void *conn, const void *m
 		break;
 	}
 
-	res_lib_cpg_partial_send.header.size = sizeof(res_lib_cpg_partial_send);
-	res_lib_cpg_partial_send.header.id = MESSAGE_RES_CPG_PARTIAL_SEND;
-
-	if (req_lib_cpg_mcast->type == LIBCPG_PARTIAL_FIRST) {
+	if (type == LIBCPG_PARTIAL_FIRST) {
 		cpd->initial_transition_counter = cpd->transition_counter;
 	}
 	if (cpd->transition_counter != cpd->initial_transition_counter) {
@@ -1918,21 +2702,21 @@ static void message_handler_req_lib_cpg_partial_mcast (void *conn, const void *m
 	}
 
 	if (error == CS_OK) {
-		req_exec_cpg_mcast.header.size = sizeof(req_exec_cpg_mcast) + msglen;
+		req_exec_cpg_mcast.header.size = sizeof(req_exec_cpg_mcast) + fraglen;
 		req_exec_cpg_mcast.header.id = SERVICE_ID_MAKE(CPG_SERVICE,
 							       MESSAGE_REQ_EXEC_CPG_PARTIAL_MCAST);
 		req_exec_cpg_mcast.pid = cpd->pid;
-		req_exec_cpg_mcast.msglen = req_lib_cpg_mcast->msglen;
-		req_exec_cpg_mcast.type = req_lib_cpg_mcast->type;
-		req_exec_cpg_mcast.fraglen = req_lib_cpg_mcast->fraglen;
+		req_exec_cpg_mcast.msglen = msglen;
+		req_exec_cpg_mcast.type = type;
+		req_exec_cpg_mcast.fraglen = fraglen;
 		api->ipc_source_set (&req_exec_cpg_mcast.source, conn);
 		memcpy(&req_exec_cpg_mcast.group_name, &group_name,
 		       sizeof(mar_cpg_name_t));
 
 		req_exec_cpg_iovec[0].iov_base = (char *)&req_exec_cpg_mcast;
 		req_exec_cpg_iovec[0].iov_len = sizeof(req_exec_cpg_mcast);
-		req_exec_cpg_iovec[1].iov_base = (char *)&req_lib_cpg_mcast->message;
-		req_exec_cpg_iovec[1].iov_len = msglen;
+		req_exec_cpg_iovec[1].iov_base = (char *)message;
+		req_exec_cpg_iovec[1].iov_len = fraglen;
 
 		result = api->totem_mcast (req_exec_cpg_iovec, 2, TOTEM_AGREED);
 		assert(result == 0);
@@ -1941,11 +2725,137 @@ static void message_handler_req_lib_cpg_partial_mcast (void *conn, const void *m
 			   conn, group_name.value, cpd->cpd_state, error);
 	}
 
+	return (error);
+}
+
+static void message_handler_req_lib_cpg_partial_mcast (void *conn, const void *message)
+{
+	const struct req_lib_cpg_partial_mcast *req_lib_cpg_mcast = message;
+	struct cpg_pd *cpd = (struct cpg_pd *)api->ipc_private_data_get (conn);
+	struct res_lib_cpg_partial_send res_lib_cpg_partial_send;
+
+	res_lib_cpg_partial_send.header.size = sizeof(res_lib_cpg_partial_send);
+	res_lib_cpg_partial_send.header.id = MESSAGE_RES_CPG_PARTIAL_SEND;
+	res_lib_cpg_partial_send.header.error = cpg_partial_mcast_send (conn, cpd,
+		req_lib_cpg_mcast->msglen, req_lib_cpg_mcast->fraglen,
+		req_lib_cpg_mcast->type, req_lib_cpg_mcast->message);
+
+	api->ipc_response_send (conn, &res_lib_cpg_partial_send,
+				sizeof (res_lib_cpg_partial_send));
+}
+
+static void message_handler_req_lib_cpg_partial_mcast_pipelined (void *conn, const void *message)
+{
+	const struct req_lib_cpg_partial_mcast_pipelined *req_lib_cpg_mcast = message;
+	struct cpg_pd *cpd = (struct cpg_pd *)api->ipc_private_data_get (conn);
+	struct res_lib_cpg_partial_send res_lib_cpg_partial_send;
+	cs_error_t error;
+
+	if (req_lib_cpg_mcast->type == LIBCPG_PARTIAL_FIRST) {
+		cpd->partial_next_seq = req_lib_cpg_mcast->seq;
+	}
+
+	if (req_lib_cpg_mcast->seq != cpd->partial_next_seq) {
+		/*
+		 * Earlier fragment was refused (flow control), the library
+		 * resends starting with that one
+		 */
+		error = CS_ERR_TRY_AGAIN;
+	} else {
+		error = cpg_partial_mcast_send (conn, cpd,
+			req_lib_cpg_mcast->msglen, req_lib_cpg_mcast->fraglen,
+			req_lib_cpg_mcast->type, req_lib_cpg_mcast->message);
+		if (error == CS_OK) {
+			cpd->partial_next_seq++;
+		}
+	}
+
+	res_lib_cpg_partial_send.header.size = sizeof(res_lib_cpg_partial_send);
+	res_lib_cpg_partial_send.header.id = MESSAGE_RES_CPG_PARTIAL_SEND;
 	res_lib_cpg_partial_send.header.error = error;
+
 	api->ipc_response_send (conn, &res_lib_cpg_partial_send,
 				sizeof (res_lib_cpg_partial_send));
 }
 
+/*
+ * Account one processed mcast request of a connection in async mode.
+ * Completions are reported once half of the library's window is used up,
+ * so the library never waits for a status which isn't coming. The first
+ * failure since the last status is reported right away.
+ */
+static void cpg_mcast_async_done (
+	void *conn,
+	struct cpg_pd *cpd,
+	cs_error_t error)
+{
+	struct res_lib_cpg_mcast_status_callback res_lib_cpg_mcast_status_callback;
+
+	if (cpd->async_window == 0) {
+		return;
+	}
+
+	cpd->async_completed++;
+	if (error != CS_OK) {
+		cpd->async_failed++;
+		cpd->async_error = error;
+	}
+
+	if (cpd->async_completed < (cpd->async_window + 1) / 2 &&
+	    !(error != CS_OK && cpd->async_failed == 1)) {
+		return;
+	}
+
+	res_lib_cpg_mcast_status_callback.header.size = sizeof(res_lib_cpg_mcast_status_callback);
+	res_lib_cpg_mcast_status_callback.header.id = MESSAGE_RES_CPG_MCAST_STATUS_CALLBACK;
+	res_lib_cpg_mcast_status_callback.header.error = CS_OK;
+	res_lib_cpg_mcast_status_callback.completed = cpd->async_completed;
+	res_lib_cpg_mcast_status_callback.failed = cpd->async_failed;
+	res_lib_cpg_mcast_status_callback.error = cpd->async_error;
+
+	/*
+	 * The library doesn't send more requests until it gets the status, so
+	 * it must not be dropped by the outq budget. If it is lost anyway,
+	 * the counters are kept and reported by the next status.
+	 */
+	if (api->ipc_dispatch_send_exempt (conn, &res_lib_cpg_mcast_status_callback,
+	    sizeof(res_lib_cpg_mcast_status_callback)) != 0) {
+		return;
+	}
+
+	cpd->async_completed = 0;
+	cpd->async_failed = 0;
+	cpd->async_error = CS_OK;
+}
+
+static void message_refused_req_lib_cpg_mcast (void *conn, const void *message, cs_error_t error)
+{
+	struct cpg_pd *cpd = (struct cpg_pd *)api->ipc_private_data_get (conn);
+
+	cpg_mcast_async_done (conn, cpd, error);
+}
+
+static void message_handler_req_lib_cpg_mcast_async_enable (void *conn, const void *message)
+{
+	const struct req_lib_cpg_mcast_async_enable *req_lib_cpg_mcast_async_enable = message;
+	struct cpg_pd *cpd = (struct cpg_pd *)api->ipc_private_data_get (conn);
+	struct res_lib_cpg_mcast_async_enable res_lib_cpg_mcast_async_enable;
+	cs_error_t error = CS_OK;
+
+	if (req_lib_cpg_mcast_async_enable->window == 0 || cpd->async_window != 0) {
+		error = CS_ERR_INVALID_PARAM;
+	} else {
+		cpd->async_window = req_lib_cpg_mcast_async_enable->window;
+	}
+
+	res_lib_cpg_mcast_async_enable.header.size = sizeof(res_lib_cpg_mcast_async_enable);
+	res_lib_cpg_mcast_async_enable.header.id = MESSAGE_RES_CPG_MCAST_ASYNC_ENABLE;
+	res_lib_cpg_mcast_async_enable.header.error = error;
+
+	api->ipc_response_send (conn, &res_lib_cpg_mcast_async_enable,
+		sizeof (res_lib_cpg_mcast_async_enable));
+}
+
 /* Mcast message from the library */
 static void message_handler_req_lib_cpg_mcast (void *conn, const void *message)
 {
@@ -1997,6 +2907,8 @@ static void message_handler_req_lib_cpg_mcast (void *conn, const void *message)
 		log_printf(LOGSYS_LEVEL_ERROR, "*** %p can't mcast to group %s state:%d, error:%d",
 			conn, group_name.value, cpd->cpd_state, error);
 	}
+
+	cpg_mcast_async_done (conn, cpd, error);
 }
 
 static void message_handler_req_lib_cpg_zc_execute (
@@ -38,44 +38,321 @@
 #include <string.h>
 #include <stdlib.h>
 #include <pthread.h>
+#include <sched.h>
 #include <errno.h>
 #include "assert.h"
 
+#define CS_QUEUE_CACHE_LINE 64
+
+/*
+ * Queue synchronization modes selected at cs_queue_init time
+ *
+ * CS_QUEUE_UNLOCKED and CS_QUEUE_MUTEX keep the historical behaviour of the
+ * threaded_mode_enabled argument (0 and 1).  CS_QUEUE_SPSC and CS_QUEUE_MPSC
+ * use a lock-free ring with power-of-two sizing.  With SPSC exactly one thread
+ * may add items and exactly one thread may get/remove/iterate them.  MPSC
+ * allows any number of producers but still a single consumer.  In both
+ * lock-free modes cs_queue_reinit must only be called while the queue is
+ * quiescent.
+ *
+ * Queues created with cs_queue_init_growable (CS_QUEUE_UNLOCKED and
+ * CS_QUEUE_MUTEX only) start with size_min items, double when full up to
+ * size_max items and go back to size_min with cs_queue_shrink once empty.
+ */
+enum cs_queue_mode {
+	CS_QUEUE_UNLOCKED = 0,
+	CS_QUEUE_MUTEX = 1,
+	CS_QUEUE_SPSC = 2,
+	CS_QUEUE_MPSC = 3
+};
+
 struct cs_queue {
 	int head;
 	int tail;
 	int used;
 	int usedhw;
 	int size;
+	int size_min;
+	int size_max;
 	void *items;
 	int size_per_item;
 	int iterator;
 	pthread_mutex_t mutex;
 	int threaded_mode_enabled;
+	enum cs_queue_mode mode;
+	unsigned int mask;
+	unsigned int *seqs;
+	/*
+	 * Lock-free ring indexes, free running and kept on separate
+	 * cache lines so producer and consumer don't bounce one line
+	 */
+	char pad0[CS_QUEUE_CACHE_LINE];
+	unsigned int prod_head;
+	char pad1[CS_QUEUE_CACHE_LINE - sizeof (unsigned int)];
+	unsigned int cons_tail;
+	unsigned int cons_iterator;
+	char pad2[CS_QUEUE_CACHE_LINE - 2 * sizeof (unsigned int)];
 };
 
-static inline int cs_queue_init (struct cs_queue *cs_queue, int cs_queue_items, int size_per_item, int threaded_mode_enabled) {
+static inline int cs_queue_lockfree (struct cs_queue *cs_queue)
+{
+	return (cs_queue->mode == CS_QUEUE_SPSC || cs_queue->mode == CS_QUEUE_MPSC);
+}
+
+static inline void cs_queue_lf_reset (struct cs_queue *cs_queue)
+{
+	unsigned int i;
+
+	cs_queue->usedhw = 0;
+	cs_queue->cons_iterator = 0;
+	if (cs_queue->mode == CS_QUEUE_MPSC) {
+		for (i = 0; i < (unsigned int)cs_queue->size; i++) {
+			__atomic_store_n (&cs_queue->seqs[i], i, __ATOMIC_RELAXED);
+		}
+	}
+	__atomic_store_n (&cs_queue->prod_head, 0, __ATOMIC_RELAXED);
+	__atomic_store_n (&cs_queue->cons_tail, 0, __ATOMIC_RELEASE);
+}
+
+static inline char *cs_queue_lf_slot (struct cs_queue *cs_queue, unsigned int pos)
+{
+	return ((char *)cs_queue->items + (pos & cs_queue->mask) * cs_queue->size_per_item);
+}
+
+static inline int cs_queue_lf_used (struct cs_queue *cs_queue)
+{
+	unsigned int head;
+	unsigned int tail;
+
+	tail = __atomic_load_n (&cs_queue->cons_tail, __ATOMIC_ACQUIRE);
+	head = __atomic_load_n (&cs_queue->prod_head, __ATOMIC_ACQUIRE);
+	return ((int)(head - tail));
+}
+
+/*
+ * Consumer side check whether the item at pos has been published
+ */
+static inline int cs_queue_lf_ready (struct cs_queue *cs_queue, unsigned int pos)
+{
+	if (cs_queue->mode == CS_QUEUE_MPSC) {
+		return (__atomic_load_n (&cs_queue->seqs[pos & cs_queue->mask],
+			__ATOMIC_ACQUIRE) == pos + 1);
+	}
+	return (__atomic_load_n (&cs_queue->prod_head, __ATOMIC_ACQUIRE) != pos);
+}
+
+static inline void cs_queue_lf_item_add (struct cs_queue *cs_queue, void *item)
+{
+	unsigned int pos;
+	unsigned int seq;
+	int used;
+
+	if (cs_queue->mode == CS_QUEUE_SPSC) {
+		pos = __atomic_load_n (&cs_queue->prod_head, __ATOMIC_RELAXED);
+		assert ((int)(pos - __atomic_load_n (&cs_queue->cons_tail,
+			__ATOMIC_ACQUIRE)) < cs_queue->size - 1);
+		memcpy (cs_queue_lf_slot (cs_queue, pos), item, cs_queue->size_per_item);
+		__atomic_store_n (&cs_queue->prod_head, pos + 1, __ATOMIC_RELEASE);
+	} else {
+		/*
+		 * Reserve a slot by advancing prod_head, then publish it
+		 * through the slot sequence so the consumer never sees a
+		 * partially copied item.  Producers racing between
+		 * cs_queue_is_full and here may find the ring really full,
+		 * in that case wait for the consumer to free the slot.
+		 */
+		pos = __atomic_load_n (&cs_queue->prod_head, __ATOMIC_RELAXED);
+		for (;;) {
+			seq = __atomic_load_n (&cs_queue->seqs[pos & cs_queue->mask],
+				__ATOMIC_ACQUIRE);
+			if (seq == pos) {
+				if (__atomic_compare_exchange_n (&cs_queue->prod_head,
+					&pos, pos + 1, 1,
+					__ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+					break;
+				}
+			} else {
+				if ((int)(seq - pos) < 0) {
+					sched_yield ();
+				}
+				pos = __atomic_load_n (&cs_queue->prod_head, __ATOMIC_RELAXED);
+			}
+		}
+		memcpy (cs_queue_lf_slot (cs_queue, pos), item, cs_queue->size_per_item);
+		__atomic_store_n (&cs_queue->seqs[pos & cs_queue->mask], pos + 1,
+			__ATOMIC_RELEASE);
+	}
+
+	/*
+	 * usedhw is statistics only, a lost update between producers is fine
+	 */
+	used = cs_queue_lf_used (cs_queue);
+	if (used > __atomic_load_n (&cs_queue->usedhw, __ATOMIC_RELAXED)) {
+		__atomic_store_n (&cs_queue->usedhw, used, __ATOMIC_RELAXED);
+	}
+}
+
+static inline void cs_queue_lf_items_remove (struct cs_queue *cs_queue, int rel_count)
+{
+	unsigned int tail;
+	int i;
+
+	tail = __atomic_load_n (&cs_queue->cons_tail, __ATOMIC_RELAXED);
+	assert (rel_count <= (int)(__atomic_load_n (&cs_queue->prod_head,
+		__ATOMIC_ACQUIRE) - tail));
+	if (cs_queue->mode == CS_QUEUE_MPSC) {
+		for (i = 0; i < rel_count; i++) {
+			__atomic_store_n (&cs_queue->seqs[(tail + i) & cs_queue->mask],
+				tail + i + cs_queue->size, __ATOMIC_RELEASE);
+		}
+	}
+	__atomic_store_n (&cs_queue->cons_tail, tail + rel_count, __ATOMIC_RELEASE);
+}
+
+static inline int cs_queue_init (struct cs_queue *cs_queue, int cs_queue_items, int size_per_item, int mode) {
+	cs_queue->mode = (enum cs_queue_mode)mode;
+	cs_queue->seqs = NULL;
+	if (cs_queue_lockfree (cs_queue)) {
+		/*
+		 * Power-of-two sizing lets the free running indexes wrap
+		 * with a mask instead of a division
+		 */
+		cs_queue->size = 2;
+		while (cs_queue->size < cs_queue_items) {
+			cs_queue->size <<= 1;
+		}
+		cs_queue_items = cs_queue->size;
+		cs_queue->mask = cs_queue->size - 1;
+	}
+
 	cs_queue->head = 0;
 	cs_queue->tail = cs_queue_items - 1;
 	cs_queue->used = 0;
 	cs_queue->usedhw = 0;
+	cs_queue->iterator = 0;
 	cs_queue->size = cs_queue_items;
+	cs_queue->size_min = cs_queue_items;
+	cs_queue->size_max = cs_queue_items;
 	cs_queue->size_per_item = size_per_item;
-	cs_queue->threaded_mode_enabled = threaded_mode_enabled;
+	cs_queue->threaded_mode_enabled = (mode == CS_QUEUE_MUTEX);
 
 	cs_queue->items = malloc (cs_queue_items * size_per_item);
 	if (cs_queue->items == 0) {
 		return (-ENOMEM);
 	}
 	memset (cs_queue->items, 0, cs_queue_items * size_per_item);
+	if (cs_queue->mode == CS_QUEUE_MPSC) {
+		cs_queue->seqs = malloc (cs_queue_items * sizeof (unsigned int));
+		if (cs_queue->seqs == NULL) {
+			free (cs_queue->items);
+			return (-ENOMEM);
+		}
+	}
+	if (cs_queue_lockfree (cs_queue)) {
+		cs_queue_lf_reset (cs_queue);
+	}
 	if (cs_queue->threaded_mode_enabled) {
 		pthread_mutex_init (&cs_queue->mutex, NULL);
 	}
 	return (0);
 }
 
+static inline int cs_queue_init_growable (struct cs_queue *cs_queue,
+	int cs_queue_items_min, int cs_queue_items_max, int size_per_item, int mode)
+{
+	int res;
+
+	assert (mode == CS_QUEUE_UNLOCKED || mode == CS_QUEUE_MUTEX);
+	assert (cs_queue_items_min <= cs_queue_items_max);
+
+	res = cs_queue_init (cs_queue, cs_queue_items_min, size_per_item, mode);
+	if (res == 0) {
+		cs_queue->size_max = cs_queue_items_max;
+	}
+	return (res);
+}
+
+/*
+ * Double the ring, called with the mutex held. Items are moved so the
+ * oldest one ends up in slot 0.
+ */
+static inline int cs_queue_grow (struct cs_queue *cs_queue)
+{
+	char *items;
+	int new_size;
+	int first;
+	int i;
+
+	new_size = cs_queue->size * 2;
+	if (new_size > cs_queue->size_max) {
+		new_size = cs_queue->size_max;
+	}
+	items = malloc (new_size * cs_queue->size_per_item);
+	if (items == NULL) {
+		return (-ENOMEM);
+	}
+	memset (items, 0, new_size * cs_queue->size_per_item);
+
+	first = (cs_queue->tail + 1) % cs_queue->size;
+	for (i = 0; i < cs_queue->used; i++) {
+		memcpy (items + i * cs_queue->size_per_item,
+			(char *)cs_queue->items +
+			((first + i) % cs_queue->size) * cs_queue->size_per_item,
+			cs_queue->size_per_item);
+	}
+	cs_queue->iterator = (cs_queue->iterator - first + cs_queue->size) % cs_queue->size;
+
+	free (cs_queue->items);
+	cs_queue->items = items;
+	cs_queue->size = new_size;
+	cs_queue->head = cs_queue->used;
+	cs_queue->tail = new_size - 1;
+
+	return (0);
+}
+
+static inline void cs_queue_shrink (struct cs_queue *cs_queue)
+{
+	char *items;
+
+	if (cs_queue_lockfree (cs_queue)) {
+		return;
+	}
+	if (cs_queue->threaded_mode_enabled) {
+		pthread_mutex_lock (&cs_queue->mutex);
+	}
+	if (cs_queue->used == 0 && cs_queue->size > cs_queue->size_min) {
+		items = malloc (cs_queue->size_min * cs_queue->size_per_item);
+		if (items != NULL) {
+			memset (items, 0, cs_queue->size_min * cs_queue->size_per_item);
+			free (cs_queue->items);
+			cs_queue->items = items;
+			cs_queue->size = cs_queue->size_min;
+			cs_queue->head = 0;
+			cs_queue->tail = cs_queue->size - 1;
+			cs_queue->iterator = 0;
+		}
+	}
+	if (cs_queue->threaded_mode_enabled) {
+		pthread_mutex_unlock (&cs_queue->mutex);
+	}
+}
+
+/*
+ * Number of bytes held by the item array
+ */
+static inline size_t cs_queue_mem_get (struct cs_queue *cs_queue)
+{
+	return ((size_t)cs_queue->size * cs_queue->size_per_item);
+}
+
 static inline int cs_queue_reinit (struct cs_queue *cs_queue)
 {
+	if (cs_queue_lockfree (cs_queue)) {
+		memset (cs_queue->items, 0, cs_queue->size * cs_queue->size_per_item);
+		cs_queue_lf_reset (cs_queue);
+		return (0);
+	}
 	if (cs_queue->threaded_mode_enabled) {
 		pthread_mutex_lock (&cs_queue->mutex);
 	}
@@ -95,16 +372,21 @@ static inline void cs_queue_free (struct cs_queue *cs_queue) {
 	if (cs_queue->threaded_mode_enabled) {
 		pthread_mutex_destroy (&cs_queue->mutex);
 	}
+	free (cs_queue->seqs);
 	free (cs_queue->items);
 }
 
 static inline int cs_queue_is_full (struct cs_queue *cs_queue) {
 	int full;
 
+	if (cs_queue_lockfree (cs_queue)) {
+		return (cs_queue_lf_used (cs_queue) >= cs_queue->size - 1);
+	}
+
 	if (cs_queue->threaded_mode_enabled) {
 		pthread_mutex_lock (&cs_queue->mutex);
 	}
-	full = ((cs_queue->size - 1) == cs_queue->used);
+	full = ((cs_queue->size_max - 1) == cs_queue->used);
 	if (cs_queue->threaded_mode_enabled) {
 		pthread_mutex_unlock (&cs_queue->mutex);
 	}
@@ -114,6 +396,11 @@ static inline int cs_queue_is_full (struct cs_queue *cs_queue) {
 static inline int cs_queue_is_empty (struct cs_queue *cs_queue) {
 	int empty;
 
+	if (cs_queue_lockfree (cs_queue)) {
+		return (!cs_queue_lf_ready (cs_queue,
+			__atomic_load_n (&cs_queue->cons_tail, __ATOMIC_RELAXED)));
+	}
+
 	if (cs_queue->threaded_mode_enabled) {
 		pthread_mutex_lock (&cs_queue->mutex);
 	}
@@ -124,14 +411,33 @@ static inline int cs_queue_is_empty (struct cs_queue *cs_queue) {
 	return (empty);
 }
 
-static inline void cs_queue_item_add (struct cs_queue *cs_queue, void *item)
+/*
+ * Returns 0 on success, -ENOMEM if a growable queue needed more room and
+ * it could not be allocated. The item is not added in that case.
+ */
+static inline int cs_queue_item_add (struct cs_queue *cs_queue, void *item)
 {
 	char *cs_queue_item;
 	int cs_queue_position;
 
+	if (cs_queue_lockfree (cs_queue)) {
+		cs_queue_lf_item_add (cs_queue, item);
+		return (0);
+	}
+
 	if (cs_queue->threaded_mode_enabled) {
 		pthread_mutex_lock (&cs_queue->mutex);
 	}
+	if (cs_queue->used == cs_queue->size - 1 &&
+		cs_queue->size < cs_queue->size_max) {
+
+		if (cs_queue_grow (cs_queue) != 0) {
+			if (cs_queue->threaded_mode_enabled) {
+				pthread_mutex_unlock (&cs_queue->mutex);
+			}
+			return (-ENOMEM);
+		}
+	}
 	cs_queue_position = cs_queue->head;
 	cs_queue_item = cs_queue->items;
 	cs_queue_item += cs_queue_position * cs_queue->size_per_item;
@@ -147,6 +453,7 @@ static inline void cs_queue_item_add (struct cs_queue *cs_queue, void *item)
 	if (cs_queue->threaded_mode_enabled) {
 		pthread_mutex_unlock (&cs_queue->mutex);
 	}
+	return (0);
 }
 
 static inline void *cs_queue_item_get (struct cs_queue *cs_queue)
@@ -154,6 +461,11 @@ static inline void *cs_queue_item_get (struct cs_queue *cs_queue)
 	char *cs_queue_item;
 	int cs_queue_position;
 
+	if (cs_queue_lockfree (cs_queue)) {
+		return ((void *)cs_queue_lf_slot (cs_queue,
+			__atomic_load_n (&cs_queue->cons_tail, __ATOMIC_RELAXED)));
+	}
+
 	if (cs_queue->threaded_mode_enabled) {
 		pthread_mutex_lock (&cs_queue->mutex);
 	}
@@ -167,6 +479,10 @@ static inline void *cs_queue_item_get (struct cs_queue *cs_queue)
 }
 
 static inline void cs_queue_item_remove (struct cs_queue *cs_queue) {
+	if (cs_queue_lockfree (cs_queue)) {
+		cs_queue_lf_items_remove (cs_queue, 1);
+		return;
+	}
 	if (cs_queue->threaded_mode_enabled) {
 		pthread_mutex_lock (&cs_queue->mutex);
 	}
@@ -183,6 +499,10 @@ static inline void cs_queue_item_remove (struct cs_queue *cs_queue) {
 
 static inline void cs_queue_items_remove (struct cs_queue *cs_queue, int rel_count)
 {
+	if (cs_queue_lockfree (cs_queue)) {
+		cs_queue_lf_items_remove (cs_queue, rel_count);
+		return;
+	}
 	if (cs_queue->threaded_mode_enabled) {
 		pthread_mutex_lock (&cs_queue->mutex);
 	}
@@ -199,6 +519,11 @@ static inline void cs_queue_items_remove (struct cs_queue *cs_queue, int rel_cou
 
 static inline void cs_queue_item_iterator_init (struct cs_queue *cs_queue)
 {
+	if (cs_queue_lockfree (cs_queue)) {
+		cs_queue->cons_iterator = __atomic_load_n (&cs_queue->cons_tail,
+			__ATOMIC_RELAXED);
+		return;
+	}
 	if (cs_queue->threaded_mode_enabled) {
 		pthread_mutex_lock (&cs_queue->mutex);
 	}
@@ -213,6 +538,13 @@ static inline void *cs_queue_item_iterator_get (struct cs_queue *cs_queue)
 	char *cs_queue_item;
 	int cs_queue_position;
 
+	if (cs_queue_lockfree (cs_queue)) {
+		if (!cs_queue_lf_ready (cs_queue, cs_queue->cons_iterator)) {
+			return (0);
+		}
+		return ((void *)cs_queue_lf_slot (cs_queue, cs_queue->cons_iterator));
+	}
+
 	if (cs_queue->threaded_mode_enabled) {
 		pthread_mutex_lock (&cs_queue->mutex);
 	}
@@ -235,6 +567,11 @@ static inline int cs_queue_item_iterator_next (struct cs_queue *cs_queue)
 {
 	int next_res;
 
+	if (cs_queue_lockfree (cs_queue)) {
+		cs_queue->cons_iterator++;
+		return (!cs_queue_lf_ready (cs_queue, cs_queue->cons_iterator));
+	}
+
 	if (cs_queue->threaded_mode_enabled) {
 		pthread_mutex_lock (&cs_queue->mutex);
 	}
@@ -249,10 +586,17 @@ static inline int cs_queue_item_iterator_next (struct cs_queue *cs_queue)
 
 static inline void cs_queue_avail (struct cs_queue *cs_queue, int *avail)
 {
+	if (cs_queue_lockfree (cs_queue)) {
+		*avail = cs_queue->size - cs_queue_lf_used (cs_queue) - 2;
+		if (*avail < 0) {
+			*avail = 0;
+		}
+		return;
+	}
 	if (cs_queue->threaded_mode_enabled) {
 		pthread_mutex_lock (&cs_queue->mutex);
 	}
-	*avail = cs_queue->size - cs_queue->used - 2;
+	*avail = cs_queue->size_max - cs_queue->used - 2;
 	assert (*avail >= 0);
 	if (cs_queue->threaded_mode_enabled) {
 		pthread_mutex_unlock (&cs_queue->mutex);
@@ -262,6 +606,10 @@ static inline void cs_queue_avail (struct cs_queue *cs_queue, int *avail)
 static inline int cs_queue_used (struct cs_queue *cs_queue) {
 	int used;
 
+	if (cs_queue_lockfree (cs_queue)) {
+		return (cs_queue_lf_used (cs_queue));
+	}
+
 	if (cs_queue->threaded_mode_enabled) {
 		pthread_mutex_lock (&cs_queue->mutex);
 	}
@@ -276,6 +624,10 @@ static inline int cs_queue_used (struct cs_queue *cs_queue) {
 static inline int cs_queue_usedhw (struct cs_queue *cs_queue) {
 	int usedhw;
 
+	if (cs_queue_lockfree (cs_queue)) {
+		return (__atomic_load_n (&cs_queue->usedhw, __ATOMIC_RELAXED));
+	}
+
 	if (cs_queue->threaded_mode_enabled) {
 		pthread_mutex_lock (&cs_queue->mutex);
 	}
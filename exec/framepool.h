@@ -0,0 +1,231 @@
+/*
+ * Copyright (c) 2026 Red Hat, Inc.
+ *
+ * All rights reserved.
+ *
+ * This software licensed under BSD license, the text of which follows:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ * - Neither the name of the MontaVista Software, Inc. nor the names of its
+ *   contributors may be used to endorse or promote products derived from this
+ *   software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ * THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef FRAMEPOOL_H_DEFINED
+#define FRAMEPOOL_H_DEFINED
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+
+#include <corosync/totem/totem.h>
+
+/*
+ * Pool of fixed size frames
+ *
+ * low_watermark frames are carved out of one anonymous mapping at
+ * initialization and are never returned to the system. The mapping is
+ * touched by the initializing thread (the main loop), so with the default
+ * first-touch policy its pages are placed on that thread's NUMA node. When
+ * prefault is set every page is faulted in up front. Under mlockall with
+ * MCL_FUTURE the kernel populates the mapping itself.
+ *
+ * Frames allocated beyond the slab come from malloc. Released frames are
+ * kept on the free list while it holds fewer than high_watermark entries,
+ * otherwise they are freed.
+ *
+ * Hits, misses and the highest number of frames in use are accounted in
+ * stats.srp.
+ */
+struct frame_pool {
+	pthread_mutex_t mutex;
+
+	size_t frame_size;
+
+	char *slab;
+
+	size_t slab_len;
+
+	void *free_list;
+
+	unsigned int free_entries;
+
+	unsigned int in_use;
+
+	unsigned int high_watermark;
+
+	totemsrp_stats_t *stats;
+};
+
+static inline int frame_pool_slab_frame (
+	struct frame_pool *pool,
+	void *frame)
+{
+	return (pool->slab != NULL &&
+		(char *)frame >= pool->slab &&
+		(char *)frame < pool->slab + pool->slab_len);
+}
+
+static inline void frame_pool_push (
+	struct frame_pool *pool,
+	void *frame)
+{
+	*(void **)frame = pool->free_list;
+	pool->free_list = frame;
+	pool->free_entries += 1;
+}
+
+/*
+ * Returns 0 on success, -1 if the slab could not be mapped. The pool is
+ * usable in both cases, without slab every frame comes from malloc.
+ */
+static inline int frame_pool_init (
+	struct frame_pool *pool,
+	size_t frame_size,
+	unsigned int low_watermark,
+	unsigned int high_watermark,
+	int prefault,
+	totemsrp_stats_t *stats)
+{
+	size_t page_size;
+	size_t offset;
+	unsigned int i;
+
+	memset (pool, 0, sizeof (struct frame_pool));
+	pthread_mutex_init (&pool->mutex, NULL);
+
+	/*
+	 * Keep frames pointer aligned, the free list link lives in the frame
+	 */
+	pool->frame_size = (frame_size + sizeof (void *) - 1) &
+		~(sizeof (void *) - 1);
+	pool->high_watermark = high_watermark;
+	pool->stats = stats;
+
+	if (low_watermark == 0) {
+		return (0);
+	}
+
+	pool->slab_len = pool->frame_size * low_watermark;
+	pool->slab = mmap (NULL, pool->slab_len, PROT_READ | PROT_WRITE,
+		MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (pool->slab == MAP_FAILED) {
+		pool->slab = NULL;
+		pool->slab_len = 0;
+		return (-1);
+	}
+
+	if (prefault) {
+		page_size = sysconf (_SC_PAGESIZE);
+		for (offset = 0; offset < pool->slab_len; offset += page_size) {
+			pool->slab[offset] = 0;
+		}
+	}
+
+	/*
+	 * Push in reverse so frames are handed out in address order
+	 */
+	for (i = low_watermark; i > 0; i--) {
+		frame_pool_push (pool, pool->slab + (i - 1) * pool->frame_size);
+	}
+
+	return (0);
+}
+
+static inline void *frame_pool_get (struct frame_pool *pool)
+{
+	void *frame;
+
+	pthread_mutex_lock (&pool->mutex);
+	frame = pool->free_list;
+	if (frame != NULL) {
+		pool->free_list = *(void **)frame;
+		pool->free_entries -= 1;
+		pool->stats->frame_pool_hits += 1;
+	} else {
+		pool->stats->frame_pool_misses += 1;
+	}
+	pool->in_use += 1;
+	if (pool->in_use > pool->stats->frame_pool_high_water) {
+		pool->stats->frame_pool_high_water = pool->in_use;
+	}
+	pthread_mutex_unlock (&pool->mutex);
+
+	if (frame == NULL) {
+		frame = malloc (pool->frame_size);
+		if (frame == NULL) {
+			pthread_mutex_lock (&pool->mutex);
+			pool->in_use -= 1;
+			pthread_mutex_unlock (&pool->mutex);
+		}
+	}
+
+	return (frame);
+}
+
+static inline void frame_pool_put (
+	struct frame_pool *pool,
+	void *frame)
+{
+	int cached = 0;
+
+	pthread_mutex_lock (&pool->mutex);
+	pool->in_use -= 1;
+	if (frame_pool_slab_frame (pool, frame) ||
+	    pool->free_entries < pool->high_watermark) {
+		frame_pool_push (pool, frame);
+		cached = 1;
+	}
+	pthread_mutex_unlock (&pool->mutex);
+
+	if (!cached) {
+		free (frame);
+	}
+}
+
+/*
+ * Frames still in use keep the slab mapped, they are released with the
+ * process.
+ */
+static inline void frame_pool_free (struct frame_pool *pool)
+{
+	void *frame;
+
+	while ((frame = pool->free_list) != NULL) {
+		pool->free_list = *(void **)frame;
+		pool->free_entries -= 1;
+		if (!frame_pool_slab_frame (pool, frame)) {
+			free (frame);
+		}
+	}
+
+	if (pool->slab != NULL && pool->in_use == 0) {
+		munmap (pool->slab, pool->slab_len);
+		pool->slab = NULL;
+		pool->slab_len = 0;
+	}
+	pthread_mutex_destroy (&pool->mutex);
+}
+
+#endif /* FRAMEPOOL_H_DEFINED */
@@ -41,6 +41,7 @@
 
 #include <qb/qbdefs.h>
 #include <qb/qblist.h>
+#include <qb/qbmap.h>
 #include <corosync/icmap.h>
 
 #define ICMAP_MAX_VALUE_LEN	(16*1024)
@@ -66,13 +67,50 @@ struct icmap_track {
 	struct qb_list_head list;
 };
 
-struct icmap_ro_access_item {
+/*
+ * Read-only access rules are kept in a character trie. Node is reached by
+ * the path of characters from the root, exact and prefix flags mark rules
+ * ending in the node. Children of a node are kept in a sibling list, key
+ * names have small fan-out, so lookup costs about the key length.
+ */
+struct icmap_ro_access_node {
+	char c;
+	char exact;
+	char prefix;
+	struct icmap_ro_access_node *child;
+	struct icmap_ro_access_node *sibling;
+};
+
+static struct icmap_ro_access_node icmap_ro_access_root;
+
+static unsigned int icmap_ro_access_rules;
+
+/*
+ * Registered counter. value must be first, icmap_counter_t points to it.
+ */
+struct icmap_counter {
+	uint64_t value;
 	char *key_name;
-	int prefix;
 	struct qb_list_head list;
 };
 
-QB_LIST_DECLARE (icmap_ro_access_item_list_head);
+/*
+ * Counters of global map by key name, created with first counter
+ */
+static qb_map_t *icmap_counter_map;
+
+QB_LIST_DECLARE (icmap_counter_list_head);
+
+struct icmap_transaction_end_notify {
+	icmap_transaction_end_fn_t end_fn;
+	void *user_data;
+	struct qb_list_head list;
+};
+
+static unsigned int icmap_transaction_depth;
+
+QB_LIST_DECLARE (icmap_transaction_end_notify_list_head);
+
 QB_LIST_DECLARE (icmap_track_list_head);
 
 /*
@@ -208,16 +246,55 @@ cs_error_t icmap_init(void)
 	return (icmap_init_r(&icmap_global_map));
 }
 
+static void icmap_ro_access_node_free(struct icmap_ro_access_node *node)
+{
+	struct icmap_ro_access_node *sibling;
+
+	while (node != NULL) {
+		icmap_ro_access_node_free(node->child);
+		sibling = node->sibling;
+		free(node);
+		node = sibling;
+	}
+}
+
 static void icmap_set_ro_access_free(void)
+{
+
+	icmap_ro_access_node_free(icmap_ro_access_root.child);
+	memset(&icmap_ro_access_root, 0, sizeof(icmap_ro_access_root));
+	icmap_ro_access_rules = 0;
+}
+
+static void icmap_counter_free_all(void)
+{
+	struct qb_list_head *iter, *tmp_iter;
+	struct icmap_counter *counter;
+
+	if (icmap_counter_map == NULL) {
+		return ;
+	}
+
+	qb_map_destroy(icmap_counter_map);
+	icmap_counter_map = NULL;
+
+	qb_list_for_each_safe(iter, tmp_iter, &icmap_counter_list_head) {
+		counter = qb_list_entry(iter, struct icmap_counter, list);
+		qb_list_del(&counter->list);
+		free(counter->key_name);
+		free(counter);
+	}
+}
+
+static void icmap_transaction_end_notify_free(void)
 {
 	struct qb_list_head *iter, *tmp_iter;
-	struct icmap_ro_access_item *icmap_ro_ai;
+	struct icmap_transaction_end_notify *end_notify;
 
-	qb_list_for_each_safe(iter, tmp_iter, &icmap_ro_access_item_list_head) {
-		icmap_ro_ai = qb_list_entry(iter, struct icmap_ro_access_item, list);
-		qb_list_del(&icmap_ro_ai->list);
-		free(icmap_ro_ai->key_name);
-		free(icmap_ro_ai);
+	qb_list_for_each_safe(iter, tmp_iter, &icmap_transaction_end_notify_list_head) {
+		end_notify = qb_list_entry(iter, struct icmap_transaction_end_notify, list);
+		qb_list_del(&end_notify->list);
+		free(end_notify);
 	}
 }
 
@@ -255,6 +332,8 @@ void icmap_fini(void)
 	 */
 	icmap_fini_r(icmap_global_map);
 	icmap_set_ro_access_free();
+	icmap_counter_free_all();
+	icmap_transaction_end_notify_free();
 
 	return ;
 }
@@ -654,6 +733,29 @@ cs_error_t icmap_delete(const char *key_name)
 	return (icmap_delete_r(icmap_global_map, key_name));
 }
 
+/*
+ * Write value of counter registered for item (if any) into the item. Item
+ * is changed in place and put back into the map, the same way
+ * icmap_fast_adjust_int_r does it, so tracking callbacks are called.
+ */
+static void icmap_counter_materialize(const icmap_map_t map, struct icmap_item *item)
+{
+	struct icmap_counter *counter;
+
+	counter = qb_map_get(icmap_counter_map, item->key_name);
+	if (counter == NULL || item->type != ICMAP_VALUETYPE_UINT64 ||
+	    item->value_len != sizeof(counter->value)) {
+		return ;
+	}
+
+	if (memcmp(item->value, &counter->value, sizeof(counter->value)) == 0) {
+		return ;
+	}
+
+	memcpy(item->value, &counter->value, sizeof(counter->value));
+	qb_map_put(map->qb_map, item->key_name, item);
+}
+
 static cs_error_t icmap_get_ref_r(
 	const icmap_map_t map,
 	const char *key_name,
@@ -672,6 +774,10 @@ static cs_error_t icmap_get_ref_r(
 		return (CS_ERR_NOT_EXIST);
 	}
 
+	if (map == icmap_global_map && icmap_counter_map != NULL) {
+		icmap_counter_materialize(map, item);
+	}
+
 	if (type != NULL) {
 		*type = item->type;
 	}
@@ -1073,6 +1179,72 @@ cs_error_t icmap_fast_dec(const char *key_name)
 	return (icmap_fast_dec_r(icmap_global_map, key_name));
 }
 
+cs_error_t icmap_counter_register(const char *key_name, icmap_counter_t *counter)
+{
+	struct icmap_counter *icmap_counter;
+	cs_error_t err;
+
+	if (key_name == NULL || counter == NULL) {
+		return (CS_ERR_INVALID_PARAM);
+	}
+
+	if (icmap_counter_map == NULL) {
+		icmap_counter_map = qb_hashtable_create(32);
+		if (icmap_counter_map == NULL) {
+			return (CS_ERR_NO_MEMORY);
+		}
+	}
+
+	if (qb_map_get(icmap_counter_map, key_name) != NULL) {
+		return (CS_ERR_EXIST);
+	}
+
+	err = icmap_set_uint64(key_name, 0);
+	if (err != CS_OK) {
+		return (err);
+	}
+
+	icmap_counter = malloc(sizeof(*icmap_counter));
+	if (icmap_counter == NULL) {
+		return (CS_ERR_NO_MEMORY);
+	}
+	memset(icmap_counter, 0, sizeof(*icmap_counter));
+
+	icmap_counter->key_name = strdup(key_name);
+	if (icmap_counter->key_name == NULL) {
+		free(icmap_counter);
+		return (CS_ERR_NO_MEMORY);
+	}
+
+	qb_list_init(&icmap_counter->list);
+	qb_list_add(&icmap_counter->list, &icmap_counter_list_head);
+	qb_map_put(icmap_counter_map, icmap_counter->key_name, icmap_counter);
+
+	*counter = &icmap_counter->value;
+
+	return (CS_OK);
+}
+
+void icmap_counter_unregister(icmap_counter_t counter)
+{
+	struct icmap_counter *icmap_counter = (struct icmap_counter *)counter;
+	struct icmap_item *item;
+
+	if (counter == NULL) {
+		return ;
+	}
+
+	item = qb_map_get(icmap_global_map->qb_map, icmap_counter->key_name);
+	if (item != NULL) {
+		icmap_counter_materialize(icmap_global_map, item);
+	}
+
+	qb_map_rm(icmap_counter_map, icmap_counter->key_name);
+	qb_list_del(&icmap_counter->list);
+	free(icmap_counter->key_name);
+	free(icmap_counter);
+}
+
 icmap_iter_t icmap_iter_init_r(const icmap_map_t map, const char *prefix)
 {
 	return (qb_map_pref_iter_create(map->qb_map, prefix));
@@ -1214,77 +1386,223 @@ void *icmap_track_get_user_data(icmap_track_t icmap_track)
 	return (icmap_track->user_data);
 }
 
-cs_error_t icmap_set_ro_access(const char *key_name, int prefix, int ro_access)
+static struct icmap_ro_access_node *icmap_ro_access_child_find(
+	const struct icmap_ro_access_node *node,
+	char c)
 {
-	struct qb_list_head *iter, *tmp_iter;
-	struct icmap_ro_access_item *icmap_ro_ai;
-
-	qb_list_for_each_safe(iter, tmp_iter, &icmap_ro_access_item_list_head) {
-		icmap_ro_ai = qb_list_entry(iter, struct icmap_ro_access_item, list);
-
-		if (icmap_ro_ai->prefix == prefix && strcmp(key_name, icmap_ro_ai->key_name) == 0) {
-			/*
-			 * We found item
-			 */
-			if (ro_access) {
-				return (CS_ERR_EXIST);
-			} else {
-				qb_list_del(&icmap_ro_ai->list);
-				free(icmap_ro_ai->key_name);
-				free(icmap_ro_ai);
-
-				return (CS_OK);
-			}
+	struct icmap_ro_access_node *child;
+
+	for (child = node->child; child != NULL; child = child->sibling) {
+		if (child->c == c) {
+			break;
 		}
 	}
 
-	if (!ro_access) {
+	return (child);
+}
+
+/*
+ * Remove rule from subtree of node. Nodes on the path which hold no rule
+ * and have no children are freed on the way back, also when the rule was
+ * not found (partially built path after allocation failure).
+ */
+static cs_error_t icmap_ro_access_node_clear(
+	struct icmap_ro_access_node *node,
+	const char *key_name,
+	int prefix)
+{
+	struct icmap_ro_access_node **child_link;
+	struct icmap_ro_access_node *child;
+	char *flag;
+	cs_error_t err;
+
+	if (*key_name == '\0') {
+		flag = (prefix ? &node->prefix : &node->exact);
+		if (!*flag) {
+			return (CS_ERR_NOT_EXIST);
+		}
+		*flag = 0;
+
+		return (CS_OK);
+	}
+
+	for (child_link = &node->child; *child_link != NULL; child_link = &(*child_link)->sibling) {
+		if ((*child_link)->c == *key_name) {
+			break;
+		}
+	}
+
+	child = *child_link;
+	if (child == NULL) {
 		return (CS_ERR_NOT_EXIST);
 	}
 
-	icmap_ro_ai = malloc(sizeof(*icmap_ro_ai));
-	if (icmap_ro_ai == NULL) {
-		return (CS_ERR_NO_MEMORY);
+	err = icmap_ro_access_node_clear(child, key_name + 1, prefix);
+	if (!child->exact && !child->prefix && child->child == NULL) {
+		*child_link = child->sibling;
+		free(child);
 	}
 
-	memset(icmap_ro_ai, 0, sizeof(*icmap_ro_ai));
-	icmap_ro_ai->key_name = strdup(key_name);
-	if (icmap_ro_ai->key_name == NULL) {
-		free(icmap_ro_ai);
-		return (CS_ERR_NO_MEMORY);
+	return (err);
+}
+
+cs_error_t icmap_set_ro_access(const char *key_name, int prefix, int ro_access)
+{
+	struct icmap_ro_access_node *node;
+	struct icmap_ro_access_node *child;
+	const char *c;
+	char *flag;
+	cs_error_t err;
+
+	prefix = (prefix ? 1 : 0);
+
+	if (!ro_access) {
+		err = icmap_ro_access_node_clear(&icmap_ro_access_root, key_name, prefix);
+		if (err == CS_OK) {
+			icmap_ro_access_rules--;
+		}
+
+		return (err);
+	}
+
+	/*
+	 * Check for existing rule first, so nothing is allocated for duplicate
+	 */
+	node = &icmap_ro_access_root;
+	for (c = key_name; *c != '\0' && node != NULL; c++) {
+		node = icmap_ro_access_child_find(node, *c);
+	}
+	if (node != NULL && (prefix ? node->prefix : node->exact)) {
+		return (CS_ERR_EXIST);
+	}
+
+	node = &icmap_ro_access_root;
+	for (c = key_name; *c != '\0'; c++) {
+		child = icmap_ro_access_child_find(node, *c);
+		if (child == NULL) {
+			child = malloc(sizeof(*child));
+			if (child == NULL) {
+				/*
+				 * Nodes created so far hold no rule, clean them
+				 * up by removing rule which was never set
+				 */
+				(void)icmap_ro_access_node_clear(&icmap_ro_access_root, key_name, prefix);
+				return (CS_ERR_NO_MEMORY);
+			}
+			memset(child, 0, sizeof(*child));
+			child->c = *c;
+			child->sibling = node->child;
+			node->child = child;
+		}
+		node = child;
 	}
 
-	icmap_ro_ai->prefix = prefix;
-	qb_list_init(&icmap_ro_ai->list);
-	qb_list_add (&icmap_ro_ai->list, &icmap_ro_access_item_list_head);
+	flag = (prefix ? &node->prefix : &node->exact);
+	*flag = 1;
+	icmap_ro_access_rules++;
 
 	return (CS_OK);
 }
 
 int icmap_is_key_ro(const char *key_name)
 {
-	struct qb_list_head *iter;
-	struct icmap_ro_access_item *icmap_ro_ai;
+	const struct icmap_ro_access_node *node;
+	const char *c;
 
-	qb_list_for_each(iter, &icmap_ro_access_item_list_head) {
-		icmap_ro_ai = qb_list_entry(iter, struct icmap_ro_access_item, list);
+	node = &icmap_ro_access_root;
+	for (c = key_name; ; c++) {
+		if (node->prefix) {
+			return (CS_TRUE);
+		}
 
-		if (icmap_ro_ai->prefix) {
-			if (strlen(icmap_ro_ai->key_name) > strlen(key_name))
-				continue;
+		if (*c == '\0') {
+			return (node->exact ? CS_TRUE : CS_FALSE);
+		}
 
-			if (strncmp(icmap_ro_ai->key_name, key_name, strlen(icmap_ro_ai->key_name)) == 0) {
-				return (CS_TRUE);
-			}
-		} else {
-			if (strcmp(icmap_ro_ai->key_name, key_name) == 0) {
-				return (CS_TRUE);
-			}
+		node = icmap_ro_access_child_find(node, *c);
+		if (node == NULL) {
+			return (CS_FALSE);
 		}
 	}
+}
 
-	return (CS_FALSE);
+unsigned int icmap_ro_access_count(void)
+{
+
+	return (icmap_ro_access_rules);
+}
+
+void icmap_transaction_begin(void)
+{
+
+	icmap_transaction_depth++;
+}
+
+void icmap_transaction_end(void)
+{
+	struct qb_list_head *iter, *tmp_iter;
+	struct icmap_transaction_end_notify *end_notify;
+
+	if (icmap_transaction_depth == 0) {
+		return ;
+	}
+
+	icmap_transaction_depth--;
+	if (icmap_transaction_depth > 0) {
+		return ;
+	}
+
+	qb_list_for_each_safe(iter, tmp_iter, &icmap_transaction_end_notify_list_head) {
+		end_notify = qb_list_entry(iter, struct icmap_transaction_end_notify, list);
+		end_notify->end_fn(end_notify->user_data);
+	}
+}
+
+int icmap_transaction_in_progress(void)
+{
+
+	return (icmap_transaction_depth > 0);
+}
+
+cs_error_t icmap_transaction_end_notify_add(icmap_transaction_end_fn_t end_fn, void *user_data)
+{
+	struct icmap_transaction_end_notify *end_notify;
+
+	if (end_fn == NULL) {
+		return (CS_ERR_INVALID_PARAM);
+	}
+
+	end_notify = malloc(sizeof(*end_notify));
+	if (end_notify == NULL) {
+		return (CS_ERR_NO_MEMORY);
+	}
+
+	memset(end_notify, 0, sizeof(*end_notify));
+	end_notify->end_fn = end_fn;
+	end_notify->user_data = user_data;
+	qb_list_init(&end_notify->list);
+	qb_list_add_tail(&end_notify->list, &icmap_transaction_end_notify_list_head);
+
+	return (CS_OK);
+}
+
+cs_error_t icmap_transaction_end_notify_del(icmap_transaction_end_fn_t end_fn, void *user_data)
+{
+	struct qb_list_head *iter, *tmp_iter;
+	struct icmap_transaction_end_notify *end_notify;
+
+	qb_list_for_each_safe(iter, tmp_iter, &icmap_transaction_end_notify_list_head) {
+		end_notify = qb_list_entry(iter, struct icmap_transaction_end_notify, list);
+
+		if (end_notify->end_fn == end_fn && end_notify->user_data == user_data) {
+			qb_list_del(&end_notify->list);
+			free(end_notify);
+
+			return (CS_OK);
+		}
+	}
 
+	return (CS_ERR_NOT_EXIST);
 }
 
 cs_error_t icmap_copy_map(icmap_map_t dst_map, const icmap_map_t src_map)
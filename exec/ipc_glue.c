@@ -40,6 +40,7 @@
 #include <assert.h>
 #include <sys/uio.h>
 #include <string.h>
+#include <inttypes.h>
 
 #include <qb/qbdefs.h>
 #include <qb/qblist.h>
@@ -74,15 +75,38 @@ static int32_t ipc_allow_connections = 0; /* boolean */
 
 #define CS_IPCS_MAPPER_SERV_NAME		256
 
+/*
+ * Delay before retrying to flush the outq of a client which didn't read
+ * anything since the last attempt
+ */
+#define OUTQ_FLUSH_RETRY_MS			1
+
+/*
+ * Packed events carry at most OUTQ_PACK_MAX_MSGS queued messages, each
+ * padded to OUTQ_PACK_ALIGN bytes so the client can use them in place
+ */
+#define OUTQ_PACK_MAX_MSGS			64
+#define OUTQ_PACK_ALIGN				8
+#define OUTQ_PACK_PAD(len)	((OUTQ_PACK_ALIGN - ((len) % OUTQ_PACK_ALIGN)) % OUTQ_PACK_ALIGN)
+
 struct cs_ipcs_mapper {
 	int32_t id;
 	qb_ipcs_service_t *inst;
 	char name[CS_IPCS_MAPPER_SERV_NAME];
 };
 
-struct outq_item {
-	void *msg;
+/*
+ * Immutable copy of a dispatched message, shared by every connection which
+ * had to queue it
+ */
+struct outq_msg {
+	uint32_t refcount;
 	size_t mlen;
+	char data[];
+};
+
+struct outq_item {
+	struct outq_msg *msg;
 	struct qb_list_head list;
 };
 
@@ -121,6 +145,47 @@ static struct qb_ipcs_service_handlers corosync_service_funcs = {
 
 static struct ipcs_global_stats global_stats;
 
+static struct outq_msg *outq_msg_create (const struct iovec *iov, uint32_t iov_len,
+	size_t mlen)
+{
+	struct outq_msg *msg;
+	char *write_buf;
+	uint32_t i;
+
+	msg = malloc (sizeof (struct outq_msg) + mlen);
+	if (msg == NULL) {
+		return (NULL);
+	}
+	msg->refcount = 1;
+	msg->mlen = mlen;
+
+	write_buf = msg->data;
+	for (i = 0; i < iov_len; i++) {
+		memcpy (write_buf, iov[i].iov_base, iov[i].iov_len);
+		write_buf += iov[i].iov_len;
+	}
+	global_stats.queued_bytes += mlen;
+
+	return (msg);
+}
+
+static void outq_msg_put (struct outq_msg *msg)
+{
+	if (--msg->refcount == 0) {
+		global_stats.queued_bytes -= msg->mlen;
+		free (msg);
+	}
+}
+
+static void outq_item_free (struct cs_ipcs_conn_context *context,
+	struct outq_item *outq_item)
+{
+	qb_list_del (&outq_item->list);
+	context->queued_bytes -= outq_item->msg->mlen;
+	outq_msg_put (outq_item->msg);
+	free (outq_item);
+}
+
 static const char* cs_ipcs_serv_short_name(int32_t service_id)
 {
 	const char *name;
@@ -259,6 +324,41 @@ static char * pid_to_name (pid_t pid, char *out_name, size_t name_len)
 	return out_name;
 }
 
+/*
+ * Budget of the outq is taken from system.ipc_outq.<service>.* with
+ * system.ipc_outq.* as default. Zero means unlimited.
+ */
+static void outq_budget_load (int32_t service, struct cs_ipcs_conn_context *context)
+{
+	char key_name[ICMAP_KEYNAME_MAXLEN];
+	const char *serv_short_name;
+	uint64_t max_bytes = 0;
+	uint32_t max_msgs = 0;
+	char *str = NULL;
+
+	serv_short_name = cs_ipcs_serv_short_name(service);
+
+	(void)icmap_get_uint64("system.ipc_outq.max_bytes", &max_bytes);
+	snprintf(key_name, sizeof(key_name), "system.ipc_outq.%s.max_bytes", serv_short_name);
+	(void)icmap_get_uint64(key_name, &max_bytes);
+
+	(void)icmap_get_uint32("system.ipc_outq.max_msgs", &max_msgs);
+	snprintf(key_name, sizeof(key_name), "system.ipc_outq.%s.max_msgs", serv_short_name);
+	(void)icmap_get_uint32(key_name, &max_msgs);
+
+	context->outq_overflow_disconnect = 1;
+	snprintf(key_name, sizeof(key_name), "system.ipc_outq.%s.overflow", serv_short_name);
+	if (icmap_get_string(key_name, &str) == CS_OK ||
+	    icmap_get_string("system.ipc_outq.overflow", &str) == CS_OK) {
+		context->outq_overflow_disconnect = (strcmp(str, "drop") != 0);
+		free(str);
+	}
+
+	context->outq_max_bytes = max_bytes;
+	context->outq_max_msgs = max_msgs;
+	context->outq_state = OUTQ_STATE_OK;
+}
+
 static void cs_ipcs_connection_created(qb_ipcs_connection_t *c)
 {
 	int32_t service = 0;
@@ -281,6 +381,7 @@ static void cs_ipcs_connection_created(qb_ipcs_connection_t *c)
 	context->queuing = QB_FALSE;
 	context->queued = 0;
 	context->sent = 0;
+	outq_budget_load (service, context);
 
 	qb_ipcs_context_set(c, context);
 
@@ -329,9 +430,7 @@ static void cs_ipcs_connection_destroyed (qb_ipcs_connection_t *c)
 		qb_list_for_each_safe(list, tmp_iter, &(context->outq_head)) {
 			outq_item = qb_list_entry (list, struct outq_item, list);
 
-			qb_list_del (list);
-			free (outq_item->msg);
-			free (outq_item);
+			outq_item_free (context, outq_item);
 		}
 		free(context);
 	}
@@ -342,6 +441,7 @@ static int32_t cs_ipcs_connection_closed (qb_ipcs_connection_t *c)
 	int32_t res = 0;
 	int32_t service = qb_ipcs_service_id_get(c);
 	struct qb_ipcs_connection_stats stats;
+	struct cs_ipcs_conn_context *context;
 
 	log_printf(LOG_DEBUG, "%s() ", __func__);
 	res = corosync_service[service]->lib_exit_fn(c);
@@ -350,6 +450,11 @@ static int32_t cs_ipcs_connection_closed (qb_ipcs_connection_t *c)
 	}
 
 	qb_loop_job_del(cs_poll_handle_get(), QB_LOOP_HIGH, c, outq_flush);
+	context = qb_ipcs_context_get(c);
+	if (context != NULL && context->outq_flush_timer != 0) {
+		qb_loop_timer_del(cs_poll_handle_get(), context->outq_flush_timer);
+		context->outq_flush_timer = 0;
+	}
 
 	qb_ipcs_connection_stats_get(c, &stats, QB_FALSE);
 
@@ -380,18 +485,201 @@ int cs_ipcs_response_send(void *conn, const void *msg, size_t mlen)
 	return rc;
 }
 
+/*
+ * Returns non-zero if the outq of the connection, grown by the given
+ * amount, would exceed its budget shifted right by shift
+ */
+static int outq_budget_exceeded (const struct cs_ipcs_conn_context *context,
+	uint64_t extra_bytes, uint32_t extra_msgs, unsigned int shift)
+{
+	if (context->outq_max_bytes != 0 &&
+	    context->queued_bytes + extra_bytes > (context->outq_max_bytes >> shift)) {
+		return 1;
+	}
+	if (context->outq_max_msgs != 0 &&
+	    context->queued + extra_msgs > (context->outq_max_msgs >> shift)) {
+		return 1;
+	}
+	return 0;
+}
+
+/*
+ * Time spent over budget including the current period, in ms
+ */
+static uint64_t outq_over_budget_time_get (const struct cs_ipcs_conn_context *context)
+{
+	uint64_t res = context->outq_over_budget_time;
+
+	if (context->outq_state != OUTQ_STATE_OK &&
+	    context->outq_state != OUTQ_STATE_DISCONNECT) {
+		res += (qb_util_nano_current_get () - context->outq_over_budget_start) /
+			QB_TIME_NS_IN_MSEC;
+	}
+	return (res);
+}
+
+/*
+ * Move between OK and FLOW_CONTROL. The connection is flow controlled once
+ * its outq uses more than half of the budget and released when it is back
+ * under half.
+ */
+static void outq_budget_update (struct cs_ipcs_conn_context *context)
+{
+	switch (context->outq_state) {
+	case OUTQ_STATE_OK:
+		if (outq_budget_exceeded (context, 0, 0, 1)) {
+			context->outq_state = OUTQ_STATE_FLOW_CONTROL;
+			context->outq_over_budget_start = qb_util_nano_current_get ();
+			log_printf(LOGSYS_LEVEL_NOTICE,
+				"IPC outq of %s over half of its budget (%u messages, %"PRIu64" bytes), "
+				"enabling flow control", context->proc_name,
+				context->queued, context->queued_bytes);
+		}
+		break;
+	case OUTQ_STATE_FLOW_CONTROL:
+	case OUTQ_STATE_OVERFLOW:
+		if (!outq_budget_exceeded (context, 0, 0, 1)) {
+			context->outq_over_budget_time = outq_over_budget_time_get (context);
+			context->outq_state = OUTQ_STATE_OK;
+			log_printf(LOGSYS_LEVEL_NOTICE,
+				"IPC outq of %s back under budget, disabling flow control",
+				context->proc_name);
+		}
+		break;
+	case OUTQ_STATE_DISCONNECT:
+		break;
+	}
+}
+
+static void outq_disconnect (void *data)
+{
+	qb_ipcs_connection_t *conn = data;
+
+	qb_ipcs_disconnect (conn);
+	qb_ipcs_connection_unref (conn);
+}
+
+/*
+ * Message doesn't fit into the budget. Drop it or schedule disconnect of
+ * the connection, depending on the configured overflow action.
+ */
+static void outq_overflow (qb_ipcs_connection_t *conn,
+	struct cs_ipcs_conn_context *context)
+{
+	context->outq_dropped++;
+
+	if (context->outq_state == OUTQ_STATE_DISCONNECT) {
+		return ;
+	}
+
+	if (context->outq_overflow_disconnect) {
+		log_printf(LOGSYS_LEVEL_WARNING,
+			"IPC outq of %s exceeded its budget (%u messages, %"PRIu64" bytes), disconnecting",
+			context->proc_name, context->queued, context->queued_bytes);
+		context->outq_over_budget_time = outq_over_budget_time_get (context);
+		context->outq_state = OUTQ_STATE_DISCONNECT;
+		/*
+		 * Don't disconnect from the middle of a service fan-out
+		 */
+		qb_ipcs_connection_ref (conn);
+		qb_loop_job_add(cs_poll_handle_get(), QB_LOOP_HIGH, conn, outq_disconnect);
+	} else if (context->outq_state != OUTQ_STATE_OVERFLOW) {
+		log_printf(LOGSYS_LEVEL_WARNING,
+			"IPC outq of %s exceeded its budget (%u messages, %"PRIu64" bytes), dropping messages",
+			context->proc_name, context->queued, context->queued_bytes);
+		if (context->outq_state == OUTQ_STATE_OK) {
+			context->outq_over_budget_start = qb_util_nano_current_get ();
+		}
+		context->outq_state = OUTQ_STATE_OVERFLOW;
+	}
+}
+
+static void outq_flush_timer_fn (void *data)
+{
+	qb_ipcs_connection_t *conn = data;
+	struct cs_ipcs_conn_context *context = qb_ipcs_context_get(conn);
+
+	context->outq_flush_timer = 0;
+	outq_flush (conn);
+}
+
+/*
+ * Send head of the outq. With packing enabled, as many queued messages as
+ * fit into outq_pack_max_bytes are sent as one event of type outq_pack_id.
+ * *count is set to the number of messages the event carries.
+ */
+static int32_t outq_send (qb_ipcs_connection_t *conn,
+	struct cs_ipcs_conn_context *context, uint32_t *count)
+{
+	static const char pad[OUTQ_PACK_ALIGN];
+	struct iovec iov[1 + 2 * OUTQ_PACK_MAX_MSGS];
+	struct qb_ipc_response_header header;
+	struct qb_list_head *list;
+	struct outq_item *outq_item;
+	unsigned int iov_len = 1;
+	uint32_t entries = 0;
+	size_t size = sizeof (header);
+	size_t pad_len;
+	int32_t rc;
+
+	if (context->outq_pack_id != 0) {
+		qb_list_for_each(list, &(context->outq_head)) {
+			outq_item = qb_list_entry (list, struct outq_item, list);
+			pad_len = OUTQ_PACK_PAD (outq_item->msg->mlen);
+			if (entries == OUTQ_PACK_MAX_MSGS ||
+			    size + outq_item->msg->mlen + pad_len > context->outq_pack_max_bytes) {
+				break;
+			}
+			iov[iov_len].iov_base = outq_item->msg->data;
+			iov[iov_len].iov_len = outq_item->msg->mlen;
+			iov_len++;
+			if (pad_len != 0) {
+				iov[iov_len].iov_base = (void *)pad;
+				iov[iov_len].iov_len = pad_len;
+				iov_len++;
+			}
+			size += outq_item->msg->mlen + pad_len;
+			entries++;
+		}
+	}
+
+	if (entries < 2) {
+		outq_item = qb_list_first_entry (&(context->outq_head), struct outq_item, list);
+		*count = 1;
+		rc = qb_ipcs_event_send(conn, outq_item->msg->data, outq_item->msg->mlen);
+		if (rc >= 0) {
+			assert(rc == outq_item->msg->mlen);
+		}
+		return (rc);
+	}
+
+	header.id = context->outq_pack_id;
+	header.size = size;
+	header.error = CS_OK;
+	iov[0].iov_base = &header;
+	iov[0].iov_len = sizeof (header);
+
+	*count = entries;
+	rc = qb_ipcs_event_sendv(conn, iov, iov_len);
+	if (rc >= 0) {
+		assert((size_t)rc == size);
+		context->outq_packed_events++;
+		context->outq_packed_msgs += entries;
+	}
+	return (rc);
+}
+
 static void outq_flush (void *data)
 {
 	qb_ipcs_connection_t *conn = data;
-	struct qb_list_head *list, *tmp_iter;
 	struct outq_item *outq_item;
 	int32_t rc;
+	uint32_t count;
+	uint32_t sent = 0;
 	struct cs_ipcs_conn_context *context = qb_ipcs_context_get(conn);
 
-	qb_list_for_each_safe(list, tmp_iter, &(context->outq_head)) {
-		outq_item = qb_list_entry (list, struct outq_item, list);
-
-		rc = qb_ipcs_event_send(conn, outq_item->msg, outq_item->mlen);
+	while (!qb_list_empty (&context->outq_head)) {
+		rc = outq_send (conn, context, &count);
 		if (rc < 0 && rc != -EAGAIN) {
 			errno = -rc;
 			qb_perror(LOG_ERR, "qb_ipcs_event_send");
@@ -399,44 +687,70 @@ static void outq_flush (void *data)
 		} else if (rc == -EAGAIN) {
 			break;
 		}
-		assert(rc == outq_item->mlen);
-		context->sent++;
-		context->queued--;
 
-		qb_list_del (list);
-		free (outq_item->msg);
-		free (outq_item);
+		while (count-- > 0) {
+			outq_item = qb_list_first_entry (&(context->outq_head), struct outq_item, list);
+			context->sent++;
+			context->queued--;
+			sent++;
+
+			outq_item_free (context, outq_item);
+		}
 	}
+	outq_budget_update (context);
+
 	if (qb_list_empty (&context->outq_head)) {
 		context->queuing = QB_FALSE;
 		log_printf(LOGSYS_LEVEL_INFO, "Q empty, queued:%d sent:%d.",
 			context->queued, context->sent);
 		context->queued = 0;
 		context->sent = 0;
-	} else {
+	} else if (sent > 0) {
 		qb_loop_job_add(cs_poll_handle_get(), QB_LOOP_HIGH, conn, outq_flush);
+	} else {
+		/*
+		 * Client is not reading, retry later instead of spinning
+		 * in the main loop
+		 */
+		context->outq_reschedules++;
+		qb_loop_timer_add(cs_poll_handle_get(), QB_LOOP_HIGH,
+			OUTQ_FLUSH_RETRY_MS * QB_TIME_NS_IN_MSEC, conn,
+			outq_flush_timer_fn, &context->outq_flush_timer);
 	}
 }
 
-static void msg_send_or_queue(qb_ipcs_connection_t *conn, const struct iovec *iov, uint32_t iov_len)
+/*
+ * When shared_msg is not NULL, the queued copy of the message is taken from
+ * (or stored to) *shared_msg, so a message sent to several connections is
+ * copied at most once. Messages sent with exempt set are queued even over
+ * the outq budget. Returns 0 if the message was sent or queued, -1 if it
+ * was dropped.
+ */
+static int msg_send_or_queue(qb_ipcs_connection_t *conn, const struct iovec *iov, uint32_t iov_len,
+	struct outq_msg **shared_msg, int exempt)
 {
 	int32_t rc = 0;
 	int32_t i;
 	int32_t bytes_msg = 0;
 	struct outq_item *outq_item;
-	char *write_buf = 0;
+	struct outq_msg *msg;
 	struct cs_ipcs_conn_context *context = qb_ipcs_context_get(conn);
 
 	for (i = 0; i < iov_len; i++) {
 		bytes_msg += iov[i].iov_len;
 	}
 
+	if (context->outq_state == OUTQ_STATE_DISCONNECT) {
+		context->outq_dropped++;
+		return (-1);
+	}
+
 	if (!context->queuing) {
 		assert(qb_list_empty (&context->outq_head));
 		rc = qb_ipcs_event_sendv(conn, iov, iov_len);
 		if (rc == bytes_msg) {
 			context->sent++;
-			return;
+			return (0);
 		}
 		if (rc == -EAGAIN) {
 			context->queued = 0;
@@ -445,30 +759,49 @@ static void msg_send_or_queue(qb_ipcs_connection_t *conn, const struct iovec *io
 			qb_loop_job_add(cs_poll_handle_get(), QB_LOOP_HIGH, conn, outq_flush);
 		} else {
 			log_printf(LOGSYS_LEVEL_ERROR, "event_send retuned %d, expected %d!", rc, bytes_msg);
-			return;
+			return (-1);
 		}
 	}
+
+	if (!exempt && outq_budget_exceeded (context, bytes_msg, 1, 0)) {
+		outq_overflow (conn, context);
+		return (-1);
+	}
+
 	outq_item = malloc (sizeof (struct outq_item));
 	if (outq_item == NULL) {
 		qb_ipcs_disconnect(conn);
-		return;
-	}
-	outq_item->msg = malloc (bytes_msg);
-	if (outq_item->msg == NULL) {
-		free (outq_item);
-		qb_ipcs_disconnect(conn);
-		return;
+		return (-1);
 	}
 
-	write_buf = outq_item->msg;
-	for (i = 0; i < iov_len; i++) {
-		memcpy (write_buf, iov[i].iov_base, iov[i].iov_len);
-		write_buf += iov[i].iov_len;
+	if (shared_msg != NULL && *shared_msg != NULL) {
+		msg = *shared_msg;
+		msg->refcount++;
+	} else {
+		msg = outq_msg_create (iov, iov_len, bytes_msg);
+		if (msg == NULL) {
+			free (outq_item);
+			qb_ipcs_disconnect(conn);
+			return (-1);
+		}
+		if (shared_msg != NULL) {
+			/*
+			 * Reference of the caller
+			 */
+			msg->refcount++;
+			*shared_msg = msg;
+		}
 	}
-	outq_item->mlen = bytes_msg;
+
+	outq_item->msg = msg;
 	qb_list_init (&outq_item->list);
 	qb_list_add_tail (&outq_item->list, &context->outq_head);
 	context->queued++;
+	context->queued_bytes += bytes_msg;
+
+	outq_budget_update (context);
+
+	return (0);
 }
 
 int cs_ipcs_dispatch_send(void *conn, const void *msg, size_t mlen)
@@ -476,16 +809,62 @@ int cs_ipcs_dispatch_send(void *conn, const void *msg, size_t mlen)
 	struct iovec iov;
 	iov.iov_base = (void *)msg;
 	iov.iov_len = mlen;
-	msg_send_or_queue (conn, &iov, 1);
-	return 0;
+	return (msg_send_or_queue (conn, &iov, 1, NULL, 0));
+}
+
+int cs_ipcs_dispatch_send_exempt(void *conn, const void *msg, size_t mlen)
+{
+	struct iovec iov;
+	iov.iov_base = (void *)msg;
+	iov.iov_len = mlen;
+	return (msg_send_or_queue (conn, &iov, 1, NULL, 1));
 }
 
 int cs_ipcs_dispatch_iov_send (void *conn,
 	const struct iovec *iov,
 	unsigned int iov_len)
 {
-	msg_send_or_queue(conn, iov, iov_len);
-	return 0;
+	return (msg_send_or_queue(conn, iov, iov_len, NULL, 0));
+}
+
+int cs_ipcs_dispatch_iov_send_shared (void *conn,
+	const struct iovec *iov,
+	unsigned int iov_len,
+	void **shared_msg)
+{
+	return (msg_send_or_queue(conn, iov, iov_len, (struct outq_msg **)shared_msg, 0));
+}
+
+void cs_ipcs_shared_msg_release (void *shared_msg)
+{
+	if (shared_msg != NULL) {
+		outq_msg_put (shared_msg);
+	}
+}
+
+void cs_ipcs_dispatch_pack_set (void *conn, uint32_t pack_id, size_t max_bytes)
+{
+	struct cs_ipcs_conn_context *context = qb_ipcs_context_get(conn);
+
+	context->outq_pack_id = pack_id;
+	context->outq_pack_max_bytes = max_bytes;
+}
+
+/*
+ * Nobody waits for the response of an asynchronous request, let the
+ * service know it was dropped
+ */
+static void cs_ipcs_async_refused (qb_ipcs_connection_t *c,
+		int32_t service,
+		const struct qb_ipc_request_header *request_pt,
+		cs_error_t error)
+{
+	struct corosync_lib_handler *handler;
+
+	handler = &corosync_service[service]->lib_engine[request_pt->id];
+	if (handler->lib_refused_fn != NULL) {
+		handler->lib_refused_fn (c, request_pt, error);
+	}
 }
 
 static int32_t cs_ipcs_msg_process(qb_ipcs_connection_t *c,
@@ -524,6 +903,7 @@ static int32_t cs_ipcs_msg_process(qb_ipcs_connection_t *c,
 		if (is_async_call) {
 			log_printf(LOGSYS_LEVEL_INFO, "*** %s() invalid message! size:%d error:%d",
 				__func__, response.size, response.error);
+			cs_ipcs_async_refused (c, service, request_pt, CS_ERR_INVALID_PARAM);
 		} else {
 			qb_ipcs_response_send (c,
 				&response,
@@ -550,10 +930,31 @@ static int32_t cs_ipcs_msg_process(qb_ipcs_connection_t *c,
 				"*** %s() (%d:%d - %d) %s!",
 				__func__, service, request_pt->id,
 				is_async_call, strerror(-send_ok));
+			cs_ipcs_async_refused (c, service, request_pt, CS_ERR_TRY_AGAIN);
 		}
 		res = -ENOBUFS;
 	}
 
+	if (send_ok >= 0 && !is_async_call &&
+	    corosync_service[service]->lib_engine[request_pt->id].flow_control == CS_LIB_FLOW_CONTROL_REQUIRED) {
+		/*
+		 * Connection which doesn't read its dispatch messages gets
+		 * no new requests accepted until its outq drains
+		 */
+		cnx = qb_ipcs_context_get(c);
+		if (cnx && cnx->outq_state != OUTQ_STATE_OK) {
+			cnx->overload++;
+			response.size = sizeof (response);
+			response.id = 0;
+			response.error = CS_ERR_TRY_AGAIN;
+			qb_ipcs_response_send (c,
+				&response,
+				sizeof (response));
+			send_ok = -ENOBUFS;
+			res = -ENOBUFS;
+		}
+	}
+
 	if (send_ok >= 0) {
 		corosync_service[service]->lib_engine[request_pt->id].lib_handler_fn(c, request_pt);
 		res = 0;
@@ -698,6 +1099,7 @@ cs_error_t cs_ipcs_get_conn_stats(int service_id, uint32_t pid, void *conn_ptr,
 		}
 		found = 1;
 		memcpy(&ipcs_stats->cnx, cnx, sizeof(struct cs_ipcs_conn_context));
+		ipcs_stats->cnx.outq_over_budget_time = outq_over_budget_time_get(cnx);
 	}
 	if (!found) {
 		return CS_ERR_NOT_EXIST;
@@ -713,8 +1115,9 @@ void cs_ipcs_clear_stats()
 	qb_ipcs_connection_t *c, *prev;
 	int service_id;
 
-	/* Global stats are easy */
-	memset(&global_stats, 0, sizeof(global_stats));
+	/* Global stats are easy, queued_bytes is a gauge and stays */
+	global_stats.active = 0;
+	global_stats.closed = 0;
 
 	for (service_id = 0; service_id < SERVICES_COUNT_MAX; service_id++) {
 		if (!ipcs_mapper[service_id].inst) {
@@ -733,6 +1136,10 @@ void cs_ipcs_clear_stats()
 			cnx->invalid_request = 0;
 			cnx->overload = 0;
 			cnx->sent = 0;
+			cnx->outq_reschedules = 0;
+			cnx->outq_dropped = 0;
+			cnx->outq_over_budget_time = 0;
+			cnx->outq_over_budget_start = qb_util_nano_current_get();
 
 		}
 	}
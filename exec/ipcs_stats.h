@@ -32,13 +32,34 @@
  * THE POSSIBILITY OF SUCH DAMAGE.
  */
 
+enum cs_ipcs_outq_state {
+	OUTQ_STATE_OK,
+	OUTQ_STATE_FLOW_CONTROL,
+	OUTQ_STATE_OVERFLOW,
+	OUTQ_STATE_DISCONNECT
+};
+
 struct cs_ipcs_conn_context {
 	struct qb_list_head outq_head;
 	int32_t queuing;
 	uint32_t queued;
+	uint64_t queued_bytes;
 	uint64_t invalid_request;
 	uint64_t overload;
 	uint32_t sent;
+	uint64_t outq_max_bytes;
+	uint32_t outq_max_msgs;
+	int32_t outq_overflow_disconnect;
+	uint32_t outq_state;
+	uint64_t outq_over_budget_start;
+	uint64_t outq_over_budget_time;
+	uint64_t outq_reschedules;
+	uint64_t outq_dropped;
+	qb_loop_timer_handle outq_flush_timer;
+	uint32_t outq_pack_id;
+	uint32_t outq_pack_max_bytes;
+	uint64_t outq_packed_events;
+	uint64_t outq_packed_msgs;
 	char proc_name[32];
 	char data[1];
 };
@@ -47,6 +68,7 @@ struct ipcs_global_stats
 {
 	uint64_t active;
 	uint64_t closed;
+	uint64_t queued_bytes;
 };
 
 struct ipcs_conn_stats
@@ -126,6 +126,7 @@
 #include "schedwrk.h"
 #include "ipcs_stats.h"
 #include "stats.h"
+#include "statepage.h"
 
 #ifdef HAVE_SMALL_MEMORY_FOOTPRINT
 #define IPC_LOGSYS_SIZE			1024*64
@@ -411,6 +412,8 @@ static void confchg_fn (
 		sync_save_transitional (member_list, member_list_entries, ring_id);
 	}
 	if (configuration_type == TOTEM_CONFIGURATION_REGULAR) {
+		cs_state_page_membership_set (totempg_my_nodeid_get (),
+			member_list, member_list_entries, ring_id);
 		sync_start (member_list, member_list_entries, ring_id);
 	}
 }
@@ -599,7 +602,9 @@ static void deliver_fn (
 		return;
 	}
 
-	icmap_fast_inc(service_stats_rx[service][fn_id]);
+	if (service_stats_rx[service][fn_id] != NULL) {
+		(*service_stats_rx[service][fn_id])++;
+	}
 
 	if (endian_conversion_required) {
 		assert(corosync_service[service]->exec_engine[fn_id].exec_endian_convert_fn != NULL);
@@ -623,13 +628,42 @@ int main_mcast (
 	service = req->id >> 16;
 	fn_id = req->id & 0xffff;
 
-	if (corosync_service[service]) {
-		icmap_fast_inc(service_stats_tx[service][fn_id]);
+	if (corosync_service[service] && service_stats_tx[service][fn_id] != NULL) {
+		(*service_stats_tx[service][fn_id])++;
 	}
 
 	return (totempg_groups_mcast_joined (corosync_group_handle, iovec, iov_len, guarantee));
 }
 
+int main_mcast_multi (
+	const struct iovec *iovec,
+	const unsigned int *iov_lens,
+	unsigned int msg_count,
+	unsigned int guarantee)
+{
+	const struct qb_ipc_request_header *req;
+	int32_t service;
+	int32_t fn_id;
+	unsigned int vec;
+	unsigned int i;
+	int queued;
+
+	queued = totempg_groups_mcast_joined_multi (corosync_group_handle,
+		iovec, iov_lens, msg_count, guarantee);
+
+	for (i = 0, vec = 0; i < (unsigned int)queued; vec += iov_lens[i], i++) {
+		req = iovec[vec].iov_base;
+		service = req->id >> 16;
+		fn_id = req->id & 0xffff;
+
+		if (corosync_service[service] && service_stats_tx[service][fn_id] != NULL) {
+			(*service_stats_tx[service][fn_id])++;
+		}
+	}
+
+	return (queued);
+}
+
 static void corosync_ring_id_create_or_load (
 	struct memb_ring_id *memb_ring_id,
 	unsigned int nodeid)
@@ -1513,6 +1547,12 @@ int main (int argc, char **argv, char **envp)
 		corosync_exit_error (flock_err);
 	}
 
+	/*
+	 * Only after the lock is held, an already running daemon owns the
+	 * page otherwise
+	 */
+	cs_state_page_init ();
+
 	/*
 	 * if totempg_initialize doesn't have root priveleges, it cannot
 	 * bind to a specific interface.  This only matters if
@@ -1566,6 +1606,8 @@ int main (int argc, char **argv, char **envp)
 	/*
 	 * Exit was requested
 	 */
+	cs_state_page_exit ();
+
 	totempg_finalize ();
 
 	/*
@@ -58,6 +58,12 @@ extern int main_mcast (
 	unsigned int iov_len,
 	unsigned int guarantee);
 
+extern int main_mcast_multi (
+	const struct iovec *iovec,
+	const unsigned int *iov_lens,
+	unsigned int msg_count,
+	unsigned int guarantee);
+
 extern void message_source_set (mar_message_source_t *source, void *conn);
 
 extern int message_source_is_local (const mar_message_source_t *source);
@@ -103,9 +109,18 @@ extern int32_t cs_ipcs_service_destroy(int32_t service_id);
 extern int32_t cs_ipcs_q_level_get(void);
 
 extern int cs_ipcs_dispatch_send(void *conn, const void *msg, size_t mlen);
+extern int cs_ipcs_dispatch_send_exempt(void *conn, const void *msg, size_t mlen);
 extern int cs_ipcs_dispatch_iov_send (void *conn,
 	const struct iovec *iov,
 	unsigned int iov_len);
+extern int cs_ipcs_dispatch_iov_send_shared (void *conn,
+	const struct iovec *iov,
+	unsigned int iov_len,
+	void **shared_msg);
+extern void cs_ipcs_shared_msg_release (void *shared_msg);
+extern void cs_ipcs_dispatch_pack_set (void *conn,
+	uint32_t pack_id,
+	size_t max_bytes);
 
 extern int cs_ipcs_response_send(void *conn, const void *msg, size_t mlen);
 extern int cs_ipcs_response_iov_send (void *conn,
@@ -0,0 +1,195 @@
+/*
+ * Copyright (c) 2026 Red Hat, Inc.
+ *
+ * All rights reserved.
+ *
+ * This software licensed under BSD license, the text of which follows:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ * - Neither the name of the MontaVista Software, Inc. nor the names of its
+ *   contributors may be used to endorse or promote products derived from this
+ *   software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ * THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef RECVBATCH_H_DEFINED
+#define RECVBATCH_H_DEFINED
+
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+#include <corosync/totem/totem.h>
+
+#include "util.h"
+
+/*
+ * Number of datagrams drained from a socket per poll wakeup
+ */
+#define RECV_BATCH_FRAMES 16
+
+/*
+ * Ring of preallocated frame buffers filled by one recvmmsg call.
+ *
+ * Frames are handed out in receive order by recv_batch_next. The index is
+ * advanced before a frame is delivered, so a nested flush (totemsrp calls
+ * recv_flush while processing a token taken from the batch) can continue
+ * delivering the remaining frames without seeing the current one again.
+ */
+struct recv_batch {
+	struct mmsghdr msgs[RECV_BATCH_FRAMES];
+
+	struct iovec iovec[RECV_BATCH_FRAMES];
+
+	struct sockaddr_storage system_from[RECV_BATCH_FRAMES];
+
+	char *buffers;
+
+	size_t frame_size;
+
+	unsigned int entries;
+
+	unsigned int next;
+
+	/*
+	 * Socket the frames were received from, -1 when the batch is empty
+	 */
+	int fd;
+};
+
+static inline int recv_batch_init (
+	struct recv_batch *batch,
+	size_t frame_size)
+{
+	memset (batch, 0, sizeof (struct recv_batch));
+
+	batch->buffers = malloc (frame_size * RECV_BATCH_FRAMES);
+	if (batch->buffers == NULL) {
+		return (-1);
+	}
+	batch->frame_size = frame_size;
+	batch->fd = -1;
+
+	return (0);
+}
+
+static inline void recv_batch_free (struct recv_batch *batch)
+{
+	free (batch->buffers);
+	batch->buffers = NULL;
+	batch->entries = 0;
+	batch->next = 0;
+	batch->fd = -1;
+}
+
+/*
+ * Receive up to RECV_BATCH_FRAMES datagrams from fd without blocking.
+ * Returns number of received frames, 0 if there was nothing to read.
+ * Frames not yet delivered from the previous call are dropped, callers
+ * must drain the batch first.
+ */
+static inline int recv_batch_recv (
+	struct recv_batch *batch,
+	int fd,
+	totemsrp_stats_t *stats)
+{
+	unsigned int i;
+	int res;
+
+	for (i = 0; i < RECV_BATCH_FRAMES; i++) {
+		batch->iovec[i].iov_base = batch->buffers + (i * batch->frame_size);
+		batch->iovec[i].iov_len = batch->frame_size;
+
+		memset (&batch->msgs[i], 0, sizeof (struct mmsghdr));
+		batch->msgs[i].msg_hdr.msg_name = &batch->system_from[i];
+		batch->msgs[i].msg_hdr.msg_namelen = sizeof (struct sockaddr_storage);
+		batch->msgs[i].msg_hdr.msg_iov = &batch->iovec[i];
+		batch->msgs[i].msg_hdr.msg_iovlen = 1;
+	}
+
+	batch->entries = 0;
+	batch->next = 0;
+	batch->fd = fd;
+
+	do {
+		res = recvmmsg (fd, batch->msgs, RECV_BATCH_FRAMES,
+			MSG_NOSIGNAL | MSG_DONTWAIT, NULL);
+	} while (res == -1 && errno == EINTR);
+
+	if (res <= 0) {
+		return (0);
+	}
+
+	batch->entries = res;
+
+	if (stats != NULL) {
+		stats->recv_batches++;
+		stats->recv_batch_frames += res;
+		if ((uint32_t)res > stats->recv_batch_max) {
+			stats->recv_batch_max = res;
+		}
+	}
+
+	return (res);
+}
+
+/*
+ * Get next undelivered frame. Returns index of the frame or -1 when the
+ * batch is drained.
+ */
+static inline int recv_batch_next (struct recv_batch *batch)
+{
+	if (batch->next >= batch->entries) {
+		return (-1);
+	}
+
+	return (batch->next++);
+}
+
+static inline void *recv_batch_frame (struct recv_batch *batch, int idx)
+{
+	return (batch->iovec[idx].iov_base);
+}
+
+static inline unsigned int recv_batch_frame_len (struct recv_batch *batch, int idx)
+{
+	return (batch->msgs[idx].msg_len);
+}
+
+/*
+ * Returns non-zero if datagram was larger than the frame buffer
+ */
+static inline int recv_batch_frame_truncated (struct recv_batch *batch, int idx)
+{
+#ifdef HAVE_MSGHDR_FLAGS
+	return ((batch->msgs[idx].msg_hdr.msg_flags & MSG_TRUNC) != 0);
+#else
+	/*
+	 * We don't have MSGHDR_FLAGS, but we can (hopefully) safely make assumption that
+	 * if bytes_received == frame_size then packet is truncated
+	 */
+	return (batch->msgs[idx].msg_len == batch->frame_size);
+#endif
+}
+
+#endif /* RECVBATCH_H_DEFINED */
@@ -109,8 +109,8 @@ struct seus_handler_data {
 
 struct corosync_service_engine *corosync_service[SERVICES_COUNT_MAX];
 
-const char *service_stats_rx[SERVICES_COUNT_MAX][SERVICE_HANDLER_MAXIMUM_COUNT];
-const char *service_stats_tx[SERVICES_COUNT_MAX][SERVICE_HANDLER_MAXIMUM_COUNT];
+icmap_counter_t service_stats_rx[SERVICES_COUNT_MAX][SERVICE_HANDLER_MAXIMUM_COUNT];
+icmap_counter_t service_stats_tx[SERVICES_COUNT_MAX][SERVICE_HANDLER_MAXIMUM_COUNT];
 
 static void (*service_unlink_all_complete) (void) = NULL;
 
@@ -162,12 +162,14 @@ char *corosync_service_link_and_init (
 
 	for (fn = 0; fn < service_engine->exec_engine_count; fn++) {
 		snprintf(key_name, ICMAP_KEYNAME_MAXLEN, "runtime.services.%s.%d.tx", name_sufix, fn);
-		icmap_set_uint64(key_name, 0);
-		service_stats_tx[service_engine->id][fn] = strdup(key_name);
+		if (icmap_counter_register(key_name, &service_stats_tx[service_engine->id][fn]) != CS_OK) {
+			service_stats_tx[service_engine->id][fn] = NULL;
+		}
 
 		snprintf(key_name, ICMAP_KEYNAME_MAXLEN, "runtime.services.%s.%d.rx", name_sufix, fn);
-		icmap_set_uint64(key_name, 0);
-		service_stats_rx[service_engine->id][fn] = strdup(key_name);
+		if (icmap_counter_register(key_name, &service_stats_rx[service_engine->id][fn]) != CS_OK) {
+			service_stats_rx[service_engine->id][fn] = NULL;
+		}
 	}
 
 	log_printf (LOGSYS_LEVEL_NOTICE,
@@ -180,6 +182,21 @@ char *corosync_service_link_and_init (
 	return NULL;
 }
 
+/*
+ * Stop counting messages of unloaded service, keys keep last values
+ */
+static void service_stats_unregister (unsigned short service_id)
+{
+	int fn;
+
+	for (fn = 0; fn < SERVICE_HANDLER_MAXIMUM_COUNT; fn++) {
+		icmap_counter_unregister (service_stats_tx[service_id][fn]);
+		service_stats_tx[service_id][fn] = NULL;
+		icmap_counter_unregister (service_stats_rx[service_id][fn]);
+		service_stats_rx[service_id][fn] = NULL;
+	}
+}
+
 static int service_priority_max(void)
 {
 	int lpc = 0, max = 0;
@@ -239,6 +256,7 @@ corosync_service_unlink_and_exit_priority (
 				"Service engine unloaded: %s",
 				corosync_service[*current_service_engine]->name);
 
+			service_stats_unregister (*current_service_engine);
 			corosync_service[*current_service_engine] = NULL;
 
 			/*
@@ -318,6 +336,7 @@ static unsigned int service_unlink_and_exit (
 			"Service engine unloaded: %s",
 			   corosync_service[service_id]->name);
 
+		service_stats_unregister (service_id);
 		corosync_service[service_id] = NULL;
 
 		cs_ipcs_service_destroy (service_id);
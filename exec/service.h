@@ -36,6 +36,7 @@
 #define COROSYNC_SERVICE_H_DEFINED
 
 #include <corosync/hdb.h>
+#include <corosync/icmap.h>
 
 struct corosync_api_v1;
 
@@ -75,8 +76,12 @@ extern unsigned int corosync_service_defaults_link_and_init (
 
 extern struct corosync_service_engine *corosync_service[];
 
-extern const char *service_stats_rx[SERVICES_COUNT_MAX][SERVICE_HANDLER_MAXIMUM_COUNT];
-extern const char *service_stats_tx[SERVICES_COUNT_MAX][SERVICE_HANDLER_MAXIMUM_COUNT];
+/*
+ * Counters of runtime.services.SERVICE.EXEC_CALL.rx/tx keys, NULL if not
+ * registered
+ */
+extern icmap_counter_t service_stats_rx[SERVICES_COUNT_MAX][SERVICE_HANDLER_MAXIMUM_COUNT];
+extern icmap_counter_t service_stats_tx[SERVICES_COUNT_MAX][SERVICE_HANDLER_MAXIMUM_COUNT];
 
 struct corosync_service_engine *votequorum_get_service_engine_ver0 (void);
 struct corosync_service_engine *vsf_quorum_get_service_engine_ver0 (void);
@@ -0,0 +1,247 @@
+/*
+ * Copyright (c) 2026 Red Hat, Inc.
+ *
+ * All rights reserved.
+ *
+ * This software licensed under BSD license, the text of which follows:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ * - Neither the name of the MontaVista Software, Inc. nor the names of its
+ *   contributors may be used to endorse or promote products derived from this
+ *   software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ * THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <config.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <qb/qbdefs.h>
+#include <qb/qbloop.h>
+
+#include <corosync/corotypes.h>
+#include <corosync/logsys.h>
+#include <corosync/icmap.h>
+#include <corosync/totem/totem.h>
+
+#include "main.h"
+#include "statepage.h"
+
+LOGSYS_DECLARE_SUBSYS ("MAIN");
+
+static struct cs_state_page *state_page = NULL;
+
+static qb_loop_timer_handle state_page_heartbeat_timer;
+
+static void state_page_heartbeat (void *data)
+{
+	__atomic_store_n (&state_page->heartbeat_ms, cs_state_page_now_ms (),
+		__ATOMIC_RELEASE);
+
+	qb_loop_timer_add (cs_poll_handle_get (), QB_LOOP_MED,
+		CS_STATE_PAGE_HEARTBEAT_MS * QB_TIME_NS_IN_MSEC, NULL,
+		state_page_heartbeat, &state_page_heartbeat_timer);
+}
+
+/*
+ * Clients of a previous daemon may still have its page mapped, tell them
+ * not to use it anymore
+ */
+static void state_page_obsolete (void)
+{
+	struct cs_state_page *page;
+	struct stat st;
+	int fd;
+
+	fd = open (CS_STATE_PAGE_PATH, O_RDWR | O_NOFOLLOW | O_CLOEXEC);
+	if (fd == -1) {
+		if (errno == ELOOP) {
+			unlink (CS_STATE_PAGE_PATH);
+		}
+		return ;
+	}
+	/*
+	 * Only a page of a previous daemon can have clients, don't write into
+	 * anything else
+	 */
+	if (fstat (fd, &st) == 0 && cs_state_page_file_trusted (&st) &&
+	    st.st_size >= (off_t)sizeof (struct cs_state_page)) {
+		page = mmap (NULL, sizeof (struct cs_state_page), PROT_READ | PROT_WRITE,
+			MAP_SHARED, fd, 0);
+		if (page != MAP_FAILED) {
+			__atomic_store_n (&page->obsolete, 1, __ATOMIC_RELEASE);
+			munmap (page, sizeof (struct cs_state_page));
+		}
+	}
+	close (fd);
+	unlink (CS_STATE_PAGE_PATH);
+}
+
+void cs_state_page_init (void)
+{
+	struct cs_state_page *page;
+	char *str;
+	int enabled = 0;
+	int fd;
+
+	if (icmap_get_string ("system.state_page", &str) == CS_OK) {
+		if (strcmp (str, "yes") == 0) {
+			enabled = 1;
+		}
+		free (str);
+	}
+
+	state_page_obsolete ();
+
+	if (!enabled) {
+		return ;
+	}
+
+	fd = open (CS_STATE_PAGE_PATH, O_RDWR | O_CREAT | O_EXCL | O_NOFOLLOW | O_CLOEXEC, 0644);
+	if (fd == -1) {
+		LOGSYS_PERROR (errno, LOGSYS_LEVEL_WARNING,
+			"Can't create cluster state page %s", CS_STATE_PAGE_PATH);
+		return ;
+	}
+	/*
+	 * Page is meant to be readable by every local user, don't let umask
+	 * interfere
+	 */
+	if (fchmod (fd, 0644) == -1 ||
+	    ftruncate (fd, sizeof (struct cs_state_page)) == -1) {
+		LOGSYS_PERROR (errno, LOGSYS_LEVEL_WARNING,
+			"Can't size cluster state page %s", CS_STATE_PAGE_PATH);
+		close (fd);
+		unlink (CS_STATE_PAGE_PATH);
+		return ;
+	}
+	page = mmap (NULL, sizeof (struct cs_state_page), PROT_READ | PROT_WRITE,
+		MAP_SHARED, fd, 0);
+	close (fd);
+	if (page == MAP_FAILED) {
+		LOGSYS_PERROR (errno, LOGSYS_LEVEL_WARNING,
+			"Can't map cluster state page %s", CS_STATE_PAGE_PATH);
+		unlink (CS_STATE_PAGE_PATH);
+		return ;
+	}
+
+	page->version = CS_STATE_PAGE_VERSION;
+	page->size = sizeof (struct cs_state_page);
+	page->heartbeat_ms = cs_state_page_now_ms ();
+	__atomic_store_n (&page->magic, CS_STATE_PAGE_MAGIC, __ATOMIC_RELEASE);
+
+	state_page = page;
+
+	qb_loop_timer_add (cs_poll_handle_get (), QB_LOOP_MED,
+		CS_STATE_PAGE_HEARTBEAT_MS * QB_TIME_NS_IN_MSEC, NULL,
+		state_page_heartbeat, &state_page_heartbeat_timer);
+
+	log_printf (LOGSYS_LEVEL_INFO, "Cluster state published in %s", CS_STATE_PAGE_PATH);
+}
+
+void cs_state_page_exit (void)
+{
+	if (state_page == NULL) {
+		return ;
+	}
+
+	qb_loop_timer_del (cs_poll_handle_get (), state_page_heartbeat_timer);
+	__atomic_store_n (&state_page->obsolete, 1, __ATOMIC_RELEASE);
+	munmap (state_page, sizeof (struct cs_state_page));
+	state_page = NULL;
+	unlink (CS_STATE_PAGE_PATH);
+}
+
+struct cs_state_page *cs_state_page_write_begin (void)
+{
+	if (state_page == NULL) {
+		return (NULL);
+	}
+
+	__atomic_store_n (&state_page->seq, state_page->seq + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence (__ATOMIC_RELEASE);
+
+	return (state_page);
+}
+
+void cs_state_page_write_end (struct cs_state_page *page)
+{
+	__atomic_store_n (&page->seq, page->seq + 1, __ATOMIC_RELEASE);
+}
+
+void cs_state_page_membership_set (
+	unsigned int local_nodeid,
+	const unsigned int *member_list,
+	size_t member_list_entries,
+	const struct memb_ring_id *ring_id)
+{
+	struct cs_state_page *page;
+
+	page = cs_state_page_write_begin ();
+	if (page == NULL) {
+		return ;
+	}
+
+	if (member_list_entries > CS_STATE_PAGE_NODES_MAX) {
+		member_list_entries = CS_STATE_PAGE_NODES_MAX;
+	}
+	page->local_nodeid = local_nodeid;
+	page->ring_seq = ring_id->seq;
+	page->ring_rep = ring_id->rep;
+	page->member_list_entries = member_list_entries;
+	memcpy (page->member_list, member_list, member_list_entries * sizeof (unsigned int));
+
+	cs_state_page_write_end (page);
+
+	__atomic_store_n (&page->membership_changes, page->membership_changes + 1,
+		__ATOMIC_RELAXED);
+}
+
+void cs_state_page_quorate_set (int quorate)
+{
+	struct cs_state_page *page;
+
+	page = cs_state_page_write_begin ();
+	if (page == NULL) {
+		return ;
+	}
+
+	page->quorum_valid = 1;
+	page->quorate = quorate;
+
+	cs_state_page_write_end (page);
+}
+
+void cs_state_page_cpg_groups_add (int delta)
+{
+	if (state_page == NULL) {
+		return ;
+	}
+
+	__atomic_store_n (&state_page->cpg_groups, state_page->cpg_groups + delta,
+		__ATOMIC_RELAXED);
+}
@@ -44,6 +44,7 @@
 
 #include <qb/qblist.h>
 #include <qb/qbipcs.h>
+#include <qb/qbloop.h>
 #include <qb/qbipc_common.h>
 
 #include <corosync/corodefs.h>
@@ -54,6 +55,7 @@
 
 #include "util.h"
 #include "ipcs_stats.h"
+#include "totemhist.h"
 #include "stats.h"
 
 LOGSYS_DECLARE_SUBSYS ("STATS");
@@ -62,7 +64,7 @@ static qb_map_t *stats_map;
 
 /* Convert iterator number to text and a stats pointer */
 struct cs_stats_conv {
-	enum {STAT_PG, STAT_SRP, STAT_KNET, STAT_KNET_HANDLE, STAT_IPCSC, STAT_IPCSG} type;
+	enum {STAT_PG, STAT_SRP, STAT_SRP_HIST, STAT_KNET, STAT_KNET_HANDLE, STAT_IPCSC, STAT_IPCSG} type;
 	const char *name;
 	const size_t offset;
 	const icmap_value_types_t value_type;
@@ -71,6 +73,8 @@ struct cs_stats_conv {
 struct cs_stats_conv cs_pg_stats[] = {
 	{ STAT_PG, "msg_queue_avail",         offsetof(totempg_stats_t, msg_queue_avail),         ICMAP_VALUETYPE_UINT32},
 	{ STAT_PG, "msg_reserved",            offsetof(totempg_stats_t, msg_reserved),            ICMAP_VALUETYPE_UINT32},
+	{ STAT_PG, "deliver_zerocopy",        offsetof(totempg_stats_t, deliver_zerocopy),        ICMAP_VALUETYPE_UINT64},
+	{ STAT_PG, "deliver_copied",          offsetof(totempg_stats_t, deliver_copied),          ICMAP_VALUETYPE_UINT64},
 };
 struct cs_stats_conv cs_srp_stats[] = {
 	{ STAT_SRP, "orf_token_tx",           offsetof(totemsrp_stats_t, orf_token_tx),           ICMAP_VALUETYPE_UINT64},
@@ -82,6 +86,8 @@ struct cs_stats_conv cs_srp_stats[] = {
 	{ STAT_SRP, "mcast_tx",               offsetof(totemsrp_stats_t, mcast_tx),               ICMAP_VALUETYPE_UINT64},
 	{ STAT_SRP, "mcast_retx",             offsetof(totemsrp_stats_t, mcast_retx),             ICMAP_VALUETYPE_UINT64},
 	{ STAT_SRP, "mcast_rx",               offsetof(totemsrp_stats_t, mcast_rx),               ICMAP_VALUETYPE_UINT64},
+	{ STAT_SRP, "mcast_tx_frames_copied", offsetof(totemsrp_stats_t, mcast_tx_frames_copied), ICMAP_VALUETYPE_UINT64},
+	{ STAT_SRP, "mcast_tx_frames_zerocopy", offsetof(totemsrp_stats_t, mcast_tx_frames_zerocopy), ICMAP_VALUETYPE_UINT64},
 	{ STAT_SRP, "memb_commit_token_tx",   offsetof(totemsrp_stats_t, memb_commit_token_tx),   ICMAP_VALUETYPE_UINT64},
 	{ STAT_SRP, "memb_commit_token_rx",   offsetof(totemsrp_stats_t, memb_commit_token_rx),   ICMAP_VALUETYPE_UINT64},
 	{ STAT_SRP, "token_hold_cancel_tx",   offsetof(totemsrp_stats_t, token_hold_cancel_tx),   ICMAP_VALUETYPE_UINT64},
@@ -96,6 +102,14 @@ struct cs_stats_conv cs_srp_stats[] = {
 	{ STAT_SRP, "recovery_token_lost",    offsetof(totemsrp_stats_t, recovery_token_lost),    ICMAP_VALUETYPE_UINT64},
 	{ STAT_SRP, "consensus_timeouts",     offsetof(totemsrp_stats_t, consensus_timeouts),     ICMAP_VALUETYPE_UINT64},
 	{ STAT_SRP, "rx_msg_dropped",         offsetof(totemsrp_stats_t, rx_msg_dropped),         ICMAP_VALUETYPE_UINT64},
+	{ STAT_SRP, "recv_batches",           offsetof(totemsrp_stats_t, recv_batches),           ICMAP_VALUETYPE_UINT64},
+	{ STAT_SRP, "recv_batch_frames",      offsetof(totemsrp_stats_t, recv_batch_frames),      ICMAP_VALUETYPE_UINT64},
+	{ STAT_SRP, "recv_batch_max",         offsetof(totemsrp_stats_t, recv_batch_max),         ICMAP_VALUETYPE_UINT32},
+	{ STAT_SRP, "frame_pool_hits",        offsetof(totemsrp_stats_t, frame_pool_hits),        ICMAP_VALUETYPE_UINT64},
+	{ STAT_SRP, "frame_pool_misses",      offsetof(totemsrp_stats_t, frame_pool_misses),      ICMAP_VALUETYPE_UINT64},
+	{ STAT_SRP, "frame_pool_high_water",  offsetof(totemsrp_stats_t, frame_pool_high_water),  ICMAP_VALUETYPE_UINT32},
+	{ STAT_SRP, "queue_mem",              offsetof(totemsrp_stats_t, queue_mem),              ICMAP_VALUETYPE_UINT64},
+	{ STAT_SRP, "queue_mem_peak",         offsetof(totemsrp_stats_t, queue_mem_peak),         ICMAP_VALUETYPE_UINT64},
 	{ STAT_SRP, "time_since_token_last_received", offsetof(totemsrp_stats_t, time_since_token_last_received), ICMAP_VALUETYPE_UINT64},
 	{ STAT_SRP, "continuous_gather",      offsetof(totemsrp_stats_t, continuous_gather),      ICMAP_VALUETYPE_UINT32},
 	{ STAT_SRP, "continuous_sendmsg_failures", offsetof(totemsrp_stats_t, continuous_sendmsg_failures), ICMAP_VALUETYPE_UINT32},
@@ -105,6 +119,26 @@ struct cs_stats_conv cs_srp_stats[] = {
 	{ STAT_SRP, "avg_backlog_calc",       offsetof(totemsrp_stats_t, avg_backlog_calc),       ICMAP_VALUETYPE_UINT32},
 };
 
+/* Histograms in stats.srp.hist.<name>, all values in microseconds */
+static const char *cs_srp_hist_names[TOTEM_HIST_MAX] = {
+	[TOTEM_HIST_TOKEN_ROTATION]  = "token_rotation",
+	[TOTEM_HIST_TOKEN_HOLD]      = "token_hold",
+	[TOTEM_HIST_ORF_TOKEN_RTR]   = "orf_token_rtr",
+	[TOTEM_HIST_ORF_TOKEN_MCAST] = "orf_token_mcast",
+	[TOTEM_HIST_DELIVER_TO_APP]  = "deliver_to_app",
+	[TOTEM_HIST_TOKEN_SEND]      = "token_send",
+};
+struct cs_stats_conv cs_srp_hist_stats[] = {
+	{ STAT_SRP_HIST, "count", offsetof(struct totem_hist_summary, count), ICMAP_VALUETYPE_UINT64},
+	{ STAT_SRP_HIST, "min",   offsetof(struct totem_hist_summary, min),   ICMAP_VALUETYPE_UINT64},
+	{ STAT_SRP_HIST, "mean",  offsetof(struct totem_hist_summary, mean),  ICMAP_VALUETYPE_UINT64},
+	{ STAT_SRP_HIST, "p50",   offsetof(struct totem_hist_summary, p50),   ICMAP_VALUETYPE_UINT64},
+	{ STAT_SRP_HIST, "p90",   offsetof(struct totem_hist_summary, p90),   ICMAP_VALUETYPE_UINT64},
+	{ STAT_SRP_HIST, "p99",   offsetof(struct totem_hist_summary, p99),   ICMAP_VALUETYPE_UINT64},
+	{ STAT_SRP_HIST, "p999",  offsetof(struct totem_hist_summary, p999),  ICMAP_VALUETYPE_UINT64},
+	{ STAT_SRP_HIST, "max",   offsetof(struct totem_hist_summary, max),   ICMAP_VALUETYPE_UINT64},
+};
+
 struct cs_stats_conv cs_knet_stats[] = {
 	{ STAT_KNET, "enabled",          offsetof(struct knet_link_status, enabled),                ICMAP_VALUETYPE_UINT8},
 	{ STAT_KNET, "connected",        offsetof(struct knet_link_status, connected),              ICMAP_VALUETYPE_UINT8},
@@ -174,6 +208,13 @@ struct cs_stats_conv cs_knet_handle_stats[] = {
 struct cs_stats_conv cs_ipcs_conn_stats[] = {
 	{ STAT_IPCSC, "queueing",        offsetof(struct ipcs_conn_stats, cnx.queuing),          ICMAP_VALUETYPE_INT32},
 	{ STAT_IPCSC, "queued",          offsetof(struct ipcs_conn_stats, cnx.queued),           ICMAP_VALUETYPE_UINT32},
+	{ STAT_IPCSC, "queued_bytes",    offsetof(struct ipcs_conn_stats, cnx.queued_bytes),     ICMAP_VALUETYPE_UINT64},
+	{ STAT_IPCSC, "outq_state",      offsetof(struct ipcs_conn_stats, cnx.outq_state),       ICMAP_VALUETYPE_UINT32},
+	{ STAT_IPCSC, "outq_over_budget_time", offsetof(struct ipcs_conn_stats, cnx.outq_over_budget_time), ICMAP_VALUETYPE_UINT64},
+	{ STAT_IPCSC, "outq_reschedules", offsetof(struct ipcs_conn_stats, cnx.outq_reschedules), ICMAP_VALUETYPE_UINT64},
+	{ STAT_IPCSC, "outq_dropped",    offsetof(struct ipcs_conn_stats, cnx.outq_dropped),     ICMAP_VALUETYPE_UINT64},
+	{ STAT_IPCSC, "outq_packed_events", offsetof(struct ipcs_conn_stats, cnx.outq_packed_events), ICMAP_VALUETYPE_UINT64},
+	{ STAT_IPCSC, "outq_packed_msgs", offsetof(struct ipcs_conn_stats, cnx.outq_packed_msgs), ICMAP_VALUETYPE_UINT64},
 	{ STAT_IPCSC, "invalid_request", offsetof(struct ipcs_conn_stats, cnx.invalid_request),  ICMAP_VALUETYPE_UINT64},
 	{ STAT_IPCSC, "overload",        offsetof(struct ipcs_conn_stats, cnx.overload),         ICMAP_VALUETYPE_UINT64},
 	{ STAT_IPCSC, "sent",            offsetof(struct ipcs_conn_stats, cnx.sent),             ICMAP_VALUETYPE_UINT32},
@@ -189,10 +230,12 @@ struct cs_stats_conv cs_ipcs_conn_stats[] = {
 struct cs_stats_conv cs_ipcs_global_stats[] = {
 	{ STAT_IPCSG, "global.active",        offsetof(struct ipcs_global_stats, active),           ICMAP_VALUETYPE_UINT64},
 	{ STAT_IPCSG, "global.closed",        offsetof(struct ipcs_global_stats, closed),           ICMAP_VALUETYPE_UINT64},
+	{ STAT_IPCSG, "global.queued_bytes",  offsetof(struct ipcs_global_stats, queued_bytes),     ICMAP_VALUETYPE_UINT64},
 };
 
 #define NUM_PG_STATS (sizeof(cs_pg_stats) / sizeof(struct cs_stats_conv))
 #define NUM_SRP_STATS (sizeof(cs_srp_stats) / sizeof(struct cs_stats_conv))
+#define NUM_SRP_HIST_STATS (sizeof(cs_srp_hist_stats) / sizeof(struct cs_stats_conv))
 #define NUM_KNET_STATS (sizeof(cs_knet_stats) / sizeof(struct cs_stats_conv))
 #define NUM_KNET_HANDLE_STATS (sizeof(cs_knet_handle_stats) / sizeof(struct cs_stats_conv))
 #define NUM_IPCSC_STATS (sizeof(cs_ipcs_conn_stats) / sizeof(struct cs_stats_conv))
@@ -258,9 +301,29 @@ static void stats_rm_entry(const char *key)
 	}
 }
 
-cs_error_t stats_map_init(const struct corosync_api_v1 *corosync_api)
+static int stats_srp_hist_get(const char *key_name, struct totem_hist_summary *summary)
 {
+	char hist_name[ICMAP_KEYNAME_MAXLEN];
+	totempg_stats_t *pg_stats;
 	int i;
+
+	if (sscanf(key_name, "stats.srp.hist.%254[^.]", hist_name) != 1) {
+		return CS_ERR_NOT_EXIST;
+	}
+
+	for (i = 0; i<TOTEM_HIST_MAX; i++) {
+		if (strcmp(hist_name, cs_srp_hist_names[i]) == 0) {
+			pg_stats = api->totem_get_stats();
+			totem_hist_summary_get(&pg_stats->srp->hist[i], summary);
+			return CS_OK;
+		}
+	}
+	return CS_ERR_NOT_EXIST;
+}
+
+cs_error_t stats_map_init(const struct corosync_api_v1 *corosync_api)
+{
+	int i, j;
 	char param[ICMAP_KEYNAME_MAXLEN];
 
 	api = corosync_api;
@@ -279,6 +342,12 @@ cs_error_t stats_map_init(const struct corosync_api_v1 *corosync_api)
 		sprintf(param, "stats.srp.%s", cs_srp_stats[i].name);
 		stats_add_entry(param, &cs_srp_stats[i]);
 	}
+	for (i = 0; i<TOTEM_HIST_MAX; i++) {
+		for (j = 0; j<NUM_SRP_HIST_STATS; j++) {
+			sprintf(param, "stats.srp.hist.%s.%s", cs_srp_hist_names[i], cs_srp_hist_stats[j].name);
+			stats_add_entry(param, &cs_srp_hist_stats[j]);
+		}
+	}
 	for (i = 0; i<NUM_IPCSG_STATS; i++) {
 		sprintf(param, "stats.ipcs.%s", cs_ipcs_global_stats[i].name);
 		stats_add_entry(param, &cs_ipcs_global_stats[i]);
@@ -300,6 +369,7 @@ cs_error_t stats_map_get(const char *key_name,
 	struct ipcs_conn_stats ipcs_conn_stats;
 	struct ipcs_global_stats ipcs_global_stats;
 	struct knet_handle_stats knet_handle_stats;
+	struct totem_hist_summary hist_summary;
 	int res;
 	int nodeid;
 	int link_no;
@@ -322,6 +392,13 @@ cs_error_t stats_map_get(const char *key_name,
 			pg_stats = api->totem_get_stats();
 			stats_map_set_value(statinfo, pg_stats->srp, value, value_len, type);
 			break;
+		case STAT_SRP_HIST:
+			res = stats_srp_hist_get(key_name, &hist_summary);
+			if (res != CS_OK) {
+				return res;
+			}
+			stats_map_set_value(statinfo, &hist_summary, value, value_len, type);
+			break;
 		case STAT_KNET_HANDLE:
 			res = totemknet_handle_get_stats(&knet_handle_stats);
 			if (res) {
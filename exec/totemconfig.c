@@ -80,6 +80,8 @@
 #define MAX_MESSAGES				17
 #define MISS_COUNT_CONST			5
 #define BLOCK_UNLISTED_IPS			1
+#define FRAME_POOL_LOW_WATERMARK		64
+#define FRAME_POOL_HIGH_WATERMARK		128
 
 /* These currently match the defaults in libknet.h */
 #define KNET_PING_INTERVAL                      1000
@@ -1745,6 +1747,20 @@ extern int totem_config_read (
 
 	icmap_get_uint32("totem.netmtu", &totem_config->net_mtu);
 
+	totem_config->frame_pool_low_watermark = FRAME_POOL_LOW_WATERMARK;
+	icmap_get_uint32("totem.frame_pool_low_watermark", &totem_config->frame_pool_low_watermark);
+
+	totem_config->frame_pool_high_watermark = FRAME_POOL_HIGH_WATERMARK;
+	icmap_get_uint32("totem.frame_pool_high_watermark", &totem_config->frame_pool_high_watermark);
+
+	totem_config->frame_pool_prefault = 1;
+	if (icmap_get_string("totem.frame_pool_prefault", &str) == CS_OK) {
+		if (strcmp (str, "no") == 0) {
+			totem_config->frame_pool_prefault = 0;
+		}
+		free(str);
+	}
+
 	totem_config->ip_version = totem_config_get_ip_version(totem_config);
 
 	if (icmap_get_string("totem.interface.0.bindnetaddr", &str) != CS_OK) {
@@ -2038,6 +2054,13 @@ int totem_config_validate (
 		}
 	}
 
+	if (totem_config->frame_pool_high_watermark < totem_config->frame_pool_low_watermark) {
+		snprintf (local_error_reason, sizeof(local_error_reason),
+			"The frame_pool_high_watermark parameter (%u) may not be less than frame_pool_low_watermark (%u).",
+			totem_config->frame_pool_high_watermark, totem_config->frame_pool_low_watermark);
+		goto parse_error;
+	}
+
 	if (totem_config->net_mtu == 0) {
 		if (totem_config->transport_number == TOTEM_TRANSPORT_KNET) {
 			totem_config->net_mtu = KNET_MAX_PACKET_SIZE;
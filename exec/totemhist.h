@@ -0,0 +1,161 @@
+/*
+ * Copyright (c) 2026 Red Hat, Inc.
+ *
+ * All rights reserved.
+ *
+ * This software licensed under BSD license, the text of which follows:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ * - Neither the name of the MontaVista Software, Inc. nor the names of its
+ *   contributors may be used to endorse or promote products derived from this
+ *   software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ * THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef TOTEMHIST_H_DEFINED
+#define TOTEMHIST_H_DEFINED
+
+#include <stdint.h>
+
+#include <corosync/totem/totemstats.h>
+
+#define TOTEM_HIST_SUB_BUCKETS (1U << TOTEM_HIST_SUB_BUCKET_BITS)
+
+/*
+ * Values below TOTEM_HIST_SUB_BUCKETS map one to one, larger values keep
+ * TOTEM_HIST_SUB_BUCKET_BITS significant bits below the most significant one
+ */
+static inline unsigned int totem_hist_bucket (uint32_t value)
+{
+	unsigned int shift;
+
+	if (value < TOTEM_HIST_SUB_BUCKETS) {
+		return (value);
+	}
+
+	shift = (31 - __builtin_clz (value)) - TOTEM_HIST_SUB_BUCKET_BITS;
+
+	return (((shift + 1) << TOTEM_HIST_SUB_BUCKET_BITS) +
+		(value >> shift) - TOTEM_HIST_SUB_BUCKETS);
+}
+
+/*
+ * Highest value which maps to bucket
+ */
+static inline uint64_t totem_hist_bucket_high (unsigned int bucket)
+{
+	unsigned int range = bucket >> TOTEM_HIST_SUB_BUCKET_BITS;
+	uint64_t sub = bucket & (TOTEM_HIST_SUB_BUCKETS - 1);
+
+	if (range == 0) {
+		return (sub);
+	}
+
+	return (((sub + TOTEM_HIST_SUB_BUCKETS + 1) << (range - 1)) - 1);
+}
+
+static inline void totem_hist_record (
+	totem_hist_t *hist,
+	uint64_t value)
+{
+	uint32_t clamped;
+
+	clamped = (value > UINT32_MAX) ? UINT32_MAX : (uint32_t)value;
+
+	if (hist->count == 0 || clamped < hist->min) {
+		hist->min = clamped;
+	}
+	if (clamped > hist->max) {
+		hist->max = clamped;
+	}
+	hist->count += 1;
+	hist->sum += clamped;
+	hist->buckets[totem_hist_bucket (clamped)] += 1;
+}
+
+/*
+ * Percentiles are expressed in thousandths of a percent
+ */
+#define TOTEM_HIST_P50		50000
+#define TOTEM_HIST_P90		90000
+#define TOTEM_HIST_P99		99000
+#define TOTEM_HIST_P999		99900
+#define TOTEM_HIST_P100		100000
+
+struct totem_hist_summary {
+	uint64_t count;
+	uint64_t min;
+	uint64_t mean;
+	uint64_t p50;
+	uint64_t p90;
+	uint64_t p99;
+	uint64_t p999;
+	uint64_t max;
+};
+
+/*
+ * Value below which the given share of samples lies, reported as the upper
+ * bound of the matching bucket but never above the largest sample
+ */
+static inline uint64_t totem_hist_percentile (
+	const totem_hist_t *hist,
+	uint32_t percentile)
+{
+	uint64_t rank;
+	uint64_t seen = 0;
+	uint64_t high;
+	unsigned int i;
+
+	if (hist->count == 0) {
+		return (0);
+	}
+
+	rank = (hist->count * percentile + TOTEM_HIST_P100 - 1) / TOTEM_HIST_P100;
+	if (rank == 0) {
+		rank = 1;
+	}
+
+	for (i = 0; i < TOTEM_HIST_BUCKETS; i++) {
+		seen += hist->buckets[i];
+		if (seen >= rank) {
+			break;
+		}
+	}
+
+	high = totem_hist_bucket_high (i);
+
+	return (high > hist->max ? hist->max : high);
+}
+
+static inline void totem_hist_summary_get (
+	const totem_hist_t *hist,
+	struct totem_hist_summary *summary)
+{
+	summary->count = hist->count;
+	summary->min = hist->min;
+	summary->mean = (hist->count == 0) ? 0 : hist->sum / hist->count;
+	summary->p50 = totem_hist_percentile (hist, TOTEM_HIST_P50);
+	summary->p90 = totem_hist_percentile (hist, TOTEM_HIST_P90);
+	summary->p99 = totem_hist_percentile (hist, TOTEM_HIST_P99);
+	summary->p999 = totem_hist_percentile (hist, TOTEM_HIST_P999);
+	summary->max = hist->max;
+}
+
+#endif /* TOTEMHIST_H_DEFINED */
@@ -74,6 +74,7 @@
 
 #include "main.h"
 #include "util.h"
+#include "recvbatch.h"
 
 #include <libknet.h>
 #include <corosync/totem/totemstats.h>
@@ -147,6 +148,13 @@ struct totemknet_instance {
 
 	char iov_buffer[KNET_MAX_PACKET_SIZE];
 
+	/*
+	 * Frames received by data_deliver_fn
+	 */
+	struct recv_batch recv_batch;
+
+	totemsrp_stats_t *stats;
+
 	char *link_status[INTERFACE_MAX];
 
 	struct totem_ip_address my_ids[INTERFACE_MAX];
@@ -603,6 +611,8 @@ finalise_error:
 
 	log_flush_messages(instance);
 
+	recv_batch_free (&instance->recv_batch);
+
 	return (res);
 }
 
@@ -654,74 +664,40 @@ static int data_deliver_fn (
 	void *data)
 {
 	struct totemknet_instance *instance = (struct totemknet_instance *)data;
-	struct msghdr msg_hdr;
-	struct iovec iov_recv;
-	struct sockaddr_storage system_from;
-	ssize_t msg_len;
-	int truncated_packet;
-
-	iov_recv.iov_base = instance->iov_buffer;
-	iov_recv.iov_len = KNET_MAX_PACKET_SIZE;
-
-	msg_hdr.msg_name = &system_from;
-	msg_hdr.msg_namelen = sizeof (struct sockaddr_storage);
-	msg_hdr.msg_iov = &iov_recv;
-	msg_hdr.msg_iovlen = 1;
-#ifdef HAVE_MSGHDR_CONTROL
-	msg_hdr.msg_control = 0;
-#endif
-#ifdef HAVE_MSGHDR_CONTROLLEN
-	msg_hdr.msg_controllen = 0;
-#endif
-#ifdef HAVE_MSGHDR_FLAGS
-	msg_hdr.msg_flags = 0;
-#endif
-#ifdef HAVE_MSGHDR_ACCRIGHTS
-	msg_hdr.msg_accrights = NULL;
-#endif
-#ifdef HAVE_MSGHDR_ACCRIGHTSLEN
-	msg_hdr.msg_accrightslen = 0;
-#endif
+	struct recv_batch *batch = &instance->recv_batch;
+	int idx;
 
-	msg_len = recvmsg (fd, &msg_hdr, MSG_NOSIGNAL | MSG_DONTWAIT);
-	if (msg_len <= 0) {
+	/*
+	 * Receive all queued datagrams (up to batch size) at once
+	 */
+	if (recv_batch_recv (batch, fd, instance->stats) == 0) {
 		return (0);
 	}
 
-	truncated_packet = 0;
+	while ((idx = recv_batch_next (batch)) != -1) {
+		if (recv_batch_frame_len (batch, idx) == 0) {
+			continue;
+		}
 
-#ifdef HAVE_MSGHDR_FLAGS
-	if (msg_hdr.msg_flags & MSG_TRUNC) {
-		truncated_packet = 1;
-	}
-#else
-	/*
-	 * We don't have MSGHDR_FLAGS, but we can (hopefully) safely make assumption that
-	 * if bytes_received == KNET_MAX_PACKET_SIZE then packet is truncated
-	 */
-	if (bytes_received == KNET_MAX_PACKET_SIZE) {
-		truncated_packet = 1;
-	}
-#endif
+		if (recv_batch_frame_truncated (batch, idx)) {
+			knet_log_printf(instance->totemknet_log_level_error,
+					"Received too big message. This may be because something bad is happening"
+					"on the network (attack?), or you tried join more nodes than corosync is"
+					"compiled with (%u) or bug in the code (bad estimation of "
+					"the KNET_MAX_PACKET_SIZE). Dropping packet.", PROCESSOR_COUNT_MAX);
+			continue;
+		}
 
-	if (truncated_packet) {
-		knet_log_printf(instance->totemknet_log_level_error,
-				"Received too big message. This may be because something bad is happening"
-				"on the network (attack?), or you tried join more nodes than corosync is"
-				"compiled with (%u) or bug in the code (bad estimation of "
-				"the KNET_MAX_PACKET_SIZE). Dropping packet.", PROCESSOR_COUNT_MAX);
-		return (0);
+		/*
+		 * Handle incoming message
+		 */
+		instance->totemknet_deliver_fn (
+			instance->context,
+			recv_batch_frame (batch, idx),
+			recv_batch_frame_len (batch, idx),
+			&batch->system_from[idx]);
 	}
 
-	/*
-	 * Handle incoming message
-	 */
-	instance->totemknet_deliver_fn (
-		instance->context,
-		instance->iov_buffer,
-		msg_len,
-		&system_from);
-
 	return (0);
 }
 
@@ -896,6 +872,12 @@ int totemknet_initialize (
 	totemknet_instance_initialize (instance);
 
 	instance->totem_config = totem_config;
+	instance->stats = stats;
+
+	if (recv_batch_init (&instance->recv_batch, KNET_MAX_PACKET_SIZE) != 0) {
+		free (instance);
+		return (-1);
+	}
 
 	/*
 	* Configure logging
@@ -1068,21 +1050,11 @@ int totemknet_initialize (
 
 exit_error:
 	log_flush_messages(instance);
+	recv_batch_free (&instance->recv_batch);
 	free(instance);
 	return (-1);
 }
 
-void *totemknet_buffer_alloc (void)
-{
-	/* Need to have space for a message AND a struct mcast in case of encapsulated messages */
-	return malloc(KNET_MAX_PACKET_SIZE + 512);
-}
-
-void totemknet_buffer_release (void *ptr)
-{
-	return free (ptr);
-}
-
 int totemknet_processor_count_set (
 	void *knet_context,
 	int processor_count)
@@ -69,9 +69,10 @@ extern int totemknet_initialize (
 	void (*target_set_completed) (
 		void *context));
 
-extern void *totemknet_buffer_alloc (void);
-
-extern void totemknet_buffer_release (void *ptr);
+/*
+ * Need to have space for a message AND a struct mcast in case of encapsulated messages
+ */
+#define TOTEMKNET_BUFFER_SIZE (KNET_MAX_PACKET_SIZE + 512)
 
 extern int totemknet_processor_count_set (
 	void *knet_context,
@@ -74,9 +74,7 @@ struct transport {
 		void (*target_set_completed) (
 			void *context));
 
-	void *(*buffer_alloc) (void);
-
-	void (*buffer_release) (void *ptr);
+	size_t buffer_size;
 
 	int (*processor_count_set) (
 		void *transport_context,
@@ -161,8 +159,7 @@ struct transport transport_entries[] = {
 	{
 		.name = "UDP/IP Multicast",
 		.initialize = totemudp_initialize,
-		.buffer_alloc = totemudp_buffer_alloc,
-		.buffer_release = totemudp_buffer_release,
+		.buffer_size = FRAME_SIZE_MAX,
 		.processor_count_set = totemudp_processor_count_set,
 		.token_send = totemudp_token_send,
 		.mcast_flush_send = totemudp_mcast_flush_send,
@@ -184,8 +181,7 @@ struct transport transport_entries[] = {
 	{
 		.name = "UDP/IP Unicast",
 		.initialize = totemudpu_initialize,
-		.buffer_alloc = totemudpu_buffer_alloc,
-		.buffer_release = totemudpu_buffer_release,
+		.buffer_size = FRAME_SIZE_MAX,
 		.processor_count_set = totemudpu_processor_count_set,
 		.token_send = totemudpu_token_send,
 		.mcast_flush_send = totemudpu_mcast_flush_send,
@@ -207,8 +203,7 @@ struct transport transport_entries[] = {
 	{
 		.name = "Kronosnet",
 		.initialize = totemknet_initialize,
-		.buffer_alloc = totemknet_buffer_alloc,
-		.buffer_release = totemknet_buffer_release,
+		.buffer_size = TOTEMKNET_BUFFER_SIZE,
 		.processor_count_set = totemknet_processor_count_set,
 		.token_send = totemknet_token_send,
 		.mcast_flush_send = totemknet_mcast_flush_send,
@@ -348,20 +343,12 @@ error_destroy:
 	return (-1);
 }
 
-void *totemnet_buffer_alloc (void *net_context)
-{
-	struct totemnet_instance *instance = net_context;
-	assert (instance != NULL);
-	assert (instance->transport != NULL);
-	return instance->transport->buffer_alloc();
-}
-
-void totemnet_buffer_release (void *net_context, void *ptr)
+size_t totemnet_buffer_size (void *net_context)
 {
 	struct totemnet_instance *instance = net_context;
 	assert (instance != NULL);
 	assert (instance->transport != NULL);
-	instance->transport->buffer_release (ptr);
+	return instance->transport->buffer_size;
 }
 
 int totemnet_processor_count_set (
@@ -79,9 +79,7 @@ extern int totemnet_initialize (
 	void (*target_set_completed) (
 		void *context));
 
-extern void *totemnet_buffer_alloc (void *net_context);
-
-extern void totemnet_buffer_release (void *net_context, void *ptr);
+extern size_t totemnet_buffer_size (void *net_context);
 
 extern int totemnet_processor_count_set (
 	void *net_context,
@@ -153,6 +153,16 @@ struct totempg_mcast {
 #define TOTEMPG_PACKET_SIZE (totempg_totem_config->net_mtu - \
 	sizeof (struct totempg_mcast))
 
+/*
+ * Maximum number of messages packed into one frame.  The message length
+ * table is written into the frame headroom in front of the packed data, so
+ * this bounds the headroom reserved in every frame.
+ */
+#define TOTEMPG_PACKED_MSG_MAX	1024
+
+#define TOTEMPG_FRAME_HEADROOM	(sizeof (struct totempg_mcast) + \
+	TOTEMPG_PACKED_MSG_MAX * sizeof (unsigned short))
+
 /*
  * Local variables used for packing small messages
  */
@@ -196,12 +206,36 @@ enum throw_away_mode {
 	THROW_AWAY_ACTIVE
 };
 
+#define ASSEMBLY_DATA_SIZE		(MESSAGE_SIZE_MAX+KNET_MAX_PACKET_SIZE)
+
+/*
+ * Number of unused assembly data buffers kept for reuse
+ */
+#define ASSEMBLY_DATA_CACHE_MAX		4
+
+#define ASSEMBLY_HASH_BITS		9
+#define ASSEMBLY_HASH_BUCKETS		(1 << ASSEMBLY_HASH_BITS)
+
+enum assembly_table {
+	ASSEMBLY_TABLE_OPERATIONAL = 0,
+	ASSEMBLY_TABLE_TRANS = 1,
+	ASSEMBLY_TABLE_MAX = 2
+};
+
+/*
+ * An assembly is only in use while a message from nodeid is being
+ * delivered or a fragment from it is pending. The data buffer is attached
+ * for that time only and otherwise cached or freed, so nodes which are
+ * idle don't pin a buffer of ASSEMBLY_DATA_SIZE bytes.
+ */
 struct assembly {
 	unsigned int nodeid;
-	unsigned char data[MESSAGE_SIZE_MAX+KNET_MAX_PACKET_SIZE];
+	unsigned char *data;
 	int index;
 	unsigned char last_frag_num;
 	enum throw_away_mode throw_away_mode;
+	enum assembly_table table;
+	struct assembly *hash_next;
 	struct qb_list_head list;
 };
 
@@ -210,14 +244,20 @@ static void assembly_deref (struct assembly *assembly);
 static int callback_token_received_fn (enum totem_callback_token_type type,
 	const void *data);
 
-QB_LIST_DECLARE(assembly_list_inuse);
+/*
+ * Assemblies in use, hashed by nodeid. Transitional and operational
+ * assemblies are kept in separate tables.
+ */
+static struct assembly *assembly_hash[ASSEMBLY_TABLE_MAX][ASSEMBLY_HASH_BUCKETS];
 
 /*
  * Free list is used both for transitional and operational assemblies
  */
 QB_LIST_DECLARE(assembly_list_free);
 
-QB_LIST_DECLARE(assembly_list_inuse_trans);
+static unsigned char *assembly_data_cache[ASSEMBLY_DATA_CACHE_MAX];
+
+static int assembly_data_cache_entries = 0;
 
 QB_LIST_DECLARE(totempg_groups_list);
 
@@ -230,7 +270,12 @@ QB_LIST_DECLARE(totempg_groups_list);
  * the size of message data and where to place new message data.
  * fragment_contuation indicates whether the first packed message in
  * the buffer is a continuation of a previously packed fragment.
+ *
+ * The staging buffer is the payload area of a totemsrp zero-copy frame,
+ * which is handed over to totemsrp as is once it is sent.
  */
+static void *fragmentation_frame;
+
 static unsigned char *fragmentation_data;
 
 static int fragment_size = 0;
@@ -287,92 +332,133 @@ static void totempg_waiting_trans_ack_cb (int waiting_trans_ack)
 	totempg_waiting_transack = waiting_trans_ack;
 }
 
-static struct assembly *assembly_ref (unsigned int nodeid)
+static inline unsigned int assembly_hash_bucket (unsigned int nodeid)
 {
-	struct assembly *assembly;
-	struct qb_list_head *list;
-	struct qb_list_head *active_assembly_list_inuse;
+	return ((nodeid * 2654435761U) >> (32 - ASSEMBLY_HASH_BITS));
+}
 
-	if (totempg_waiting_transack) {
-		active_assembly_list_inuse = &assembly_list_inuse_trans;
-	} else {
-		active_assembly_list_inuse = &assembly_list_inuse;
+static unsigned char *assembly_data_get (void)
+{
+	if (assembly_data_cache_entries > 0) {
+		assembly_data_cache_entries -= 1;
+		return (assembly_data_cache[assembly_data_cache_entries]);
 	}
+	return (malloc (ASSEMBLY_DATA_SIZE));
+}
 
-	/*
-	 * Search inuse list for node id and return assembly buffer if found
-	 */
-	qb_list_for_each(list, active_assembly_list_inuse) {
-		assembly = qb_list_entry (list, struct assembly, list);
+static void assembly_data_put (unsigned char *data)
+{
+	if (assembly_data_cache_entries < ASSEMBLY_DATA_CACHE_MAX) {
+		assembly_data_cache[assembly_data_cache_entries] = data;
+		assembly_data_cache_entries += 1;
+		return;
+	}
+	free (data);
+}
+
+static struct assembly *assembly_find (
+	enum assembly_table table,
+	unsigned int nodeid)
+{
+	struct assembly *assembly;
+
+	for (assembly = assembly_hash[table][assembly_hash_bucket (nodeid)];
+		assembly != NULL; assembly = assembly->hash_next) {
 
 		if (nodeid == assembly->nodeid) {
 			return (assembly);
 		}
 	}
+	return (NULL);
+}
+
+/*
+ * Assemblies started while waiting for the transitional configuration
+ * are kept apart from the operational ones
+ */
+static inline enum assembly_table assembly_table_get (void)
+{
+	if (totempg_waiting_transack) {
+		return (ASSEMBLY_TABLE_TRANS);
+	}
+	return (ASSEMBLY_TABLE_OPERATIONAL);
+}
+
+static struct assembly *assembly_ref (unsigned int nodeid)
+{
+	struct assembly *assembly;
+	enum assembly_table table;
+	unsigned int bucket;
+
+	table = assembly_table_get ();
 
 	/*
-	 * Nothing found in inuse list get one from free list if available
+	 * Search inuse table for node id and return assembly buffer if found
 	 */
-	if (qb_list_empty (&assembly_list_free) == 0) {
-		assembly = qb_list_first_entry (&assembly_list_free, struct assembly, list);
-		qb_list_del (&assembly->list);
-		qb_list_add (&assembly->list, active_assembly_list_inuse);
-		assembly->nodeid = nodeid;
-		assembly->index = 0;
-		assembly->last_frag_num = 0;
-		assembly->throw_away_mode = THROW_AWAY_INACTIVE;
+	assembly = assembly_find (table, nodeid);
+	if (assembly != NULL) {
 		return (assembly);
 	}
 
 	/*
-	 * Nothing available in inuse or free list, so allocate a new one
+	 * Nothing found in inuse table get one from free list if available
 	 */
-	assembly = malloc (sizeof (struct assembly));
-	/*
-	 * TODO handle memory allocation failure here
-	 */
-	assert (assembly);
+	if (qb_list_empty (&assembly_list_free) == 0) {
+		assembly = qb_list_first_entry (&assembly_list_free, struct assembly, list);
+		qb_list_del (&assembly->list);
+	} else {
+		assembly = malloc (sizeof (struct assembly));
+		/*
+		 * TODO handle memory allocation failure here
+		 */
+		assert (assembly);
+		qb_list_init (&assembly->list);
+	}
+
+	assembly->data = assembly_data_get ();
+	assert (assembly->data);
 	assembly->nodeid = nodeid;
 	assembly->data[0] = 0;
 	assembly->index = 0;
 	assembly->last_frag_num = 0;
 	assembly->throw_away_mode = THROW_AWAY_INACTIVE;
-	qb_list_init (&assembly->list);
-	qb_list_add (&assembly->list, active_assembly_list_inuse);
+	assembly->table = table;
+
+	bucket = assembly_hash_bucket (nodeid);
+	assembly->hash_next = assembly_hash[table][bucket];
+	assembly_hash[table][bucket] = assembly;
 
 	return (assembly);
 }
 
 static void assembly_deref (struct assembly *assembly)
 {
-	qb_list_del (&assembly->list);
+	struct assembly **prev;
+
+	prev = &assembly_hash[assembly->table][assembly_hash_bucket (assembly->nodeid)];
+	while (*prev != assembly) {
+		prev = &(*prev)->hash_next;
+	}
+	*prev = assembly->hash_next;
+	assembly->hash_next = NULL;
+
+	assembly_data_put (assembly->data);
+	assembly->data = NULL;
+
 	qb_list_add (&assembly->list, &assembly_list_free);
 }
 
 static void assembly_deref_from_normal_and_trans (int nodeid)
 {
-	int j;
-	struct qb_list_head *list, *tmp_iter;
-	struct qb_list_head *active_assembly_list_inuse;
 	struct assembly *assembly;
+	int table;
 
-	for (j = 0; j < 2; j++) {
-		if (j == 0) {
-			active_assembly_list_inuse = &assembly_list_inuse;
-		} else {
-			active_assembly_list_inuse = &assembly_list_inuse_trans;
-		}
-
-		qb_list_for_each_safe(list, tmp_iter, active_assembly_list_inuse) {
-			assembly = qb_list_entry (list, struct assembly, list);
-
-			if (nodeid == assembly->nodeid) {
-				qb_list_del (&assembly->list);
-				qb_list_add (&assembly->list, &assembly_list_free);
-			}
+	for (table = 0; table < ASSEMBLY_TABLE_MAX; table++) {
+		assembly = assembly_find (table, nodeid);
+		if (assembly != NULL) {
+			assembly_deref (assembly);
 		}
 	}
-
 }
 
 static inline void app_confchg_fn (
@@ -586,6 +672,25 @@ static void totempg_confchg_fn (
 		ring_id);
 }
 
+/*
+ * Length of the idx-th packed message. Lengths follow the totempg header
+ * in the frame and are not necessarily aligned.
+ */
+static inline unsigned short mcast_msg_len (
+	const struct totempg_mcast *mcast,
+	int idx,
+	int endian_conversion_required)
+{
+	unsigned short len;
+
+	memcpy (&len, (const char *)mcast + sizeof (struct totempg_mcast) +
+		idx * sizeof (unsigned short), sizeof (unsigned short));
+	if (endian_conversion_required) {
+		len = swab16 (len);
+	}
+	return (len);
+}
+
 static void totempg_deliver_fn (
 	unsigned int nodeid,
 	const void *msg,
@@ -593,58 +698,79 @@ static void totempg_deliver_fn (
 	int endian_conversion_required)
 {
 	struct totempg_mcast *mcast;
-	unsigned short *msg_lens;
 	int i;
 	struct assembly *assembly;
-	char header[FRAME_SIZE_MAX];
 	int msg_count;
 	int continuation;
 	int start;
 	const char *data;
 	int datasize;
+	unsigned short len;
 	struct iovec iov_delv;
 
-	assembly = assembly_ref (nodeid);
-	assert (assembly);
-
-	/*
-	 * Assemble the header into one block of data and
-	 * assemble the packet contents into one block of data to simplify delivery
-	 */
-
 	mcast = (struct totempg_mcast *)msg;
 	if (endian_conversion_required) {
 		mcast->msg_count = swab16 (mcast->msg_count);
 	}
 
-	msg_count = mcast->msg_count;
 	datasize = sizeof (struct totempg_mcast) +
-		msg_count * sizeof (unsigned short);
+		mcast->msg_count * sizeof (unsigned short);
 
-	memcpy (header, msg, datasize);
-	data = msg;
+	/*
+	 * If the last message in the buffer is a fragment, then we
+	 * can't deliver it.  We'll first deliver the full messages
+	 * then keep the fragment in the assembly buffer so we can add
+	 * the rest of it when it arrives.
+	 */
+	msg_count = mcast->fragmented ? mcast->msg_count - 1 : mcast->msg_count;
+	continuation = mcast->continuation;
 
-	msg_lens = (unsigned short *) (header + sizeof (struct totempg_mcast));
-	if (endian_conversion_required) {
-		for (i = 0; i < mcast->msg_count; i++) {
-			msg_lens[i] = swab16 (msg_lens[i]);
+	/*
+	 * Nothing is pending for this node, so complete messages are delivered
+	 * straight from the frame and only a trailing fragment is copied.
+	 * Services convert endianness in place, which must not happen to a
+	 * frame still held in the sort queue, so frames needing conversion
+	 * always go through the assembly buffer.
+	 */
+	if (endian_conversion_required == 0 && continuation == 0 &&
+	    assembly_find (assembly_table_get (), nodeid) == NULL) {
+
+		data = (const char *)msg + datasize;
+		for (i = 0; i < msg_count; i++) {
+			len = mcast_msg_len (mcast, i, 0);
+			app_deliver_fn (nodeid, (void *)data, len, 0);
+			data += len;
+		}
+		totempg_stats.deliver_zerocopy += msg_count;
+
+		if (mcast->fragmented) {
+			assembly = assembly_ref (nodeid);
+			assert (assembly);
+
+			len = mcast_msg_len (mcast, msg_count, 0);
+			assert (len < ASSEMBLY_DATA_SIZE);
+			memcpy (assembly->data, data, len);
+			assembly->index = len;
+			assembly->last_frag_num = mcast->fragmented;
 		}
+		return;
 	}
 
-	assert((assembly->index+msg_len) < sizeof(assembly->data));
-	memcpy (&assembly->data[assembly->index], &data[datasize],
-		msg_len - datasize);
+	assembly = assembly_ref (nodeid);
+	assert (assembly);
 
 	/*
-	 * If the last message in the buffer is a fragment, then we
-	 * can't deliver it.  We'll first deliver the full messages
-	 * then adjust the assembly buffer so we can add the rest of the
-	 * fragment when it arrives.
+	 * Assemble the packet contents into one block of data to simplify
+	 * delivery
 	 */
-	msg_count = mcast->fragmented ? mcast->msg_count - 1 : mcast->msg_count;
-	continuation = mcast->continuation;
+	data = msg;
+	assert((assembly->index+msg_len) < ASSEMBLY_DATA_SIZE);
+	memcpy (&assembly->data[assembly->index], &data[datasize],
+		msg_len - datasize);
+
 	iov_delv.iov_base = (void *)&assembly->data[0];
-	iov_delv.iov_len = assembly->index + msg_lens[0];
+	iov_delv.iov_len = assembly->index +
+		mcast_msg_len (mcast, 0, endian_conversion_required);
 
 	/*
 	 * Make sure that if this message is a continuation, that it
@@ -663,9 +789,11 @@ static void totempg_deliver_fn (
 		if (mcast->fragmented == 0 || mcast->fragmented == 1) {
 			assembly->throw_away_mode = THROW_AWAY_INACTIVE;
 
-			assembly->index += msg_lens[0];
+			assembly->index += mcast_msg_len (mcast, 0,
+				endian_conversion_required);
 			iov_delv.iov_base = (void *)&assembly->data[assembly->index];
-			iov_delv.iov_len = msg_lens[1];
+			iov_delv.iov_len = mcast_msg_len (mcast, 1,
+				endian_conversion_required);
 			start = 1;
 		}
 	} else
@@ -675,12 +803,17 @@ static void totempg_deliver_fn (
 			for  (i = start; i < msg_count; i++) {
 				app_deliver_fn(nodeid, iov_delv.iov_base, iov_delv.iov_len,
 					endian_conversion_required);
-				assembly->index += msg_lens[i];
+				assembly->index += mcast_msg_len (mcast, i,
+					endian_conversion_required);
 				iov_delv.iov_base = (void *)&assembly->data[assembly->index];
 				if (i < (msg_count - 1)) {
-					iov_delv.iov_len = msg_lens[i + 1];
+					iov_delv.iov_len = mcast_msg_len (mcast, i + 1,
+						endian_conversion_required);
 				}
 			}
+			if (msg_count > start) {
+				totempg_stats.deliver_copied += msg_count - start;
+			}
 		} else {
 			log_printf (LOG_DEBUG, "fragmented continuation %u is not equal to assembly last_frag_num %u",
 					continuation, assembly->last_frag_num);
@@ -699,14 +832,15 @@ static void totempg_deliver_fn (
 		/*
 		 * Message is fragmented, keep around assembly list
 		 */
+		len = mcast_msg_len (mcast, msg_count, endian_conversion_required);
 		if (mcast->msg_count > 1) {
 			memmove (&assembly->data[0],
 				&assembly->data[assembly->index],
-				msg_lens[msg_count]);
+				len);
 
 			assembly->index = 0;
 		}
-		assembly->index += msg_lens[msg_count];
+		assembly->index += len;
 	}
 }
 
@@ -717,11 +851,52 @@ static void totempg_deliver_fn (
 
 void *callback_token_received_handle;
 
+/*
+ * Send the frame being packed.  The totempg header and the packed message
+ * lengths are written into the headroom just in front of the packed data,
+ * then the whole frame is handed to totemsrp and a new one starts staging.
+ */
+static int packed_frame_send (
+	struct totempg_mcast *mcast,
+	unsigned int data_len,
+	int guarantee)
+{
+	unsigned int lens_len;
+	unsigned char *msg;
+	void *new_frame;
+	void *new_data;
+	int res;
+
+	assert (mcast->msg_count <= TOTEMPG_PACKED_MSG_MAX);
+	lens_len = mcast->msg_count * sizeof (unsigned short);
+
+	new_frame = totemsrp_mcast_frame_alloc (totemsrp_context,
+		TOTEMPG_FRAME_HEADROOM, &new_data);
+	if (new_frame == NULL) {
+		return (-1);
+	}
+
+	msg = fragmentation_data - lens_len - sizeof (struct totempg_mcast);
+	memcpy (msg, mcast, sizeof (struct totempg_mcast));
+	memcpy (msg + sizeof (struct totempg_mcast), mcast_packed_msg_lens, lens_len);
+
+	res = totemsrp_mcast_frame (totemsrp_context, fragmentation_frame, msg,
+		sizeof (struct totempg_mcast) + lens_len + data_len, guarantee);
+	if (res == -1) {
+		totemsrp_mcast_frame_free (totemsrp_context, new_frame);
+		return (-1);
+	}
+
+	fragmentation_frame = new_frame;
+	fragmentation_data = new_data;
+
+	return (0);
+}
+
 int callback_token_received_fn (enum totem_callback_token_type type,
 				const void *data)
 {
 	struct totempg_mcast mcast;
-	struct iovec iovecs[3];
 
 	if (totempg_threaded_mode == 1) {
 		pthread_mutex_lock (&mcast_msg_mutex);
@@ -751,13 +926,7 @@ int callback_token_received_fn (enum totem_callback_token_type type,
 
 	mcast.msg_count = mcast_packed_msg_count;
 
-	iovecs[0].iov_base = (void *)&mcast;
-	iovecs[0].iov_len = sizeof (struct totempg_mcast);
-	iovecs[1].iov_base = (void *)mcast_packed_msg_lens;
-	iovecs[1].iov_len = mcast_packed_msg_count * sizeof (unsigned short);
-	iovecs[2].iov_base = (void *)&fragmentation_data[0];
-	iovecs[2].iov_len = fragment_size;
-	(void)totemsrp_mcast (totemsrp_context, iovecs, 3, 0);
+	(void)packed_frame_send (&mcast, fragment_size, 0);
 
 	mcast_packed_msg_count = 0;
 	fragment_size = 0;
@@ -786,11 +955,6 @@ int totempg_initialize (
 	totempg_log_printf = totem_config->totem_logging_configuration.log_printf;
 	totempg_subsys_id = totem_config->totem_logging_configuration.log_subsys_id;
 
-	fragmentation_data = malloc (TOTEMPG_PACKET_SIZE);
-	if (fragmentation_data == 0) {
-		return (-1);
-	}
-
 	totemsrp_net_mtu_adjust (totem_config);
 
 	res = totemsrp_initialize (
@@ -806,6 +970,13 @@ int totempg_initialize (
 		goto error_exit;
 	}
 
+	fragmentation_frame = totemsrp_mcast_frame_alloc (totemsrp_context,
+		TOTEMPG_FRAME_HEADROOM, (void **)&fragmentation_data);
+	if (fragmentation_frame == NULL) {
+		res = -1;
+		goto error_exit;
+	}
+
 	totemsrp_callback_token_create (
 		totemsrp_context,
 		&callback_token_received_handle,
@@ -829,6 +1000,8 @@ void totempg_finalize (void)
 	if (totempg_threaded_mode == 1) {
 		pthread_mutex_lock (&totempg_mutex);
 	}
+	totemsrp_mcast_frame_free (totemsrp_context, fragmentation_frame);
+	fragmentation_frame = NULL;
 	totemsrp_finalize (totemsrp_context);
 	if (totempg_threaded_mode == 1) {
 		pthread_mutex_unlock (&totempg_mutex);
@@ -845,7 +1018,6 @@ static int mcast_msg (
 {
 	int res = 0;
 	struct totempg_mcast mcast;
-	struct iovec iovecs[3];
 	struct iovec iovec[64];
 	int i;
 	int dest, src;
@@ -871,6 +1043,30 @@ static int mcast_msg (
 	}
 	iov_len = dest;
 
+	/*
+	 * The length table of a frame can't outgrow the headroom reserved
+	 * for it, send the packed messages first if it is full
+	 */
+	if (mcast_packed_msg_count >= TOTEMPG_PACKED_MSG_MAX) {
+		mcast.header.version = 0;
+		mcast.header.type = 0;
+		mcast.fragmented = 0;
+		mcast.continuation = fragment_continuation;
+		fragment_continuation = 0;
+		mcast.msg_count = mcast_packed_msg_count;
+
+		if (totemsrp_avail (totemsrp_context) == 0 ||
+			packed_frame_send (&mcast, fragment_size, guarantee) == -1) {
+
+			if (totempg_threaded_mode == 1) {
+				pthread_mutex_unlock (&mcast_msg_mutex);
+			}
+			return (-1);
+		}
+		mcast_packed_msg_count = 0;
+		fragment_size = 0;
+	}
+
 	max_packet_size = TOTEMPG_PACKET_SIZE -
 		(sizeof (unsigned short) * (mcast_packed_msg_count + 1));
 
@@ -921,14 +1117,7 @@ static int mcast_msg (
 		 * If it just fits or is too big, then send out what fits.
 		 */
 		} else {
-			unsigned char *data_ptr;
-
 			copy_len = min(copy_len, max_packet_size - fragment_size);
-			if( copy_len == max_packet_size )
-				data_ptr = (unsigned char *)iovec[i].iov_base + copy_base;
-			else {
-				data_ptr = fragmentation_data;
-			}
 
 			memcpy (&fragmentation_data[fragment_size],
 				(unsigned char *)iovec[i].iov_base + copy_base, copy_len);
@@ -956,15 +1145,9 @@ static int mcast_msg (
 			 * assemble the message and send it
 			 */
 			mcast.msg_count = ++mcast_packed_msg_count;
-			iovecs[0].iov_base = (void *)&mcast;
-			iovecs[0].iov_len = sizeof(struct totempg_mcast);
-			iovecs[1].iov_base = (void *)mcast_packed_msg_lens;
-			iovecs[1].iov_len = mcast_packed_msg_count *
-				sizeof(unsigned short);
-			iovecs[2].iov_base = (void *)data_ptr;
-			iovecs[2].iov_len = fragment_size + copy_len;
 			assert (totemsrp_avail(totemsrp_context) > 0);
-			res = totemsrp_mcast (totemsrp_context, iovecs, 3, guarantee);
+			res = packed_frame_send (&mcast, fragment_size + copy_len,
+				guarantee);
 			if (res == -1) {
 				goto error_exit;
 			}
@@ -1240,6 +1423,89 @@ int totempg_groups_mcast_joined (
 	return (res);
 }
 
+/*
+ * Multicast msg_count independent messages with one queue space check.
+ * iovec holds the vectors of all messages back to back, iov_lens[n] is the
+ * number of vectors of message n. Returns the number of messages queued,
+ * counted from the first one. If the new message queue can't take all of
+ * them none is queued, but a message can still fail once the check passed,
+ * so callers must only resend the messages past the returned count.
+ */
+int totempg_groups_mcast_joined_multi (
+	void *totempg_groups_instance,
+	const struct iovec *iovec,
+	const unsigned int *iov_lens,
+	unsigned int msg_count,
+	int guarantee)
+{
+	struct totempg_group_instance *instance = (struct totempg_group_instance *)totempg_groups_instance;
+	unsigned short group_len[MAX_GROUPS_PER_MSG + 1];
+	struct iovec iovec_mcast[MAX_GROUPS_PER_MSG + 1 + MAX_IOVECS_FROM_APP];
+	unsigned int groups_size;
+	unsigned int total_size = 0;
+	unsigned int msg;
+	unsigned int vec;
+	unsigned int i;
+	int queued = 0;
+	int res = 0;
+
+	if (totempg_threaded_mode == 1) {
+		pthread_mutex_lock (&totempg_mutex);
+	}
+
+	group_len[0] = instance->groups_cnt;
+	groups_size = (instance->groups_cnt + 1) * sizeof (unsigned short);
+	for (i = 0; i < instance->groups_cnt; i++) {
+		group_len[i + 1] = instance->groups[i].group_len;
+		iovec_mcast[i + 1].iov_len = instance->groups[i].group_len;
+		iovec_mcast[i + 1].iov_base = (void *) instance->groups[i].group;
+		groups_size += instance->groups[i].group_len;
+	}
+	iovec_mcast[0].iov_len = (instance->groups_cnt + 1) * sizeof (unsigned short);
+	iovec_mcast[0].iov_base = group_len;
+
+	/*
+	 * Every message costs its group header and one entry in the length
+	 * table of the packed frame
+	 */
+	for (msg = 0, vec = 0; msg < msg_count; msg++) {
+		total_size += groups_size + sizeof (unsigned short);
+		for (i = 0; i < iov_lens[msg]; i++, vec++) {
+			total_size += iovec[vec].iov_len;
+		}
+	}
+
+	if (totempg_threaded_mode == 1) {
+		pthread_mutex_lock (&mcast_msg_mutex);
+	}
+	if (byte_count_send_ok (total_size + sizeof (unsigned short) *
+		mcast_packed_msg_count) == 0) {
+
+		res = -1;
+	}
+	if (totempg_threaded_mode == 1) {
+		pthread_mutex_unlock (&mcast_msg_mutex);
+	}
+
+	for (msg = 0, vec = 0; res == 0 && msg < msg_count; msg++) {
+		assert (iov_lens[msg] <= MAX_IOVECS_FROM_APP);
+		for (i = 0; i < iov_lens[msg]; i++, vec++) {
+			iovec_mcast[i + instance->groups_cnt + 1] = iovec[vec];
+		}
+		res = mcast_msg (iovec_mcast,
+			iov_lens[msg] + instance->groups_cnt + 1, guarantee);
+		if (res == 0) {
+			queued++;
+		}
+	}
+
+	if (totempg_threaded_mode == 1) {
+		pthread_mutex_unlock (&totempg_mutex);
+	}
+
+	return (queued);
+}
+
 static void check_q_level(
 	void *totempg_groups_instance)
 {
@@ -1536,6 +1802,8 @@ extern void totempg_stats_clear (int flags)
 	if (flags & TOTEMPG_STATS_CLEAR_TOTEM) {
 		totempg_stats.msg_reserved = 0;
 		totempg_stats.msg_queue_avail = 0;
+		totempg_stats.deliver_zerocopy = 0;
+		totempg_stats.deliver_copied = 0;
 	}
 	return totemsrp_stats_clear (totemsrp_context, flags);
 }
@@ -88,13 +88,17 @@
 #include "totemnet.h"
 
 #include "cs_queue.h"
+#include "framepool.h"
+#include "totemhist.h"
 
 #define LOCALHOST_IP				inet_addr("127.0.0.1")
 #define QUEUE_RTR_ITEMS_SIZE_MAX		16384 /* allow 16384 retransmit items */
 #define RETRANS_MESSAGE_QUEUE_SIZE_MAX		16384 /* allow 500 messages to be queued */
+#define RETRANS_MESSAGE_QUEUE_SIZE_MIN		256
 #define RECEIVED_MESSAGE_QUEUE_SIZE_MAX		500 /* allow 500 messages to be queued */
 #define MAXIOVS					5
 #define RETRANSMIT_ENTRIES_MAX			30
+#define RTR_RANGE_BITMAP_BITS			64
 #define TOKEN_SIZE_MAX				64000 /* bytes */
 #define LEAVE_DUMMY_NODEID                      0
 
@@ -193,6 +197,18 @@ struct rtr_item  {
 	unsigned int seq;
 }__attribute__((packed));
 
+/*
+ * Retransmit list entry of TOTEM_MH_VERSION_RTR_RANGE tokens. Requests
+ * count consecutive messages starting at seq plus every message seq +
+ * count + n for which bit n of bitmap is set.
+ */
+struct rtr_range_item {
+	struct memb_ring_id ring_id;
+	unsigned int seq;
+	unsigned int count;
+	uint64_t bitmap;
+}__attribute__((packed));
+
 
 struct orf_token {
 	struct totem_message_header header;
@@ -220,6 +236,7 @@ struct memb_join {
  * These parts of the data structure are dynamic:
  * struct srp_addr proc_list[];
  * struct srp_addr failed_list[];
+ * unsigned int token_version; (optional, highest orf_token version understood)
  */
 } __attribute__((packed));
 
@@ -261,14 +278,20 @@ struct memb_commit_token {
  */
 }__attribute__((packed));
 
+/*
+ * frame is set when mcast points into a zero-copy frame handed over by
+ * totemsrp_mcast_frame, in that case frame is what has to be released
+ */
 struct message_item {
 	struct mcast *mcast;
 	unsigned int msg_len;
+	void *frame;
 };
 
 struct sort_queue_item {
 	struct mcast *mcast;
 	unsigned int msg_len;
+	void *frame;
 };
 
 enum memb_state {
@@ -308,6 +331,14 @@ struct totemsrp_instance {
 
 	struct srp_addr my_new_memb_list[PROCESSOR_COUNT_MAX];
 
+	/*
+	 * Processors which announced TOTEM_MH_VERSION_RTR_RANGE tokens in
+	 * their last join message
+	 */
+	struct srp_addr my_rtr_range_list[PROCESSOR_COUNT_MAX];
+
+	int my_rtr_range_list_entries;
+
 	struct srp_addr my_trans_memb_list[PROCESSOR_COUNT_MAX];
 
 	struct srp_addr my_memb_list[PROCESSOR_COUNT_MAX];
@@ -512,6 +543,12 @@ struct totemsrp_instance {
 
 	totemsrp_stats_t stats;
 
+	/*
+	 * Receive time of the last token this processor forwarded, 0 if the
+	 * token was held or lost since
+	 */
+	unsigned long long token_hist_last_rx;
+
 	uint32_t orf_token_discard;
 
 	uint32_t originated_orf_token;
@@ -522,6 +559,11 @@ struct totemsrp_instance {
 
 	int 	flushing;
 
+	/*
+	 * Frames for queued, retransmitted and zero-copy multicasts
+	 */
+	struct frame_pool frame_pool;
+
 	void * token_recv_event_handle;
 	void * token_sent_event_handle;
 	char commit_token_storage[40000];
@@ -627,6 +669,7 @@ static int srp_addr_equal (const struct srp_addr *a, const struct srp_addr *b);
 static void memb_leave_message_send (struct totemsrp_instance *instance);
 
 static void token_callbacks_execute (struct totemsrp_instance *instance, enum totem_callback_token_type type);
+static void memb_rtr_range_list_trim (struct totemsrp_instance *instance);
 static void memb_state_gather_enter (struct totemsrp_instance *instance, enum gather_state_from gather_from);
 static void messages_deliver_to_app (struct totemsrp_instance *instance, int skip, unsigned int end_point);
 static int orf_token_mcast (struct totemsrp_instance *instance, struct orf_token *oken,
@@ -657,8 +700,11 @@ static void timer_function_heartbeat_timeout (void *data);
 static void timer_function_token_retransmit_timeout (void *data);
 static void timer_function_token_hold_retransmit_timeout (void *data);
 static void timer_function_merge_detect_timeout (void *data);
+static void queue_mem_update (struct totemsrp_instance *instance);
 static void *totemsrp_buffer_alloc (struct totemsrp_instance *instance);
 static void totemsrp_buffer_release (struct totemsrp_instance *instance, void *ptr);
+static void sort_queue_item_release (struct totemsrp_instance *instance,
+	struct sort_queue_item *sort_queue_item);
 static const char* gsfrom_to_msg(enum gather_state_from gsfrom);
 
 void main_deliver_fn (
@@ -799,6 +845,16 @@ static int token_event_stats_collector (enum totem_callback_token_type type, con
 	return 0;
 }
 
+static inline void token_hist_record (
+	struct totemsrp_instance *instance,
+	enum totem_hist_type type,
+	unsigned long long start,
+	unsigned long long end)
+{
+	totem_hist_record (&instance->stats.hist[type],
+		(end - start) / QB_TIME_NS_IN_USEC);
+}
+
 static void totempg_mtu_changed(void *context, int net_mtu)
 {
 	struct totemsrp_instance *instance = context;
@@ -835,6 +891,7 @@ int totemsrp_initialize (
 		int waiting_trans_ack))
 {
 	struct totemsrp_instance *instance;
+	size_t frame_size;
 	int res;
 
 	instance = malloc (sizeof (struct totemsrp_instance));
@@ -929,7 +986,8 @@ int totemsrp_initialize (
 		"max_network_delay (%d ms)", totem_config->max_network_delay);
 
 
-	cs_queue_init (&instance->retrans_message_queue, RETRANS_MESSAGE_QUEUE_SIZE_MAX,
+	cs_queue_init_growable (&instance->retrans_message_queue,
+		RETRANS_MESSAGE_QUEUE_SIZE_MIN, RETRANS_MESSAGE_QUEUE_SIZE_MAX,
 		sizeof (struct message_item), instance->threaded_mode_enabled);
 
 	sq_init (&instance->regular_sort_queue,
@@ -938,6 +996,8 @@ int totemsrp_initialize (
 	sq_init (&instance->recovery_sort_queue,
 		QUEUE_RTR_ITEMS_SIZE_MAX, sizeof (struct sort_queue_item), 0);
 
+	queue_mem_update (instance);
+
 	instance->totemsrp_poll_handle = poll_handle;
 
 	instance->totemsrp_deliver_fn = deliver_fn;
@@ -991,16 +1051,40 @@ int totemsrp_initialize (
 
 	instance->my_id.nodeid = instance->totem_config->interfaces[instance->lowest_active_if].boundto.nodeid;
 
+	/*
+	 * One frame size serves both transport buffers and zero-copy frames
+	 */
+	frame_size = sizeof (struct mcast) + TOTEMSRP_FRAME_HEADROOM_MAX + FRAME_SIZE_MAX;
+	if (frame_size < totemnet_buffer_size (instance->totemnet_context)) {
+		frame_size = totemnet_buffer_size (instance->totemnet_context);
+	}
+	if (frame_pool_init (&instance->frame_pool, frame_size,
+		totem_config->frame_pool_low_watermark,
+		totem_config->frame_pool_high_watermark,
+		totem_config->frame_pool_prefault,
+		&instance->stats) != 0) {
+
+		LOGSYS_PERROR (errno, instance->totemsrp_log_level_warning,
+			"Unable to preallocate %u frames for frame pool",
+			totem_config->frame_pool_low_watermark);
+	}
+
 	/*
 	 * Must have net_mtu adjusted by totemnet_initialize first
+	 *
+	 * In threaded mode totempg serializes all producers with
+	 * mcast_msg_mutex and only the token handler consumes, so the
+	 * lock-free single producer/single consumer ring is sufficient
 	 */
 	cs_queue_init (&instance->new_message_queue,
 		MESSAGE_QUEUE_MAX,
-		sizeof (struct message_item), instance->threaded_mode_enabled);
+		sizeof (struct message_item),
+		instance->threaded_mode_enabled ? CS_QUEUE_SPSC : CS_QUEUE_UNLOCKED);
 
 	cs_queue_init (&instance->new_message_queue_trans,
 		MESSAGE_QUEUE_MAX,
-		sizeof (struct message_item), instance->threaded_mode_enabled);
+		sizeof (struct message_item),
+		instance->threaded_mode_enabled ? CS_QUEUE_SPSC : CS_QUEUE_UNLOCKED);
 
 	totemsrp_callback_token_create (instance,
 		&instance->token_recv_event_handle,
@@ -1033,6 +1117,7 @@ void totemsrp_finalize (
 	cs_queue_free (&instance->retrans_message_queue);
 	sq_free (&instance->regular_sort_queue);
 	sq_free (&instance->recovery_sort_queue);
+	frame_pool_free (&instance->frame_pool);
 	free (instance);
 }
 
@@ -1476,13 +1561,23 @@ static void my_leave_memb_set(
 static void *totemsrp_buffer_alloc (struct totemsrp_instance *instance)
 {
 	assert (instance != NULL);
-	return totemnet_buffer_alloc (instance->totemnet_context);
+	return frame_pool_get (&instance->frame_pool);
 }
 
 static void totemsrp_buffer_release (struct totemsrp_instance *instance, void *ptr)
 {
 	assert (instance != NULL);
-	totemnet_buffer_release (instance->totemnet_context, ptr);
+	frame_pool_put (&instance->frame_pool, ptr);
+}
+
+static void sort_queue_item_release (struct totemsrp_instance *instance,
+	struct sort_queue_item *sort_queue_item)
+{
+	if (sort_queue_item->frame != NULL) {
+		totemsrp_mcast_frame_free (instance, sort_queue_item->frame);
+	} else {
+		totemsrp_buffer_release (instance, sort_queue_item->mcast);
+	}
 }
 
 static void reset_token_retransmit_timeout (struct totemsrp_instance *instance)
@@ -1859,6 +1954,7 @@ static void deliver_messages_from_recovery_to_regular (struct totemsrp_instance
 				(struct mcast *)(((char *)recovery_message_item->mcast) + sizeof (struct mcast));
 			regular_message_item.msg_len =
 			recovery_message_item->msg_len - sizeof (struct mcast);
+			regular_message_item.frame = NULL;
 			mcast = regular_message_item.mcast;
 		} else {
 			/*
@@ -1881,8 +1977,15 @@ static void deliver_messages_from_recovery_to_regular (struct totemsrp_instance
 
 			res = sq_item_inuse (&instance->regular_sort_queue, mcast->seq);
 			if (res == 0) {
-				sq_item_add (&instance->regular_sort_queue,
-					&regular_message_item, mcast->seq);
+				if (sq_item_add (&instance->regular_sort_queue,
+					&regular_message_item, mcast->seq) == NULL) {
+
+					log_printf (instance->totemsrp_log_level_error,
+						"Unable to allocate sort queue for recovered message seq %x",
+						mcast->seq);
+					instance->stats.rx_msg_dropped++;
+					continue;
+				}
 				if (sq_lt_compare (instance->old_ring_state_high_seq_received, mcast->seq)) {
 					instance->old_ring_state_high_seq_received = mcast->seq;
 				}
@@ -1947,6 +2050,7 @@ static void memb_state_operational_enter (struct totemsrp_instance *instance)
 	instance->my_memb_entries = instance->my_new_memb_entries;
 	memcpy (&instance->my_memb_list, instance->my_new_memb_list,
 		sizeof (struct srp_addr) * instance->my_memb_entries);
+	memb_rtr_range_list_trim (instance);
 	instance->last_released = 0;
 	instance->my_set_retrans_flg = 0;
 
@@ -2043,7 +2147,7 @@ static void memb_state_operational_enter (struct totemsrp_instance *instance)
 			struct sort_queue_item *regular_message;
 
 			regular_message = ptr;
-			free (regular_message->mcast);
+			sort_queue_item_release (instance, regular_message);
 		}
 	}
 	sq_items_release (&instance->regular_sort_queue, instance->my_high_delivered);
@@ -2131,6 +2235,11 @@ static void memb_state_gather_enter (
 
 	instance->originated_orf_token = 0;
 
+	/*
+	 * Don't account the membership change as token rotation
+	 */
+	instance->token_hist_last_rx = 0;
+
 	memb_set_merge (
 		&instance->my_id, 1,
 		instance->my_proc_list, &instance->my_proc_list_entries);
@@ -2415,7 +2524,13 @@ static void memb_state_recovery_enter (
 		memcpy (((char *)message_item.mcast) + sizeof (struct mcast),
 			sort_queue_item->mcast,
 			sort_queue_item->msg_len);
-		cs_queue_item_add (&instance->retrans_message_queue, &message_item);
+		if (cs_queue_item_add (&instance->retrans_message_queue, &message_item) != 0) {
+			log_printf (instance->totemsrp_log_level_error,
+				"Unable to allocate retransmit queue for old ring message %x",
+				low_ring_aru + i);
+			totemsrp_buffer_release (instance, message_item.mcast);
+			continue;
+		}
 	}
 	log_printf (instance->totemsrp_log_level_debug,
 		"Originated %d messages in RECOVERY.", messages_originated);
@@ -2510,9 +2625,13 @@ int totemsrp_mcast (
 
 	message_item.msg_len = addr_idx;
 
+	if (cs_queue_item_add (queue_use, &message_item) != 0) {
+		totemsrp_buffer_release (instance, message_item.mcast);
+		goto error_mcast;
+	}
 	log_printf (instance->totemsrp_log_level_trace, "mcasted message added to pending queue");
 	instance->stats.mcast_tx++;
-	cs_queue_item_add (queue_use, &message_item);
+	instance->stats.mcast_tx_frames_copied++;
 
 	return (0);
 
@@ -2520,6 +2639,98 @@ error_mcast:
 	return (-1);
 }
 
+/*
+ * Zero-copy frames
+ *
+ * The caller packs its payload into the frame starting at the returned data
+ * pointer and builds its own headers backwards into the headroom in front of
+ * it.  totemsrp_mcast_frame then writes struct mcast in front of that and
+ * queues the frame as is, so the payload reaches the transport without being
+ * copied again.
+ */
+void *totemsrp_mcast_frame_alloc (
+	void *srp_context,
+	unsigned int headroom,
+	void **data)
+{
+	struct totemsrp_instance *instance = (struct totemsrp_instance *)srp_context;
+	char *frame;
+
+	assert (headroom <= TOTEMSRP_FRAME_HEADROOM_MAX);
+
+	frame = totemsrp_buffer_alloc (instance);
+	if (frame == NULL) {
+		return (NULL);
+	}
+	*data = frame + sizeof (struct mcast) + headroom;
+
+	return (frame);
+}
+
+void totemsrp_mcast_frame_free (
+	void *srp_context,
+	void *frame)
+{
+	struct totemsrp_instance *instance = (struct totemsrp_instance *)srp_context;
+
+	totemsrp_buffer_release (instance, frame);
+}
+
+int totemsrp_mcast_frame (
+	void *srp_context,
+	void *frame,
+	const void *msg,
+	unsigned int msg_len,
+	int guarantee)
+{
+	struct totemsrp_instance *instance = (struct totemsrp_instance *)srp_context;
+	struct message_item message_item;
+	struct cs_queue *queue_use;
+
+	assert (((const char *)msg - (char *)frame) >= sizeof (struct mcast));
+
+	if (instance->waiting_trans_ack) {
+		queue_use = &instance->new_message_queue_trans;
+	} else {
+		queue_use = &instance->new_message_queue;
+	}
+
+	if (cs_queue_is_full (queue_use)) {
+		log_printf (instance->totemsrp_log_level_debug, "queue full");
+		return (-1);
+	}
+
+	memset (&message_item, 0, sizeof (struct message_item));
+	message_item.frame = frame;
+	message_item.mcast = (struct mcast *)((char *)msg - sizeof (struct mcast));
+
+	/*
+	 * Set mcast header
+	 */
+	memset(message_item.mcast, 0, sizeof (struct mcast));
+	message_item.mcast->header.magic = TOTEM_MH_MAGIC;
+	message_item.mcast->header.version = TOTEM_MH_VERSION;
+	message_item.mcast->header.type = MESSAGE_TYPE_MCAST;
+	message_item.mcast->header.encapsulated = MESSAGE_NOT_ENCAPSULATED;
+
+	message_item.mcast->header.nodeid = instance->my_id.nodeid;
+	assert (message_item.mcast->header.nodeid);
+
+	message_item.mcast->guarantee = guarantee;
+	message_item.mcast->system_from = instance->my_id;
+
+	message_item.msg_len = sizeof (struct mcast) + msg_len;
+
+	if (cs_queue_item_add (queue_use, &message_item) != 0) {
+		return (-1);
+	}
+	log_printf (instance->totemsrp_log_level_trace, "mcasted frame added to pending queue");
+	instance->stats.mcast_tx++;
+	instance->stats.mcast_tx_frames_zerocopy++;
+
+	return (0);
+}
+
 /*
  * Determine if there is room to queue a new message
  */
@@ -2628,7 +2839,7 @@ static void messages_free (
 			instance->last_released + i, &ptr);
 		if (res == 0) {
 			regular_message = ptr;
-			totemsrp_buffer_release (instance, regular_message->mcast);
+			sort_queue_item_release (instance, regular_message);
 		}
 		sq_items_release (&instance->regular_sort_queue,
 			instance->last_released + i);
@@ -2643,14 +2854,37 @@ static void messages_free (
 	}
 }
 
+static void queue_mem_update (struct totemsrp_instance *instance)
+{
+	uint64_t queue_mem;
+
+	queue_mem = sq_mem_get (&instance->regular_sort_queue) +
+		sq_mem_get (&instance->recovery_sort_queue) +
+		cs_queue_mem_get (&instance->retrans_message_queue);
+
+	instance->stats.queue_mem = queue_mem;
+	if (queue_mem > instance->stats.queue_mem_peak) {
+		instance->stats.queue_mem_peak = queue_mem;
+	}
+}
+
+/*
+ * Give memory of the sort and retransmit queues back once the ring is idle
+ */
+static void queues_shrink (struct totemsrp_instance *instance)
+{
+	sq_shrink (&instance->regular_sort_queue);
+	sq_shrink (&instance->recovery_sort_queue);
+	cs_queue_shrink (&instance->retrans_message_queue);
+
+	queue_mem_update (instance);
+}
+
 static void update_aru (
 	struct totemsrp_instance *instance)
 {
-	unsigned int i;
-	int res;
 	struct sq *sort_queue;
 	unsigned int range;
-	unsigned int my_aru_saved = 0;
 
 	if (instance->memb_state == MEMB_STATE_RECOVERY) {
 		sort_queue = &instance->recovery_sort_queue;
@@ -2660,20 +2894,10 @@ static void update_aru (
 
 	range = instance->my_high_seq_received - instance->my_aru;
 
-	my_aru_saved = instance->my_aru;
-	for (i = 1; i <= range; i++) {
-
-		void *ptr;
-
-		res = sq_item_get (sort_queue, my_aru_saved + i, &ptr);
-		/*
-		 * If hole, stop updating aru
-		 */
-		if (res != 0) {
-			break;
-		}
-	}
-	instance->my_aru += i - 1;
+	/*
+	 * Advance aru up to the first hole
+	 */
+	instance->my_aru += sq_next_hole (sort_queue, instance->my_aru + 1, range);
 }
 
 /*
@@ -2711,8 +2935,8 @@ static int orf_token_mcast (
 		}
 		message_item = (struct message_item *)cs_queue_item_get (mcast_queue);
 
-		message_item->mcast->seq = ++token->seq;
-		message_item->mcast->this_seqno = instance->global_seqno++;
+		message_item->mcast->seq = token->seq + 1;
+		message_item->mcast->this_seqno = instance->global_seqno;
 
 		/*
 		 * Build IO vector
@@ -2720,15 +2944,25 @@ static int orf_token_mcast (
 		memset (&sort_queue_item, 0, sizeof (struct sort_queue_item));
 		sort_queue_item.mcast = message_item->mcast;
 		sort_queue_item.msg_len = message_item->msg_len;
+		sort_queue_item.frame = message_item->frame;
 
 		mcast = sort_queue_item.mcast;
 
 		memcpy (&mcast->ring_id, &instance->my_ring_id, sizeof (struct memb_ring_id));
 
 		/*
-		 * Add message to retransmit queue
+		 * Add message to retransmit queue. If that fails the message
+		 * stays pending and gets a sequence number on a later token.
 		 */
-		sq_item_add (sort_queue, &sort_queue_item, message_item->mcast->seq);
+		if (sq_item_add (sort_queue, &sort_queue_item,
+			message_item->mcast->seq) == NULL) {
+
+			log_printf (instance->totemsrp_log_level_warning,
+				"Unable to allocate sort queue, postponing pending messages");
+			break;
+		}
+		token->seq += 1;
+		instance->global_seqno += 1;
 
 		totemnet_mcast_noflush_send (
 			instance->totemnet_context,
@@ -2754,6 +2988,312 @@ static int orf_token_mcast (
 	return (fcc_mcast_current);
 }
 
+static size_t rtr_item_size (char token_version)
+{
+	if (token_version == TOTEM_MH_VERSION_RTR_RANGE) {
+		return (sizeof (struct rtr_range_item));
+	}
+	return (sizeof (struct rtr_item));
+}
+
+typedef int (*rtr_missing_add_fn_t) (
+	struct orf_token *orf_token,
+	const struct memb_ring_id *ring_id,
+	unsigned int seq);
+
+/*
+ * Add seq to an orf_token carrying struct rtr_item entries
+ */
+static int rtr_item_missing_add (
+	struct orf_token *orf_token,
+	const struct memb_ring_id *ring_id,
+	unsigned int seq)
+{
+	struct rtr_item *rtr_list = &orf_token->rtr_list[0];
+	int i;
+
+	/*
+	 * Determine if missing message is already in retransmit list
+	 */
+	for (i = 0; i < orf_token->rtr_list_entries; i++) {
+		if (rtr_list[i].seq == seq) {
+			return (0);
+		}
+	}
+	if (orf_token->rtr_list_entries >= RETRANSMIT_ENTRIES_MAX) {
+		return (-1);
+	}
+
+	memcpy (&rtr_list[orf_token->rtr_list_entries].ring_id,
+		ring_id, sizeof (struct memb_ring_id));
+	rtr_list[orf_token->rtr_list_entries].seq = seq;
+	orf_token->rtr_list_entries++;
+
+	return (0);
+}
+
+static int rtr_range_contains (
+	const struct rtr_range_item *item,
+	unsigned int seq)
+{
+	unsigned int offset;
+
+	offset = seq - item->seq;
+	if (offset < item->count) {
+		return (1);
+	}
+	offset -= item->count;
+
+	return (offset < RTR_RANGE_BITMAP_BITS &&
+		(item->bitmap & (1ULL << offset)) != 0);
+}
+
+/*
+ * Append seq to a range encoded retransmit list, extending the last entry
+ * when seq falls into its bitmap. Returns -1 if a new entry is needed and
+ * the list is full.
+ */
+static int rtr_range_append (
+	struct orf_token *orf_token,
+	const struct memb_ring_id *ring_id,
+	unsigned int seq)
+{
+	struct rtr_range_item *rtr_list = (struct rtr_range_item *)&orf_token->rtr_list[0];
+	struct rtr_range_item *item;
+	unsigned int offset;
+
+	if (orf_token->rtr_list_entries > 0) {
+		item = &rtr_list[orf_token->rtr_list_entries - 1];
+		offset = seq - (item->seq + item->count);
+		if (offset < RTR_RANGE_BITMAP_BITS &&
+			memcmp (&item->ring_id, ring_id, sizeof (struct memb_ring_id)) == 0) {
+
+			item->bitmap |= 1ULL << offset;
+			/*
+			 * Keep runs in count, bit 0 of bitmap is always clear
+			 */
+			while (item->bitmap & 1) {
+				item->count += 1;
+				item->bitmap >>= 1;
+			}
+			return (0);
+		}
+	}
+	if (orf_token->rtr_list_entries >= RETRANSMIT_ENTRIES_MAX) {
+		return (-1);
+	}
+
+	item = &rtr_list[orf_token->rtr_list_entries];
+	memcpy (&item->ring_id, ring_id, sizeof (struct memb_ring_id));
+	item->seq = seq;
+	item->count = 1;
+	item->bitmap = 0;
+	orf_token->rtr_list_entries += 1;
+
+	return (0);
+}
+
+/*
+ * Add seq to an orf_token carrying struct rtr_range_item entries
+ */
+static int rtr_range_missing_add (
+	struct orf_token *orf_token,
+	const struct memb_ring_id *ring_id,
+	unsigned int seq)
+{
+	struct rtr_range_item *rtr_list = (struct rtr_range_item *)&orf_token->rtr_list[0];
+	int i;
+
+	for (i = 0; i < orf_token->rtr_list_entries; i++) {
+		if (memcmp (&rtr_list[i].ring_id, ring_id,
+			sizeof (struct memb_ring_id)) == 0 &&
+			rtr_range_contains (&rtr_list[i], seq)) {
+
+			return (0);
+		}
+	}
+
+	return (rtr_range_append (orf_token, ring_id, seq));
+}
+
+static void orf_token_rtr_log (
+	struct totemsrp_instance *instance,
+	const struct orf_token *orf_token)
+{
+	const struct rtr_range_item *rtr_range_list;
+	char retransmit_msg[2048];
+	char value[64];
+	int i;
+
+	if (orf_token->rtr_list_entries == 0) {
+		return;
+	}
+
+	log_printf (instance->totemsrp_log_level_debug,
+		"Retransmit List %d", orf_token->rtr_list_entries);
+
+	strcpy (retransmit_msg, "Retransmit List: ");
+	if (orf_token->header.version == TOTEM_MH_VERSION_RTR_RANGE) {
+		rtr_range_list = (const struct rtr_range_item *)&orf_token->rtr_list[0];
+		for (i = 0; i < orf_token->rtr_list_entries; i++) {
+			if (rtr_range_list[i].bitmap) {
+				snprintf (value, sizeof (value), "%x-%x+%" PRIx64 " ",
+					rtr_range_list[i].seq,
+					rtr_range_list[i].seq + rtr_range_list[i].count - 1,
+					(uint64_t)rtr_range_list[i].bitmap);
+			} else {
+				snprintf (value, sizeof (value), "%x-%x ",
+					rtr_range_list[i].seq,
+					rtr_range_list[i].seq + rtr_range_list[i].count - 1);
+			}
+			strcat (retransmit_msg, value);
+		}
+	} else {
+		for (i = 0; i < orf_token->rtr_list_entries; i++) {
+			sprintf (value, "%x ", orf_token->rtr_list[i].seq);
+			strcat (retransmit_msg, value);
+		}
+	}
+	log_printf (instance->totemsrp_log_level_notice,
+		"%s", retransmit_msg);
+}
+
+/*
+ * Remulticast messages requested by a range encoded retransmit list. The
+ * list is rebuilt with the requests this processor could not serve.
+ * Requests which no longer fit are dropped, the processor missing them
+ * adds them again on the next rotation.
+ */
+static void orf_token_rtr_range_remcast (
+	struct totemsrp_instance *instance,
+	struct orf_token *orf_token,
+	unsigned int fcc_allowed)
+{
+	struct rtr_range_item requests[RETRANSMIT_ENTRIES_MAX];
+	struct rtr_range_item *rtr_list;
+	unsigned int offset;
+	unsigned int seq;
+	int request_entries;
+	int i;
+
+	rtr_list = (struct rtr_range_item *)&orf_token->rtr_list[0];
+	request_entries = orf_token->rtr_list_entries;
+	memcpy (requests, rtr_list, request_entries * sizeof (struct rtr_range_item));
+	orf_token->rtr_list_entries = 0;
+
+	for (i = 0; i < request_entries; i++) {
+		/*
+		 * If this retransmit request isn't from this configuration,
+		 * pass it on unchanged
+		 */
+		if (memcmp (&requests[i].ring_id, &instance->my_ring_id,
+			sizeof (struct memb_ring_id)) != 0) {
+
+			if (orf_token->rtr_list_entries < RETRANSMIT_ENTRIES_MAX) {
+				memcpy (&rtr_list[orf_token->rtr_list_entries],
+					&requests[i], sizeof (struct rtr_range_item));
+				orf_token->rtr_list_entries++;
+			}
+			continue;
+		}
+
+		for (offset = 0;
+			offset < requests[i].count + RTR_RANGE_BITMAP_BITS; offset++) {
+
+			if (offset >= requests[i].count &&
+				(requests[i].bitmap & (1ULL << (offset - requests[i].count))) == 0) {
+				continue;
+			}
+			seq = requests[i].seq + offset;
+
+			if (instance->fcc_remcast_current < fcc_allowed &&
+				orf_token_remcast (instance, seq) == 0) {
+
+				instance->stats.mcast_retx++;
+				instance->fcc_remcast_current++;
+				continue;
+			}
+			rtr_range_append (orf_token, &requests[i].ring_id, seq);
+		}
+	}
+}
+
+/*
+ * Add messages missing from this processor to orf_token's retransmit list.
+ * Gaps come from the sort queue hole index, so the cost depends on the
+ * number of missing messages rather than on the aru..seq window.
+ */
+static void orf_token_rtr_missing (
+	struct totemsrp_instance *instance,
+	struct sq *sort_queue,
+	struct orf_token *orf_token,
+	rtr_missing_add_fn_t missing_add_fn)
+{
+	const struct sq_hole *holes;
+	unsigned int hole_entries;
+	unsigned int range;
+	unsigned int seq;
+	unsigned int count;
+	unsigned int i, j;
+	unsigned int res;
+
+	range = orf_token->seq - instance->my_aru;
+	assert (range < QUEUE_RTR_ITEMS_SIZE_MAX);
+
+	hole_entries = sq_holes_get (sort_queue, &holes);
+
+	for (i = 0; i <= hole_entries; i++) {
+		if (i < hole_entries) {
+			seq = holes[i].seqid;
+			count = holes[i].count;
+		} else {
+			/*
+			 * Messages above the highest one received
+			 */
+			seq = sq_tail_get (sort_queue);
+			if (sq_lt_compare (orf_token->seq, seq)) {
+				break;
+			}
+			count = orf_token->seq - seq + 1;
+		}
+
+		for (j = 0; j < count; j++, seq++) {
+			if (sq_lte_compare (seq, instance->my_aru)) {
+				continue;
+			}
+			if (sq_lt_compare (orf_token->seq, seq)) {
+				return;
+			}
+
+			/*
+			 * Ensure message is within the sort queue range
+			 */
+			res = sq_in_range (sort_queue, seq);
+			if (res == 0) {
+				return;
+			}
+
+			/*
+			 * Determine how many times we have missed receiving
+			 * this sequence number.  sq_item_miss_count increments
+			 * a counter for the sequence number.  The miss count
+			 * will be returned and compared.  This allows time for
+			 * delayed multicast messages to be received before
+			 * declaring the message is missing and requesting a
+			 * retransmit.
+			 */
+			res = sq_item_miss_count (sort_queue, seq);
+			if (res < instance->totem_config->miss_count_const) {
+				continue;
+			}
+
+			if (missing_add_fn (orf_token, &instance->my_ring_id, seq) == -1) {
+				return;
+			}
+		}
+	}
+}
+
 /*
  * Remulticasts messages in orf_token's retransmit list (requires orf_token)
  * Modify's orf_token's rtr to include retransmits required by this process
@@ -2764,13 +3304,9 @@ static int orf_token_rtr (
 	unsigned int *fcc_allowed)
 {
 	unsigned int res;
-	unsigned int i, j;
-	unsigned int found;
+	int i;
 	struct sq *sort_queue;
 	struct rtr_item *rtr_list;
-	unsigned int range = 0;
-	char retransmit_msg[1024];
-	char value[64];
 
 	if (instance->memb_state == MEMB_STATE_RECOVERY) {
 		sort_queue = &instance->recovery_sort_queue;
@@ -2778,25 +3314,26 @@ static int orf_token_rtr (
 		sort_queue = &instance->regular_sort_queue;
 	}
 
-	rtr_list = &orf_token->rtr_list[0];
+	orf_token_rtr_log (instance, orf_token);
 
-	strcpy (retransmit_msg, "Retransmit List: ");
-	if (orf_token->rtr_list_entries) {
-		log_printf (instance->totemsrp_log_level_debug,
-			"Retransmit List %d", orf_token->rtr_list_entries);
-		for (i = 0; i < orf_token->rtr_list_entries; i++) {
-			sprintf (value, "%x ", rtr_list[i].seq);
-			strcat (retransmit_msg, value);
-		}
-		strcat (retransmit_msg, "");
-		log_printf (instance->totemsrp_log_level_notice,
-			"%s", retransmit_msg);
+	instance->fcc_remcast_current = 0;
+
+	if (orf_token->header.version == TOTEM_MH_VERSION_RTR_RANGE) {
+		orf_token_rtr_range_remcast (instance, orf_token, *fcc_allowed);
+		*fcc_allowed = *fcc_allowed - instance->fcc_remcast_current;
+
+		orf_token_rtr_missing (instance, sort_queue, orf_token,
+			rtr_range_missing_add);
+
+		return (instance->fcc_remcast_current);
 	}
 
+	rtr_list = &orf_token->rtr_list[0];
+
 	/*
 	 * Retransmit messages on orf_token's RTR list from RTR queue
 	 */
-	for (instance->fcc_remcast_current = 0, i = 0;
+	for (i = 0;
 		instance->fcc_remcast_current < *fcc_allowed && i < orf_token->rtr_list_entries;) {
 
 		/*
@@ -2832,60 +3369,11 @@ static int orf_token_rtr (
 	 * Add messages to retransmit to RTR list
 	 * but only retry if there is room in the retransmit list
 	 */
-
-	range = orf_token->seq - instance->my_aru;
-	assert (range < QUEUE_RTR_ITEMS_SIZE_MAX);
-
-	for (i = 1; (orf_token->rtr_list_entries < RETRANSMIT_ENTRIES_MAX) &&
-		(i <= range); i++) {
-
-		/*
-		 * Ensure message is within the sort queue range
-		 */
-		res = sq_in_range (sort_queue, instance->my_aru + i);
-		if (res == 0) {
-			break;
-		}
-
-		/*
-		 * Find if a message is missing from this processor
-		 */
-		res = sq_item_inuse (sort_queue, instance->my_aru + i);
-		if (res == 0) {
-			/*
-			 * Determine how many times we have missed receiving
-			 * this sequence number.  sq_item_miss_count increments
-			 * a counter for the sequence number.  The miss count
-			 * will be returned and compared.  This allows time for
-			 * delayed multicast messages to be received before
-			 * declaring the message is missing and requesting a
-			 * retransmit.
-			 */
-			res = sq_item_miss_count (sort_queue, instance->my_aru + i);
-			if (res < instance->totem_config->miss_count_const) {
-				continue;
-			}
-
-			/*
-			 * Determine if missing message is already in retransmit list
-			 */
-			found = 0;
-			for (j = 0; j < orf_token->rtr_list_entries; j++) {
-				if (instance->my_aru + i == rtr_list[j].seq) {
-					found = 1;
-				}
-			}
-			if (found == 0) {
-				/*
-				 * Missing message not found in current retransmit list so add it
-				 */
-				memcpy (&rtr_list[orf_token->rtr_list_entries].ring_id,
-					&instance->my_ring_id, sizeof (struct memb_ring_id));
-				rtr_list[orf_token->rtr_list_entries].seq = instance->my_aru + i;
-				orf_token->rtr_list_entries++;
-			}
-		}
+	if (orf_token->rtr_list_entries < RETRANSMIT_ENTRIES_MAX) {
+		orf_token_rtr_missing (instance, sort_queue, orf_token,
+			rtr_item_missing_add);
 	}
+
 	return (instance->fcc_remcast_current);
 }
 
@@ -2964,7 +3452,7 @@ static int token_send (
 	unsigned int orf_token_size;
 
 	orf_token_size = sizeof (struct orf_token) +
-		(orf_token->rtr_list_entries * sizeof (struct rtr_item));
+		(orf_token->rtr_list_entries * rtr_item_size (orf_token->header.version));
 
 	orf_token->header.nodeid = instance->my_id.nodeid;
 	memcpy (instance->orf_token_retransmit, orf_token, orf_token_size);
@@ -3021,6 +3509,20 @@ static int orf_token_send_initial (struct totemsrp_instance *instance)
 
 	orf_token.header.magic = TOTEM_MH_MAGIC;
 	orf_token.header.version = TOTEM_MH_VERSION;
+	/*
+	 * Use range encoded retransmit lists if every member of the new ring
+	 * understands them
+	 */
+	if (memb_set_subset (instance->my_new_memb_list,
+		instance->my_new_memb_entries,
+		instance->my_rtr_range_list,
+		instance->my_rtr_range_list_entries)) {
+
+		orf_token.header.version = TOTEM_MH_VERSION_RTR_RANGE;
+	}
+	log_printf (instance->totemsrp_log_level_debug,
+		"Retransmit requests are %s encoded",
+		orf_token.header.version == TOTEM_MH_VERSION_RTR_RANGE ? "range" : "sequence");
 	orf_token.header.type = MESSAGE_TYPE_ORF_TOKEN;
 	orf_token.header.encapsulated = 0;
 	orf_token.header.nodeid = instance->my_id.nodeid;
@@ -3285,6 +3787,7 @@ static void memb_join_message_send (struct totemsrp_instance *instance)
 	struct memb_join *memb_join = (struct memb_join *)memb_join_data;
 	char *addr;
 	unsigned int addr_idx;
+	unsigned int token_version;
 	size_t msg_len;
 
 	memb_join->header.magic = TOTEM_MH_MAGIC;
@@ -3295,7 +3798,8 @@ static void memb_join_message_send (struct totemsrp_instance *instance)
 	assert (memb_join->header.nodeid);
 
 	msg_len = sizeof(struct memb_join) +
-	    ((instance->my_proc_list_entries + instance->my_failed_list_entries) * sizeof(struct srp_addr));
+	    ((instance->my_proc_list_entries + instance->my_failed_list_entries) * sizeof(struct srp_addr)) +
+	    sizeof (unsigned int);
 
 	if (msg_len > sizeof(memb_join_data)) {
 		log_printf (instance->totemsrp_log_level_error,
@@ -3330,6 +3834,13 @@ static void memb_join_message_send (struct totemsrp_instance *instance)
 		instance->my_failed_list_entries *
 		sizeof (struct srp_addr);
 
+	/*
+	 * Older versions ignore data past the failed list
+	 */
+	token_version = TOTEM_MH_VERSION_RTR_RANGE;
+	memcpy (&addr[addr_idx], &token_version, sizeof (unsigned int));
+	addr_idx += sizeof (unsigned int);
+
 	if (instance->totem_config->send_join_timeout) {
 		usleep (random() % (instance->totem_config->send_join_timeout * 1000));
 	}
@@ -3640,7 +4151,10 @@ static int check_orf_token_sanity(
 {
 	int rtr_entries;
 	const struct orf_token *token = (const struct orf_token *)msg;
+	const struct rtr_range_item *rtr_range_list;
+	unsigned int count;
 	size_t required_len;
+	int i;
 
 	if (msg_len < sizeof(struct orf_token)) {
 		log_printf (instance->totemsrp_log_level_security,
@@ -3655,7 +4169,15 @@ static int check_orf_token_sanity(
 		rtr_entries = token->rtr_list_entries;
 	}
 
-	required_len = sizeof(struct orf_token) + rtr_entries * sizeof(struct rtr_item);
+	if (rtr_entries < 0 || rtr_entries > RETRANSMIT_ENTRIES_MAX) {
+		log_printf (instance->totemsrp_log_level_security,
+		    "Received orf_token message has invalid retransmit list...  ignoring.");
+
+		return (-1);
+	}
+
+	required_len = sizeof(struct orf_token) +
+	    rtr_entries * rtr_item_size (token->header.version);
 	if (msg_len < required_len) {
 		log_printf (instance->totemsrp_log_level_security,
 		    "Received orf_token message is too short...  ignoring.");
@@ -3663,6 +4185,26 @@ static int check_orf_token_sanity(
 		return (-1);
 	}
 
+	/*
+	 * A range can't cover more messages than the sender is able to
+	 * have outstanding, larger counts would only make orf_token_rtr spin
+	 */
+	if (token->header.version == TOTEM_MH_VERSION_RTR_RANGE) {
+		rtr_range_list = (const struct rtr_range_item *)&token->rtr_list[0];
+		for (i = 0; i < rtr_entries; i++) {
+			count = rtr_range_list[i].count;
+			if (endian_conversion_needed) {
+				count = swab32 (count);
+			}
+			if (count > QUEUE_RTR_ITEMS_SIZE_MAX) {
+				log_printf (instance->totemsrp_log_level_security,
+				    "Received orf_token message has invalid retransmit range...  ignoring.");
+
+				return (-1);
+			}
+		}
+	}
+
 	return (0);
 }
 
@@ -3810,6 +4352,9 @@ static int message_handler_orf_token (
 	unsigned int mcasted_retransmit;
 	unsigned int mcasted_regular;
 	unsigned int last_aru;
+	unsigned long long token_rx;
+	unsigned long long phase_start;
+	unsigned long long phase_end;
 
 #ifdef GIVEINFO
 	unsigned long long tv_current;
@@ -3847,9 +4392,9 @@ static int message_handler_orf_token (
 	 * to flush incoming messages from the kernel queue
 	 */
 	token = (struct orf_token *)token_storage;
-	memcpy (token, msg, sizeof (struct orf_token));
-	memcpy (&token->rtr_list[0], (char *)msg + sizeof (struct orf_token),
-		sizeof (struct rtr_item) * RETRANSMIT_ENTRIES_MAX);
+	memcpy (token, msg, sizeof (struct orf_token) +
+		((const struct orf_token *)msg)->rtr_list_entries *
+		rtr_item_size (((const struct orf_token *)msg)->header.version));
 
 
 	/*
@@ -3875,6 +4420,11 @@ static int message_handler_orf_token (
 	totemnet_recv_flush (instance->totemnet_context);
 	instance->flushing = 0;
 
+	queue_mem_update (instance);
+	if (instance->my_seq_unchanged == instance->totem_config->seqno_unchanged_const) {
+		queues_shrink (instance);
+	}
+
 	/*
 	 * Determine if we should hold (in reality drop) the token
 	 */
@@ -3945,8 +4495,22 @@ static int message_handler_orf_token (
 		last_aru = instance->my_last_aru;
 		instance->my_last_aru = token->aru;
 
+		/*
+		 * Rotation is only measured between tokens this processor
+		 * forwarded, a held token would account the idle time
+		 */
+		token_rx = qb_util_nano_current_get ();
+		if (instance->token_hist_last_rx != 0) {
+			token_hist_record (instance, TOTEM_HIST_TOKEN_ROTATION,
+				instance->token_hist_last_rx, token_rx);
+		}
+		instance->token_hist_last_rx = 0;
+
 		transmits_allowed = fcc_calculate (instance, token);
 		mcasted_retransmit = orf_token_rtr (instance, token, &transmits_allowed);
+		phase_end = qb_util_nano_current_get ();
+		token_hist_record (instance, TOTEM_HIST_ORF_TOKEN_RTR,
+			token_rx, phase_end);
 
 		if (instance->my_token_held == 1 &&
 			(token->rtr_list_entries > 0 || mcasted_retransmit > 0)) {
@@ -3955,7 +4519,10 @@ static int message_handler_orf_token (
 		}
 
 		fcc_rtr_limit (instance, token, &transmits_allowed);
+		phase_start = qb_util_nano_current_get ();
 		mcasted_regular = orf_token_mcast (instance, token, transmits_allowed);
+		token_hist_record (instance, TOTEM_HIST_ORF_TOKEN_MCAST,
+			phase_start, qb_util_nano_current_get ());
 /*
 if (mcasted_regular) {
 printf ("mcasted regular %d\n", mcasted_regular);
@@ -4064,7 +4631,16 @@ printf ("token seq %d\n", token->seq);
 			}
 
 			totemnet_send_flush (instance->totemnet_context);
+			phase_start = qb_util_nano_current_get ();
 			token_send (instance, token, forward_token);
+			phase_end = qb_util_nano_current_get ();
+			if (forward_token) {
+				token_hist_record (instance, TOTEM_HIST_TOKEN_SEND,
+					phase_start, phase_end);
+				token_hist_record (instance, TOTEM_HIST_TOKEN_HOLD,
+					token_rx, phase_end);
+				instance->token_hist_last_rx = token_rx;
+			}
 
 #ifdef GIVEINFO
 			tv_current = qb_util_nano_current_get ();
@@ -4075,8 +4651,11 @@ printf ("token seq %d\n", token->seq);
 				((float)tv_diff) / 1000000.0);
 #endif
 			if (instance->memb_state == MEMB_STATE_OPERATIONAL) {
+				phase_start = qb_util_nano_current_get ();
 				messages_deliver_to_app (instance, 0,
 					instance->my_high_seq_received);
+				token_hist_record (instance, TOTEM_HIST_DELIVER_TO_APP,
+					phase_start, qb_util_nano_current_get ());
 			}
 
 			/*
@@ -4132,6 +4711,14 @@ static void messages_deliver_to_app (
 	assert (range < QUEUE_RTR_ITEMS_SIZE_MAX);
 	my_high_delivered_stored = instance->my_high_delivered;
 
+	/*
+	 * Without skipping, delivery stops at the first hole
+	 */
+	if (skip == 0) {
+		range = sq_next_hole (&instance->regular_sort_queue,
+			my_high_delivered_stored + 1, range);
+	}
+
 	/*
 	 * Deliver messages in order from rtr queue to pending delivery queue
 	 */
@@ -4160,8 +4747,13 @@ static void messages_deliver_to_app (
 		instance->my_high_delivered = my_high_delivered_stored + i;
 
 		if (res != 0) {
+			/*
+			 * Skip the rest of the hole
+			 */
+			i += sq_next_present (&instance->regular_sort_queue,
+				my_high_delivered_stored + i + 1, range - i);
+			instance->my_high_delivered = my_high_delivered_stored + i;
 			continue;
-
 		}
 
 		sort_queue_item_p = ptr;
@@ -4316,13 +4908,21 @@ static int message_handler_mcast (
 		}
 		memcpy (sort_queue_item.mcast, msg, msg_len);
 		sort_queue_item.msg_len = msg_len;
+		sort_queue_item.frame = NULL;
+
+		/*
+		 * Dropped message is requested again by the retransmit list
+		 */
+		if (sq_item_add (sort_queue, &sort_queue_item, mcast_header.seq) == NULL) {
+			totemsrp_buffer_release (instance, sort_queue_item.mcast);
+			instance->stats.rx_msg_dropped++;
+			return (-1);
+		}
 
 		if (sq_lt_compare (instance->my_high_seq_received,
 			mcast_header.seq)) {
 			instance->my_high_seq_received = mcast_header.seq;
 		}
-
-		sq_item_add (sort_queue, &sort_queue_item, mcast_header.seq);
 	}
 
 	update_aru (instance);
@@ -4626,10 +5226,12 @@ static void memb_commit_token_endian_convert (const struct memb_commit_token *in
 
 static void orf_token_endian_convert (const struct orf_token *in, struct orf_token *out)
 {
+	const struct rtr_range_item *in_range_list;
+	struct rtr_range_item *out_range_list;
 	int i;
 
 	out->header.magic = TOTEM_MH_MAGIC;
-	out->header.version = TOTEM_MH_VERSION;
+	out->header.version = in->header.version;
 	out->header.type = in->header.type;
 	out->header.nodeid = swab32 (in->header.nodeid);
 	out->seq = swab32 (in->seq);
@@ -4642,6 +5244,18 @@ static void orf_token_endian_convert (const struct orf_token *in, struct orf_tok
 	out->backlog = swab32 (in->backlog);
 	out->retrans_flg = swab32 (in->retrans_flg);
 	out->rtr_list_entries = swab32 (in->rtr_list_entries);
+	if (in->header.version == TOTEM_MH_VERSION_RTR_RANGE) {
+		in_range_list = (const struct rtr_range_item *)&in->rtr_list[0];
+		out_range_list = (struct rtr_range_item *)&out->rtr_list[0];
+		for (i = 0; i < out->rtr_list_entries; i++) {
+			out_range_list[i].ring_id.rep = swab32(in_range_list[i].ring_id.rep);
+			out_range_list[i].ring_id.seq = swab64 (in_range_list[i].ring_id.seq);
+			out_range_list[i].seq = swab32 (in_range_list[i].seq);
+			out_range_list[i].count = swab32 (in_range_list[i].count);
+			out_range_list[i].bitmap = swab64 (in_range_list[i].bitmap);
+		}
+		return;
+	}
 	for (i = 0; i < out->rtr_list_entries; i++) {
 		out->rtr_list[i].ring_id.rep = swab32(in->rtr_list[i].ring_id.rep);
 		out->rtr_list[i].ring_id.seq = swab64 (in->rtr_list[i].ring_id.seq);
@@ -4711,6 +5325,101 @@ static int ignore_join_under_operational (
 	return (0);
 }
 
+/*
+ * Returns the highest orf_token version announced in a join message,
+ * TOTEM_MH_VERSION if the sender doesn't append one
+ */
+static unsigned int memb_join_token_version (
+	const void *msg,
+	size_t msg_len,
+	int endian_conversion_needed)
+{
+	const struct memb_join *memb_join = msg;
+	unsigned int proc_list_entries;
+	unsigned int failed_list_entries;
+	unsigned int token_version;
+	size_t offset;
+
+	proc_list_entries = memb_join->proc_list_entries;
+	failed_list_entries = memb_join->failed_list_entries;
+	if (endian_conversion_needed) {
+		proc_list_entries = swab32 (proc_list_entries);
+		failed_list_entries = swab32 (failed_list_entries);
+	}
+
+	offset = sizeof (struct memb_join) +
+		((proc_list_entries + failed_list_entries) * sizeof (struct srp_addr));
+	if (msg_len < offset + sizeof (unsigned int)) {
+		return (TOTEM_MH_VERSION);
+	}
+
+	memcpy (&token_version, (const char *)msg + offset, sizeof (unsigned int));
+	if (endian_conversion_needed) {
+		token_version = swab32 (token_version);
+	}
+
+	return (token_version);
+}
+
+/*
+ * Forget processors which are neither in the current membership nor in
+ * the processor list being gathered
+ */
+static void memb_rtr_range_list_trim (struct totemsrp_instance *instance)
+{
+	int i;
+
+	for (i = 0; i < instance->my_rtr_range_list_entries; ) {
+		if (memb_set_subset (&instance->my_rtr_range_list[i], 1,
+			instance->my_memb_list, instance->my_memb_entries) ||
+			memb_set_subset (&instance->my_rtr_range_list[i], 1,
+			instance->my_proc_list, instance->my_proc_list_entries)) {
+
+			i++;
+			continue;
+		}
+		instance->my_rtr_range_list_entries -= 1;
+		instance->my_rtr_range_list[i] =
+			instance->my_rtr_range_list[instance->my_rtr_range_list_entries];
+	}
+}
+
+static void memb_join_token_version_update (
+	struct totemsrp_instance *instance,
+	const struct srp_addr *system_from,
+	unsigned int token_version)
+{
+	int i;
+
+	if (token_version >= TOTEM_MH_VERSION_RTR_RANGE) {
+		if (memb_set_subset (system_from, 1,
+			instance->my_rtr_range_list, instance->my_rtr_range_list_entries)) {
+			return;
+		}
+		if (instance->my_rtr_range_list_entries >= PROCESSOR_COUNT_MAX) {
+			memb_rtr_range_list_trim (instance);
+		}
+		/*
+		 * A processor missing from the list only makes the next ring
+		 * fall back to sequence encoded retransmit requests
+		 */
+		if (instance->my_rtr_range_list_entries < PROCESSOR_COUNT_MAX) {
+			memb_set_merge (system_from, 1,
+				instance->my_rtr_range_list, &instance->my_rtr_range_list_entries);
+		}
+		return;
+	}
+
+	for (i = 0; i < instance->my_rtr_range_list_entries; i++) {
+		if (instance->my_rtr_range_list[i].nodeid == system_from->nodeid) {
+			instance->my_rtr_range_list_entries -= 1;
+			instance->my_rtr_range_list[i] =
+				instance->my_rtr_range_list[instance->my_rtr_range_list_entries];
+			break;
+		}
+	}
+}
+
 static int message_handler_memb_join (
 	struct totemsrp_instance *instance,
 	const void *msg,
@@ -4747,6 +5456,10 @@ static int message_handler_memb_join (
 	if (instance->token_ring_id_seq < memb_join->ring_seq) {
 		instance->token_ring_id_seq = memb_join->ring_seq;
 	}
+
+	memb_join_token_version_update (instance, &aligned_system_from,
+		memb_join_token_version (msg, msg_len, endian_conversion_needed));
+
 	switch (instance->memb_state) {
 		case MEMB_STATE_OPERATIONAL:
 			if (!ignore_join_under_operational (instance, memb_join)) {
@@ -4971,7 +5684,9 @@ static int check_message_header_validity(
 		return (-1);
 	}
 
-	if (message_header->version != TOTEM_MH_VERSION) {
+	if (message_header->version != TOTEM_MH_VERSION &&
+	    (message_header->version != TOTEM_MH_VERSION_RTR_RANGE ||
+	     message_header->type != MESSAGE_TYPE_ORF_TOKEN)) {
 		log_printf(instance->totemsrp_log_level_security,
 		    "Message received from %s has unsupported version %u... Ignoring",
 		    totemip_sa_print((struct sockaddr *)system_from),
@@ -80,6 +80,35 @@ int totemsrp_mcast (
 	unsigned int iov_len,
 	int priority);
 
+/**
+ * Largest headroom a zero-copy frame can reserve
+ */
+#define TOTEMSRP_FRAME_HEADROOM_MAX	4096
+
+/**
+ * Allocate a zero-copy frame with headroom bytes reserved in front of data
+ */
+void *totemsrp_mcast_frame_alloc (
+	void *srp_context,
+	unsigned int headroom,
+	void **data);
+
+void totemsrp_mcast_frame_free (
+	void *srp_context,
+	void *frame);
+
+/**
+ * Multicast msg, which must lie inside frame past its headroom.  On success
+ * the frame is owned by totemsrp and released once the message is freed
+ * from the ring.
+ */
+int totemsrp_mcast_frame (
+	void *srp_context,
+	void *frame,
+	const void *msg,
+	unsigned int msg_len,
+	int guarantee);
+
 /**
  * Return number of available messages that can be queued
  */
@@ -68,12 +68,23 @@
 #include "totemudp.h"
 
 #include "util.h"
+#include "recvbatch.h"
 
 #ifndef MSG_NOSIGNAL
 #define MSG_NOSIGNAL 0
 #endif
 
 #define MCAST_SOCKET_BUFFER_SIZE (TRANSMITS_ALLOWED * FRAME_SIZE_MAX)
+/*
+ * Maximum number of frames gathered by totemudp_mcast_noflush_send before
+ * they are transmitted by a single sendmmsg call
+ */
+#define SEND_BATCH_MAX 64
+
+/*
+ * Bytes of frames the batch can hold, flushed earlier when full
+ */
+#define SEND_BATCH_BUFFER_SIZE (4 * FRAME_SIZE_MAX)
 #define NETIF_STATE_REPORT_UP		1
 #define NETIF_STATE_REPORT_DOWN		2
 
@@ -151,14 +162,18 @@ struct totemudp_instance {
 
 	struct qb_list_head member_list;
 
-	char iov_buffer[UDP_RECEIVE_FRAME_SIZE_MAX];
-
 	char iov_buffer_flush[UDP_RECEIVE_FRAME_SIZE_MAX];
 
-	struct iovec totemudp_iov_recv;
-
 	struct iovec totemudp_iov_recv_flush;
 
+	/*
+	 * Frames received by net_deliver_fn. Separate batch is used while
+	 * flushing so frames of the batch being delivered stay intact.
+	 */
+	struct recv_batch recv_batch;
+
+	struct recv_batch recv_batch_flush;
+
 	struct totemudp_socket totemudp_sockets;
 
 	struct totem_ip_address mcast_address;
@@ -190,6 +205,21 @@ struct totemudp_instance {
 	totemsrp_stats_t *stats;
 
 	struct totem_ip_address token_target;
+
+	/*
+	 * Frames queued by noflush send, transmitted by totemudp_send_flush.
+	 * Frames are copied into send_batch_buffer, totemsrp may release its
+	 * copy (e.g. on membership change) before the batch is flushed.
+	 */
+	struct mmsghdr send_batch_msgs[SEND_BATCH_MAX];
+
+	struct iovec send_batch_iovec[SEND_BATCH_MAX];
+
+	unsigned int send_batch_entries;
+
+	char send_batch_buffer[SEND_BATCH_BUFFER_SIZE];
+
+	size_t send_batch_bytes;
 };
 
 struct work_item {
@@ -213,9 +243,6 @@ static void totemudp_instance_initialize (struct totemudp_instance *instance)
 
 	instance->netif_state_report = NETIF_STATE_REPORT_UP | NETIF_STATE_REPORT_DOWN;
 
-	instance->totemudp_iov_recv.iov_base = instance->iov_buffer;
-
-	instance->totemudp_iov_recv.iov_len = UDP_RECEIVE_FRAME_SIZE_MAX; //sizeof (instance->iov_buffer);
 	instance->totemudp_iov_recv_flush.iov_base = instance->iov_buffer_flush;
 
 	instance->totemudp_iov_recv_flush.iov_len = UDP_RECEIVE_FRAME_SIZE_MAX; //sizeof (instance->iov_buffer);
@@ -379,6 +406,120 @@ static inline void mcast_sendmsg (
 	}
 }
 
+/*
+ * Transmit all messages in msgs, retrying after partial sends.
+ * Message which failed to send is skipped the same way as a failed
+ * sendmsg would. Returns number of failed messages, errno of last
+ * failure is stored in err.
+ */
+static unsigned int send_batch_sendmmsg (
+	int fd,
+	struct mmsghdr *msgs,
+	unsigned int entries,
+	int *err)
+{
+	unsigned int sent = 0;
+	unsigned int failed = 0;
+	int res;
+
+	while (sent < entries) {
+		res = sendmmsg (fd, &msgs[sent], entries - sent, MSG_NOSIGNAL);
+		if (res < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			*err = errno;
+			failed += 1;
+			sent += 1;
+		} else {
+			sent += res;
+		}
+	}
+
+	return (failed);
+}
+
+static void mcast_send_batch_flush (
+	struct totemudp_instance *instance)
+{
+	struct sockaddr_storage sockaddr;
+	int addrlen;
+	unsigned int i;
+	unsigned int failed;
+	int err = 0;
+
+	if (instance->send_batch_entries == 0) {
+		return;
+	}
+
+	totemip_totemip_to_sockaddr_convert(&instance->mcast_address,
+		instance->totem_interface->ip_port, &sockaddr, &addrlen);
+	for (i = 0; i < instance->send_batch_entries; i++) {
+		instance->send_batch_msgs[i].msg_hdr.msg_name = &sockaddr;
+		instance->send_batch_msgs[i].msg_hdr.msg_namelen = addrlen;
+	}
+
+	/*
+	 * Transmit multicast messages
+	 * An error here is recovered by totemsrp
+	 */
+	failed = send_batch_sendmmsg (instance->totemudp_sockets.mcast_send,
+		instance->send_batch_msgs, instance->send_batch_entries, &err);
+	if (failed) {
+		LOGSYS_PERROR (err, instance->totemudp_log_level_debug,
+			"sendmmsg(mcast) failed (non-critical)");
+		instance->stats->continuous_sendmsg_failures += failed;
+	} else {
+		instance->stats->continuous_sendmsg_failures = 0;
+	}
+
+	/*
+	 * Transmit multicast messages to local unix mcast loop
+	 * An error here is recovered by totemsrp
+	 */
+	for (i = 0; i < instance->send_batch_entries; i++) {
+		instance->send_batch_msgs[i].msg_hdr.msg_name = NULL;
+		instance->send_batch_msgs[i].msg_hdr.msg_namelen = 0;
+	}
+
+	failed = send_batch_sendmmsg (instance->totemudp_sockets.local_mcast_loop[1],
+		instance->send_batch_msgs, instance->send_batch_entries, &err);
+	if (failed) {
+		LOGSYS_PERROR (err, instance->totemudp_log_level_debug,
+			"sendmmsg(local mcast loop) failed (non-critical)");
+	}
+
+	instance->send_batch_entries = 0;
+	instance->send_batch_bytes = 0;
+}
+
+static void mcast_send_batch_add (
+	struct totemudp_instance *instance,
+	const void *msg,
+	unsigned int msg_len)
+{
+	struct mmsghdr *mmsg;
+	struct iovec *iovec;
+
+	if (instance->send_batch_entries == SEND_BATCH_MAX ||
+	    instance->send_batch_bytes + msg_len > SEND_BATCH_BUFFER_SIZE) {
+		mcast_send_batch_flush (instance);
+	}
+
+	mmsg = &instance->send_batch_msgs[instance->send_batch_entries];
+	iovec = &instance->send_batch_iovec[instance->send_batch_entries];
+
+	iovec->iov_base = instance->send_batch_buffer + instance->send_batch_bytes;
+	iovec->iov_len = msg_len;
+	memcpy (iovec->iov_base, msg, msg_len);
+	instance->send_batch_bytes += msg_len;
+
+	memset (mmsg, 0, sizeof (struct mmsghdr));
+	mmsg->msg_hdr.msg_iov = iovec;
+	mmsg->msg_hdr.msg_iovlen = 1;
+
+	instance->send_batch_entries += 1;
+}
 
 int totemudp_finalize (
 	void *udp_context)
@@ -386,6 +527,10 @@ int totemudp_finalize (
 	struct totemudp_instance *instance = (struct totemudp_instance *)udp_context;
 	int res = 0;
 
+	mcast_send_batch_flush (instance);
+	recv_batch_free (&instance->recv_batch);
+	recv_batch_free (&instance->recv_batch_flush);
+
 	if (instance->totemudp_sockets.mcast_recv > 0) {
 	 	qb_loop_poll_del (instance->totemudp_poll_handle,
 			instance->totemudp_sockets.mcast_recv);
@@ -410,8 +555,38 @@ int totemudp_finalize (
 }
 
 /*
- * Only designed to work with a message with one iov
+ * Deliver frames of batch which were not delivered yet
  */
+static void net_deliver_batch (
+	struct totemudp_instance *instance,
+	struct recv_batch *batch)
+{
+	unsigned int bytes_received;
+	int idx;
+
+	while ((idx = recv_batch_next (batch)) != -1) {
+		bytes_received = recv_batch_frame_len (batch, idx);
+		instance->stats_recv += bytes_received;
+
+		if (recv_batch_frame_truncated (batch, idx)) {
+			log_printf (instance->totemudp_log_level_error,
+					"Received too big message. This may be because something bad is happening"
+					"on the network (attack?), or you tried join more nodes than corosync is"
+					"compiled with (%u) or bug in the code (bad estimation of "
+					"the UDP_RECEIVE_FRAME_SIZE_MAX). Dropping packet.", PROCESSOR_COUNT_MAX);
+			continue;
+		}
+
+		/*
+		 * Handle incoming message
+		 */
+		instance->totemudp_deliver_fn (
+			instance->context,
+			recv_batch_frame (batch, idx),
+			bytes_received,
+			&batch->system_from[idx]);
+	}
+}
 
 static int net_deliver_fn (
 	int fd,
@@ -419,85 +594,23 @@ static int net_deliver_fn (
 	void *data)
 {
 	struct totemudp_instance *instance = (struct totemudp_instance *)data;
-	struct msghdr msg_recv;
-	struct iovec *iovec;
-	struct sockaddr_storage system_from;
-	int bytes_received;
-	int truncated_packet;
+	struct recv_batch *batch;
 
 	if (instance->flushing == 1) {
-		iovec = &instance->totemudp_iov_recv_flush;
+		batch = &instance->recv_batch_flush;
 	} else {
-		iovec = &instance->totemudp_iov_recv;
+		batch = &instance->recv_batch;
 	}
 
 	/*
-	 * Receive datagram
+	 * Receive all queued datagrams (up to batch size) at once
 	 */
-	msg_recv.msg_name = &system_from;
-	msg_recv.msg_namelen = sizeof (struct sockaddr_storage);
-	msg_recv.msg_iov = iovec;
-	msg_recv.msg_iovlen = 1;
-#ifdef HAVE_MSGHDR_CONTROL
-	msg_recv.msg_control = 0;
-#endif
-#ifdef HAVE_MSGHDR_CONTROLLEN
-	msg_recv.msg_controllen = 0;
-#endif
-#ifdef HAVE_MSGHDR_FLAGS
-	msg_recv.msg_flags = 0;
-#endif
-#ifdef HAVE_MSGHDR_ACCRIGHTS
-	msg_recv.msg_accrights = NULL;
-#endif
-#ifdef HAVE_MSGHDR_ACCRIGHTSLEN
-	msg_recv.msg_accrightslen = 0;
-#endif
-
-	bytes_received = recvmsg (fd, &msg_recv, MSG_NOSIGNAL | MSG_DONTWAIT);
-	if (bytes_received == -1) {
+	if (recv_batch_recv (batch, fd, instance->stats) == 0) {
 		return (0);
-	} else {
-		instance->stats_recv += bytes_received;
 	}
 
-	truncated_packet = 0;
-
-#ifdef HAVE_MSGHDR_FLAGS
-	if (msg_recv.msg_flags & MSG_TRUNC) {
-		truncated_packet = 1;
-	}
-#else
-	/*
-	 * We don't have MSGHDR_FLAGS, but we can (hopefully) safely make assumption that
-	 * if bytes_received == UDP_RECIEVE_FRAME_SIZE_MAX then packet is truncated
-	 */
-	if (bytes_received == UDP_RECEIVE_FRAME_SIZE_MAX) {
-		truncated_packet = 1;
-	}
-#endif
-
-	if (truncated_packet) {
-		log_printf (instance->totemudp_log_level_error,
-				"Received too big message. This may be because something bad is happening"
-				"on the network (attack?), or you tried join more nodes than corosync is"
-				"compiled with (%u) or bug in the code (bad estimation of "
-				"the UDP_RECEIVE_FRAME_SIZE_MAX). Dropping packet.", PROCESSOR_COUNT_MAX);
-		return (0);
-	}
-
-	iovec->iov_len = bytes_received;
-
-	/*
-	 * Handle incoming message
-	 */
-	instance->totemudp_deliver_fn (
-		instance->context,
-		iovec->iov_base,
-		iovec->iov_len,
-		&system_from);
+	net_deliver_batch (instance, batch);
 
-	iovec->iov_len = UDP_RECEIVE_FRAME_SIZE_MAX;
 	return (0);
 }
 
@@ -1182,7 +1295,15 @@ int totemudp_initialize (
 	 */
 	instance->totem_interface = &totem_config->interfaces[0];
 	totemip_copy (&instance->mcast_address, &instance->totem_interface->mcast_addr);
-	memset (instance->iov_buffer, 0, UDP_RECEIVE_FRAME_SIZE_MAX);
+	if (recv_batch_init (&instance->recv_batch, UDP_RECEIVE_FRAME_SIZE_MAX) != 0) {
+		free (instance);
+		return (-1);
+	}
+	if (recv_batch_init (&instance->recv_batch_flush, UDP_RECEIVE_FRAME_SIZE_MAX) != 0) {
+		recv_batch_free (&instance->recv_batch);
+		free (instance);
+		return (-1);
+	}
 
 	instance->totemudp_poll_handle = poll_handle;
 
@@ -1213,16 +1334,6 @@ int totemudp_initialize (
 	return (0);
 }
 
-void *totemudp_buffer_alloc (void)
-{
-	return malloc (FRAME_SIZE_MAX);
-}
-
-void totemudp_buffer_release (void *ptr)
-{
-	return free (ptr);
-}
-
 int totemudp_processor_count_set (
 	void *udp_context,
 	int processor_count)
@@ -1256,6 +1367,13 @@ int totemudp_recv_flush (void *udp_context)
 
 	instance->flushing = 1;
 
+	/*
+	 * Called from the token handler only, so the batch being delivered
+	 * is the token socket's. Its leftovers may contain another token and
+	 * are delivered by net_deliver_fn once the current one is processed.
+	 */
+	assert (instance->recv_batch.fd == instance->totemudp_sockets.token);
+
 	for (i = 0; i < 2; i++) {
 		sock = -1;
 		if (i == 0) {
@@ -1283,6 +1401,10 @@ int totemudp_recv_flush (void *udp_context)
 
 int totemudp_send_flush (void *udp_context)
 {
+	struct totemudp_instance *instance = (struct totemudp_instance *)udp_context;
+
+	mcast_send_batch_flush (instance);
+
 	return 0;
 }
 
@@ -1294,6 +1416,7 @@ int totemudp_token_send (
 	struct totemudp_instance *instance = (struct totemudp_instance *)udp_context;
 	int res = 0;
 
+	mcast_send_batch_flush (instance);
 	ucast_sendmsg (instance, &instance->token_target, msg, msg_len);
 
 	return (res);
@@ -1306,6 +1429,7 @@ int totemudp_mcast_flush_send (
 	struct totemudp_instance *instance = (struct totemudp_instance *)udp_context;
 	int res = 0;
 
+	mcast_send_batch_flush (instance);
 	mcast_sendmsg (instance, msg, msg_len);
 
 	return (res);
@@ -1319,7 +1443,7 @@ int totemudp_mcast_noflush_send (
 	struct totemudp_instance *instance = (struct totemudp_instance *)udp_context;
 	int res = 0;
 
-	mcast_sendmsg (instance, msg, msg_len);
+	mcast_send_batch_add (instance, msg, msg_len);
 
 	return (res);
 }
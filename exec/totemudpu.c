@@ -69,12 +69,23 @@
 #include "totemudpu.h"
 
 #include "util.h"
+#include "recvbatch.h"
 
 #ifndef MSG_NOSIGNAL
 #define MSG_NOSIGNAL 0
 #endif
 
 #define MCAST_SOCKET_BUFFER_SIZE (TRANSMITS_ALLOWED * UDP_RECEIVE_FRAME_SIZE_MAX)
+/*
+ * Maximum number of frames gathered by totemudpu_mcast_noflush_send before
+ * they are transmitted to every member by a single sendmmsg call
+ */
+#define SEND_BATCH_MAX 64
+
+/*
+ * Bytes of frames the batch can hold, flushed earlier when full
+ */
+#define SEND_BATCH_BUFFER_SIZE (4 * FRAME_SIZE_MAX)
 #define NETIF_STATE_REPORT_UP		1
 #define NETIF_STATE_REPORT_DOWN		2
 
@@ -143,6 +154,11 @@ struct totemudpu_instance {
 
 	struct iovec totemudpu_iov_recv;
 
+	/*
+	 * Frames received by net_deliver_fn
+	 */
+	struct recv_batch recv_batch;
+
 	struct qb_list_head member_list;
 
 	int stats_sent;
@@ -180,6 +196,21 @@ struct totemudpu_instance {
 	int send_merge_detect_message;
 
 	unsigned int merge_detect_messages_sent_before_timeout;
+
+	/*
+	 * Frames queued by noflush send, transmitted by totemudpu_send_flush.
+	 * Frames are copied into send_batch_buffer, totemsrp may release its
+	 * copy (e.g. on membership change) before the batch is flushed.
+	 */
+	struct mmsghdr send_batch_msgs[SEND_BATCH_MAX];
+
+	struct iovec send_batch_iovec[SEND_BATCH_MAX];
+
+	unsigned int send_batch_entries;
+
+	char send_batch_buffer[SEND_BATCH_BUFFER_SIZE];
+
+	size_t send_batch_bytes;
 };
 
 struct work_item {
@@ -376,6 +407,9 @@ static inline void mcast_sendmsg (
 				if (res < 0) {
 					LOGSYS_PERROR (errno, instance->totemudpu_log_level_debug,
 						"sendmsg(mcast) failed (non-critical)");
+					instance->stats->continuous_sendmsg_failures++;
+				} else {
+					instance->stats->continuous_sendmsg_failures = 0;
 				}
 		}
 
@@ -420,12 +454,162 @@ static inline void mcast_sendmsg (
 	}
 }
 
+/*
+ * Transmit all messages in msgs, retrying after partial sends.
+ * Message which failed to send is skipped the same way as a failed
+ * sendmsg would. Returns number of failed messages, errno of last
+ * failure is stored in err.
+ */
+static unsigned int send_batch_sendmmsg (
+	int fd,
+	struct mmsghdr *msgs,
+	unsigned int entries,
+	int *err)
+{
+	unsigned int sent = 0;
+	unsigned int failed = 0;
+	int res;
+
+	while (sent < entries) {
+		res = sendmmsg (fd, &msgs[sent], entries - sent, MSG_NOSIGNAL);
+		if (res < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			*err = errno;
+			failed += 1;
+			sent += 1;
+		} else {
+			sent += res;
+		}
+	}
+
+	return (failed);
+}
+
+static void mcast_send_batch_flush (
+	struct totemudpu_instance *instance)
+{
+	struct sockaddr_storage sockaddr;
+	int addrlen;
+	struct qb_list_head *list;
+	struct totemudpu_member *member;
+	unsigned int entries;
+	unsigned int i;
+	unsigned int failed;
+	int err = 0;
+
+	if (instance->send_batch_entries == 0) {
+		return;
+	}
+
+	if (instance->netif_bind_state == BIND_STATE_REGULAR) {
+		qb_list_for_each(list, &(instance->member_list)) {
+			member = qb_list_entry (list,
+				struct totemudpu_member,
+				list);
+
+			entries = instance->send_batch_entries;
+			if (!member->active) {
+				/*
+				 * Inactive member gets only the first message and only
+				 * when timeout for sending merge message expired, same
+				 * as when every message was sent separately.
+				 */
+				if (!instance->send_merge_detect_message) {
+					continue ;
+				}
+				entries = 1;
+			}
+
+			totemip_totemip_to_sockaddr_convert(&member->member,
+				instance->totem_interface->ip_port, &sockaddr, &addrlen);
+			for (i = 0; i < entries; i++) {
+				instance->send_batch_msgs[i].msg_hdr.msg_name = &sockaddr;
+				instance->send_batch_msgs[i].msg_hdr.msg_namelen = addrlen;
+			}
+
+			/*
+			 * Transmit multicast messages
+			 * An error here is recovered by totemsrp
+			 */
+			failed = send_batch_sendmmsg (member->fd,
+				instance->send_batch_msgs, entries, &err);
+			if (failed) {
+				LOGSYS_PERROR (err, instance->totemudpu_log_level_debug,
+					"sendmmsg(mcast) failed (non-critical)");
+				instance->stats->continuous_sendmsg_failures += failed;
+			} else {
+				instance->stats->continuous_sendmsg_failures = 0;
+			}
+		}
+
+		if (instance->send_merge_detect_message) {
+			/*
+			 * First message was sent to all nodes
+			 */
+			instance->merge_detect_messages_sent_before_timeout++;
+			instance->send_merge_detect_message = 0;
+		}
+	} else {
+		/*
+		 * Transmit multicast messages to local unix mcast loop
+		 * An error here is recovered by totemsrp
+		 */
+		for (i = 0; i < instance->send_batch_entries; i++) {
+			instance->send_batch_msgs[i].msg_hdr.msg_name = NULL;
+			instance->send_batch_msgs[i].msg_hdr.msg_namelen = 0;
+		}
+
+		failed = send_batch_sendmmsg (instance->local_loop_sock[1],
+			instance->send_batch_msgs, instance->send_batch_entries, &err);
+		if (failed) {
+			LOGSYS_PERROR (err, instance->totemudpu_log_level_debug,
+				"sendmmsg(local mcast loop) failed (non-critical)");
+		}
+	}
+
+	instance->send_batch_entries = 0;
+	instance->send_batch_bytes = 0;
+}
+
+static void mcast_send_batch_add (
+	struct totemudpu_instance *instance,
+	const void *msg,
+	unsigned int msg_len)
+{
+	struct mmsghdr *mmsg;
+	struct iovec *iovec;
+
+	if (instance->send_batch_entries == SEND_BATCH_MAX ||
+	    instance->send_batch_bytes + msg_len > SEND_BATCH_BUFFER_SIZE) {
+		mcast_send_batch_flush (instance);
+	}
+
+	mmsg = &instance->send_batch_msgs[instance->send_batch_entries];
+	iovec = &instance->send_batch_iovec[instance->send_batch_entries];
+
+	iovec->iov_base = instance->send_batch_buffer + instance->send_batch_bytes;
+	iovec->iov_len = msg_len;
+	memcpy (iovec->iov_base, msg, msg_len);
+	instance->send_batch_bytes += msg_len;
+
+	memset (mmsg, 0, sizeof (struct mmsghdr));
+	mmsg->msg_hdr.msg_iov = iovec;
+	mmsg->msg_hdr.msg_iovlen = 1;
+
+	instance->send_batch_entries += 1;
+}
+
 int totemudpu_finalize (
 	void *udpu_context)
 {
 	struct totemudpu_instance *instance = (struct totemudpu_instance *)udpu_context;
 	int res = 0;
 
+	mcast_send_batch_flush (instance);
+	recv_batch_free (&instance->recv_batch);
+
 	if (instance->token_socket > 0) {
 		qb_loop_poll_del (instance->totemudpu_poll_handle,
 			instance->token_socket);
@@ -476,89 +660,50 @@ static int net_deliver_fn (
 	void *data)
 {
 	struct totemudpu_instance *instance = (struct totemudpu_instance *)data;
-	struct msghdr msg_recv;
-	struct iovec *iovec;
-	struct sockaddr_storage system_from;
-	int bytes_received;
-	int truncated_packet;
-
-	iovec = &instance->totemudpu_iov_recv;
+	struct recv_batch *batch = &instance->recv_batch;
+	struct sockaddr_storage *system_from;
+	unsigned int bytes_received;
+	int idx;
 
 	/*
-	 * Receive datagram
+	 * Receive all queued datagrams (up to batch size) at once
 	 */
-	msg_recv.msg_name = &system_from;
-	msg_recv.msg_namelen = sizeof (struct sockaddr_storage);
-	msg_recv.msg_iov = iovec;
-	msg_recv.msg_iovlen = 1;
-#ifdef HAVE_MSGHDR_CONTROL
-	msg_recv.msg_control = 0;
-#endif
-#ifdef HAVE_MSGHDR_CONTROLLEN
-	msg_recv.msg_controllen = 0;
-#endif
-#ifdef HAVE_MSGHDR_FLAGS
-	msg_recv.msg_flags = 0;
-#endif
-#ifdef HAVE_MSGHDR_ACCRIGHTS
-	msg_recv.msg_accrights = NULL;
-#endif
-#ifdef HAVE_MSGHDR_ACCRIGHTSLEN
-	msg_recv.msg_accrightslen = 0;
-#endif
-
-	bytes_received = recvmsg (fd, &msg_recv, MSG_NOSIGNAL | MSG_DONTWAIT);
-	if (bytes_received == -1) {
+	if (recv_batch_recv (batch, fd, instance->stats) == 0) {
 		return (0);
-	} else {
-		instance->stats_recv += bytes_received;
 	}
 
-	truncated_packet = 0;
+	while ((idx = recv_batch_next (batch)) != -1) {
+		bytes_received = recv_batch_frame_len (batch, idx);
+		system_from = &batch->system_from[idx];
+		instance->stats_recv += bytes_received;
 
-#ifdef HAVE_MSGHDR_FLAGS
-	if (msg_recv.msg_flags & MSG_TRUNC) {
-		truncated_packet = 1;
-	}
-#else
-	/*
-	 * We don't have MSGHDR_FLAGS, but we can (hopefully) safely make assumption that
-	 * if bytes_received == UDP_RECEIVE_FRAME_SIZE_MAX then packet is truncated
-	 */
-	if (bytes_received == UDP_RECEIVE_FRAME_SIZE_MAX) {
-		truncated_packet = 1;
-	}
-#endif
+		if (recv_batch_frame_truncated (batch, idx)) {
+			log_printf (instance->totemudpu_log_level_error,
+					"Received too big message. This may be because something bad is happening"
+					"on the network (attack?), or you tried join more nodes than corosync is"
+					"compiled with (%u) or bug in the code (bad estimation of "
+					"the UDP_RECEIVE_FRAME_SIZE_MAX). Dropping packet.", PROCESSOR_COUNT_MAX);
+			continue;
+		}
 
-	if (truncated_packet) {
-		log_printf (instance->totemudpu_log_level_error,
-				"Received too big message. This may be because something bad is happening"
-				"on the network (attack?), or you tried join more nodes than corosync is"
-				"compiled with (%u) or bug in the code (bad estimation of "
-				"the UDP_RECEIVE_FRAME_SIZE_MAX). Dropping packet.", PROCESSOR_COUNT_MAX);
-		return (0);
-	}
+		if (instance->totem_config->block_unlisted_ips &&
+		    find_member_by_sockaddr(instance, (const struct sockaddr *)system_from) == NULL) {
+			log_printf(instance->totemudpu_log_level_debug, "Packet rejected from %s",
+			    totemip_sa_print((const struct sockaddr *)system_from));
 
-	if (instance->totem_config->block_unlisted_ips &&
-	    find_member_by_sockaddr(instance, (const struct sockaddr *)&system_from) == NULL) {
-		log_printf(instance->totemudpu_log_level_debug, "Packet rejected from %s",
-		    totemip_sa_print((const struct sockaddr *)&system_from));
+			continue;
+		}
 
-		return (0);
+		/*
+		 * Handle incoming message
+		 */
+		instance->totemudpu_deliver_fn (
+			instance->context,
+			recv_batch_frame (batch, idx),
+			bytes_received,
+			system_from);
 	}
 
-	iovec->iov_len = bytes_received;
-
-	/*
-	 * Handle incoming message
-	 */
-	instance->totemudpu_deliver_fn (
-		instance->context,
-		iovec->iov_base,
-		iovec->iov_len,
-		&system_from);
-
-	iovec->iov_len = UDP_RECEIVE_FRAME_SIZE_MAX;
 	return (0);
 }
 
@@ -974,6 +1119,10 @@ int totemudpu_initialize (
 	 */
 	instance->totem_interface = &totem_config->interfaces[0];
 	memset (instance->iov_buffer, 0, UDP_RECEIVE_FRAME_SIZE_MAX);
+	if (recv_batch_init (&instance->recv_batch, UDP_RECEIVE_FRAME_SIZE_MAX) != 0) {
+		free (instance);
+		return (-1);
+	}
 
 	instance->totemudpu_poll_handle = poll_handle;
 
@@ -1017,16 +1166,6 @@ int totemudpu_initialize (
 	return (0);
 }
 
-void *totemudpu_buffer_alloc (void)
-{
-	return malloc (FRAME_SIZE_MAX);
-}
-
-void totemudpu_buffer_release (void *ptr)
-{
-	return free (ptr);
-}
-
 int totemudpu_processor_count_set (
 	void *udpu_context,
 	int processor_count)
@@ -1058,8 +1197,11 @@ int totemudpu_recv_flush (void *udpu_context)
 
 int totemudpu_send_flush (void *udpu_context)
 {
+	struct totemudpu_instance *instance = (struct totemudpu_instance *)udpu_context;
 	int res = 0;
 
+	mcast_send_batch_flush (instance);
+
 	return (res);
 }
 
@@ -1071,6 +1213,7 @@ int totemudpu_token_send (
 	struct totemudpu_instance *instance = (struct totemudpu_instance *)udpu_context;
 	int res = 0;
 
+	mcast_send_batch_flush (instance);
 	ucast_sendmsg (instance, &instance->token_target, msg, msg_len);
 
 	return (res);
@@ -1083,6 +1226,7 @@ int totemudpu_mcast_flush_send (
 	struct totemudpu_instance *instance = (struct totemudpu_instance *)udpu_context;
 	int res = 0;
 
+	mcast_send_batch_flush (instance);
 	mcast_sendmsg (instance, msg, msg_len, 0);
 
 	return (res);
@@ -1096,7 +1240,7 @@ int totemudpu_mcast_noflush_send (
 	struct totemudpu_instance *instance = (struct totemudpu_instance *)udpu_context;
 	int res = 0;
 
-	mcast_sendmsg (instance, msg, msg_len, 1);
+	mcast_send_batch_add (instance, msg, msg_len);
 
 	return (res);
 }
@@ -188,3 +188,47 @@ const char *get_state_dir(void)
 
 	return (path);
 }
+
+#ifndef HAVE_SENDMMSG
+int sendmmsg (int sockfd, struct mmsghdr *msgvec, unsigned int vlen,
+	int flags)
+{
+	unsigned int i;
+	ssize_t res;
+
+	for (i = 0; i < vlen; i++) {
+		res = sendmsg (sockfd, &msgvec[i].msg_hdr, flags);
+		if (res < 0) {
+			if (i == 0) {
+				return (-1);
+			}
+			break;
+		}
+		msgvec[i].msg_len = res;
+	}
+
+	return (i);
+}
+#endif
+
+#ifndef HAVE_RECVMMSG
+int recvmmsg (int sockfd, struct mmsghdr *msgvec, unsigned int vlen,
+	int flags, struct timespec *timeout)
+{
+	unsigned int i;
+	ssize_t res;
+
+	for (i = 0; i < vlen; i++) {
+		res = recvmsg (sockfd, &msgvec[i].msg_hdr, flags | MSG_DONTWAIT);
+		if (res < 0) {
+			if (i == 0) {
+				return (-1);
+			}
+			break;
+		}
+		msgvec[i].msg_len = res;
+	}
+
+	return (i);
+}
+#endif
@@ -37,6 +37,7 @@
 #define UTIL_H_DEFINED
 
 #include <sys/time.h>
+#include <sys/socket.h>
 #include <corosync/corotypes.h>
 
 /**
@@ -87,4 +88,29 @@ const char * short_service_name_get(uint32_t service_id,
  */
 const char *get_state_dir(void);
 
+#if !defined(HAVE_SENDMMSG) && !defined(HAVE_RECVMMSG)
+struct mmsghdr {
+	struct msghdr msg_hdr;
+	unsigned int msg_len;
+};
+#endif
+
+#ifndef HAVE_SENDMMSG
+/*
+ * Fallback for platforms without sendmmsg. Messages are sent one by one
+ * with sendmsg, return value has same meaning as for sendmmsg.
+ */
+extern int sendmmsg (int sockfd, struct mmsghdr *msgvec, unsigned int vlen,
+	int flags);
+#endif
+
+#ifndef HAVE_RECVMMSG
+/*
+ * Fallback for platforms without recvmmsg. Messages are received one by one
+ * with recvmsg until the socket would block, timeout is ignored.
+ */
+extern int recvmmsg (int sockfd, struct mmsghdr *msgvec, unsigned int vlen,
+	int flags, struct timespec *timeout);
+#endif
+
 #endif /* UTIL_H_DEFINED */
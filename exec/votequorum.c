@@ -54,6 +54,7 @@
 
 #include "service.h"
 #include "util.h"
+#include "statepage.h"
 
 LOGSYS_DECLARE_SUBSYS ("VOTEQ");
 
@@ -320,6 +321,8 @@ static void qdevice_timer_fn(void *arg);
 static void message_handler_req_lib_votequorum_getinfo (void *conn,
 							const void *message);
 
+static void votequorum_state_page_publish(void);
+
 static void message_handler_req_lib_votequorum_setexpected (void *conn,
 							    const void *message);
 
@@ -1135,6 +1138,8 @@ static void recalculate_quorum(int allow_decrease, int by_current_nodes)
 
 	are_we_quorate(total_votes);
 
+	votequorum_state_page_publish();
+
 	LEAVE();
 }
 
@@ -1911,6 +1916,7 @@ static void message_handler_req_exec_votequorum_qdevice_reconfigure (
 		 *       this is not relevant for now and can wait later on since
 		 *       qdevices are local only and libvotequorum is not final
 		 */
+		votequorum_state_page_publish();
 	}
 
 	LEAVE();
@@ -2150,6 +2156,8 @@ recalculate:
 		update_wait_for_all_status(0);
 	}
 
+	votequorum_state_page_publish();
+
 	LEAVE();
 }
 
@@ -2539,6 +2547,146 @@ static void qdevice_timer_fn(void *arg)
  * Library Handler Functions
  */
 
+/*
+ * Sum of votes and highest expected votes of current members, shared by
+ * getinfo and the published state page
+ */
+static void votequorum_members_votes_get(unsigned int *highest_expected,
+					 unsigned int *total_votes)
+{
+	struct cluster_node *iternode;
+	struct qb_list_head *nodelist;
+
+	*highest_expected = 0;
+	*total_votes = 0;
+
+	qb_list_for_each(nodelist, &cluster_members_list) {
+		iternode = qb_list_entry(nodelist, struct cluster_node, list);
+
+		if (iternode->state == NODESTATE_MEMBER) {
+			*highest_expected =
+				max(*highest_expected, iternode->expected_votes);
+			*total_votes += iternode->votes;
+		}
+	}
+}
+
+static void votequorum_node_info_fill(struct cluster_node *node,
+				      unsigned int highest_expected,
+				      unsigned int total_votes,
+				      struct res_lib_votequorum_getinfo *res)
+{
+	if (node->flags & NODE_FLAGS_QDEVICE_CAST_VOTE) {
+		total_votes += qdevice->votes;
+	}
+
+	switch(node->state) {
+		case NODESTATE_MEMBER:
+			res->state = VOTEQUORUM_NODESTATE_MEMBER;
+			break;
+		case NODESTATE_DEAD:
+			res->state = VOTEQUORUM_NODESTATE_DEAD;
+			break;
+		case NODESTATE_LEAVING:
+			res->state = VOTEQUORUM_NODESTATE_LEAVING;
+			break;
+		default:
+			res->state = node->state;
+			break;
+	}
+	res->state = node->state;
+	res->votes = node->votes;
+	res->expected_votes = node->expected_votes;
+	res->highest_expected = highest_expected;
+
+	res->quorum = quorum;
+	res->total_votes = total_votes;
+	res->flags = 0;
+	res->nodeid = node->node_id;
+
+	if (two_node) {
+		res->flags |= VOTEQUORUM_INFO_TWONODE;
+	}
+	if (cluster_is_quorate) {
+		res->flags |= VOTEQUORUM_INFO_QUORATE;
+	}
+	if (wait_for_all) {
+		res->flags |= VOTEQUORUM_INFO_WAIT_FOR_ALL;
+	}
+	if (last_man_standing) {
+		res->flags |= VOTEQUORUM_INFO_LAST_MAN_STANDING;
+	}
+	if (auto_tie_breaker != ATB_NONE) {
+		res->flags |= VOTEQUORUM_INFO_AUTO_TIE_BREAKER;
+	}
+	if (allow_downscale) {
+		res->flags |= VOTEQUORUM_INFO_ALLOW_DOWNSCALE;
+	}
+
+	memset(res->qdevice_name, 0, VOTEQUORUM_QDEVICE_MAX_NAME_LEN);
+	strcpy(res->qdevice_name, qdevice_name);
+	res->qdevice_votes = qdevice->votes;
+
+	if (node->flags & NODE_FLAGS_QDEVICE_REGISTERED) {
+		res->flags |= VOTEQUORUM_INFO_QDEVICE_REGISTERED;
+	}
+	if (node->flags & NODE_FLAGS_QDEVICE_ALIVE) {
+		res->flags |= VOTEQUORUM_INFO_QDEVICE_ALIVE;
+	}
+	if (node->flags & NODE_FLAGS_QDEVICE_CAST_VOTE) {
+		res->flags |= VOTEQUORUM_INFO_QDEVICE_CAST_VOTE;
+	}
+	if (node->flags & NODE_FLAGS_QDEVICE_MASTER_WINS) {
+		res->flags |= VOTEQUORUM_INFO_QDEVICE_MASTER_WINS;
+	}
+}
+
+/*
+ * Refresh votequorum part of the cluster state page
+ */
+static void votequorum_state_page_publish(void)
+{
+	struct res_lib_votequorum_getinfo info;
+	struct cs_state_page *page;
+	struct cluster_node *node;
+	struct qb_list_head *nodelist;
+	unsigned int highest_expected;
+	unsigned int total_votes;
+	unsigned int entries = 0;
+
+	page = cs_state_page_write_begin();
+	if (page == NULL) {
+		return;
+	}
+
+	votequorum_members_votes_get(&highest_expected, &total_votes);
+
+	qb_list_for_each(nodelist, &cluster_members_list) {
+		if (entries >= CS_STATE_PAGE_NODES_MAX) {
+			break;
+		}
+		node = qb_list_entry(nodelist, struct cluster_node, list);
+		votequorum_node_info_fill(node, highest_expected, total_votes, &info);
+
+		page->vq_nodes[entries].nodeid = info.nodeid;
+		page->vq_nodes[entries].state = info.state;
+		page->vq_nodes[entries].votes = info.votes;
+		page->vq_nodes[entries].expected_votes = info.expected_votes;
+		page->vq_nodes[entries].highest_expected = info.highest_expected;
+		page->vq_nodes[entries].total_votes = info.total_votes;
+		page->vq_nodes[entries].quorum = info.quorum;
+		page->vq_nodes[entries].flags = info.flags;
+		entries++;
+	}
+	page->vq_node_entries = entries;
+	page->vq_qdevice_votes = qdevice->votes;
+	memset(page->vq_qdevice_name, 0, sizeof(page->vq_qdevice_name));
+	strncpy(page->vq_qdevice_name, qdevice_name, sizeof(page->vq_qdevice_name) - 1);
+	page->vq_valid = 1;
+
+	cs_state_page_write_end(page);
+}
+
 static void message_handler_req_lib_votequorum_getinfo (void *conn, const void *message)
 {
 	const struct req_lib_votequorum_getinfo *req_lib_votequorum_getinfo = message;
@@ -2559,82 +2707,9 @@ static void message_handler_req_lib_votequorum_getinfo (void *conn, const void *
 
 	node = find_node_by_nodeid(nodeid);
 	if (node) {
-		struct cluster_node *iternode;
-		struct qb_list_head *nodelist;
-
-		qb_list_for_each(nodelist, &cluster_members_list) {
-			iternode = qb_list_entry(nodelist, struct cluster_node, list);
-
-			if (iternode->state == NODESTATE_MEMBER) {
-				highest_expected =
-					max(highest_expected, iternode->expected_votes);
-				total_votes += iternode->votes;
-			}
-		}
-
-		if (node->flags & NODE_FLAGS_QDEVICE_CAST_VOTE) {
-			total_votes += qdevice->votes;
-		}
-
-		switch(node->state) {
-			case NODESTATE_MEMBER:
-				res_lib_votequorum_getinfo.state = VOTEQUORUM_NODESTATE_MEMBER;
-				break;
-			case NODESTATE_DEAD:
-				res_lib_votequorum_getinfo.state = VOTEQUORUM_NODESTATE_DEAD;
-				break;
-			case NODESTATE_LEAVING:
-				res_lib_votequorum_getinfo.state = VOTEQUORUM_NODESTATE_LEAVING;
-				break;
-			default:
-				res_lib_votequorum_getinfo.state = node->state;
-				break;
-		}
-		res_lib_votequorum_getinfo.state = node->state;
-		res_lib_votequorum_getinfo.votes = node->votes;
-		res_lib_votequorum_getinfo.expected_votes = node->expected_votes;
-		res_lib_votequorum_getinfo.highest_expected = highest_expected;
-
-		res_lib_votequorum_getinfo.quorum = quorum;
-		res_lib_votequorum_getinfo.total_votes = total_votes;
-		res_lib_votequorum_getinfo.flags = 0;
-		res_lib_votequorum_getinfo.nodeid = node->node_id;
-
-		if (two_node) {
-			res_lib_votequorum_getinfo.flags |= VOTEQUORUM_INFO_TWONODE;
-		}
-		if (cluster_is_quorate) {
-			res_lib_votequorum_getinfo.flags |= VOTEQUORUM_INFO_QUORATE;
-		}
-		if (wait_for_all) {
-			res_lib_votequorum_getinfo.flags |= VOTEQUORUM_INFO_WAIT_FOR_ALL;
-		}
-		if (last_man_standing) {
-			res_lib_votequorum_getinfo.flags |= VOTEQUORUM_INFO_LAST_MAN_STANDING;
-		}
-		if (auto_tie_breaker != ATB_NONE) {
-			res_lib_votequorum_getinfo.flags |= VOTEQUORUM_INFO_AUTO_TIE_BREAKER;
-		}
-		if (allow_downscale) {
-			res_lib_votequorum_getinfo.flags |= VOTEQUORUM_INFO_ALLOW_DOWNSCALE;
-		}
-
-		memset(res_lib_votequorum_getinfo.qdevice_name, 0, VOTEQUORUM_QDEVICE_MAX_NAME_LEN);
-		strcpy(res_lib_votequorum_getinfo.qdevice_name, qdevice_name);
-		res_lib_votequorum_getinfo.qdevice_votes = qdevice->votes;
-
-		if (node->flags & NODE_FLAGS_QDEVICE_REGISTERED) {
-			res_lib_votequorum_getinfo.flags |= VOTEQUORUM_INFO_QDEVICE_REGISTERED;
-		}
-		if (node->flags & NODE_FLAGS_QDEVICE_ALIVE) {
-			res_lib_votequorum_getinfo.flags |= VOTEQUORUM_INFO_QDEVICE_ALIVE;
-		}
-		if (node->flags & NODE_FLAGS_QDEVICE_CAST_VOTE) {
-			res_lib_votequorum_getinfo.flags |= VOTEQUORUM_INFO_QDEVICE_CAST_VOTE;
-		}
-		if (node->flags & NODE_FLAGS_QDEVICE_MASTER_WINS) {
-			res_lib_votequorum_getinfo.flags |= VOTEQUORUM_INFO_QDEVICE_MASTER_WINS;
-		}
+		votequorum_members_votes_get(&highest_expected, &total_votes);
+		votequorum_node_info_fill(node, highest_expected, total_votes,
+			&res_lib_votequorum_getinfo);
 	} else {
 		error = CS_ERR_NOT_EXIST;
 	}
@@ -69,6 +69,7 @@
 #include "service.h"
 #include "votequorum.h"
 #include "vsf_ykd.h"
+#include "statepage.h"
 
 LOGSYS_DECLARE_SUBSYS ("QUORUM");
 
@@ -149,6 +150,8 @@ static void quorum_api_set_quorum(const unsigned int *view_list,
 		log_printf (LOGSYS_LEVEL_NOTICE, "This node is within the non-primary component and will NOT provide any services.");
 	}
 
+	cs_state_page_quorate_set (primary_designated);
+
 	quorum_view_list_entries = view_list_entries;
 	memcpy(&quorum_ring_id, ring_id, sizeof (quorum_ring_id));
 	memcpy(quorum_view_list, view_list, sizeof(unsigned int)*view_list_entries);
@@ -304,6 +307,7 @@ static char *quorum_exec_init_fn (struct corosync_api_v1 *api)
 	if (quorum_type == 0) {
 		primary_designated = 1;
 	}
+	cs_state_page_quorate_set (primary_designated);
 
 	return (NULL);
 }
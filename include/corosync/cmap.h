@@ -86,6 +86,16 @@ typedef uint64_t cmap_track_handle_t;
  */
 #define CMAP_TRACK_PREFIX	8
 
+/**
+ * Changes are not delivered one by one as they happen but collected and
+ * delivered together after corosync finishes processing of the current
+ * event (or at the end of bigger operation like config reload). Only the
+ * newest value of each key is delivered, old value is the value before the
+ * first change. Key which was added and deleted meanwhile is not reported.
+ * Used only in adding track.
+ */
+#define CMAP_TRACK_COALESCE	16
+
 /**
  * Possible types of value. Binary is raw data without trailing zero with given length
  */
@@ -120,6 +130,34 @@ struct cmap_notify_value {
 	const void *data;
 };
 
+/**
+ * Prototype of function called by cmap_iter_next_bulk for every returned key.
+ * key_name and value are valid only during the call.
+ */
+typedef void (*cmap_iter_bulk_fn_t) (
+	cmap_handle_t cmap_handle,
+	const char *key_name,
+	const void *value,
+	size_t value_len,
+	cmap_value_types_t type,
+	void *user_data);
+
+/**
+ * One key of cmap_get_multi, cmap_set_multi or cmap_delete_multi.
+ *
+ * For cmap_get_multi value is a buffer of value_len bytes (or NULL), on
+ * return value_len and type describe the value in map. For cmap_set_multi
+ * value, value_len and type are the value to store. cmap_delete_multi uses
+ * only key_name. error is set to result for the key by every call.
+ */
+struct cmap_multi_item {
+	const char *key_name;
+	void *value;
+	size_t value_len;
+	cmap_value_types_t type;
+	cs_error_t error;
+};
+
 /**
  * Prototype for notify callback function. Even is one of CMAP_TRACK_* event, key_name is
  * changed key, new and old_value contains values or are zeroed (in other words, type is non
@@ -135,6 +173,28 @@ typedef void (*cmap_notify_fn_t) (
 	struct cmap_notify_value old_value,
 	void *user_data);
 
+/**
+ * One change delivered to cmap_notify_batch_fn_t
+ */
+struct cmap_notify_item {
+	int32_t event;
+	const char *key_name;
+	struct cmap_notify_value new_value;
+	struct cmap_notify_value old_value;
+};
+
+/**
+ * Prototype for batched notify callback function. items is array of no_items
+ * changes, valid only during the call. user_data are passed when adding
+ * tracking.
+ */
+typedef void (*cmap_notify_batch_fn_t) (
+	cmap_handle_t cmap_handle,
+	cmap_track_handle_t cmap_track_handle,
+	const struct cmap_notify_item *items,
+	size_t no_items,
+	void *user_data);
+
 /**
  * Create a new cmap connection
  *
@@ -285,6 +345,57 @@ extern cs_error_t cmap_get_double(cmap_handle_t handle, const char *key_name, do
  */
 extern cs_error_t cmap_get_string(cmap_handle_t handle, const char *key_name, char **str);
 
+/**
+ * @brief Retrieve values of several keys with as few requests as possible.
+ *
+ * Works like cmap_get called for every item, result for each key is stored
+ * in its error field. Keys are sent in batches limited by the IPC message
+ * size, values of one batch are read at once.
+ *
+ * @param handle cmap handle
+ * @param items keys to get
+ * @param no_items number of items
+ * @return CS_OK if all requests were processed, errors of keys are in items
+ */
+extern cs_error_t cmap_get_multi(
+	cmap_handle_t handle,
+	struct cmap_multi_item *items,
+	size_t no_items);
+
+/**
+ * @brief Store values of several keys in one request.
+ *
+ * Either all keys are stored or none of them. If any key is read only or
+ * can't be stored, error of the call is error of the first such key and
+ * error field of failed keys is set.
+ *
+ * @param handle cmap handle
+ * @param items keys and values to store
+ * @param no_items number of items
+ * @return CS_ERR_TOO_BIG if items don't fit into one request
+ */
+extern cs_error_t cmap_set_multi(
+	cmap_handle_t handle,
+	struct cmap_multi_item *items,
+	size_t no_items);
+
+/**
+ * @brief Delete several keys in one request.
+ *
+ * No key is deleted if any of them is read only. Keys which don't exist
+ * have CS_ERR_NOT_EXIST in error field but don't prevent deletion of the
+ * others.
+ *
+ * @param handle cmap handle
+ * @param items keys to delete
+ * @param no_items number of items
+ * @return CS_ERR_TOO_BIG if items don't fit into one request
+ */
+extern cs_error_t cmap_delete_multi(
+	cmap_handle_t handle,
+	struct cmap_multi_item *items,
+	size_t no_items);
+
 /**
  * @brief Increment value of key_name if it is [u]int* type
  *
@@ -332,6 +443,25 @@ extern cs_error_t cmap_iter_next(
 		size_t *value_len,
 		cmap_value_types_t *type);
 
+/**
+ * @brief Return next page of keys in iterator iter, with their values.
+ *
+ * Corosync returns as many keys as fit into one IPC message and iter_fn is
+ * called for each of them. Next call continues after the last returned key.
+ * Calls can be mixed with cmap_iter_next on the same iterator.
+ *
+ * @param handle cmap handle
+ * @param iter_handle handle of iteration returned by cmap_iter_init
+ * @param iter_fn function called for every key
+ * @param user_data passed unchanged to iter_fn
+ * @return CS_NO_SECTION if there are no more keys to iterate
+ */
+extern cs_error_t cmap_iter_next_bulk(
+		cmap_handle_t handle,
+		cmap_iter_handle_t iter_handle,
+		cmap_iter_bulk_fn_t iter_fn,
+		void *user_data);
+
 /**
  * @brief Finalize iterator
  * @param handle
@@ -362,6 +492,27 @@ extern cs_error_t cmap_track_add(
         void *user_data,
         cmap_track_handle_t *cmap_track_handle);
 
+/**
+ * @brief Add tracking function receiving coalesced changes of given key_name.
+ *
+ * Same as cmap_track_add with CMAP_TRACK_COALESCE, but all changes collected
+ * by corosync are passed to notify_fn in one call.
+ *
+ * @param handle cmap handle
+ * @param key_name name of key to track changes on
+ * @param track_type bitwise-or of CMAP_TRACK_* values
+ * @param notify_fn function to be called with changes
+ * @param user_data given pointer is unchanged passed to notify_fn
+ * @param cmap_track_handle handle used for removing of newly created track
+ */
+extern cs_error_t cmap_track_add_batch(
+	cmap_handle_t handle,
+	const char *key_name,
+	int32_t track_type,
+	cmap_notify_batch_fn_t notify_fn,
+	void *user_data,
+	cmap_track_handle_t *cmap_track_handle);
+
 /**
  * Delete track created previously by cmap_track_add
  * @param handle cmap handle
@@ -260,11 +260,45 @@ struct corosync_api_v1 {
 	int (*ipc_response_iov_send) (void *conn,
 				      const struct iovec *iov, unsigned int iov_len);
 
+	/*
+	 * Dispatch sends return 0 if the message was sent or queued and -1
+	 * if it was dropped, e.g. because the connection is over its outq
+	 * budget
+	 */
 	int (*ipc_dispatch_send) (void *conn, const void *msg, size_t mlen);
 
 	int (*ipc_dispatch_iov_send) (void *conn,
 				      const struct iovec *iov, unsigned int iov_len);
 
+	/*
+	 * Same as ipc_dispatch_iov_send, for a message sent to several
+	 * connections. *shared_msg must be NULL before the first call. If a
+	 * connection has to queue the message, one copy is made and referenced
+	 * by every connection which queues it. The caller releases its
+	 * reference with ipc_shared_msg_release once all sends are done.
+	 */
+	int (*ipc_dispatch_iov_send_shared) (void *conn,
+				      const struct iovec *iov, unsigned int iov_len,
+				      void **shared_msg);
+
+	void (*ipc_shared_msg_release) (void *shared_msg);
+
+	/*
+	 * Allow consecutive queued dispatch messages of the connection to be
+	 * sent as one event of type pack_id, at most max_bytes long. The
+	 * service must only enable this for clients which can unpack such
+	 * events. pack_id 0 disables packing.
+	 */
+	void (*ipc_dispatch_pack_set) (void *conn, uint32_t pack_id,
+				      size_t max_bytes);
+
+	/*
+	 * Same as ipc_dispatch_send, but the message is queued even when the
+	 * outq of the connection is over its budget. Only for small control
+	 * messages whose loss would stall the client.
+	 */
+	int (*ipc_dispatch_send_exempt) (void *conn, const void *msg, size_t mlen);
+
 	void (*ipc_refcnt_inc) (void *conn);
 
 	void (*ipc_refcnt_dec) (void *conn);
@@ -279,6 +313,16 @@ struct corosync_api_v1 {
 	int (*totem_mcast) (const struct iovec *iovec,
 			    unsigned int iov_len, unsigned int guarantee);
 
+	/*
+	 * Send msg_count messages, iov_lens[n] vectors each. Returns the
+	 * number of messages queued from the first one, only the rest may
+	 * be sent again.
+	 */
+	int (*totem_mcast_multi) (const struct iovec *iovec,
+				  const unsigned int *iov_lens,
+				  unsigned int msg_count,
+				  unsigned int guarantee);
+
 	int (*totem_ifaces_get) (
 		unsigned int nodeid,
 		unsigned int *interface_ids,
@@ -467,6 +511,12 @@ struct corosync_api_v1 {
 struct corosync_lib_handler {
 	void (*lib_handler_fn) (void *conn, const void *msg);
 	enum cs_lib_flow_control flow_control;
+	/*
+	 * Called instead of lib_handler_fn when a request the library
+	 * doesn't wait a response for is refused by the IPC layer. May be
+	 * NULL.
+	 */
+	void (*lib_refused_fn) (void *conn, const void *msg, cs_error_t error);
 };
 
 /**
@@ -191,6 +191,21 @@ typedef struct {
 } cpg_model_data_t;
 
 #define CPG_MODEL_V1_DELIVER_INITIAL_TOTEM_CONF 0x01
+/*
+ * Let the daemon pack several queued messages into one dispatch event.
+ * cpg_dispatch with CS_DISPATCH_ONE or CS_DISPATCH_ONE_NONBLOCKING then
+ * may call more than one callback per call.
+ */
+#define CPG_MODEL_V1_PACKED_EVENTS 0x02
+
+/**
+ * @brief Called from cpg_dispatch when messages accepted by
+ * cpg_mcast_joined in async mode could not be sent
+ */
+typedef void (*cpg_mcast_status_fn_t) (
+	cpg_handle_t handle,
+	cs_error_t error,
+	unsigned int failed_count);
 
 /**
  * @brief The cpg_model_v1_data_t struct
@@ -203,6 +218,42 @@ typedef struct {
 	unsigned int flags;
 } cpg_model_v1_data_t;
 
+/**
+ * @brief One message delivered by cpg_dispatch_batch
+ *
+ * msg points into the receive buffer of the library and is only valid
+ * during the cpg_deliver_batch_fn_t callback.
+ */
+typedef struct {
+	const struct cpg_name *group_name;
+	uint32_t nodeid;
+	uint32_t pid;
+	void *msg;
+	size_t msg_len;
+} cpg_delivered_msg_t;
+
+/**
+ * @brief The cpg_zcb_deliver_fn_t callback
+ *
+ * msg is in the receive zero copy pool and stays valid until it is
+ * passed to cpg_zcb_recv_release.
+ */
+typedef void (*cpg_zcb_deliver_fn_t) (
+	cpg_handle_t handle,
+	const struct cpg_name *group_name,
+	uint32_t nodeid,
+	uint32_t pid,
+	void *msg,
+	size_t msg_len);
+
+/**
+ * @brief The cpg_deliver_batch_fn_t callback
+ */
+typedef void (*cpg_deliver_batch_fn_t) (
+	cpg_handle_t handle,
+	const cpg_delivered_msg_t *msgs,
+	unsigned int msg_count);
+
 
 /** @} */
 
@@ -291,6 +342,27 @@ cs_error_t cpg_dispatch (
 	cpg_handle_t handle,
 	cs_dispatch_flags_t dispatch_types);
 
+/**
+ * @brief Dispatch delivered messages in batches
+ *
+ * Messages are passed to deliver_batch_fn instead of cpg_deliver_fn, at most
+ * max_messages per call. Configuration changes are dispatched to the
+ * callbacks of the model, after all messages delivered before them.
+ * Waits up to timeout milliseconds (-1 forever) for the first event and
+ * then dispatches only events which are already available.
+ *
+ * @param handle
+ * @param deliver_batch_fn
+ * @param max_messages
+ * @param timeout
+ * @return CS_ERR_TRY_AGAIN if nothing was dispatched
+ */
+cs_error_t cpg_dispatch_batch (
+	cpg_handle_t handle,
+	cpg_deliver_batch_fn_t deliver_batch_fn,
+	unsigned int max_messages,
+	int32_t timeout);
+
 /**
  * @brief Join one or more groups.
  *
@@ -331,6 +403,51 @@ cs_error_t cpg_mcast_joined (
 	const struct iovec *iovec,
 	unsigned int iov_len);
 
+/**
+ * @brief Multicast several independent messages to groups joined with
+ * cpg_join.
+ *
+ * Each element of msgs is one message. They are delivered separately and
+ * in order, exactly as if cpg_mcast_joined was called for each of them, but
+ * are submitted to the daemon in as few requests as possible.
+ *
+ * @param handle
+ * @param guarantee
+ * @param msgs
+ * @param msg_count
+ * @param msgs_sent Number of messages queued, from the beginning of msgs.
+ *                  May be NULL.
+ * @return CS_OK if all messages were queued. Otherwise the error of the
+ *         first message that was not, msgs_sent tells where to resume.
+ */
+cs_error_t cpg_mcast_joined_batch (
+	cpg_handle_t handle,
+	cpg_guarantee_t guarantee,
+	const struct iovec *msgs,
+	unsigned int msg_count,
+	unsigned int *msgs_sent);
+
+/**
+ * @brief Enable asynchronous send completion for cpg_mcast_joined.
+ *
+ * cpg_mcast_joined returns as soon as a message is written to the daemon.
+ * The daemon reports completion of sent messages with events on the
+ * cpg_fd_get descriptor, which are handled by cpg_dispatch. At most window
+ * messages are in flight, beyond that cpg_mcast_joined returns
+ * CS_ERR_TRY_AGAIN and cpg_flow_control_state_get reports
+ * CPG_FLOW_CONTROL_ENABLED. Messages which were accepted but not sent are
+ * reported to status_fn.
+ *
+ * @param handle
+ * @param window
+ * @param status_fn May be NULL
+ * @return
+ */
+cs_error_t cpg_mcast_async_enable (
+	cpg_handle_t handle,
+	unsigned int window,
+	cpg_mcast_status_fn_t status_fn);
+
 /**
  * @brief Get membership information from cpg
  * @param handle
@@ -354,6 +471,24 @@ cs_error_t cpg_local_get (
 	cpg_handle_t handle,
 	unsigned int *local_nodeid);
 
+/**
+ * @brief Get totem membership from the state page published by corosync.
+ *
+ * Reads the page without asking the daemon. On input member_list_entries
+ * is the size of member_list, on output the number of members.
+ *
+ * @param handle
+ * @param ring_id
+ * @param member_list
+ * @param member_list_entries
+ * @return CS_ERR_NOT_SUPPORTED if no page is published (system.state_page)
+ */
+cs_error_t cpg_totem_membership_get (
+	cpg_handle_t handle,
+	struct cpg_ring_id *ring_id,
+	uint32_t *member_list,
+	int *member_list_entries);
+
 /**
  * @brief cpg_flow_control_state_get
  * @param handle
@@ -400,6 +535,37 @@ cs_error_t cpg_zcb_mcast_joined (
 	void *msg,
 	size_t msg_len);
 
+/**
+ * @brief Enable zero copy receive of large messages
+ *
+ * Messages of at least min_size bytes are written by corosync straight
+ * into a pool of pool_size bytes shared with the application and passed
+ * to zcb_deliver_fn instead of cpg_deliver_fn (or the batch callback).
+ * Smaller messages, and large ones which don't fit into the pool, are
+ * delivered as usual.
+ *
+ * @param handle
+ * @param pool_size
+ * @param min_size
+ * @param zcb_deliver_fn
+ * @return
+ */
+cs_error_t cpg_zcb_recv_enable (
+	cpg_handle_t handle,
+	size_t pool_size,
+	size_t min_size,
+	cpg_zcb_deliver_fn_t zcb_deliver_fn);
+
+/**
+ * @brief Return message passed to cpg_zcb_deliver_fn_t to the pool
+ * @param handle
+ * @param msg
+ * @return
+ */
+cs_error_t cpg_zcb_recv_release (
+	cpg_handle_t handle,
+	void *msg);
+
 /**
  * @brief cpg_iteration_initialize
  * @param handle
@@ -127,6 +127,17 @@ typedef qb_map_iter_t *icmap_iter_t;
  */
 typedef struct icmap_track *icmap_track_t;
 
+/**
+ * @brief Counter type. Points to plain 64-bit value which can be incremented
+ * directly.
+ */
+typedef uint64_t *icmap_counter_t;
+
+/**
+ * Prototype for function called when outermost transaction ends
+ */
+typedef void (*icmap_transaction_end_fn_t) (void *user_data);
+
 /**
  * @brief Initialize global icmap
  * @return
@@ -439,6 +450,28 @@ extern cs_error_t icmap_fast_dec(const char *key_name);
  */
 extern cs_error_t icmap_fast_dec_r(const icmap_map_t map, const char *key_name);
 
+/**
+ * @brief Register counter for key_name in global map.
+ *
+ * Key is created with type uint64 and value 0. Returned counter can be
+ * incremented without any map lookup. Its value is written into the map
+ * only when the key is read (icmap_get and friends), so tracking
+ * notifications for the key are also delivered only at that time. Only one
+ * counter can be registered for a key.
+ *
+ * @param key_name
+ * @param counter
+ * @return CS_ERR_EXIST if counter for key_name is already registered
+ */
+extern cs_error_t icmap_counter_register(const char *key_name, icmap_counter_t *counter);
+
+/**
+ * @brief Unregister counter. Current value of counter is written into the map,
+ * key itself is kept.
+ * @param counter
+ */
+extern void icmap_counter_unregister(icmap_counter_t counter);
+
 /**
  * @brief Initialize iterator with given prefix
  * @param prefix
@@ -508,6 +541,46 @@ extern void *icmap_track_get_user_data(icmap_track_t icmap_track);
  */
 extern cs_error_t icmap_track_delete(icmap_track_t icmap_track);
 
+/**
+ * @brief Start transaction on global map.
+ *
+ * Changes are applied and tracking callbacks called immediately as usual.
+ * Transaction only marks the changes made until icmap_transaction_end as one
+ * batch for users which coalesce notifications (cmap tracks with
+ * CMAP_TRACK_COALESCE). There is no rollback. Transactions can be nested,
+ * batch ends with the outermost icmap_transaction_end.
+ */
+extern void icmap_transaction_begin(void);
+
+/**
+ * @brief End transaction started by icmap_transaction_begin. Functions added
+ * by icmap_transaction_end_notify_add are called when outermost transaction
+ * ends.
+ */
+extern void icmap_transaction_end(void);
+
+/**
+ * @brief Returns !0 if transaction is in progress, otherwise 0
+ * @return
+ */
+extern int icmap_transaction_in_progress(void);
+
+/**
+ * @brief Add function called at end of outermost transaction
+ * @param end_fn
+ * @param user_data
+ * @return
+ */
+extern cs_error_t icmap_transaction_end_notify_add(icmap_transaction_end_fn_t end_fn, void *user_data);
+
+/**
+ * @brief Remove function added by icmap_transaction_end_notify_add
+ * @param end_fn
+ * @param user_data
+ * @return
+ */
+extern cs_error_t icmap_transaction_end_notify_del(icmap_transaction_end_fn_t end_fn, void *user_data);
+
 /**
  * @brief Set read-only access for given key (key_name) or prefix,
  * If prefix is set. ro_access can be !0, which means, that old information
@@ -528,6 +601,13 @@ extern cs_error_t icmap_set_ro_access(const char *key_name, int prefix, int ro_a
  */
 extern int icmap_is_key_ro(const char *key_name);
 
+/**
+ * @brief Return number of read-only access rules (keys and prefixes) set by
+ * icmap_set_ro_access
+ * @return
+ */
+extern unsigned int icmap_ro_access_count(void);
+
 /**
  * @brief Converts given key_name to valid key name (replacing all prohibited characters by _)
  * @param key_name
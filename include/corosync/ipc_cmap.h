@@ -39,6 +39,56 @@
 #include <corosync/corotypes.h>
 #include <corosync/mar_gen.h>
 
+/*
+ * Items of MESSAGE_REQ_CMAP_*_MULTI requests and responses start at multiples
+ * of CMAP_MULTI_ALIGN bytes. One request carries at most CMAP_MULTI_ITEMS_MAX
+ * keys.
+ */
+#define CMAP_MULTI_ALIGN			8
+#define CMAP_MULTI_ITEMS_MAX			1024
+
+/*
+ * Longest value of one key in a multi request, same as the icmap limit
+ */
+#define CMAP_MULTI_VALUE_LEN_MAX		(16*1024)
+
+#define CMAP_MULTI_ALIGNED(len) \
+	(((len) + CMAP_MULTI_ALIGN - 1) & ~((size_t)CMAP_MULTI_ALIGN - 1))
+
+/*
+ * Largest response of MESSAGE_REQ_CMAP_ITER_NEXT_BULK
+ */
+#define CMAP_ITER_BULK_PAGE_MAX			(1024 * 1024)
+
+/*
+ * Length of one record of MESSAGE_RES_CMAP_ITER_NEXT_BULK. Key with trailing
+ * zero and value are each padded to CMAP_MULTI_ALIGN.
+ */
+#define CMAP_ITER_BULK_RECORD_LEN(key_len, value_len) \
+	(sizeof(struct res_lib_cmap_iter_bulk_item) + \
+	 CMAP_MULTI_ALIGNED((key_len) + 1) + CMAP_MULTI_ALIGNED(value_len))
+
+/*
+ * Track type bit of MESSAGE_REQ_CMAP_TRACK_ADD asking for coalesced
+ * notifications, same value as CMAP_TRACK_COALESCE
+ */
+#define CMAP_TRACK_COALESCE_FLAG		16
+
+/*
+ * Largest MESSAGE_RES_CMAP_NOTIFY_BATCH_CALLBACK, fits dispatch buffer of
+ * every client
+ */
+#define CMAP_NOTIFY_BATCH_MAX			(64 * 1024)
+
+/*
+ * Length of one record of MESSAGE_RES_CMAP_NOTIFY_BATCH_CALLBACK. Key with
+ * trailing zero, new value and old value are each padded to CMAP_MULTI_ALIGN.
+ */
+#define CMAP_NOTIFY_BATCH_RECORD_LEN(key_len, new_value_len, old_value_len) \
+	(sizeof(struct res_lib_cmap_notify_batch_item) + \
+	 CMAP_MULTI_ALIGNED((key_len) + 1) + CMAP_MULTI_ALIGNED(new_value_len) + \
+	 CMAP_MULTI_ALIGNED(old_value_len))
+
 /**
  * @brief The req_cmap_types enum
  */
@@ -53,6 +103,10 @@ enum req_cmap_types {
 	MESSAGE_REQ_CMAP_TRACK_ADD = 7,
 	MESSAGE_REQ_CMAP_TRACK_DELETE = 8,
 	MESSAGE_REQ_CMAP_SET_CURRENT_MAP = 9,
+	MESSAGE_REQ_CMAP_GET_MULTI = 10,
+	MESSAGE_REQ_CMAP_SET_MULTI = 11,
+	MESSAGE_REQ_CMAP_DELETE_MULTI = 12,
+	MESSAGE_REQ_CMAP_ITER_NEXT_BULK = 13,
 };
 
 /**
@@ -70,6 +124,11 @@ enum res_cmap_types {
 	MESSAGE_RES_CMAP_TRACK_DELETE = 8,
 	MESSAGE_RES_CMAP_NOTIFY_CALLBACK = 9,
 	MESSAGE_RES_CMAP_SET_CURRENT_MAP = 10,
+	MESSAGE_RES_CMAP_GET_MULTI = 11,
+	MESSAGE_RES_CMAP_SET_MULTI = 12,
+	MESSAGE_RES_CMAP_DELETE_MULTI = 13,
+	MESSAGE_RES_CMAP_ITER_NEXT_BULK = 14,
+	MESSAGE_RES_CMAP_NOTIFY_BATCH_CALLBACK = 15,
 };
 
 enum {
@@ -259,5 +318,153 @@ struct req_lib_cmap_set_current_map {
 	mar_int32_t map __attribute__((aligned(8)));
 };
 
+/**
+ * @brief The req_lib_cmap_get_multi_item struct
+ */
+struct req_lib_cmap_get_multi_item {
+	mar_name_t key_name __attribute__((aligned(8)));
+	mar_size_t value_len __attribute__((aligned(8)));
+};
+
+/**
+ * @brief The req_lib_cmap_get_multi struct
+ */
+struct req_lib_cmap_get_multi {
+	struct qb_ipc_request_header header __attribute__((aligned(8)));
+	mar_uint32_t no_items __attribute__((aligned(8)));
+	struct req_lib_cmap_get_multi_item items[] __attribute__((aligned(8)));
+};
+
+/**
+ * @brief The res_lib_cmap_get_multi_item struct
+ *
+ * Value area of every item is CMAP_MULTI_ALIGNED(value_len) bytes long,
+ * where value_len is the one requested for the key, so position of each
+ * item is known before the response is received.
+ */
+struct res_lib_cmap_get_multi_item {
+	mar_int32_t error __attribute__((aligned(8)));
+	mar_uint8_t type __attribute__((aligned(8)));
+	mar_size_t value_len __attribute__((aligned(8)));
+	mar_uint8_t value[] __attribute__((aligned(8)));
+};
+
+/**
+ * @brief The res_lib_cmap_get_multi struct
+ */
+struct res_lib_cmap_get_multi {
+	struct qb_ipc_response_header header __attribute__((aligned(8)));
+	mar_uint32_t no_items __attribute__((aligned(8)));
+	/*
+	 * Following are no_items res_lib_cmap_get_multi_item
+	 */
+};
+
+/**
+ * @brief The req_lib_cmap_set_multi_item struct
+ *
+ * Followed by CMAP_MULTI_ALIGNED(value_len) bytes of value
+ */
+struct req_lib_cmap_set_multi_item {
+	mar_name_t key_name __attribute__((aligned(8)));
+	mar_size_t value_len __attribute__((aligned(8)));
+	mar_uint8_t type __attribute__((aligned(8)));
+	mar_uint8_t value[] __attribute__((aligned(8)));
+};
+
+/**
+ * @brief The req_lib_cmap_set_multi struct
+ */
+struct req_lib_cmap_set_multi {
+	struct qb_ipc_request_header header __attribute__((aligned(8)));
+	mar_uint32_t no_items __attribute__((aligned(8)));
+	/*
+	 * Following are no_items req_lib_cmap_set_multi_item
+	 */
+};
+
+/**
+ * @brief The req_lib_cmap_delete_multi struct
+ */
+struct req_lib_cmap_delete_multi {
+	struct qb_ipc_request_header header __attribute__((aligned(8)));
+	mar_uint32_t no_items __attribute__((aligned(8)));
+	mar_name_t key_names[] __attribute__((aligned(8)));
+};
+
+/**
+ * @brief The res_lib_cmap_multi struct
+ *
+ * Response to MESSAGE_REQ_CMAP_SET_MULTI and MESSAGE_REQ_CMAP_DELETE_MULTI,
+ * with result of every key
+ */
+struct res_lib_cmap_multi {
+	struct qb_ipc_response_header header __attribute__((aligned(8)));
+	mar_uint32_t no_items __attribute__((aligned(8)));
+	mar_int32_t errors[] __attribute__((aligned(8)));
+};
+
+/**
+ * @brief The req_lib_cmap_iter_next_bulk struct
+ */
+struct req_lib_cmap_iter_next_bulk {
+	struct qb_ipc_request_header header __attribute__((aligned(8)));
+	mar_uint64_t iter_handle __attribute__((aligned(8)));
+	mar_uint64_t page_size __attribute__((aligned(8)));
+};
+
+/**
+ * @brief The res_lib_cmap_iter_bulk_item struct
+ *
+ * data holds key name with trailing zero, value starts at
+ * CMAP_MULTI_ALIGNED(key_len + 1)
+ */
+struct res_lib_cmap_iter_bulk_item {
+	mar_uint32_t key_len __attribute__((aligned(8)));
+	mar_uint8_t type __attribute__((aligned(8)));
+	mar_uint64_t value_len __attribute__((aligned(8)));
+	char data[] __attribute__((aligned(8)));
+};
+
+/**
+ * @brief The res_lib_cmap_iter_next_bulk struct
+ */
+struct res_lib_cmap_iter_next_bulk {
+	struct qb_ipc_response_header header __attribute__((aligned(8)));
+	mar_uint32_t no_items __attribute__((aligned(8)));
+	mar_uint32_t last __attribute__((aligned(8)));
+	/*
+	 * Following are no_items res_lib_cmap_iter_bulk_item records
+	 */
+};
+
+/**
+ * @brief The res_lib_cmap_notify_batch_item struct
+ *
+ * data holds key name with trailing zero, new value starts at
+ * CMAP_MULTI_ALIGNED(key_len + 1) and old value follows new value padded
+ * to CMAP_MULTI_ALIGN
+ */
+struct res_lib_cmap_notify_batch_item {
+	mar_int32_t event __attribute__((aligned(8)));
+	mar_uint32_t key_len __attribute__((aligned(8)));
+	mar_uint8_t new_value_type __attribute__((aligned(8)));
+	mar_uint8_t old_value_type __attribute__((aligned(8)));
+	mar_uint64_t new_value_len __attribute__((aligned(8)));
+	mar_uint64_t old_value_len __attribute__((aligned(8)));
+	char data[] __attribute__((aligned(8)));
+};
+
+/**
+ * @brief The res_lib_cmap_notify_batch_callback struct
+ */
+struct res_lib_cmap_notify_batch_callback {
+	struct qb_ipc_response_header header __attribute__((aligned(8)));
+	mar_uint64_t track_inst_handle __attribute__((aligned(8)));
+	mar_uint32_t no_items __attribute__((aligned(8)));
+	/*
+	 * Following are no_items res_lib_cmap_notify_batch_item records
+	 */
+};
 
 #endif /* IPC_CMAP_H_DEFINED */
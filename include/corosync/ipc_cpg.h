@@ -42,6 +42,37 @@
 
 #define CPG_ZC_PATH_LEN				128
 
+/*
+ * Join flag set by libcpg when the application asked for
+ * MESSAGE_RES_CPG_PACKED_CALLBACK events with CPG_MODEL_V1_PACKED_EVENTS.
+ * Not part of the public cpg_model_v1_data_t flags.
+ */
+#define CPG_JOIN_FLAG_PACKED_EVENTS		0x80000000
+
+/*
+ * A packed event is a qb_ipc_response_header followed by whole dispatch
+ * messages, each starting at a multiple of CPG_PACKED_EVENT_ALIGN bytes.
+ * It is at most CPG_PACKED_EVENT_SIZE_MAX bytes long, so it always fits
+ * into the receive buffer of libcpg.
+ */
+#define CPG_PACKED_EVENT_ALIGN			8
+#define CPG_PACKED_EVENT_SIZE_MAX		(32 * 1024)
+
+/*
+ * Chunks of the receive zero copy pool start at multiples of
+ * CPG_ZCB_RECV_ALIGN bytes, so the released flags written by the library
+ * don't share cache lines with data written by the daemon
+ */
+#define CPG_ZCB_RECV_ALIGN			64
+
+/*
+ * Messages of a MESSAGE_REQ_CPG_MCAST_BATCH request start at multiples of
+ * CPG_MCAST_BATCH_ALIGN bytes. One request carries at most
+ * CPG_MCAST_BATCH_MSGS_MAX messages.
+ */
+#define CPG_MCAST_BATCH_ALIGN			8
+#define CPG_MCAST_BATCH_MSGS_MAX		64
+
 /**
  * @brief The req_cpg_types enum
  */
@@ -59,6 +90,10 @@ enum req_cpg_types {
 	MESSAGE_REQ_CPG_ZC_FREE = 10,
 	MESSAGE_REQ_CPG_ZC_EXECUTE = 11,
 	MESSAGE_REQ_CPG_PARTIAL_MCAST = 12,
+	MESSAGE_REQ_CPG_PARTIAL_MCAST_PIPELINED = 13,
+	MESSAGE_REQ_CPG_ZC_RECV_ENABLE = 14,
+	MESSAGE_REQ_CPG_MCAST_BATCH = 15,
+	MESSAGE_REQ_CPG_MCAST_ASYNC_ENABLE = 16,
 };
 
 /**
@@ -84,6 +119,12 @@ enum res_cpg_types {
 	MESSAGE_RES_CPG_ZC_EXECUTE = 16,
 	MESSAGE_RES_CPG_PARTIAL_DELIVER_CALLBACK = 17,
 	MESSAGE_RES_CPG_PARTIAL_SEND = 18,
+	MESSAGE_RES_CPG_PACKED_CALLBACK = 19,
+	MESSAGE_RES_CPG_ZC_RECV_ENABLE = 20,
+	MESSAGE_RES_CPG_ZC_DELIVER_CALLBACK = 21,
+	MESSAGE_RES_CPG_MCAST_BATCH = 22,
+	MESSAGE_RES_CPG_MCAST_ASYNC_ENABLE = 23,
+	MESSAGE_RES_CPG_MCAST_STATUS_CALLBACK = 24,
 };
 
 /**
@@ -320,6 +361,93 @@ struct req_lib_cpg_partial_mcast {
 	mar_uint8_t message[] __attribute__((aligned(8)));
 };
 
+/**
+ * @brief The req_lib_cpg_partial_mcast_pipelined struct
+ *
+ * Fragments are numbered by seq, which keeps growing over all messages of
+ * the connection, so a fragment is never confused with one of an earlier,
+ * interrupted message. The first fragment sets the expected sequence
+ * number. The library doesn't wait for the response of a fragment before
+ * sending the next one. A fragment out of sequence is refused with
+ * CS_ERR_TRY_AGAIN, so once one fragment is refused, all fragments sent
+ * after it are refused too.
+ */
+struct req_lib_cpg_partial_mcast_pipelined {
+	struct qb_ipc_response_header header __attribute__((aligned(8)));
+	mar_uint32_t guarantee __attribute__((aligned(8)));
+	mar_uint32_t msglen __attribute__((aligned(8)));
+	mar_uint32_t fraglen __attribute__((aligned(8)));
+	mar_uint32_t type __attribute__((aligned(8)));
+	mar_uint32_t seq __attribute__((aligned(8)));
+	mar_uint8_t message[] __attribute__((aligned(8)));
+};
+
+/**
+ * @brief One message of a req_lib_cpg_mcast_batch request
+ */
+struct cpg_mcast_batch_item {
+	mar_uint32_t msglen __attribute__((aligned(8)));
+	mar_uint8_t message[] __attribute__((aligned(8)));
+};
+
+/**
+ * @brief The req_lib_cpg_mcast_batch struct
+ *
+ * Followed by msg_count cpg_mcast_batch_item records. Every message is
+ * delivered on its own, in the order of the records. If totem can't take
+ * the whole batch, the daemon responds with CS_ERR_TRY_AGAIN.
+ */
+struct req_lib_cpg_mcast_batch {
+	struct qb_ipc_request_header header __attribute__((aligned(8)));
+	mar_uint32_t guarantee __attribute__((aligned(8)));
+	mar_uint32_t msg_count __attribute__((aligned(8)));
+	mar_uint8_t items[] __attribute__((aligned(8)));
+};
+
+/**
+ * @brief The res_lib_cpg_mcast_batch struct
+ *
+ * msgs_queued messages from the start of the request were queued, also
+ * when the request failed. Only the rest may be sent again.
+ */
+struct res_lib_cpg_mcast_batch {
+	struct qb_ipc_response_header header __attribute__((aligned(8)));
+	mar_uint32_t msgs_queued __attribute__((aligned(8)));
+};
+
+/**
+ * @brief The req_lib_cpg_mcast_async_enable struct
+ *
+ * Asks the daemon to report completion of MESSAGE_REQ_CPG_MCAST requests
+ * with MESSAGE_RES_CPG_MCAST_STATUS_CALLBACK events. The library keeps at
+ * most window requests in flight.
+ */
+struct req_lib_cpg_mcast_async_enable {
+	struct qb_ipc_request_header header __attribute__((aligned(8)));
+	mar_uint32_t window __attribute__((aligned(8)));
+};
+
+/**
+ * @brief The res_lib_cpg_mcast_async_enable struct
+ */
+struct res_lib_cpg_mcast_async_enable {
+	struct qb_ipc_response_header header __attribute__((aligned(8)));
+};
+
+/**
+ * @brief The res_lib_cpg_mcast_status_callback struct
+ *
+ * completed MESSAGE_REQ_CPG_MCAST requests were processed since the last
+ * status, failed of them were not sent. error is the error of the last
+ * failed one.
+ */
+struct res_lib_cpg_mcast_status_callback {
+	struct qb_ipc_response_header header __attribute__((aligned(8)));
+	mar_uint32_t completed __attribute__((aligned(8)));
+	mar_uint32_t failed __attribute__((aligned(8)));
+	mar_uint32_t error __attribute__((aligned(8)));
+};
+
 /**
  * @brief The res_lib_cpg_mcast struct
  */
@@ -492,6 +620,52 @@ typedef struct {
 	uint64_t server_address __attribute__((aligned(8)));
 } mar_req_coroipcc_zc_execute_t __attribute__((aligned(8)));
 
+/**
+ * @brief The req_lib_cpg_zc_recv_enable struct
+ *
+ * Hands the daemon a mapping of map_size bytes, created by the library,
+ * for deliveries of at least min_size bytes
+ */
+struct req_lib_cpg_zc_recv_enable {
+	struct qb_ipc_request_header header __attribute__((aligned(8)));
+	mar_uint64_t map_size __attribute__((aligned(8)));
+	mar_uint32_t min_size __attribute__((aligned(8)));
+	char path_to_file[CPG_ZC_PATH_LEN] __attribute__((aligned(8)));
+};
+
+/**
+ * @brief The res_lib_cpg_zc_recv_enable struct
+ */
+struct res_lib_cpg_zc_recv_enable {
+	struct qb_ipc_response_header header __attribute__((aligned(8)));
+};
+
+/**
+ * @brief Header of a chunk in the receive zero copy pool
+ *
+ * Written by the daemon when the chunk is allocated. The library sets
+ * released once the application is done with the message, the daemon then
+ * reuses the chunk.
+ */
+struct cpg_zcb_recv_chunk_header {
+	mar_uint32_t released;
+	mar_uint32_t msglen;
+} __attribute__((aligned(8)));
+
+/**
+ * @brief The res_lib_cpg_zc_deliver_callback struct
+ *
+ * Message of msglen bytes is at offset within the receive pool
+ */
+struct res_lib_cpg_zc_deliver_callback {
+	struct qb_ipc_response_header header __attribute__((aligned(8)));
+	mar_cpg_name_t group_name __attribute__((aligned(8)));
+	mar_uint32_t msglen __attribute__((aligned(8)));
+	mar_uint32_t nodeid __attribute__((aligned(8)));
+	mar_uint32_t pid __attribute__((aligned(8)));
+	mar_uint64_t offset __attribute__((aligned(8)));
+};
+
 /**
  * @brief coroipcs_zc_header struct
  */
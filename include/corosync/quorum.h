@@ -119,6 +119,20 @@ cs_error_t quorum_getquorate (
 	quorum_handle_t handle,
 	int *quorate);
 
+/**
+ * @brief Get quorum information from the state page published by corosync.
+ *
+ * Reads the page without asking the daemon. Falls back to
+ * quorum_getquorate if no page is published (system.state_page).
+ *
+ * @param handle
+ * @param quorate
+ * @return
+ */
+cs_error_t quorum_getquorate_fast (
+	quorum_handle_t handle,
+	int *quorate);
+
 /**
  * @brief Track node and quorum changes
  * @param handle
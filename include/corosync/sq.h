@@ -36,20 +36,64 @@
 
 #include <errno.h>
 #include <string.h>
+#include <limits.h>
+
+/**
+ * SQ_BITMAP_BITS is the number of slots tracked by one word of the occupancy
+ *	bitmap.
+ */
+#define SQ_BITMAP_BITS (sizeof (unsigned long) * CHAR_BIT)
+
+/**
+ * SQ_SEGMENT_ITEMS is the number of slots allocated at once.
+ */
+#define SQ_SEGMENT_ITEMS 256
+
+/**
+ * SQ_HOLES_MIN is the initial size of the hole index.
+ */
+#define SQ_HOLES_MIN 16
+
+/**
+ * @brief Range of consecutive sequence numbers missing from the queue
+ */
+struct sq_hole {
+	unsigned int seqid;
+	unsigned int count;
+};
 
 /**
  * @brief The sq struct
+ *
+ * holes is kept sorted by sequence number and lists every gap between
+ * head_seqid and tail_seqid (one past the highest added item), so gaps
+ * can be enumerated without probing every slot of the window.
+ *
+ * items_bitmap has one bit per slot set while the slot holds an item, runs
+ * of present or missing items are found a word at a time.
+ *
+ * Items and their miss counts live in segments of SQ_SEGMENT_ITEMS slots
+ * which are only allocated while the window covers messages. Segments
+ * behind the head are kept on a spare list until sq_shrink, so a busy
+ * queue doesn't go back to malloc on every wrap. mem_allocated counts
+ * every byte held by the queue.
  */
 struct sq {
 	unsigned int head;
 	unsigned int size;
-	void *items;
-	unsigned int *items_inuse;
-	unsigned int *items_miss_count;
+	char **segments;
+	unsigned int segment_entries;
+	void *segments_spare;
+	unsigned long *items_bitmap;
+	size_t mem_allocated;
 	unsigned int size_per_item;
 	unsigned int head_seqid;
 	unsigned int item_count;
 	unsigned int pos_max;
+	unsigned int tail_seqid;
+	struct sq_hole *holes;
+	unsigned int hole_entries;
+	unsigned int hole_entries_max;
 };
 
 /*
@@ -107,10 +151,313 @@ static inline int sq_lte_compare (unsigned int a, unsigned int b) {
 	return (0);
 }
 
+static inline size_t sq_bitmap_size (unsigned int item_count)
+{
+	return (((item_count + SQ_BITMAP_BITS - 1) / SQ_BITMAP_BITS) *
+		sizeof (unsigned long));
+}
+
+static inline unsigned int sq_bitmap_test (
+	const struct sq *sq,
+	unsigned int sq_position)
+{
+	return ((sq->items_bitmap[sq_position / SQ_BITMAP_BITS] >>
+		(sq_position % SQ_BITMAP_BITS)) & 1);
+}
+
+/**
+ * @brief sq_bitmap_clear marks count slots starting at sq_position unused
+ * @param sq
+ * @param sq_position
+ * @param count
+ */
+static inline void sq_bitmap_clear (
+	struct sq *sq,
+	unsigned int sq_position,
+	unsigned int count)
+{
+	unsigned int bits;
+	unsigned long mask;
+
+	while (count > 0) {
+		bits = SQ_BITMAP_BITS - (sq_position % SQ_BITMAP_BITS);
+		if (bits > count) {
+			bits = count;
+		}
+		if (bits == SQ_BITMAP_BITS) {
+			mask = ~0UL;
+		} else {
+			mask = ((1UL << bits) - 1) << (sq_position % SQ_BITMAP_BITS);
+		}
+		sq->items_bitmap[sq_position / SQ_BITMAP_BITS] &= ~mask;
+		sq_position += bits;
+		count -= bits;
+	}
+}
+
+/**
+ * @brief sq_bitmap_any
+ * @param sq
+ * @param sq_position
+ * @param count
+ * @return 1 if any of count slots starting at sq_position holds an item
+ */
+static inline int sq_bitmap_any (
+	const struct sq *sq,
+	unsigned int sq_position,
+	unsigned int count)
+{
+	unsigned int bits;
+	unsigned long mask;
+
+	while (count > 0) {
+		bits = SQ_BITMAP_BITS - (sq_position % SQ_BITMAP_BITS);
+		if (bits > count) {
+			bits = count;
+		}
+		if (bits == SQ_BITMAP_BITS) {
+			mask = ~0UL;
+		} else {
+			mask = ((1UL << bits) - 1) << (sq_position % SQ_BITMAP_BITS);
+		}
+		if (sq->items_bitmap[sq_position / SQ_BITMAP_BITS] & mask) {
+			return (1);
+		}
+		sq_position += bits;
+		count -= bits;
+	}
+	return (0);
+}
+
+static inline unsigned int sq_ctz (unsigned long word)
+{
+#ifdef __GNUC__
+	return (__builtin_ctzl (word));
+#else
+	unsigned int bit = 0;
+
+	while ((word & 1) == 0) {
+		word >>= 1;
+		bit += 1;
+	}
+	return (bit);
+#endif
+}
+
+/**
+ * @brief sq_bitmap_scan finds the first slot whose occupancy equals present
+ * @param sq
+ * @param seq_id first sequence number to check
+ * @param limit maximum number of slots to check
+ * @param present 1 to look for an item, 0 to look for a hole
+ * @return offset of the slot from seq_id, limit if there is none
+ */
+static inline unsigned int sq_bitmap_scan (
+	const struct sq *sq,
+	unsigned int seq_id,
+	unsigned int limit,
+	int present)
+{
+	unsigned int sq_position;
+	unsigned int window;
+	unsigned int offset = 0;
+	unsigned int bits;
+	unsigned long word;
+
+	/*
+	 * Never look past the end of the window, those slots are reused
+	 */
+	window = sq->head_seqid + sq->size - seq_id;
+	if (limit > window) {
+		limit = window;
+	}
+
+	sq_position = (sq->head - sq->head_seqid + seq_id) % sq->size;
+	while (offset < limit) {
+		bits = SQ_BITMAP_BITS - (sq_position % SQ_BITMAP_BITS);
+		if (bits > sq->size - sq_position) {
+			bits = sq->size - sq_position;
+		}
+		word = sq->items_bitmap[sq_position / SQ_BITMAP_BITS];
+		if (present == 0) {
+			word = ~word;
+		}
+		word >>= sq_position % SQ_BITMAP_BITS;
+		if (bits < SQ_BITMAP_BITS) {
+			word &= (1UL << bits) - 1;
+		}
+		if (word != 0) {
+			offset += sq_ctz (word);
+			return (offset < limit ? offset : limit);
+		}
+		offset += bits;
+		sq_position += bits;
+		if (sq_position == sq->size) {
+			sq_position = 0;
+		}
+	}
+	return (limit);
+}
+
+static inline size_t sq_segment_size (const struct sq *sq)
+{
+	return (SQ_SEGMENT_ITEMS * (sq->size_per_item + sizeof (unsigned int)));
+}
+
+static inline char *sq_slot_item (
+	const struct sq *sq,
+	unsigned int sq_position)
+{
+	return (sq->segments[sq_position / SQ_SEGMENT_ITEMS] +
+		(sq_position % SQ_SEGMENT_ITEMS) * sq->size_per_item);
+}
+
+static inline unsigned int *sq_slot_miss_count (
+	const struct sq *sq,
+	unsigned int sq_position)
+{
+	return ((unsigned int *)(sq->segments[sq_position / SQ_SEGMENT_ITEMS] +
+		SQ_SEGMENT_ITEMS * sq->size_per_item) +
+		(sq_position % SQ_SEGMENT_ITEMS));
+}
+
+/**
+ * @brief sq_segment_alloc makes sure the segment holding a slot exists
+ * @param sq
+ * @param sq_position
+ * @return the segment, NULL if it could not be allocated
+ */
+static inline char *sq_segment_alloc (
+	struct sq *sq,
+	unsigned int sq_position)
+{
+	unsigned int segment = sq_position / SQ_SEGMENT_ITEMS;
+	char *seg;
+
+	if (sq->segments[segment] != NULL) {
+		return (sq->segments[segment]);
+	}
+
+	if (sq->segments_spare != NULL) {
+		seg = sq->segments_spare;
+		sq->segments_spare = *(void **)seg;
+	} else {
+		seg = malloc (sq_segment_size (sq));
+		if (seg == NULL) {
+			return (NULL);
+		}
+		sq->mem_allocated += sq_segment_size (sq);
+	}
+	memset (seg, 0, sq_segment_size (sq));
+	sq->segments[segment] = seg;
+
+	return (seg);
+}
+
+static inline void sq_segment_release (
+	struct sq *sq,
+	unsigned int segment)
+{
+	char *seg = sq->segments[segment];
+
+	if (seg == NULL) {
+		return;
+	}
+	*(void **)seg = sq->segments_spare;
+	sq->segments_spare = seg;
+	sq->segments[segment] = NULL;
+}
+
+/**
+ * @brief sq_segments_release moves empty segments ending inside a range of
+ *	released slots to the spare list
+ * @param sq
+ * @param sq_position
+ * @param count
+ *
+ * Slots of the first segment in front of sq_position were released by
+ * earlier calls.
+ */
+static inline void sq_segments_release (
+	struct sq *sq,
+	unsigned int sq_position,
+	unsigned int count)
+{
+	unsigned int segment;
+	unsigned int segment_start;
+	unsigned int segment_end;
+
+	for (segment = sq_position / SQ_SEGMENT_ITEMS;
+		segment < sq->segment_entries; segment++) {
+
+		segment_start = segment * SQ_SEGMENT_ITEMS;
+		segment_end = segment_start + SQ_SEGMENT_ITEMS;
+		if (segment_end > sq->size) {
+			segment_end = sq->size;
+		}
+		if (segment_end > sq_position + count) {
+			break;
+		}
+		if (sq->segments[segment] == NULL ||
+			sq_bitmap_any (sq, segment_start, segment_end - segment_start)) {
+			continue;
+		}
+		sq_segment_release (sq, segment);
+	}
+}
+
+static inline void sq_miss_count_clear (
+	struct sq *sq,
+	unsigned int sq_position,
+	unsigned int count)
+{
+	unsigned int i;
+
+	for (i = 0; i < count; i++, sq_position++) {
+		if (sq->segments[sq_position / SQ_SEGMENT_ITEMS] != NULL) {
+			*sq_slot_miss_count (sq, sq_position) = 0;
+		}
+	}
+}
+
+/**
+ * @brief sq_holes_reserve makes room for one more hole
+ * @param sq
+ * @param hole_entries
+ * @return 0 on success, -ENOMEM otherwise
+ */
+static inline int sq_holes_reserve (
+	struct sq *sq,
+	unsigned int hole_entries)
+{
+	struct sq_hole *holes;
+	unsigned int hole_entries_max;
+
+	if (hole_entries <= sq->hole_entries_max) {
+		return (0);
+	}
+
+	hole_entries_max = sq->hole_entries_max;
+	while (hole_entries_max < hole_entries) {
+		hole_entries_max *= 2;
+	}
+
+	holes = realloc (sq->holes, hole_entries_max * sizeof (struct sq_hole));
+	if (holes == NULL) {
+		return (-ENOMEM);
+	}
+	sq->mem_allocated += (hole_entries_max - sq->hole_entries_max) *
+		sizeof (struct sq_hole);
+	sq->holes = holes;
+	sq->hole_entries_max = hole_entries_max;
+
+	return (0);
+}
+
 /**
  * @brief sq_init
  * @param sq
- * @param item_count
+ * @param item_count maximum number of items in the window
  * @param size_per_item
  * @param head_seqid
  * @return
@@ -127,23 +474,37 @@ static inline int sq_init (
 	sq->head_seqid = head_seqid;
 	sq->item_count = item_count;
 	sq->pos_max = 0;
-
-	sq->items = malloc (item_count * size_per_item);
-	if (sq->items == NULL) {
+	sq->tail_seqid = head_seqid;
+	sq->hole_entries = 0;
+	sq->segments_spare = NULL;
+	sq->segment_entries = (item_count + SQ_SEGMENT_ITEMS - 1) / SQ_SEGMENT_ITEMS;
+
+	sq->hole_entries_max = SQ_HOLES_MIN;
+	sq->holes = malloc (sq->hole_entries_max * sizeof (struct sq_hole));
+	if (sq->holes == NULL) {
 		return (-ENOMEM);
 	}
-	memset (sq->items, 0, item_count * size_per_item);
 
-	if ((sq->items_inuse = malloc (item_count * sizeof (unsigned int)))
-	    == NULL) {
+	sq->segments = calloc (sq->segment_entries, sizeof (char *));
+	if (sq->segments == NULL) {
+		free (sq->holes);
+		sq->holes = NULL;
 		return (-ENOMEM);
 	}
-	if ((sq->items_miss_count = malloc (item_count * sizeof (unsigned int)))
+
+	if ((sq->items_bitmap = malloc (sq_bitmap_size (item_count)))
 	    == NULL) {
+		free (sq->segments);
+		sq->segments = NULL;
+		free (sq->holes);
+		sq->holes = NULL;
 		return (-ENOMEM);
 	}
-	memset (sq->items_inuse, 0, item_count * sizeof (unsigned int));
-	memset (sq->items_miss_count, 0, item_count * sizeof (unsigned int));
+	memset (sq->items_bitmap, 0, sq_bitmap_size (item_count));
+
+	sq->mem_allocated = sq->hole_entries_max * sizeof (struct sq_hole) +
+		sq->segment_entries * sizeof (char *) +
+		sq_bitmap_size (item_count);
 	return (0);
 }
 
@@ -154,13 +515,56 @@ static inline int sq_init (
  */
 static inline void sq_reinit (struct sq *sq, unsigned int head_seqid)
 {
+	unsigned int i;
+
 	sq->head = 0;
 	sq->head_seqid = head_seqid;
 	sq->pos_max = 0;
+	sq->tail_seqid = head_seqid;
+	sq->hole_entries = 0;
 
-	memset (sq->items, 0, sq->item_count * sq->size_per_item);
-	memset (sq->items_inuse, 0, sq->item_count * sizeof (unsigned int));
-	memset (sq->items_miss_count, 0, sq->item_count * sizeof (unsigned int));
+	for (i = 0; i < sq->segment_entries; i++) {
+		sq_segment_release (sq, i);
+	}
+	memset (sq->items_bitmap, 0, sq_bitmap_size (sq->item_count));
+}
+
+/**
+ * @brief sq_shrink frees spare segments and an oversized hole index
+ * @param sq
+ */
+static inline void sq_shrink (struct sq *sq)
+{
+	struct sq_hole *holes;
+	void *seg;
+
+	while ((seg = sq->segments_spare) != NULL) {
+		sq->segments_spare = *(void **)seg;
+		free (seg);
+		sq->mem_allocated -= sq_segment_size (sq);
+	}
+
+	if (sq->hole_entries_max > SQ_HOLES_MIN &&
+		sq->hole_entries <= SQ_HOLES_MIN) {
+
+		holes = realloc (sq->holes, SQ_HOLES_MIN * sizeof (struct sq_hole));
+		if (holes != NULL) {
+			sq->mem_allocated -= (sq->hole_entries_max - SQ_HOLES_MIN) *
+				sizeof (struct sq_hole);
+			sq->holes = holes;
+			sq->hole_entries_max = SQ_HOLES_MIN;
+		}
+	}
+}
+
+/**
+ * @brief sq_mem_get
+ * @param sq
+ * @return number of bytes allocated by the queue
+ */
+static inline size_t sq_mem_get (const struct sq *sq)
+{
+	return (sq->mem_allocated);
 }
 
 /**
@@ -175,7 +579,7 @@ static inline void sq_assert (const struct sq *sq, unsigned int pos)
 //	printf ("Instrument[%d] Asserting from %d to %d\n",
 //		pos, sq->pos_max, sq->size);
 	for (i = sq->pos_max + 1; i < sq->size; i++) {
-		assert (sq->items_inuse[i] == 0);
+		assert (sq_bitmap_test (sq, i) == 0);
 	}
 }
 
@@ -186,19 +590,35 @@ static inline void sq_assert (const struct sq *sq, unsigned int pos)
  */
 static inline void sq_copy (struct sq *sq_dest, const struct sq *sq_src)
 {
+	unsigned int i;
+	int res;
+
 	sq_assert (sq_src, 20);
+	assert (sq_dest->segment_entries == sq_src->segment_entries);
+	assert (sq_dest->size_per_item == sq_src->size_per_item);
 	sq_dest->head = sq_src->head;
 	sq_dest->size = sq_src->item_count;
-	sq_dest->size_per_item = sq_src->size_per_item;
 	sq_dest->head_seqid = sq_src->head_seqid;
 	sq_dest->item_count = sq_src->item_count;
 	sq_dest->pos_max = sq_src->pos_max;
-	memcpy (sq_dest->items, sq_src->items,
-		sq_src->item_count * sq_src->size_per_item);
-	memcpy (sq_dest->items_inuse, sq_src->items_inuse,
-		sq_src->item_count * sizeof (unsigned int));
-	memcpy (sq_dest->items_miss_count, sq_src->items_miss_count,
-		sq_src->item_count * sizeof (unsigned int));
+	sq_dest->tail_seqid = sq_src->tail_seqid;
+	res = sq_holes_reserve (sq_dest, sq_src->hole_entries);
+	assert (res == 0);
+	sq_dest->hole_entries = sq_src->hole_entries;
+	memcpy (sq_dest->holes, sq_src->holes,
+		sq_src->hole_entries * sizeof (struct sq_hole));
+	for (i = 0; i < sq_src->segment_entries; i++) {
+		if (sq_src->segments[i] == NULL) {
+			sq_segment_release (sq_dest, i);
+			continue;
+		}
+		sq_segment_alloc (sq_dest, i * SQ_SEGMENT_ITEMS);
+		assert (sq_dest->segments[i] != NULL);
+		memcpy (sq_dest->segments[i], sq_src->segments[i],
+			sq_segment_size (sq_src));
+	}
+	memcpy (sq_dest->items_bitmap, sq_src->items_bitmap,
+		sq_bitmap_size (sq_src->item_count));
 }
 
 /**
@@ -206,9 +626,97 @@ static inline void sq_copy (struct sq *sq_dest, const struct sq *sq_src)
  * @param sq
  */
 static inline void sq_free (struct sq *sq) {
-	free (sq->items);
-	free (sq->items_inuse);
-	free (sq->items_miss_count);
+	unsigned int i;
+
+	for (i = 0; i < sq->segment_entries; i++) {
+		sq_segment_release (sq, i);
+	}
+	sq_shrink (sq);
+	free (sq->segments);
+	free (sq->items_bitmap);
+	free (sq->holes);
+}
+
+/**
+ * @brief sq_hole_fill removes seqid from the hole index
+ * @param sq
+ * @param seqid
+ */
+static inline void sq_hole_fill (struct sq *sq, unsigned int seqid)
+{
+	struct sq_hole *hole;
+	unsigned int offset;
+	unsigned int hole_offset;
+	unsigned int low = 0;
+	unsigned int high = sq->hole_entries;
+	unsigned int mid;
+
+	offset = seqid - sq->head_seqid;
+
+	/*
+	 * Find the last hole starting at or before seqid
+	 */
+	while (low < high) {
+		mid = (low + high) / 2;
+		if (sq->holes[mid].seqid - sq->head_seqid <= offset) {
+			low = mid + 1;
+		} else {
+			high = mid;
+		}
+	}
+	if (low == 0) {
+		return;
+	}
+	hole = &sq->holes[low - 1];
+	hole_offset = offset - (hole->seqid - sq->head_seqid);
+	if (hole_offset >= hole->count) {
+		return;
+	}
+
+	if (hole->count == 1) {
+		memmove (hole, hole + 1,
+			(sq->hole_entries - low) * sizeof (struct sq_hole));
+		sq->hole_entries -= 1;
+	} else
+	if (hole_offset == 0) {
+		hole->seqid += 1;
+		hole->count -= 1;
+	} else
+	if (hole_offset == hole->count - 1) {
+		hole->count -= 1;
+	} else {
+		assert (sq->hole_entries < sq->hole_entries_max);
+		memmove (hole + 2, hole + 1,
+			(sq->hole_entries - low) * sizeof (struct sq_hole));
+		sq->hole_entries += 1;
+		hole[1].seqid = seqid + 1;
+		hole[1].count = hole->count - hole_offset - 1;
+		hole->count = hole_offset;
+	}
+}
+
+/**
+ * @brief sq_holes_get returns the gaps between head and the highest item
+ * @param sq
+ * @param holes set to the sorted hole array
+ * @return number of holes
+ */
+static inline unsigned int sq_holes_get (
+	const struct sq *sq,
+	const struct sq_hole **holes)
+{
+	*holes = sq->holes;
+	return (sq->hole_entries);
+}
+
+/**
+ * @brief sq_tail_get
+ * @param sq
+ * @return sequence number following the highest item added
+ */
+static inline unsigned int sq_tail_get (const struct sq *sq)
+{
+	return (sq->tail_seqid);
 }
 
 /**
@@ -227,20 +735,44 @@ static inline void *sq_item_add (
 	unsigned int sq_position;
 
 	sq_position = (sq->head + seqid - sq->head_seqid) % sq->size;
+
+	/*
+	 * Adding an item creates at most one more hole. If memory can't be
+	 * allocated the item isn't stored and is retransmitted later.
+	 */
+	if (sq_segment_alloc (sq, sq_position) == NULL ||
+		sq_holes_reserve (sq, sq->hole_entries + 1) != 0) {
+		return (NULL);
+	}
+
 	if (sq_position > sq->pos_max) {
 		sq->pos_max = sq_position;
 	}
 
-	sq_item = sq->items;
-	sq_item += sq_position * sq->size_per_item;
-	assert(sq->items_inuse[sq_position] == 0);
+	sq_item = sq_slot_item (sq, sq_position);
+	assert(sq_bitmap_test (sq, sq_position) == 0);
 	memcpy (sq_item, item, sq->size_per_item);
-	if (seqid == 0) {
-		sq->items_inuse[sq_position] = 1;
+	sq->items_bitmap[sq_position / SQ_BITMAP_BITS] |=
+		1UL << (sq_position % SQ_BITMAP_BITS);
+	*sq_slot_miss_count (sq, sq_position) = 0;
+
+	/*
+	 * Items outside of the window are not indexed
+	 */
+	if (seqid - sq->head_seqid >= sq->size) {
+		return (sq_item);
+	}
+	if (seqid - sq->head_seqid >= sq->tail_seqid - sq->head_seqid) {
+		if (seqid != sq->tail_seqid) {
+			assert (sq->hole_entries < sq->hole_entries_max);
+			sq->holes[sq->hole_entries].seqid = sq->tail_seqid;
+			sq->holes[sq->hole_entries].count = seqid - sq->tail_seqid;
+			sq->hole_entries += 1;
+		}
+		sq->tail_seqid = seqid + 1;
 	} else {
-		sq->items_inuse[sq_position] = seqid;
+		sq_hole_fill (sq, seqid);
 	}
-	sq->items_miss_count[sq_position] = 0;
 
 	return (sq_item);
 }
@@ -270,7 +802,7 @@ static inline unsigned int sq_item_inuse (
 	}
 #endif
 	sq_position = (sq->head - sq->head_seqid + seq_id) % sq->size;
-	return (sq->items_inuse[sq_position] != 0);
+	return (sq_bitmap_test (sq, sq_position));
 }
 
 /**
@@ -280,14 +812,22 @@ static inline unsigned int sq_item_inuse (
  * @return
  */
 static inline unsigned int sq_item_miss_count (
-	const struct sq *sq,
+	struct sq *sq,
 	unsigned int seq_id)
 {
 	unsigned int sq_position;
+	unsigned int *miss_count;
 
 	sq_position = (sq->head - sq->head_seqid + seq_id) % sq->size;
-	sq->items_miss_count[sq_position]++;
-	return (sq->items_miss_count[sq_position]);
+	if (sq_segment_alloc (sq, sq_position) == NULL) {
+		/*
+		 * Without memory to count, ask for the message right away
+		 */
+		return (UINT_MAX);
+	}
+	miss_count = sq_slot_miss_count (sq, sq_position);
+	*miss_count += 1;
+	return (*miss_count);
 }
 
 /**
@@ -365,15 +905,44 @@ static inline unsigned int sq_item_get (
 //	sq_position = (sq->head - sq->head_seqid + seq_id) % sq->size;
 //printf ("sq_position = %x\n", sq_position);
 //printf ("ITEMGET %d %d %d %d\n", sq_position, sq->head, sq->head_seqid, seq_id);
-	if (sq->items_inuse[sq_position] == 0) {
+	if (sq_bitmap_test (sq, sq_position) == 0) {
 		return (ENOENT);
 	}
-	sq_item = sq->items;
-	sq_item += sq_position * sq->size_per_item;
+	sq_item = sq_slot_item (sq, sq_position);
 	*sq_item_out = sq_item;
 	return (0);
 }
 
+/**
+ * @brief sq_next_hole
+ * @param sq
+ * @param seq_id
+ * @param limit
+ * @return number of items present in a row starting at seq_id, at most limit
+ */
+static inline unsigned int sq_next_hole (
+	const struct sq *sq,
+	unsigned int seq_id,
+	unsigned int limit)
+{
+	return (sq_bitmap_scan (sq, seq_id, limit, 0));
+}
+
+/**
+ * @brief sq_next_present
+ * @param sq
+ * @param seq_id
+ * @param limit
+ * @return number of items missing in a row starting at seq_id, at most limit
+ */
+static inline unsigned int sq_next_present (
+	const struct sq *sq,
+	unsigned int seq_id,
+	unsigned int limit)
+{
+	return (sq_bitmap_scan (sq, seq_id, limit, 1));
+}
+
 /**
  * @brief sq_items_release
  * @param sq
@@ -382,21 +951,46 @@ static inline unsigned int sq_item_get (
 static inline void sq_items_release (struct sq *sq, unsigned int seqid)
 {
 	unsigned int oldhead;
+	unsigned int released;
+	unsigned int hole_end;
+	unsigned int i;
 
 	oldhead = sq->head;
 
+	/*
+	 * Drop holes below the new head
+	 */
+	released = seqid - sq->head_seqid + 1;
+	for (i = 0; i < sq->hole_entries; i++) {
+		hole_end = sq->holes[i].seqid - sq->head_seqid + sq->holes[i].count;
+		if (hole_end > released) {
+			if (sq->holes[i].seqid - sq->head_seqid < released) {
+				sq->holes[i].count = hole_end - released;
+				sq->holes[i].seqid = seqid + 1;
+			}
+			break;
+		}
+	}
+	sq->hole_entries -= i;
+	memmove (sq->holes, &sq->holes[i],
+		sq->hole_entries * sizeof (struct sq_hole));
+	if (sq->tail_seqid - sq->head_seqid < released) {
+		sq->tail_seqid = seqid + 1;
+	}
+
 	sq->head = (sq->head + seqid - sq->head_seqid + 1) % sq->size;
 	if ((oldhead + seqid - sq->head_seqid + 1) > sq->size) {
 //		printf ("releasing %d for %d\n", oldhead, sq->size - oldhead);
 //		printf ("releasing %d for %d\n", 0, sq->head);
-		memset (&sq->items_inuse[oldhead], 0, (sq->size - oldhead) * sizeof (unsigned int));
-		memset (sq->items_inuse, 0, sq->head * sizeof (unsigned int));
+		sq_bitmap_clear (sq, oldhead, sq->size - oldhead);
+		sq_bitmap_clear (sq, 0, sq->head);
+		sq_segments_release (sq, oldhead, sq->size - oldhead);
+		sq_segments_release (sq, 0, sq->head);
 	} else {
 //		printf ("releasing %d for %d\n", oldhead, seqid - sq->head_seqid + 1);
-		memset (&sq->items_inuse[oldhead], 0,
-			(seqid - sq->head_seqid + 1) * sizeof (unsigned int));
-		memset (&sq->items_miss_count[oldhead], 0,
-			(seqid - sq->head_seqid + 1) * sizeof (unsigned int));
+		sq_bitmap_clear (sq, oldhead, seqid - sq->head_seqid + 1);
+		sq_miss_count_clear (sq, oldhead, seqid - sq->head_seqid + 1);
+		sq_segments_release (sq, oldhead, seqid - sq->head_seqid + 1);
 	}
 	sq->head_seqid = seqid + 1;
 }
@@ -0,0 +1,282 @@
+/*
+ * Copyright (c) 2026 Red Hat, Inc.
+ *
+ * All rights reserved.
+ *
+ * This software licensed under BSD license, the text of which follows:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ * - Neither the name of the MontaVista Software, Inc. nor the names of its
+ *   contributors may be used to endorse or promote products derived from this
+ *   software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ * THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef COROSYNC_STATEPAGE_H_DEFINED
+#define COROSYNC_STATEPAGE_H_DEFINED
+
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/*
+ * Cluster state published by corosync in a read only shared memory page
+ * (system.state_page), so clients can read quorum and membership without
+ * an IPC round trip.
+ *
+ * The seqlocked part is written by the daemon main loop only. seq is odd
+ * while it is being updated, readers copy what they need and retry when seq
+ * changed meanwhile. Counters and the heartbeat are updated with plain
+ * atomic stores outside of the seqlock.
+ *
+ * The daemon refreshes heartbeat_ms (CLOCK_MONOTONIC) every
+ * CS_STATE_PAGE_HEARTBEAT_MS. A page with an older heartbeat than
+ * CS_STATE_PAGE_STALE_MS, or marked obsolete by an exiting or restarting
+ * daemon, must not be trusted, clients then ask the daemon over IPC.
+ *
+ * The page lives in the root owned run directory, not in world writable
+ * /dev/shm, so other local users can't plant a page of their own. It is
+ * only used if it is a regular file owned by root and not writable by
+ * anybody else.
+ */
+#define CS_STATE_PAGE_PATH		LOCALSTATEDIR"/run/corosync-state"
+#define CS_STATE_PAGE_MAGIC		0x43535350
+#define CS_STATE_PAGE_VERSION		1
+#define CS_STATE_PAGE_NODES_MAX		384
+#define CS_STATE_PAGE_QDEVICE_NAME_LEN	256
+#define CS_STATE_PAGE_HEARTBEAT_MS	1000
+#define CS_STATE_PAGE_STALE_MS		(3 * CS_STATE_PAGE_HEARTBEAT_MS)
+#define CS_STATE_PAGE_READ_TRIES	1000
+
+/*
+ * Same content as the votequorum getinfo response for the node
+ */
+struct cs_state_page_vq_node {
+	uint32_t nodeid;
+	uint32_t state;
+	uint32_t votes;
+	uint32_t expected_votes;
+	uint32_t highest_expected;
+	uint32_t total_votes;
+	uint32_t quorum;
+	uint32_t flags;
+};
+
+struct cs_state_page {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t size;
+	uint32_t obsolete;
+	uint64_t heartbeat_ms;
+
+	/*
+	 * Counters, not covered by seq
+	 */
+	uint64_t membership_changes;
+	uint64_t cpg_groups;
+
+	uint32_t seq;
+	uint32_t local_nodeid;
+
+	/*
+	 * Totem membership, set on every regular configuration change
+	 */
+	uint64_t ring_seq;
+	uint32_t ring_rep;
+	uint32_t member_list_entries;
+	uint32_t member_list[CS_STATE_PAGE_NODES_MAX];
+
+	/*
+	 * Quorum service view
+	 */
+	uint32_t quorum_valid;
+	uint32_t quorate;
+
+	/*
+	 * votequorum, vq_valid is set when votequorum is the quorum provider
+	 */
+	uint32_t vq_valid;
+	uint32_t vq_qdevice_votes;
+	char vq_qdevice_name[CS_STATE_PAGE_QDEVICE_NAME_LEN];
+	uint32_t vq_node_entries;
+	struct cs_state_page_vq_node vq_nodes[CS_STATE_PAGE_NODES_MAX];
+};
+
+static inline uint64_t cs_state_page_now_ms (void)
+{
+	struct timespec ts;
+
+	clock_gettime (CLOCK_MONOTONIC, &ts);
+	return ((uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000);
+}
+
+/*
+ * Returns 1 if the opened page file can be trusted to come from the daemon
+ */
+static inline int cs_state_page_file_trusted (const struct stat *st)
+{
+	return (S_ISREG (st->st_mode) && st->st_uid == 0 &&
+	    (st->st_mode & (S_IWGRP | S_IWOTH)) == 0);
+}
+
+/*
+ * Map the page published by the daemon. Returns NULL if there is none or
+ * it has another layout.
+ */
+static inline const struct cs_state_page *cs_state_page_map (void)
+{
+	struct cs_state_page *page;
+	struct stat st;
+	int fd;
+
+	fd = open (CS_STATE_PAGE_PATH, O_RDONLY | O_NOFOLLOW | O_CLOEXEC);
+	if (fd == -1) {
+		return (NULL);
+	}
+	if (fstat (fd, &st) == -1 || !cs_state_page_file_trusted (&st) ||
+	    st.st_size < (off_t)sizeof (struct cs_state_page)) {
+		close (fd);
+		return (NULL);
+	}
+	page = mmap (NULL, sizeof (struct cs_state_page), PROT_READ, MAP_SHARED, fd, 0);
+	close (fd);
+	if (page == MAP_FAILED) {
+		return (NULL);
+	}
+
+	if (page->magic != CS_STATE_PAGE_MAGIC ||
+	    page->version != CS_STATE_PAGE_VERSION ||
+	    page->size != sizeof (struct cs_state_page)) {
+		munmap (page, sizeof (struct cs_state_page));
+		return (NULL);
+	}
+
+	return (page);
+}
+
+/*
+ * Marks a handle which found no page, it is created before the daemon
+ * accepts connections, so there is no point in looking again
+ */
+#define CS_STATE_PAGE_NONE		((const struct cs_state_page *)MAP_FAILED)
+
+static inline void cs_state_page_unmap (const struct cs_state_page *page)
+{
+	if (page != NULL && page != CS_STATE_PAGE_NONE) {
+		munmap ((void *)page, sizeof (struct cs_state_page));
+	}
+}
+
+/*
+ * Mapping of a library handle, made on first use. A handle doesn't outlive
+ * the daemon it is connected to, so the mapping is never replaced and
+ * concurrent callers only race to install it. Returns NULL if there is no
+ * page.
+ */
+static inline const struct cs_state_page *cs_state_page_get (
+	const struct cs_state_page **pagep)
+{
+	const struct cs_state_page *page;
+	const struct cs_state_page *expected = NULL;
+
+	page = __atomic_load_n (pagep, __ATOMIC_ACQUIRE);
+	if (page == NULL) {
+		page = cs_state_page_map ();
+		if (page == NULL) {
+			page = CS_STATE_PAGE_NONE;
+		}
+		if (!__atomic_compare_exchange_n (pagep, &expected, page, 0,
+			__ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+
+			cs_state_page_unmap (page);
+			page = expected;
+		}
+	}
+
+	return (page == CS_STATE_PAGE_NONE ? NULL : page);
+}
+
+/*
+ * Returns 1 when the page can be used, 0 if it was left behind by a
+ * daemon which is gone
+ */
+static inline int cs_state_page_valid (const struct cs_state_page *page)
+{
+	uint64_t heartbeat_ms;
+
+	if (__atomic_load_n (&page->obsolete, __ATOMIC_ACQUIRE)) {
+		return (0);
+	}
+	heartbeat_ms = __atomic_load_n (&page->heartbeat_ms, __ATOMIC_ACQUIRE);
+	return (cs_state_page_now_ms () - heartbeat_ms < CS_STATE_PAGE_STALE_MS);
+}
+
+/*
+ * Seqlock read side. Data read between cs_state_page_read_begin and
+ * cs_state_page_read_retry is consistent if the latter returns 0. An odd
+ * sequence number means the daemon is writing, the read must be retried.
+ */
+static inline uint32_t cs_state_page_read_begin (const struct cs_state_page *page)
+{
+	return (__atomic_load_n (&page->seq, __ATOMIC_ACQUIRE));
+}
+
+static inline int cs_state_page_read_retry (
+	const struct cs_state_page *page,
+	uint32_t seq)
+{
+	__atomic_thread_fence (__ATOMIC_ACQUIRE);
+	return ((seq & 1) || __atomic_load_n (&page->seq, __ATOMIC_RELAXED) != seq);
+}
+
+/*
+ * Copy len bytes at offset of the seqlocked part of the page into dst.
+ * Returns 0 on success, -1 if the page is not valid or no consistent copy
+ * could be made.
+ */
+static inline int cs_state_page_read (
+	const struct cs_state_page *page,
+	size_t offset,
+	size_t len,
+	void *dst)
+{
+	uint32_t seq;
+	unsigned int i;
+
+	if (!cs_state_page_valid (page)) {
+		return (-1);
+	}
+
+	for (i = 0; i < CS_STATE_PAGE_READ_TRIES; i++) {
+		seq = cs_state_page_read_begin (page);
+		memcpy (dst, (const char *)page + offset, len);
+		if (!cs_state_page_read_retry (page, seq)) {
+			return (0);
+		}
+	}
+
+	return (-1);
+}
+
+#endif /* COROSYNC_STATEPAGE_H_DEFINED */
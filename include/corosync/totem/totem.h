@@ -121,6 +121,12 @@ struct totem_logging_configuration {
 #define TOTEM_MH_MAGIC		0xC070
 #define TOTEM_MH_VERSION	0x03
 
+/*
+ * orf_token carrying range encoded retransmit requests. Only used on rings
+ * where every member announced support for it in its join messages.
+ */
+#define TOTEM_MH_VERSION_RTR_RANGE	0x04
+
 struct totem_message_header {
 	unsigned short magic;
 	char version;
@@ -235,6 +241,12 @@ struct totem_config {
 
 	unsigned int block_unlisted_ips;
 
+	unsigned int frame_pool_low_watermark;
+
+	unsigned int frame_pool_high_watermark;
+
+	unsigned int frame_pool_prefault;
+
 	void (*totem_memb_ring_id_create_or_load) (
 	    struct memb_ring_id *memb_ring_id,
 	    unsigned int nodeid);
@@ -115,6 +115,13 @@ extern int totempg_groups_mcast_joined (
 	unsigned int iov_len,
 	int guarantee);
 
+extern int totempg_groups_mcast_joined_multi (
+	void *instance,
+	const struct iovec *iovec,
+	const unsigned int *iov_lens,
+	unsigned int msg_count,
+	int guarantee);
+
 extern int totempg_groups_joined_reserve (
 	void *instance,
 	const struct iovec *iovec,
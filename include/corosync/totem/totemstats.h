@@ -50,6 +50,32 @@ typedef struct {
 	int backlog_calc;
 } totemsrp_token_stats_t;
 
+/*
+ * Log-linear latency histogram, values are in microseconds. Every power of
+ * two is split into 1 << TOTEM_HIST_SUB_BUCKET_BITS linear buckets, so the
+ * relative error of a reported value is below 1/16.
+ */
+#define TOTEM_HIST_SUB_BUCKET_BITS 4
+#define TOTEM_HIST_BUCKETS ((33 - TOTEM_HIST_SUB_BUCKET_BITS) << TOTEM_HIST_SUB_BUCKET_BITS)
+
+typedef struct {
+	uint64_t count;
+	uint64_t sum;
+	uint32_t min;
+	uint32_t max;
+	uint64_t buckets[TOTEM_HIST_BUCKETS];
+} totem_hist_t;
+
+enum totem_hist_type {
+	TOTEM_HIST_TOKEN_ROTATION,
+	TOTEM_HIST_TOKEN_HOLD,
+	TOTEM_HIST_ORF_TOKEN_RTR,
+	TOTEM_HIST_ORF_TOKEN_MCAST,
+	TOTEM_HIST_DELIVER_TO_APP,
+	TOTEM_HIST_TOKEN_SEND,
+	TOTEM_HIST_MAX
+};
+
 typedef struct {
 	totem_stats_header_t hdr;
 	uint64_t orf_token_tx;
@@ -61,6 +87,8 @@ typedef struct {
 	uint64_t mcast_tx;
 	uint64_t mcast_retx;
 	uint64_t mcast_rx;
+	uint64_t mcast_tx_frames_copied;
+	uint64_t mcast_tx_frames_zerocopy;
 	uint64_t memb_commit_token_tx;
 	uint64_t memb_commit_token_rx;
 	uint64_t token_hold_cancel_tx;
@@ -75,6 +103,14 @@ typedef struct {
 	uint64_t recovery_token_lost;
 	uint64_t consensus_timeouts;
 	uint64_t rx_msg_dropped;
+	uint64_t recv_batches;
+	uint64_t recv_batch_frames;
+	uint32_t recv_batch_max;
+	uint64_t frame_pool_hits;
+	uint64_t frame_pool_misses;
+	uint32_t frame_pool_high_water;
+	uint64_t queue_mem;
+	uint64_t queue_mem_peak;
 	uint32_t continuous_gather;
 	uint32_t continuous_sendmsg_failures;
 	uint64_t time_since_token_last_received; // relative time
@@ -89,6 +125,8 @@ typedef struct {
 #define TOTEM_TOKEN_STATS_MAX 100
 	totemsrp_token_stats_t token[TOTEM_TOKEN_STATS_MAX];
 
+	totem_hist_t hist[TOTEM_HIST_MAX];
+
 } totemsrp_stats_t;
 
 typedef struct {
@@ -96,6 +134,8 @@ typedef struct {
 	totemsrp_stats_t *srp;
 	uint32_t msg_reserved;
 	uint32_t msg_queue_avail;
+	uint64_t deliver_zerocopy;
+	uint64_t deliver_copied;
 } totempg_stats_t;
 
 
@@ -188,6 +188,23 @@ cs_error_t votequorum_getinfo (
 	unsigned int nodeid,
 	struct votequorum_info *info);
 
+/**
+ * @brief Get quorum information from the state page published by corosync.
+ *
+ * Same as votequorum_getinfo, but reads the page without asking the
+ * daemon. Falls back to votequorum_getinfo if no page is published
+ * (system.state_page).
+ *
+ * @param handle
+ * @param nodeid
+ * @param info
+ * @return
+ */
+cs_error_t votequorum_getinfo_fast (
+	votequorum_handle_t handle,
+	unsigned int nodeid,
+	struct votequorum_info *info);
+
 /**
  * @brief set expected_votes
  * @param handle
@@ -62,6 +62,7 @@ struct cmap_inst {
 struct cmap_track_inst {
 	void *user_data;
 	cmap_notify_fn_t notify_fn;
+	cmap_notify_batch_fn_t notify_batch_fn;
 	qb_ipcc_connection_t *c;
 	cmap_track_handle_t track_handle;
 };
@@ -83,6 +84,19 @@ static cs_error_t cmap_get_int(
 
 static cs_error_t cmap_adjust_int(cmap_handle_t handle, const char *key_name, int32_t step);
 
+static cs_error_t cmap_notify_batch_dispatch(
+	cmap_handle_t handle,
+	const struct res_lib_cmap_notify_batch_callback *res_lib_cmap_notify_batch_callback);
+
+static cs_error_t cmap_track_add_inst(
+	cmap_handle_t handle,
+	const char *key_name,
+	int32_t track_type,
+	cmap_notify_fn_t notify_fn,
+	cmap_notify_batch_fn_t notify_batch_fn,
+	void *user_data,
+	cmap_track_handle_t *cmap_track_handle);
+
 /*
  * Function implementations
  */
@@ -322,6 +336,13 @@ cs_error_t cmap_dispatch (
 
 			(void)hdb_handle_put(&cmap_track_handle_t_db, res_lib_cmap_notify_callback->track_inst_handle);
 			break;
+		case MESSAGE_RES_CMAP_NOTIFY_BATCH_CALLBACK:
+			error = cmap_notify_batch_dispatch(handle,
+			    (struct res_lib_cmap_notify_batch_callback *)dispatch_data);
+			if (error != CS_OK) {
+				goto error_put;
+			}
+			break;
 		default:
 			error = CS_ERR_LIBRARY;
 			goto error_put;
@@ -504,6 +525,196 @@ cs_error_t cmap_set_string(cmap_handle_t handle, const char *key_name, const cha
 	return (cmap_set(handle, key_name, value, strlen(value), CMAP_VALUETYPE_STRING));
 }
 
+cs_error_t cmap_set_multi(
+	cmap_handle_t handle,
+	struct cmap_multi_item *items,
+	size_t no_items)
+{
+	cs_error_t error;
+	struct iovec iov;
+	struct cmap_inst *cmap_inst;
+	struct req_lib_cmap_set_multi *req_lib_cmap_set_multi;
+	struct req_lib_cmap_set_multi_item *req_item;
+	struct res_lib_cmap_multi *res_lib_cmap_multi;
+	size_t req_size;
+	size_t res_size;
+	size_t key_len;
+	size_t i;
+	char *pos;
+
+	if ((items == NULL && no_items > 0) || no_items > CMAP_MULTI_ITEMS_MAX) {
+		return (CS_ERR_INVALID_PARAM);
+	}
+
+	req_size = sizeof(*req_lib_cmap_set_multi);
+	for (i = 0; i < no_items; i++) {
+		if (items[i].key_name == NULL || items[i].value == NULL) {
+			return (CS_ERR_INVALID_PARAM);
+		}
+		if (strlen(items[i].key_name) >= CS_MAX_NAME_LENGTH) {
+			items[i].error = CS_ERR_NAME_TOO_LONG;
+			return (CS_ERR_NAME_TOO_LONG);
+		}
+		if (items[i].value_len > CMAP_MULTI_VALUE_LEN_MAX) {
+			items[i].error = CS_ERR_INVALID_PARAM;
+			return (CS_ERR_INVALID_PARAM);
+		}
+		req_size += sizeof(*req_item) + CMAP_MULTI_ALIGNED(items[i].value_len);
+	}
+	res_size = sizeof(*res_lib_cmap_multi) + no_items * sizeof(mar_int32_t);
+
+	if (req_size > IPC_REQUEST_SIZE || res_size > IPC_RESPONSE_SIZE) {
+		return (CS_ERR_TOO_BIG);
+	}
+
+	error = hdb_error_to_cs(hdb_handle_get (&cmap_handle_t_db, handle, (void *)&cmap_inst));
+	if (error != CS_OK) {
+		return (error);
+	}
+
+	req_lib_cmap_set_multi = malloc(req_size);
+	res_lib_cmap_multi = malloc(res_size);
+	if (req_lib_cmap_set_multi == NULL || res_lib_cmap_multi == NULL) {
+		error = CS_ERR_NO_MEMORY;
+		goto error_put;
+	}
+
+	memset(req_lib_cmap_set_multi, 0, req_size);
+	req_lib_cmap_set_multi->header.size = req_size;
+	req_lib_cmap_set_multi->header.id = MESSAGE_REQ_CMAP_SET_MULTI;
+	req_lib_cmap_set_multi->no_items = no_items;
+
+	pos = (char *)req_lib_cmap_set_multi + sizeof(*req_lib_cmap_set_multi);
+	for (i = 0; i < no_items; i++) {
+		req_item = (struct req_lib_cmap_set_multi_item *)pos;
+		key_len = strlen(items[i].key_name);
+		memcpy(req_item->key_name.value, items[i].key_name, key_len);
+		req_item->key_name.length = key_len;
+		req_item->value_len = items[i].value_len;
+		req_item->type = items[i].type;
+		memcpy(req_item->value, items[i].value, items[i].value_len);
+		pos += sizeof(*req_item) + CMAP_MULTI_ALIGNED(items[i].value_len);
+	}
+
+	iov.iov_base = (char *)req_lib_cmap_set_multi;
+	iov.iov_len = req_size;
+
+	error = qb_to_cs_error(qb_ipcc_sendv_recv(
+		cmap_inst->c,
+		&iov,
+		1,
+		res_lib_cmap_multi,
+		res_size, CS_IPC_TIMEOUT_MS));
+
+	if (error == CS_OK) {
+		if (res_lib_cmap_multi->header.size == res_size) {
+			for (i = 0; i < no_items; i++) {
+				items[i].error = res_lib_cmap_multi->errors[i];
+			}
+		}
+		error = res_lib_cmap_multi->header.error;
+	}
+
+error_put:
+	free(req_lib_cmap_set_multi);
+	free(res_lib_cmap_multi);
+
+	(void)hdb_handle_put (&cmap_handle_t_db, handle);
+
+	return (error);
+}
+
+cs_error_t cmap_delete_multi(
+	cmap_handle_t handle,
+	struct cmap_multi_item *items,
+	size_t no_items)
+{
+	cs_error_t error;
+	struct iovec iov[2];
+	struct cmap_inst *cmap_inst;
+	struct req_lib_cmap_delete_multi req_lib_cmap_delete_multi;
+	struct res_lib_cmap_multi *res_lib_cmap_multi;
+	mar_name_t *key_names;
+	size_t req_size;
+	size_t res_size;
+	size_t key_len;
+	size_t i;
+
+	if ((items == NULL && no_items > 0) || no_items > CMAP_MULTI_ITEMS_MAX) {
+		return (CS_ERR_INVALID_PARAM);
+	}
+
+	for (i = 0; i < no_items; i++) {
+		if (items[i].key_name == NULL) {
+			return (CS_ERR_INVALID_PARAM);
+		}
+		if (strlen(items[i].key_name) >= CS_MAX_NAME_LENGTH) {
+			items[i].error = CS_ERR_NAME_TOO_LONG;
+			return (CS_ERR_NAME_TOO_LONG);
+		}
+	}
+
+	req_size = sizeof(req_lib_cmap_delete_multi) + no_items * sizeof(mar_name_t);
+	res_size = sizeof(*res_lib_cmap_multi) + no_items * sizeof(mar_int32_t);
+
+	if (req_size > IPC_REQUEST_SIZE || res_size > IPC_RESPONSE_SIZE) {
+		return (CS_ERR_TOO_BIG);
+	}
+
+	error = hdb_error_to_cs(hdb_handle_get (&cmap_handle_t_db, handle, (void *)&cmap_inst));
+	if (error != CS_OK) {
+		return (error);
+	}
+
+	key_names = malloc(no_items * sizeof(mar_name_t) + 1);
+	res_lib_cmap_multi = malloc(res_size);
+	if (key_names == NULL || res_lib_cmap_multi == NULL) {
+		error = CS_ERR_NO_MEMORY;
+		goto error_put;
+	}
+
+	memset(key_names, 0, no_items * sizeof(mar_name_t));
+	for (i = 0; i < no_items; i++) {
+		key_len = strlen(items[i].key_name);
+		memcpy(key_names[i].value, items[i].key_name, key_len);
+		key_names[i].length = key_len;
+	}
+
+	memset(&req_lib_cmap_delete_multi, 0, sizeof(req_lib_cmap_delete_multi));
+	req_lib_cmap_delete_multi.header.size = req_size;
+	req_lib_cmap_delete_multi.header.id = MESSAGE_REQ_CMAP_DELETE_MULTI;
+	req_lib_cmap_delete_multi.no_items = no_items;
+
+	iov[0].iov_base = (char *)&req_lib_cmap_delete_multi;
+	iov[0].iov_len = sizeof(req_lib_cmap_delete_multi);
+	iov[1].iov_base = (char *)key_names;
+	iov[1].iov_len = no_items * sizeof(mar_name_t);
+
+	error = qb_to_cs_error(qb_ipcc_sendv_recv(
+		cmap_inst->c,
+		iov,
+		2,
+		res_lib_cmap_multi,
+		res_size, CS_IPC_TIMEOUT_MS));
+
+	if (error == CS_OK) {
+		if (res_lib_cmap_multi->header.size == res_size) {
+			for (i = 0; i < no_items; i++) {
+				items[i].error = res_lib_cmap_multi->errors[i];
+			}
+		}
+		error = res_lib_cmap_multi->header.error;
+	}
+
+error_put:
+	free(key_names);
+	free(res_lib_cmap_multi);
+
+	(void)hdb_handle_put (&cmap_handle_t_db, handle);
+
+	return (error);
+}
+
 cs_error_t cmap_delete(cmap_handle_t handle, const char *key_name)
 {
 	cs_error_t error;
@@ -635,6 +846,168 @@ cs_error_t cmap_get(
 	return (error);
 }
 
+/*
+ * Send one MESSAGE_REQ_CMAP_GET_MULTI with all items. Caller checks that
+ * request and response fit into IPC message.
+ */
+static cs_error_t cmap_get_multi_send(
+	struct cmap_inst *cmap_inst,
+	struct cmap_multi_item *items,
+	size_t no_items,
+	size_t res_size)
+{
+	cs_error_t error;
+	struct iovec iov[2];
+	struct req_lib_cmap_get_multi req_lib_cmap_get_multi;
+	struct req_lib_cmap_get_multi_item *req_items;
+	struct res_lib_cmap_get_multi *res_lib_cmap_get_multi;
+	struct res_lib_cmap_get_multi_item *res_item;
+	size_t key_len;
+	size_t i;
+	char *pos;
+
+	req_items = malloc(no_items * sizeof(*req_items));
+	res_lib_cmap_get_multi = malloc(res_size);
+	if (req_items == NULL || res_lib_cmap_get_multi == NULL) {
+		free(req_items);
+		free(res_lib_cmap_get_multi);
+		return (CS_ERR_NO_MEMORY);
+	}
+
+	memset(req_items, 0, no_items * sizeof(*req_items));
+	for (i = 0; i < no_items; i++) {
+		key_len = strlen(items[i].key_name);
+		memcpy(req_items[i].key_name.value, items[i].key_name, key_len);
+		req_items[i].key_name.length = key_len;
+		req_items[i].value_len = (items[i].value != NULL ? items[i].value_len : 0);
+	}
+
+	memset(&req_lib_cmap_get_multi, 0, sizeof(req_lib_cmap_get_multi));
+	req_lib_cmap_get_multi.header.size = sizeof(req_lib_cmap_get_multi) +
+	    no_items * sizeof(*req_items);
+	req_lib_cmap_get_multi.header.id = MESSAGE_REQ_CMAP_GET_MULTI;
+	req_lib_cmap_get_multi.no_items = no_items;
+
+	iov[0].iov_base = (char *)&req_lib_cmap_get_multi;
+	iov[0].iov_len = sizeof(req_lib_cmap_get_multi);
+	iov[1].iov_base = (char *)req_items;
+	iov[1].iov_len = no_items * sizeof(*req_items);
+
+	error = qb_to_cs_error(qb_ipcc_sendv_recv(
+		cmap_inst->c,
+		iov,
+		2,
+		res_lib_cmap_get_multi,
+		res_size, CS_IPC_TIMEOUT_MS));
+
+	if (error == CS_OK) {
+		error = res_lib_cmap_get_multi->header.error;
+	}
+
+	if (error == CS_OK && res_lib_cmap_get_multi->header.size != res_size) {
+		error = CS_ERR_MESSAGE_ERROR;
+	}
+
+	if (error == CS_OK) {
+		pos = (char *)res_lib_cmap_get_multi + sizeof(*res_lib_cmap_get_multi);
+		for (i = 0; i < no_items; i++) {
+			res_item = (struct res_lib_cmap_get_multi_item *)pos;
+			pos += sizeof(*res_item) + CMAP_MULTI_ALIGNED(req_items[i].value_len);
+
+			items[i].error = res_item->error;
+			if (items[i].error != CS_OK) {
+				continue;
+			}
+			items[i].type = res_item->type;
+			if (items[i].value != NULL) {
+				memcpy(items[i].value, res_item->value, res_item->value_len);
+			}
+			items[i].value_len = res_item->value_len;
+		}
+	}
+
+	free(req_items);
+	free(res_lib_cmap_get_multi);
+
+	return (error);
+}
+
+cs_error_t cmap_get_multi(
+	cmap_handle_t handle,
+	struct cmap_multi_item *items,
+	size_t no_items)
+{
+	cs_error_t error;
+	struct cmap_inst *cmap_inst;
+	size_t first;
+	size_t count;
+	size_t req_size;
+	size_t res_size;
+	size_t item_res_size;
+	size_t i;
+
+	if (items == NULL && no_items > 0) {
+		return (CS_ERR_INVALID_PARAM);
+	}
+
+	for (i = 0; i < no_items; i++) {
+		if (items[i].key_name == NULL) {
+			return (CS_ERR_INVALID_PARAM);
+		}
+	}
+
+	error = hdb_error_to_cs(hdb_handle_get (&cmap_handle_t_db, handle, (void *)&cmap_inst));
+	if (error != CS_OK) {
+		return (error);
+	}
+
+	i = 0;
+	while (i < no_items && error == CS_OK) {
+		/*
+		 * Take as many keys as fit into one request and its response.
+		 * Keys which can't be sent at all get their error right away.
+		 */
+		first = i;
+		count = 0;
+		req_size = sizeof(struct req_lib_cmap_get_multi);
+		res_size = sizeof(struct res_lib_cmap_get_multi);
+		for (; i < no_items && count < CMAP_MULTI_ITEMS_MAX; i++) {
+			if (strlen(items[i].key_name) >= CS_MAX_NAME_LENGTH) {
+				if (count > 0) {
+					break;
+				}
+				items[i].error = CS_ERR_NAME_TOO_LONG;
+				first = i + 1;
+				continue;
+			}
+
+			item_res_size = sizeof(struct res_lib_cmap_get_multi_item);
+			if (items[i].value != NULL) {
+				if (items[i].value_len > CMAP_MULTI_VALUE_LEN_MAX) {
+					items[i].value_len = CMAP_MULTI_VALUE_LEN_MAX;
+				}
+				item_res_size += CMAP_MULTI_ALIGNED(items[i].value_len);
+			}
+
+			if (req_size + sizeof(struct req_lib_cmap_get_multi_item) > IPC_REQUEST_SIZE ||
+			    res_size + item_res_size > IPC_RESPONSE_SIZE) {
+				break;
+			}
+			req_size += sizeof(struct req_lib_cmap_get_multi_item);
+			res_size += item_res_size;
+			count++;
+		}
+
+		if (count > 0) {
+			error = cmap_get_multi_send(cmap_inst, &items[first], count, res_size);
+		}
+	}
+
+	(void)hdb_handle_put (&cmap_handle_t_db, handle);
+
+	return (error);
+}
+
 static cs_error_t cmap_get_int(
 	cmap_handle_t handle,
 	const char *key_name,
@@ -935,6 +1308,92 @@ cs_error_t cmap_iter_next(
 	return (error);
 }
 
+cs_error_t cmap_iter_next_bulk(
+		cmap_handle_t handle,
+		cmap_iter_handle_t iter_handle,
+		cmap_iter_bulk_fn_t iter_fn,
+		void *user_data)
+{
+	cs_error_t error;
+	struct iovec iov;
+	struct cmap_inst *cmap_inst;
+	struct req_lib_cmap_iter_next_bulk req_lib_cmap_iter_next_bulk;
+	struct res_lib_cmap_iter_next_bulk *res_lib_cmap_iter_next_bulk;
+	const struct res_lib_cmap_iter_bulk_item *item;
+	size_t record_len;
+	size_t pos;
+	uint32_t i;
+
+	if (iter_fn == NULL) {
+		return (CS_ERR_INVALID_PARAM);
+	}
+
+	error = hdb_error_to_cs(hdb_handle_get (&cmap_handle_t_db, handle, (void *)&cmap_inst));
+	if (error != CS_OK) {
+		return (error);
+	}
+
+	res_lib_cmap_iter_next_bulk = malloc(IPC_RESPONSE_SIZE);
+	if (res_lib_cmap_iter_next_bulk == NULL) {
+		error = CS_ERR_NO_MEMORY;
+		goto error_put;
+	}
+
+	memset(&req_lib_cmap_iter_next_bulk, 0, sizeof(req_lib_cmap_iter_next_bulk));
+	req_lib_cmap_iter_next_bulk.header.size = sizeof(req_lib_cmap_iter_next_bulk);
+	req_lib_cmap_iter_next_bulk.header.id = MESSAGE_REQ_CMAP_ITER_NEXT_BULK;
+	req_lib_cmap_iter_next_bulk.iter_handle = iter_handle;
+	req_lib_cmap_iter_next_bulk.page_size = IPC_RESPONSE_SIZE;
+
+	iov.iov_base = (char *)&req_lib_cmap_iter_next_bulk;
+	iov.iov_len = sizeof(req_lib_cmap_iter_next_bulk);
+
+	error = qb_to_cs_error(qb_ipcc_sendv_recv(
+		cmap_inst->c,
+		&iov,
+		1,
+		res_lib_cmap_iter_next_bulk,
+		IPC_RESPONSE_SIZE, CS_IPC_TIMEOUT_MS));
+
+	if (error == CS_OK) {
+		error = res_lib_cmap_iter_next_bulk->header.error;
+	}
+
+	if (error != CS_OK) {
+		goto error_free;
+	}
+
+	pos = sizeof(*res_lib_cmap_iter_next_bulk);
+	for (i = 0; i < res_lib_cmap_iter_next_bulk->no_items; i++) {
+		if (pos + sizeof(*item) > res_lib_cmap_iter_next_bulk->header.size) {
+			error = CS_ERR_MESSAGE_ERROR;
+			break;
+		}
+		item = (const struct res_lib_cmap_iter_bulk_item *)((char *)res_lib_cmap_iter_next_bulk + pos);
+		if (item->key_len > CMAP_KEYNAME_MAXLEN || item->value_len > IPC_RESPONSE_SIZE) {
+			error = CS_ERR_MESSAGE_ERROR;
+			break;
+		}
+		record_len = CMAP_ITER_BULK_RECORD_LEN(item->key_len, item->value_len);
+		if (pos + record_len > res_lib_cmap_iter_next_bulk->header.size) {
+			error = CS_ERR_MESSAGE_ERROR;
+			break;
+		}
+
+		iter_fn(handle, item->data, item->data + CMAP_MULTI_ALIGNED(item->key_len + 1),
+		    item->value_len, item->type, user_data);
+
+		pos += record_len;
+	}
+
+error_free:
+	free(res_lib_cmap_iter_next_bulk);
+error_put:
+	(void)hdb_handle_put (&cmap_handle_t_db, handle);
+
+	return (error);
+}
+
 cs_error_t cmap_iter_finalize(
 		cmap_handle_t handle,
 		cmap_iter_handle_t iter_handle)
@@ -974,6 +1433,100 @@ cs_error_t cmap_iter_finalize(
 	return (error);
 }
 
+/*
+ * Parse coalesced changes and pass them to batch callback at once, or one
+ * by one to callback of track added by cmap_track_add
+ */
+static cs_error_t cmap_notify_batch_dispatch(
+	cmap_handle_t handle,
+	const struct res_lib_cmap_notify_batch_callback *res_lib_cmap_notify_batch_callback)
+{
+	const struct res_lib_cmap_notify_batch_item *item;
+	struct cmap_track_inst *cmap_track_inst;
+	struct cmap_notify_item *items;
+	size_t record_len;
+	size_t pos;
+	uint32_t i;
+	cs_error_t error;
+
+	error = hdb_error_to_cs(hdb_handle_get(&cmap_track_handle_t_db,
+			res_lib_cmap_notify_batch_callback->track_inst_handle,
+			(void *)&cmap_track_inst));
+	if (error == CS_ERR_BAD_HANDLE) {
+		/*
+		 * User deleted tracker -> ignore error
+		 */
+		return (CS_OK);
+	}
+	if (error != CS_OK) {
+		return (error);
+	}
+
+	items = malloc(sizeof(*items) * (res_lib_cmap_notify_batch_callback->no_items + 1));
+	if (items == NULL) {
+		error = CS_ERR_NO_MEMORY;
+		goto error_put;
+	}
+
+	pos = sizeof(*res_lib_cmap_notify_batch_callback);
+	for (i = 0; i < res_lib_cmap_notify_batch_callback->no_items; i++) {
+		if (pos + sizeof(*item) > res_lib_cmap_notify_batch_callback->header.size) {
+			error = CS_ERR_MESSAGE_ERROR;
+			goto error_free;
+		}
+		item = (const struct res_lib_cmap_notify_batch_item *)
+		    ((const char *)res_lib_cmap_notify_batch_callback + pos);
+		if (item->key_len > CMAP_KEYNAME_MAXLEN ||
+		    item->new_value_len > IPC_DISPATCH_SIZE || item->old_value_len > IPC_DISPATCH_SIZE) {
+			error = CS_ERR_MESSAGE_ERROR;
+			goto error_free;
+		}
+		record_len = CMAP_NOTIFY_BATCH_RECORD_LEN(item->key_len, item->new_value_len,
+		    item->old_value_len);
+		if (pos + record_len > res_lib_cmap_notify_batch_callback->header.size) {
+			error = CS_ERR_MESSAGE_ERROR;
+			goto error_free;
+		}
+
+		items[i].event = item->event;
+		items[i].key_name = item->data;
+		items[i].new_value.type = item->new_value_type;
+		items[i].new_value.len = item->new_value_len;
+		items[i].new_value.data = item->data + CMAP_MULTI_ALIGNED(item->key_len + 1);
+		items[i].old_value.type = item->old_value_type;
+		items[i].old_value.len = item->old_value_len;
+		items[i].old_value.data = (const char *)items[i].new_value.data +
+		    CMAP_MULTI_ALIGNED(item->new_value_len);
+
+		pos += record_len;
+	}
+
+	if (cmap_track_inst->notify_batch_fn != NULL) {
+		cmap_track_inst->notify_batch_fn(handle,
+				cmap_track_inst->track_handle,
+				items,
+				res_lib_cmap_notify_batch_callback->no_items,
+				cmap_track_inst->user_data);
+	} else {
+		for (i = 0; i < res_lib_cmap_notify_batch_callback->no_items; i++) {
+			cmap_track_inst->notify_fn(handle,
+					cmap_track_inst->track_handle,
+					items[i].event,
+					items[i].key_name,
+					items[i].new_value,
+					items[i].old_value,
+					cmap_track_inst->user_data);
+		}
+	}
+
+error_free:
+	free(items);
+error_put:
+	(void)hdb_handle_put(&cmap_track_handle_t_db, res_lib_cmap_notify_batch_callback->track_inst_handle);
+
+	return (error);
+}
+
 cs_error_t cmap_track_add(
 	cmap_handle_t handle,
 	const char *key_name,
@@ -982,6 +1535,41 @@ cs_error_t cmap_track_add(
 	void *user_data,
 	cmap_track_handle_t *cmap_track_handle)
 {
+
+	if (notify_fn == NULL) {
+		return (CS_ERR_INVALID_PARAM);
+	}
+
+	return (cmap_track_add_inst(handle, key_name, track_type, notify_fn, NULL,
+	    user_data, cmap_track_handle));
+}
+
+cs_error_t cmap_track_add_batch(
+	cmap_handle_t handle,
+	const char *key_name,
+	int32_t track_type,
+	cmap_notify_batch_fn_t notify_fn,
+	void *user_data,
+	cmap_track_handle_t *cmap_track_handle)
+{
+
+	if (notify_fn == NULL) {
+		return (CS_ERR_INVALID_PARAM);
+	}
+
+	return (cmap_track_add_inst(handle, key_name, track_type | CMAP_TRACK_COALESCE, NULL, notify_fn,
+	    user_data, cmap_track_handle));
+}
+
+static cs_error_t cmap_track_add_inst(
+	cmap_handle_t handle,
+	const char *key_name,
+	int32_t track_type,
+	cmap_notify_fn_t notify_fn,
+	cmap_notify_batch_fn_t notify_batch_fn,
+	void *user_data,
+	cmap_track_handle_t *cmap_track_handle)
+{
 	cs_error_t error;
 	struct iovec iov;
 	struct cmap_inst *cmap_inst;
@@ -990,7 +1578,7 @@ cs_error_t cmap_track_add(
 	struct cmap_track_inst *cmap_track_inst;
 	cmap_track_handle_t cmap_track_inst_handle;
 
-	if (cmap_track_handle == NULL || notify_fn == NULL) {
+	if (cmap_track_handle == NULL) {
 		return (CS_ERR_INVALID_PARAM);
 	}
 
@@ -1013,6 +1601,7 @@ cs_error_t cmap_track_add(
 
 	cmap_track_inst->user_data = user_data;
 	cmap_track_inst->notify_fn = notify_fn;
+	cmap_track_inst->notify_batch_fn = notify_batch_fn;
 	cmap_track_inst->c = cmap_inst->c;
 
 	memset(&req_lib_cmap_track_add, 0, sizeof(req_lib_cmap_track_add));
@@ -62,6 +62,7 @@
 #include <corosync/corodefs.h>
 #include <corosync/cpg.h>
 #include <corosync/ipc_cpg.h>
+#include <corosync/statepage.h>
 
 #include "util.h"
 
@@ -70,16 +71,22 @@
 #endif
 
 /*
- * Maximum number of times to retry a send when transmitting
- * a large message fragment
+ * Number of fragments of a large message sent before waiting for the
+ * response to the oldest one
  */
-#define MAX_RETRIES 100
+#define CPG_PARTIAL_WINDOW 8
 
 /*
  * ZCB files have following umask (umask is same as used in libqb)
  */
 #define CPG_MEMORY_MAP_UMASK		077
 
+/*
+ * Receive buffers used by cpg_dispatch_batch, messages of one batch are
+ * referenced in place from up to this many events
+ */
+#define CPG_DISPATCH_BATCH_BUFS		8
+
 struct cpg_assembly_data
 {
 	struct qb_list_head list;
@@ -100,6 +107,20 @@ struct cpg_inst {
 	struct qb_list_head iteration_list_head;
 	uint32_t max_msg_size;
 	struct qb_list_head assembly_list_head;
+	uint32_t partial_seq;
+	size_t partial_resume_len;
+	size_t partial_resume_sent;
+	char *zcb_recv_pool;
+	size_t zcb_recv_size;
+	cpg_zcb_deliver_fn_t zcb_deliver_fn;
+	char *batch_bufs[CPG_DISPATCH_BATCH_BUFS];
+	cpg_delivered_msg_t *batch_msgs;
+	struct cpg_name *batch_names;
+	unsigned int batch_max;
+	uint32_t async_window;
+	uint32_t async_inflight;
+	cpg_mcast_status_fn_t mcast_status_fn;
+	const struct cs_state_page *state_page;
 };
 static void cpg_inst_free (void *inst);
 
@@ -140,7 +161,20 @@ static void cpg_iteration_instance_finalize (struct cpg_iteration_instance_t *cp
 static void cpg_inst_free (void *inst)
 {
 	struct cpg_inst *cpg_inst = (struct cpg_inst *)inst;
+	unsigned int i;
+
 	qb_ipcc_disconnect(cpg_inst->c);
+
+	for (i = 0; i < CPG_DISPATCH_BATCH_BUFS; i++) {
+		free (cpg_inst->batch_bufs[i]);
+	}
+	free (cpg_inst->batch_msgs);
+	free (cpg_inst->batch_names);
+
+	if (cpg_inst->zcb_recv_pool != NULL) {
+		munmap (cpg_inst->zcb_recv_pool, cpg_inst->zcb_recv_size);
+	}
+	cs_state_page_unmap (cpg_inst->state_page);
 }
 
 static void cpg_inst_finalize (struct cpg_inst *cpg_inst, hdb_handle_t handle)
@@ -367,20 +401,72 @@ cs_error_t cpg_context_set (
 	return (CS_OK);
 }
 
-cs_error_t cpg_dispatch (
+/*
+ * State of cpg_dispatch_batch. Delivered messages are collected until
+ * max_messages are pending or another callback has to be called first.
+ */
+struct cpg_batch {
+	cpg_deliver_batch_fn_t deliver_batch_fn;
+	cpg_delivered_msg_t *msgs;
+	struct cpg_name *names;
+	unsigned int max_messages;
+	unsigned int entries;
+	unsigned int dispatched;
+};
+
+static void cpg_batch_flush (cpg_handle_t handle, struct cpg_batch *batch)
+{
+	if (batch->entries > 0) {
+		batch->deliver_batch_fn (handle, batch->msgs, batch->entries);
+		batch->entries = 0;
+	}
+}
+
+static void cpg_batch_add (
 	cpg_handle_t handle,
-	cs_dispatch_flags_t dispatch_types)
+	struct cpg_batch *batch,
+	const mar_cpg_name_t *group_name,
+	uint32_t nodeid,
+	uint32_t pid,
+	void *msg,
+	size_t msg_len)
+{
+	cpg_delivered_msg_t *entry;
+
+	if (batch->entries == batch->max_messages) {
+		cpg_batch_flush (handle, batch);
+	}
+
+	marshall_from_mar_cpg_name_t (&batch->names[batch->entries], group_name);
+
+	entry = &batch->msgs[batch->entries];
+	entry->group_name = &batch->names[batch->entries];
+	entry->nodeid = nodeid;
+	entry->pid = pid;
+	entry->msg = msg;
+	entry->msg_len = msg_len;
+
+	batch->entries++;
+	batch->dispatched++;
+}
+
+/*
+ * Dispatch one message. With batch set, delivered messages are collected
+ * in the batch instead of being passed to cpg_deliver_fn.
+ */
+static cs_error_t cpg_dispatch_message (
+	cpg_handle_t handle,
+	struct cpg_inst *cpg_inst,
+	struct cpg_inst *cpg_inst_copy,
+	struct qb_ipc_response_header *dispatch_data,
+	struct cpg_batch *batch)
 {
-	int timeout = -1;
-	cs_error_t error;
-	int cont = 1; /* always continue do loop except when set to 0 */
-	struct cpg_inst *cpg_inst;
 	struct res_lib_cpg_confchg_callback *res_cpg_confchg_callback;
 	struct res_lib_cpg_deliver_callback *res_cpg_deliver_callback;
 	struct res_lib_cpg_partial_deliver_callback *res_cpg_partial_deliver_callback;
 	struct res_lib_cpg_totem_confchg_callback *res_cpg_totem_confchg_callback;
-	struct cpg_inst cpg_inst_copy;
-	struct qb_ipc_response_header *dispatch_data;
+	struct res_lib_cpg_zc_deliver_callback *res_cpg_zc_deliver_callback;
+	struct res_lib_cpg_mcast_status_callback *res_cpg_mcast_status_callback;
 	struct cpg_address member_list[CPG_MEMBERS_MAX];
 	struct cpg_address left_list[CPG_MEMBERS_MAX];
 	struct cpg_address joined_list[CPG_MEMBERS_MAX];
@@ -392,6 +478,313 @@ cs_error_t cpg_dispatch (
 	unsigned int i;
 	struct cpg_ring_id ring_id;
 	uint32_t totem_member_list[CPG_MEMBERS_MAX];
+
+	switch (cpg_inst_copy->model_data.model) {
+	case CPG_MODEL_V1:
+		/*
+		 * Dispatch incoming message
+		 */
+		switch (dispatch_data->id) {
+		case MESSAGE_RES_CPG_DELIVER_CALLBACK:
+			res_cpg_deliver_callback = (struct res_lib_cpg_deliver_callback *)dispatch_data;
+
+			if (batch != NULL) {
+				cpg_batch_add (handle, batch,
+					&res_cpg_deliver_callback->group_name,
+					res_cpg_deliver_callback->nodeid,
+					res_cpg_deliver_callback->pid,
+					&res_cpg_deliver_callback->message,
+					res_cpg_deliver_callback->msglen);
+				break;
+			}
+
+			if (cpg_inst_copy->model_v1_data.cpg_deliver_fn == NULL) {
+				break;
+			}
+
+			marshall_from_mar_cpg_name_t (
+				&group_name,
+				&res_cpg_deliver_callback->group_name);
+
+			cpg_inst_copy->model_v1_data.cpg_deliver_fn (handle,
+				&group_name,
+				res_cpg_deliver_callback->nodeid,
+				res_cpg_deliver_callback->pid,
+				&res_cpg_deliver_callback->message,
+				res_cpg_deliver_callback->msglen);
+			break;
+
+		case MESSAGE_RES_CPG_ZC_DELIVER_CALLBACK:
+			res_cpg_zc_deliver_callback = (struct res_lib_cpg_zc_deliver_callback *)dispatch_data;
+
+			if (cpg_inst->zcb_recv_pool == NULL ||
+			    res_cpg_zc_deliver_callback->offset < sizeof (struct cpg_zcb_recv_chunk_header) ||
+			    res_cpg_zc_deliver_callback->offset > cpg_inst->zcb_recv_size ||
+			    res_cpg_zc_deliver_callback->msglen > cpg_inst->zcb_recv_size - res_cpg_zc_deliver_callback->offset) {
+				return (CS_ERR_LIBRARY);
+			}
+
+			if (batch != NULL) {
+				cpg_batch_flush (handle, batch);
+			}
+
+			marshall_from_mar_cpg_name_t (
+				&group_name,
+				&res_cpg_zc_deliver_callback->group_name);
+
+			cpg_inst_copy->zcb_deliver_fn (handle,
+				&group_name,
+				res_cpg_zc_deliver_callback->nodeid,
+				res_cpg_zc_deliver_callback->pid,
+				cpg_inst->zcb_recv_pool + res_cpg_zc_deliver_callback->offset,
+				res_cpg_zc_deliver_callback->msglen);
+			break;
+
+		case MESSAGE_RES_CPG_MCAST_STATUS_CALLBACK:
+			res_cpg_mcast_status_callback = (struct res_lib_cpg_mcast_status_callback *)dispatch_data;
+
+			__atomic_sub_fetch (&cpg_inst->async_inflight,
+				res_cpg_mcast_status_callback->completed, __ATOMIC_RELEASE);
+
+			if (res_cpg_mcast_status_callback->failed == 0 ||
+			    cpg_inst_copy->mcast_status_fn == NULL) {
+				break;
+			}
+
+			cpg_inst_copy->mcast_status_fn (handle,
+				res_cpg_mcast_status_callback->error,
+				res_cpg_mcast_status_callback->failed);
+			break;
+
+		case MESSAGE_RES_CPG_PARTIAL_DELIVER_CALLBACK:
+			res_cpg_partial_deliver_callback = (struct res_lib_cpg_partial_deliver_callback *)dispatch_data;
+
+			marshall_from_mar_cpg_name_t (
+				&group_name,
+				&res_cpg_partial_deliver_callback->group_name);
+
+			/*
+			 * Search for assembly data for current messages (nodeid, pid) pair in list of assemblies
+			 */
+			assembly_data = NULL;
+			qb_list_for_each(iter, &(cpg_inst->assembly_list_head)) {
+				struct cpg_assembly_data *current_assembly_data = qb_list_entry (iter, struct cpg_assembly_data, list);
+				if (current_assembly_data->nodeid == res_cpg_partial_deliver_callback->nodeid && current_assembly_data->pid == res_cpg_partial_deliver_callback->pid) {
+					assembly_data = current_assembly_data;
+					break;
+				}
+			}
+
+			if (res_cpg_partial_deliver_callback->type == LIBCPG_PARTIAL_FIRST) {
+
+				/*
+				 * As this is LIBCPG_PARTIAL_FIRST packet, check that there is no ongoing assembly.
+				 * Otherwise the sending of packet must have been interrupted and error should have
+				 * been reported to sending client. Therefore here last assembly will be dropped.
+				 */
+				if (assembly_data) {
+					qb_list_del (&assembly_data->list);
+					free(assembly_data->assembly_buf);
+					free(assembly_data);
+					assembly_data = NULL;
+				}
+
+				assembly_data = malloc(sizeof(struct cpg_assembly_data));
+				if (!assembly_data) {
+					return (CS_ERR_NO_MEMORY);
+				}
+
+				assembly_data->nodeid = res_cpg_partial_deliver_callback->nodeid;
+				assembly_data->pid = res_cpg_partial_deliver_callback->pid;
+				assembly_data->assembly_buf = malloc(res_cpg_partial_deliver_callback->msglen);
+				if (!assembly_data->assembly_buf) {
+					free(assembly_data);
+					return (CS_ERR_NO_MEMORY);
+				}
+				assembly_data->assembly_buf_ptr = 0;
+				qb_list_init (&assembly_data->list);
+
+				qb_list_add (&assembly_data->list, &cpg_inst->assembly_list_head);
+			}
+			if (assembly_data) {
+				memcpy(assembly_data->assembly_buf + assembly_data->assembly_buf_ptr,
+					res_cpg_partial_deliver_callback->message, res_cpg_partial_deliver_callback->fraglen);
+				assembly_data->assembly_buf_ptr += res_cpg_partial_deliver_callback->fraglen;
+
+				if (res_cpg_partial_deliver_callback->type == LIBCPG_PARTIAL_LAST) {
+					if (batch != NULL) {
+						/*
+						 * Assembly buffer is freed right away, deliver it alone
+						 */
+						cpg_batch_flush (handle, batch);
+						cpg_batch_add (handle, batch,
+							&res_cpg_partial_deliver_callback->group_name,
+							res_cpg_partial_deliver_callback->nodeid,
+							res_cpg_partial_deliver_callback->pid,
+							assembly_data->assembly_buf,
+							res_cpg_partial_deliver_callback->msglen);
+						cpg_batch_flush (handle, batch);
+					} else {
+						cpg_inst_copy->model_v1_data.cpg_deliver_fn (handle,
+							&group_name,
+							res_cpg_partial_deliver_callback->nodeid,
+							res_cpg_partial_deliver_callback->pid,
+							assembly_data->assembly_buf,
+							res_cpg_partial_deliver_callback->msglen);
+					}
+
+					qb_list_del (&assembly_data->list);
+					free(assembly_data->assembly_buf);
+					free(assembly_data);
+				}
+			}
+			break;
+
+		case MESSAGE_RES_CPG_CONFCHG_CALLBACK:
+			if (batch != NULL) {
+				cpg_batch_flush (handle, batch);
+			}
+			if (cpg_inst_copy->model_v1_data.cpg_confchg_fn == NULL) {
+				break;
+			}
+
+			res_cpg_confchg_callback = (struct res_lib_cpg_confchg_callback *)dispatch_data;
+
+			for (i = 0; i < res_cpg_confchg_callback->member_list_entries; i++) {
+				marshall_from_mar_cpg_address_t (&member_list[i],
+					&res_cpg_confchg_callback->member_list[i]);
+			}
+			left_list_start = res_cpg_confchg_callback->member_list +
+				res_cpg_confchg_callback->member_list_entries;
+			for (i = 0; i < res_cpg_confchg_callback->left_list_entries; i++) {
+				marshall_from_mar_cpg_address_t (&left_list[i],
+					&left_list_start[i]);
+			}
+			joined_list_start = res_cpg_confchg_callback->member_list +
+				res_cpg_confchg_callback->member_list_entries +
+				res_cpg_confchg_callback->left_list_entries;
+			for (i = 0; i < res_cpg_confchg_callback->joined_list_entries; i++) {
+				marshall_from_mar_cpg_address_t (&joined_list[i],
+					&joined_list_start[i]);
+			}
+			marshall_from_mar_cpg_name_t (
+				&group_name,
+				&res_cpg_confchg_callback->group_name);
+
+			cpg_inst_copy->model_v1_data.cpg_confchg_fn (handle,
+				&group_name,
+				member_list,
+				res_cpg_confchg_callback->member_list_entries,
+				left_list,
+				res_cpg_confchg_callback->left_list_entries,
+				joined_list,
+				res_cpg_confchg_callback->joined_list_entries);
+
+			/*
+			 * If member left while his partial packet was being assembled, assembly data must be removed from list
+			 */
+			for (i = 0; i < res_cpg_confchg_callback->left_list_entries; i++) {
+				qb_list_for_each_safe(iter, tmp_iter, &(cpg_inst->assembly_list_head)) {
+					struct cpg_assembly_data *current_assembly_data = qb_list_entry (iter, struct cpg_assembly_data, list);
+					if (current_assembly_data->nodeid != left_list[i].nodeid || current_assembly_data->pid != left_list[i].pid)
+						continue;
+
+					qb_list_del (&current_assembly_data->list);
+					free(current_assembly_data->assembly_buf);
+					free(current_assembly_data);
+				}
+			}
+
+			break;
+		case MESSAGE_RES_CPG_TOTEM_CONFCHG_CALLBACK:
+			if (batch != NULL) {
+				cpg_batch_flush (handle, batch);
+			}
+			if (cpg_inst_copy->model_v1_data.cpg_totem_confchg_fn == NULL) {
+				break;
+			}
+
+			res_cpg_totem_confchg_callback = (struct res_lib_cpg_totem_confchg_callback *)dispatch_data;
+
+			marshall_from_mar_cpg_ring_id_t (&ring_id, &res_cpg_totem_confchg_callback->ring_id);
+			for (i = 0; i < res_cpg_totem_confchg_callback->member_list_entries; i++) {
+				totem_member_list[i] = res_cpg_totem_confchg_callback->member_list[i];
+			}
+
+			cpg_inst_copy->model_v1_data.cpg_totem_confchg_fn (handle,
+				ring_id,
+				res_cpg_totem_confchg_callback->member_list_entries,
+				totem_member_list);
+			break;
+		default:
+			return (CS_ERR_LIBRARY);
+		} /* - switch (dispatch_data->id) */
+		break; /* case CPG_MODEL_V1 */
+	} /* - switch (cpg_inst_copy->model_data.model) */
+
+	return (CS_OK);
+}
+
+/*
+ * Dispatch one received event, which is either a single message or a
+ * packed event carrying several of them
+ */
+static cs_error_t cpg_dispatch_event (
+	cpg_handle_t handle,
+	struct cpg_inst *cpg_inst,
+	struct cpg_inst *cpg_inst_copy,
+	struct qb_ipc_response_header *dispatch_data,
+	struct cpg_batch *batch)
+{
+	struct qb_ipc_response_header *msg;
+	size_t offset;
+	cs_error_t error;
+
+	if (dispatch_data->id != MESSAGE_RES_CPG_PACKED_CALLBACK) {
+		return (cpg_dispatch_message (handle, cpg_inst, cpg_inst_copy,
+			dispatch_data, batch));
+	}
+
+	offset = sizeof (struct qb_ipc_response_header);
+	while (offset + sizeof (struct qb_ipc_response_header) <= dispatch_data->size) {
+		msg = (struct qb_ipc_response_header *)((char *)dispatch_data + offset);
+		if (msg->size < sizeof (struct qb_ipc_response_header) ||
+		    offset + msg->size > dispatch_data->size ||
+		    msg->id == MESSAGE_RES_CPG_PACKED_CALLBACK) {
+			return (CS_ERR_LIBRARY);
+		}
+
+		error = cpg_dispatch_message (handle, cpg_inst, cpg_inst_copy,
+			msg, batch);
+		if (error != CS_OK) {
+			return (error);
+		}
+
+		/*
+		 * Rest of the event must not be dispatched after cpg_finalize
+		 */
+		if (cpg_inst->finalize) {
+			break;
+		}
+
+		offset += msg->size;
+		offset += (CPG_PACKED_EVENT_ALIGN - (msg->size % CPG_PACKED_EVENT_ALIGN)) %
+			CPG_PACKED_EVENT_ALIGN;
+	}
+
+	return (CS_OK);
+}
+
+cs_error_t cpg_dispatch (
+	cpg_handle_t handle,
+	cs_dispatch_flags_t dispatch_types)
+{
+	int timeout = -1;
+	cs_error_t error;
+	int cont = 1; /* always continue do loop except when set to 0 */
+	struct cpg_inst *cpg_inst;
+	struct cpg_inst cpg_inst_copy;
+	struct qb_ipc_response_header *dispatch_data;
 	int32_t errno_res;
 	char dispatch_buf[IPC_DISPATCH_SIZE];
 
@@ -444,180 +837,11 @@ cs_error_t cpg_dispatch (
 		 * operate at the same time that cpgFinalize has been called.
 		 */
 		memcpy (&cpg_inst_copy, cpg_inst, sizeof (struct cpg_inst));
-		switch (cpg_inst_copy.model_data.model) {
-		case CPG_MODEL_V1:
-			/*
-			 * Dispatch incoming message
-			 */
-			switch (dispatch_data->id) {
-			case MESSAGE_RES_CPG_DELIVER_CALLBACK:
-				if (cpg_inst_copy.model_v1_data.cpg_deliver_fn == NULL) {
-					break;
-				}
-
-				res_cpg_deliver_callback = (struct res_lib_cpg_deliver_callback *)dispatch_data;
-
-				marshall_from_mar_cpg_name_t (
-					&group_name,
-					&res_cpg_deliver_callback->group_name);
-
-				cpg_inst_copy.model_v1_data.cpg_deliver_fn (handle,
-					&group_name,
-					res_cpg_deliver_callback->nodeid,
-					res_cpg_deliver_callback->pid,
-					&res_cpg_deliver_callback->message,
-					res_cpg_deliver_callback->msglen);
-				break;
-
-			case MESSAGE_RES_CPG_PARTIAL_DELIVER_CALLBACK:
-				res_cpg_partial_deliver_callback = (struct res_lib_cpg_partial_deliver_callback *)dispatch_data;
-
-				marshall_from_mar_cpg_name_t (
-					&group_name,
-					&res_cpg_partial_deliver_callback->group_name);
-
-				/*
-				 * Search for assembly data for current messages (nodeid, pid) pair in list of assemblies
-				 */
-				assembly_data = NULL;
-				qb_list_for_each(iter, &(cpg_inst->assembly_list_head)) {
-					struct cpg_assembly_data *current_assembly_data = qb_list_entry (iter, struct cpg_assembly_data, list);
-					if (current_assembly_data->nodeid == res_cpg_partial_deliver_callback->nodeid && current_assembly_data->pid == res_cpg_partial_deliver_callback->pid) {
-						assembly_data = current_assembly_data;
-						break;
-					}
-				}
-
-				if (res_cpg_partial_deliver_callback->type == LIBCPG_PARTIAL_FIRST) {
-
-					/*
-					 * As this is LIBCPG_PARTIAL_FIRST packet, check that there is no ongoing assembly.
-					 * Otherwise the sending of packet must have been interrupted and error should have
-					 * been reported to sending client. Therefore here last assembly will be dropped.
-					 */
-					if (assembly_data) {
-						qb_list_del (&assembly_data->list);
-						free(assembly_data->assembly_buf);
-						free(assembly_data);
-						assembly_data = NULL;
-					}
-
-					assembly_data = malloc(sizeof(struct cpg_assembly_data));
-					if (!assembly_data) {
-						error = CS_ERR_NO_MEMORY;
-						goto error_put;
-					}
-
-					assembly_data->nodeid = res_cpg_partial_deliver_callback->nodeid;
-					assembly_data->pid = res_cpg_partial_deliver_callback->pid;
-					assembly_data->assembly_buf = malloc(res_cpg_partial_deliver_callback->msglen);
-					if (!assembly_data->assembly_buf) {
-						free(assembly_data);
-						error = CS_ERR_NO_MEMORY;
-						goto error_put;
-					}
-					assembly_data->assembly_buf_ptr = 0;
-					qb_list_init (&assembly_data->list);
-
-					qb_list_add (&assembly_data->list, &cpg_inst->assembly_list_head);
-				}
-				if (assembly_data) {
-					memcpy(assembly_data->assembly_buf + assembly_data->assembly_buf_ptr,
-						res_cpg_partial_deliver_callback->message, res_cpg_partial_deliver_callback->fraglen);
-					assembly_data->assembly_buf_ptr += res_cpg_partial_deliver_callback->fraglen;
-
-					if (res_cpg_partial_deliver_callback->type == LIBCPG_PARTIAL_LAST) {
-						cpg_inst_copy.model_v1_data.cpg_deliver_fn (handle,
-							&group_name,
-							res_cpg_partial_deliver_callback->nodeid,
-							res_cpg_partial_deliver_callback->pid,
-							assembly_data->assembly_buf,
-							res_cpg_partial_deliver_callback->msglen);
-
-						qb_list_del (&assembly_data->list);
-						free(assembly_data->assembly_buf);
-						free(assembly_data);
-					}
-				}
-				break;
-
-			case MESSAGE_RES_CPG_CONFCHG_CALLBACK:
-				if (cpg_inst_copy.model_v1_data.cpg_confchg_fn == NULL) {
-					break;
-				}
-
-				res_cpg_confchg_callback = (struct res_lib_cpg_confchg_callback *)dispatch_data;
-
-				for (i = 0; i < res_cpg_confchg_callback->member_list_entries; i++) {
-					marshall_from_mar_cpg_address_t (&member_list[i],
-						&res_cpg_confchg_callback->member_list[i]);
-				}
-				left_list_start = res_cpg_confchg_callback->member_list +
-					res_cpg_confchg_callback->member_list_entries;
-				for (i = 0; i < res_cpg_confchg_callback->left_list_entries; i++) {
-					marshall_from_mar_cpg_address_t (&left_list[i],
-						&left_list_start[i]);
-				}
-				joined_list_start = res_cpg_confchg_callback->member_list +
-					res_cpg_confchg_callback->member_list_entries +
-					res_cpg_confchg_callback->left_list_entries;
-				for (i = 0; i < res_cpg_confchg_callback->joined_list_entries; i++) {
-					marshall_from_mar_cpg_address_t (&joined_list[i],
-						&joined_list_start[i]);
-				}
-				marshall_from_mar_cpg_name_t (
-					&group_name,
-					&res_cpg_confchg_callback->group_name);
-
-				cpg_inst_copy.model_v1_data.cpg_confchg_fn (handle,
-					&group_name,
-					member_list,
-					res_cpg_confchg_callback->member_list_entries,
-					left_list,
-					res_cpg_confchg_callback->left_list_entries,
-					joined_list,
-					res_cpg_confchg_callback->joined_list_entries);
-
-				/*
-				 * If member left while his partial packet was being assembled, assembly data must be removed from list
-				 */
-				for (i = 0; i < res_cpg_confchg_callback->left_list_entries; i++) {
-					qb_list_for_each_safe(iter, tmp_iter, &(cpg_inst->assembly_list_head)) {
-						struct cpg_assembly_data *current_assembly_data = qb_list_entry (iter, struct cpg_assembly_data, list);
-						if (current_assembly_data->nodeid != left_list[i].nodeid || current_assembly_data->pid != left_list[i].pid)
-							continue;
-
-						qb_list_del (&current_assembly_data->list);
-						free(current_assembly_data->assembly_buf);
-						free(current_assembly_data);
-					}
-				}
-
-				break;
-			case MESSAGE_RES_CPG_TOTEM_CONFCHG_CALLBACK:
-				if (cpg_inst_copy.model_v1_data.cpg_totem_confchg_fn == NULL) {
-					break;
-				}
-
-				res_cpg_totem_confchg_callback = (struct res_lib_cpg_totem_confchg_callback *)dispatch_data;
-
-				marshall_from_mar_cpg_ring_id_t (&ring_id, &res_cpg_totem_confchg_callback->ring_id);
-				for (i = 0; i < res_cpg_totem_confchg_callback->member_list_entries; i++) {
-					totem_member_list[i] = res_cpg_totem_confchg_callback->member_list[i];
-				}
-
-				cpg_inst_copy.model_v1_data.cpg_totem_confchg_fn (handle,
-					ring_id,
-					res_cpg_totem_confchg_callback->member_list_entries,
-					totem_member_list);
-				break;
-			default:
-				error = CS_ERR_LIBRARY;
-				goto error_put;
-				break;
-			} /* - switch (dispatch_data->id) */
-			break; /* case CPG_MODEL_V1 */
-		} /* - switch (cpg_inst_copy.model_data.model) */
+		error = cpg_dispatch_event (handle, cpg_inst, &cpg_inst_copy,
+			dispatch_data, NULL);
+		if (error != CS_OK) {
+			goto error_put;
+		}
 
 		if (cpg_inst_copy.finalize || cpg_inst->finalize) {
 			/*
@@ -641,34 +865,166 @@ error_put:
 	return (error);
 }
 
-cs_error_t cpg_join (
-    cpg_handle_t handle,
-    const struct cpg_name *group)
+/*
+ * Make sure the instance has room for max_messages batch entries
+ */
+static cs_error_t cpg_batch_alloc (struct cpg_inst *cpg_inst, unsigned int max_messages)
 {
-	cs_error_t error;
-	struct cpg_inst *cpg_inst;
-	struct iovec iov[2];
-	struct req_lib_cpg_join req_lib_cpg_join;
-	struct res_lib_cpg_join response;
+	cpg_delivered_msg_t *msgs;
+	struct cpg_name *names;
 
-	if (group->length > CPG_MAX_NAME_LENGTH) {
-		return (CS_ERR_NAME_TOO_LONG);
+	if (cpg_inst->batch_max >= max_messages) {
+		return (CS_OK);
 	}
 
-	error = hdb_error_to_cs (hdb_handle_get (&cpg_handle_t_db, handle, (void *)&cpg_inst));
-	if (error != CS_OK) {
-		return (error);
+	msgs = realloc (cpg_inst->batch_msgs, max_messages * sizeof (cpg_delivered_msg_t));
+	if (msgs == NULL) {
+		return (CS_ERR_NO_MEMORY);
 	}
+	cpg_inst->batch_msgs = msgs;
 
-	/* Now join */
-	req_lib_cpg_join.header.size = sizeof (struct req_lib_cpg_join);
-	req_lib_cpg_join.header.id = MESSAGE_REQ_CPG_JOIN;
-	req_lib_cpg_join.pid = getpid();
-	req_lib_cpg_join.flags = 0;
+	names = realloc (cpg_inst->batch_names, max_messages * sizeof (struct cpg_name));
+	if (names == NULL) {
+		return (CS_ERR_NO_MEMORY);
+	}
+	cpg_inst->batch_names = names;
+
+	cpg_inst->batch_max = max_messages;
+
+	return (CS_OK);
+}
+
+cs_error_t cpg_dispatch_batch (
+	cpg_handle_t handle,
+	cpg_deliver_batch_fn_t deliver_batch_fn,
+	unsigned int max_messages,
+	int32_t timeout)
+{
+	cs_error_t error;
+	struct cpg_inst *cpg_inst;
+	struct cpg_inst cpg_inst_copy;
+	struct cpg_batch batch;
+	struct qb_ipc_response_header *dispatch_data;
+	unsigned int buf_idx = 0;
+	unsigned int events = 0;
+	int32_t errno_res;
+
+	if (deliver_batch_fn == NULL || max_messages == 0) {
+		return (CS_ERR_INVALID_PARAM);
+	}
+
+	error = hdb_error_to_cs (hdb_handle_get (&cpg_handle_t_db, handle, (void *)&cpg_inst));
+	if (error != CS_OK) {
+		return (error);
+	}
+
+	error = cpg_batch_alloc (cpg_inst, max_messages);
+	if (error != CS_OK) {
+		goto error_put;
+	}
+
+	memset (&batch, 0, sizeof (batch));
+	batch.deliver_batch_fn = deliver_batch_fn;
+	batch.msgs = cpg_inst->batch_msgs;
+	batch.names = cpg_inst->batch_names;
+	batch.max_messages = max_messages;
+
+	while (batch.dispatched < max_messages) {
+		/*
+		 * Pending entries point into the receive buffers, so a buffer
+		 * is only reused once the batch was passed to the callback
+		 */
+		if (batch.entries == 0) {
+			buf_idx = 0;
+		} else if (buf_idx == CPG_DISPATCH_BATCH_BUFS) {
+			cpg_batch_flush (handle, &batch);
+			buf_idx = 0;
+		}
+
+		if (cpg_inst->batch_bufs[buf_idx] == NULL) {
+			cpg_inst->batch_bufs[buf_idx] = malloc (IPC_DISPATCH_SIZE);
+			if (cpg_inst->batch_bufs[buf_idx] == NULL) {
+				error = CS_ERR_NO_MEMORY;
+				break;
+			}
+		}
+
+		/*
+		 * Only wait for the first event, then take what is available
+		 */
+		errno_res = qb_ipcc_event_recv (
+			cpg_inst->c,
+			cpg_inst->batch_bufs[buf_idx],
+			IPC_DISPATCH_SIZE,
+			(events == 0) ? timeout : 0);
+		error = qb_to_cs_error (errno_res);
+		if (error == CS_ERR_BAD_HANDLE) {
+			error = CS_OK;
+			break;
+		}
+		if (error != CS_OK) {
+			break;
+		}
+		dispatch_data = (struct qb_ipc_response_header *)cpg_inst->batch_bufs[buf_idx];
+		buf_idx++;
+		events++;
+
+		memcpy (&cpg_inst_copy, cpg_inst, sizeof (struct cpg_inst));
+		error = cpg_dispatch_event (handle, cpg_inst, &cpg_inst_copy,
+			dispatch_data, &batch);
+		if (error != CS_OK) {
+			break;
+		}
+
+		if (cpg_inst_copy.finalize || cpg_inst->finalize) {
+			cpg_inst->finalize = 1;
+			error = CS_ERR_BAD_HANDLE;
+			goto error_put;
+		}
+	}
+
+	cpg_batch_flush (handle, &batch);
+
+	if (error == CS_ERR_TRY_AGAIN && events > 0) {
+		error = CS_OK;
+	}
+
+error_put:
+	hdb_handle_put (&cpg_handle_t_db, handle);
+	return (error);
+}
+
+cs_error_t cpg_join (
+    cpg_handle_t handle,
+    const struct cpg_name *group)
+{
+	cs_error_t error;
+	struct cpg_inst *cpg_inst;
+	struct iovec iov[2];
+	struct req_lib_cpg_join req_lib_cpg_join;
+	struct res_lib_cpg_join response;
+
+	if (group->length > CPG_MAX_NAME_LENGTH) {
+		return (CS_ERR_NAME_TOO_LONG);
+	}
+
+	error = hdb_error_to_cs (hdb_handle_get (&cpg_handle_t_db, handle, (void *)&cpg_inst));
+	if (error != CS_OK) {
+		return (error);
+	}
+
+	/* Now join */
+	req_lib_cpg_join.header.size = sizeof (struct req_lib_cpg_join);
+	req_lib_cpg_join.header.id = MESSAGE_REQ_CPG_JOIN;
+	req_lib_cpg_join.pid = getpid();
+	req_lib_cpg_join.flags = 0;
 
 	switch (cpg_inst->model_data.model) {
 	case CPG_MODEL_V1:
 		req_lib_cpg_join.flags = cpg_inst->model_v1_data.flags;
+		if (cpg_inst->model_v1_data.flags & CPG_MODEL_V1_PACKED_EVENTS) {
+			req_lib_cpg_join.flags |= CPG_JOIN_FLAG_PACKED_EVENTS;
+		}
 		break;
 	}
 
@@ -841,6 +1197,66 @@ error_exit:
 	return (error);
 }
 
+cs_error_t cpg_totem_membership_get (
+	cpg_handle_t handle,
+	struct cpg_ring_id *ring_id,
+	uint32_t *member_list,
+	int *member_list_entries)
+{
+	cs_error_t error;
+	struct cpg_inst *cpg_inst;
+	const struct cs_state_page *page;
+	uint32_t seq;
+	uint32_t entries = 0;
+	unsigned int i;
+
+	if (ring_id == NULL || member_list == NULL || member_list_entries == NULL ||
+	    *member_list_entries < 0) {
+		return (CS_ERR_INVALID_PARAM);
+	}
+
+	error = hdb_error_to_cs (hdb_handle_get (&cpg_handle_t_db, handle, (void *)&cpg_inst));
+	if (error != CS_OK) {
+		return (error);
+	}
+
+	page = cs_state_page_get (&cpg_inst->state_page);
+	if (page == NULL || !cs_state_page_valid (page)) {
+		error = CS_ERR_NOT_SUPPORTED;
+		goto error_exit;
+	}
+
+	error = CS_ERR_TRY_AGAIN;
+	for (i = 0; i < CS_STATE_PAGE_READ_TRIES; i++) {
+		seq = cs_state_page_read_begin (page);
+		ring_id->seq = page->ring_seq;
+		ring_id->nodeid = page->ring_rep;
+		entries = page->member_list_entries;
+		if (entries > CS_STATE_PAGE_NODES_MAX) {
+			entries = CS_STATE_PAGE_NODES_MAX;
+		}
+		if (entries <= (uint32_t)*member_list_entries) {
+			memcpy (member_list, page->member_list, entries * sizeof (uint32_t));
+		}
+		if (!cs_state_page_read_retry (page, seq)) {
+			error = CS_OK;
+			break;
+		}
+	}
+
+	if (error == CS_OK) {
+		if (entries > (uint32_t)*member_list_entries) {
+			error = CS_ERR_NO_SPACE;
+		}
+		*member_list_entries = entries;
+	}
+
+error_exit:
+	hdb_handle_put (&cpg_handle_t_db, handle);
+
+	return (error);
+}
+
 cs_error_t cpg_flow_control_state_get (
 	cpg_handle_t handle,
 	cpg_flow_control_state_t *flow_control_state)
@@ -853,6 +1269,10 @@ cs_error_t cpg_flow_control_state_get (
 		return (error);
 	}
 	*flow_control_state = CPG_FLOW_CONTROL_DISABLED;
+	if (cpg_inst->async_window != 0 &&
+	    __atomic_load_n (&cpg_inst->async_inflight, __ATOMIC_ACQUIRE) >= cpg_inst->async_window) {
+		*flow_control_state = CPG_FLOW_CONTROL_ENABLED;
+	}
 	error = CS_OK;
 
 	hdb_handle_put (&cpg_handle_t_db, handle);
@@ -1107,6 +1527,160 @@ error_exit:
 	return (error);
 }
 
+cs_error_t cpg_zcb_recv_enable (
+	cpg_handle_t handle,
+	size_t pool_size,
+	size_t min_size,
+	cpg_zcb_deliver_fn_t zcb_deliver_fn)
+{
+	void *buf = NULL;
+	char path[PATH_MAX];
+	struct req_lib_cpg_zc_recv_enable req_lib_cpg_zc_recv_enable;
+	struct res_lib_cpg_zc_recv_enable res_lib_cpg_zc_recv_enable;
+	struct iovec iovec;
+	long int page_size;
+	cs_error_t error;
+	struct cpg_inst *cpg_inst;
+
+	if (zcb_deliver_fn == NULL || min_size == 0 || min_size > UINT32_MAX) {
+		return (CS_ERR_INVALID_PARAM);
+	}
+
+	page_size = sysconf (_SC_PAGESIZE);
+	if (page_size <= 0) {
+		return (CS_ERR_LIBRARY);
+	}
+	pool_size = (pool_size + page_size - 1) & ~((size_t)page_size - 1);
+	if (pool_size == 0) {
+		return (CS_ERR_INVALID_PARAM);
+	}
+
+	error = hdb_error_to_cs (hdb_handle_get (&cpg_handle_t_db, handle, (void *)&cpg_inst));
+	if (error != CS_OK) {
+		return (error);
+	}
+
+	if (cpg_inst->zcb_recv_pool != NULL) {
+		error = CS_ERR_EXIST;
+		goto error_put;
+	}
+
+	if (memory_map (path, "corosync_zerocopy_recv-XXXXXX", &buf, pool_size) == -1) {
+		error = CS_ERR_NO_MEMORY;
+		goto error_put;
+	}
+
+	if (strlen(path) >= CPG_ZC_PATH_LEN) {
+		unlink(path);
+		munmap (buf, pool_size);
+		error = CS_ERR_NAME_TOO_LONG;
+		goto error_put;
+	}
+
+	memset (&req_lib_cpg_zc_recv_enable, 0, sizeof (req_lib_cpg_zc_recv_enable));
+	req_lib_cpg_zc_recv_enable.header.size = sizeof (req_lib_cpg_zc_recv_enable);
+	req_lib_cpg_zc_recv_enable.header.id = MESSAGE_REQ_CPG_ZC_RECV_ENABLE;
+	req_lib_cpg_zc_recv_enable.map_size = pool_size;
+	req_lib_cpg_zc_recv_enable.min_size = min_size;
+	strcpy (req_lib_cpg_zc_recv_enable.path_to_file, path);
+
+	iovec.iov_base = (void *)&req_lib_cpg_zc_recv_enable;
+	iovec.iov_len = sizeof (req_lib_cpg_zc_recv_enable);
+
+	/*
+	 * Pool must be known before the first delivery referencing it can
+	 * be dispatched
+	 */
+	cpg_inst->zcb_recv_pool = buf;
+	cpg_inst->zcb_recv_size = pool_size;
+	cpg_inst->zcb_deliver_fn = zcb_deliver_fn;
+
+	error = coroipcc_msg_send_reply_receive (
+		cpg_inst->c,
+		&iovec,
+		1,
+		&res_lib_cpg_zc_recv_enable,
+		sizeof (res_lib_cpg_zc_recv_enable));
+
+	if (error == CS_OK) {
+		error = res_lib_cpg_zc_recv_enable.header.error;
+	}
+
+	if (error != CS_OK) {
+		/*
+		 * Daemon unlinks the file once it maps it, make sure it is
+		 * gone in case it didn't get that far
+		 */
+		unlink (path);
+		cpg_inst->zcb_recv_pool = NULL;
+		cpg_inst->zcb_recv_size = 0;
+		cpg_inst->zcb_deliver_fn = NULL;
+		munmap (buf, pool_size);
+	}
+
+error_put:
+	hdb_handle_put (&cpg_handle_t_db, handle);
+	return (error);
+}
+
+cs_error_t cpg_zcb_recv_release (
+	cpg_handle_t handle,
+	void *msg)
+{
+	struct cpg_zcb_recv_chunk_header *header;
+	cs_error_t error;
+	struct cpg_inst *cpg_inst;
+
+	error = hdb_error_to_cs (hdb_handle_get (&cpg_handle_t_db, handle, (void *)&cpg_inst));
+	if (error != CS_OK) {
+		return (error);
+	}
+
+	if (cpg_inst->zcb_recv_pool == NULL ||
+	    (char *)msg < cpg_inst->zcb_recv_pool + sizeof (struct cpg_zcb_recv_chunk_header) ||
+	    (char *)msg >= cpg_inst->zcb_recv_pool + cpg_inst->zcb_recv_size) {
+		error = CS_ERR_INVALID_PARAM;
+		goto error_put;
+	}
+
+	/*
+	 * Daemon reclaims the chunk next time it needs room in the pool
+	 */
+	header = (struct cpg_zcb_recv_chunk_header *)((char *)msg - sizeof (struct cpg_zcb_recv_chunk_header));
+	__atomic_store_n (&header->released, 1, __ATOMIC_RELEASE);
+
+error_put:
+	hdb_handle_put (&cpg_handle_t_db, handle);
+	return (error);
+}
+
+/*
+ * Receive response to the oldest in flight fragment
+ */
+static cs_error_t partial_response_recv (struct cpg_inst *cpg_inst, cs_error_t *result)
+{
+	struct res_lib_cpg_partial_send res_lib_cpg_partial_send;
+	int32_t res;
+
+	res = qb_ipcc_recv (cpg_inst->c, &res_lib_cpg_partial_send,
+		sizeof (res_lib_cpg_partial_send), CS_IPC_TIMEOUT_MS);
+	if (res < 0) {
+		return (qb_to_cs_error (res));
+	}
+
+	*result = res_lib_cpg_partial_send.header.error;
+	return (CS_OK);
+}
+
+/*
+ * Send large message as fragments of at most max_msg_size bytes. Up to
+ * CPG_PARTIAL_WINDOW fragments are in flight, responses are collected
+ * while the next fragments are sent. When the daemon refuses a fragment
+ * because of flow control, it refuses every later fragment as well, so
+ * the remaining responses are drained and CS_ERR_TRY_AGAIN is returned.
+ * The position of the refused fragment is kept in the handle, the next
+ * call with a message of the same length continues from it.
+ */
 static cs_error_t send_fragments (
 	struct cpg_inst *cpg_inst,
 	cpg_guarantee_t guarantee,
@@ -1114,75 +1688,146 @@ static cs_error_t send_fragments (
 	const struct iovec *iovec,
 	unsigned int iov_len)
 {
-	int i;
+	unsigned int i;
 	cs_error_t error = CS_OK;
+	cs_error_t result;
 	struct iovec iov[2];
-	struct req_lib_cpg_partial_mcast req_lib_cpg_mcast;
-	struct res_lib_cpg_partial_send res_lib_cpg_partial_send;
+	struct req_lib_cpg_partial_mcast_pipelined req_lib_cpg_mcast;
+	size_t window[CPG_PARTIAL_WINDOW];
 	size_t sent = 0;
 	size_t iov_sent = 0;
-	int retry_count;
+	uint32_t seq = 0;
+	uint32_t acked = 0;
+	uint32_t refused;
+	int32_t res;
 
-	req_lib_cpg_mcast.header.id = MESSAGE_REQ_CPG_PARTIAL_MCAST;
+	req_lib_cpg_mcast.header.id = MESSAGE_REQ_CPG_PARTIAL_MCAST_PIPELINED;
 	req_lib_cpg_mcast.guarantee = guarantee;
 	req_lib_cpg_mcast.msglen = msg_len;
 
 	iov[0].iov_base = (void *)&req_lib_cpg_mcast;
-	iov[0].iov_len = sizeof (struct req_lib_cpg_partial_mcast);
+	iov[0].iov_len = sizeof (struct req_lib_cpg_partial_mcast_pipelined);
+
+	i = 0;
+	if (cpg_inst->partial_resume_len == msg_len) {
+		sent = cpg_inst->partial_resume_sent;
+		for (iov_sent = sent; iov_sent >= iovec[i].iov_len; i++) {
+			iov_sent -= iovec[i].iov_len;
+		}
+	}
+	cpg_inst->partial_resume_len = 0;
+	cpg_inst->partial_resume_sent = 0;
 
-	i=0;
-	iov_sent = 0 ;
 	qb_ipcc_fc_enable_max_set(cpg_inst->c,  2);
 
-	while (error == CS_OK && sent < msg_len) {
+	while (error == CS_OK && (sent < msg_len || acked < seq)) {
+		if (sent < msg_len && seq - acked < CPG_PARTIAL_WINDOW) {
+			if ( (iovec[i].iov_len - iov_sent) > cpg_inst->max_msg_size) {
+				iov[1].iov_len = cpg_inst->max_msg_size;
+			}
+			else {
+				iov[1].iov_len = iovec[i].iov_len - iov_sent;
+			}
 
-		retry_count = 0;
-		if ( (iovec[i].iov_len - iov_sent) > cpg_inst->max_msg_size) {
-			iov[1].iov_len = cpg_inst->max_msg_size;
-		}
-		else {
-			iov[1].iov_len = iovec[i].iov_len - iov_sent;
+			if (sent == 0) {
+				req_lib_cpg_mcast.type = LIBCPG_PARTIAL_FIRST;
+			}
+			else if ((sent + iov[1].iov_len) == msg_len) {
+				req_lib_cpg_mcast.type = LIBCPG_PARTIAL_LAST;
+			}
+			else {
+				req_lib_cpg_mcast.type = LIBCPG_PARTIAL_CONTINUED;
+			}
+
+			req_lib_cpg_mcast.fraglen = iov[1].iov_len;
+			req_lib_cpg_mcast.seq = cpg_inst->partial_seq + seq;
+			req_lib_cpg_mcast.header.size = sizeof (struct req_lib_cpg_partial_mcast_pipelined) + iov[1].iov_len;
+			iov[1].iov_base = (char *)iovec[i].iov_base + iov_sent;
+
+			res = qb_ipcc_sendv (cpg_inst->c, iov, 2);
+			if (res >= 0) {
+				/*
+				 * Offset of the fragment, to resume from if it
+				 * is refused
+				 */
+				window[seq % CPG_PARTIAL_WINDOW] = sent;
+				seq++;
+
+				iov_sent += iov[1].iov_len;
+				sent += iov[1].iov_len;
+
+				/* Next iovec */
+				if (iov_sent >= iovec[i].iov_len) {
+					i++;
+					iov_sent = 0;
+				}
+				continue;
+			}
+			if (res != -EAGAIN) {
+				error = qb_to_cs_error (res);
+				break;
+			}
+			if (acked == seq) {
+				/*
+				 * Nothing in flight to wait for
+				 */
+				error = CS_ERR_TRY_AGAIN;
+				break;
+			}
+			/*
+			 * Request ring is full, wait for the daemon to process
+			 * the oldest fragment
+			 */
 		}
 
-		if (sent == 0) {
-			req_lib_cpg_mcast.type = LIBCPG_PARTIAL_FIRST;
+		error = partial_response_recv (cpg_inst, &result);
+		if (error != CS_OK) {
+			break;
 		}
-		else if ((sent + iov[1].iov_len) == msg_len) {
-			req_lib_cpg_mcast.type = LIBCPG_PARTIAL_LAST;
+		refused = acked++;
+
+		if (result == CS_OK) {
+			continue;
 		}
-		else {
-			req_lib_cpg_mcast.type = LIBCPG_PARTIAL_CONTINUED;
+		if (result != CS_ERR_TRY_AGAIN) {
+			error = result;
+			break;
 		}
 
-		req_lib_cpg_mcast.fraglen = iov[1].iov_len;
-		req_lib_cpg_mcast.header.size = sizeof (struct req_lib_cpg_partial_mcast) + iov[1].iov_len;
-		iov[1].iov_base = (char *)iovec[i].iov_base + iov_sent;
-
-	resend:
-		error = coroipcc_msg_send_reply_receive (cpg_inst->c, iov, 2,
-							 &res_lib_cpg_partial_send,
-							 sizeof (res_lib_cpg_partial_send));
-
-		if (error == CS_ERR_TRY_AGAIN) {
-			fprintf(stderr, "sleep. counter=%d\n", retry_count);
-			if (++retry_count > MAX_RETRIES) {
-				goto error_exit;
+		/*
+		 * Fragments sent after the refused one are refused too
+		 */
+		while (acked < seq) {
+			error = partial_response_recv (cpg_inst, &result);
+			if (error != CS_OK) {
+				break;
 			}
-			usleep(10000);
-			goto resend;
+			acked++;
+		}
+		if (error != CS_OK) {
+			break;
 		}
 
-		iov_sent += iov[1].iov_len;
-		sent += iov[1].iov_len;
+		sent = window[refused % CPG_PARTIAL_WINDOW];
+		seq = acked = refused;
 
-		/* Next iovec */
-		if (iov_sent >= iovec[i].iov_len) {
-			i++;
-			iov_sent = 0;
-		}
-		error = res_lib_cpg_partial_send.header.error;
+		error = CS_ERR_TRY_AGAIN;
 	}
-error_exit:
+
+	/*
+	 * Don't leave responses for the next request
+	 */
+	while (acked < seq && partial_response_recv (cpg_inst, &result) == CS_OK) {
+		acked++;
+	}
+
+	if (error == CS_ERR_TRY_AGAIN && sent > 0) {
+		cpg_inst->partial_resume_len = msg_len;
+		cpg_inst->partial_resume_sent = sent;
+	}
+
+	cpg_inst->partial_seq += seq;
+
 	qb_ipcc_fc_enable_max_set(cpg_inst->c,  1);
 
 	return error;
@@ -1227,16 +1872,191 @@ cs_error_t cpg_mcast_joined (
 	iov[0].iov_len = sizeof (struct req_lib_cpg_mcast);
 	memcpy (&iov[1], iovec, iov_len * sizeof (struct iovec));
 
+	/*
+	 * Take a slot of the window first, concurrent senders must not
+	 * overshoot it
+	 */
+	if (cpg_inst->async_window != 0 &&
+	    __atomic_add_fetch (&cpg_inst->async_inflight, 1, __ATOMIC_ACQUIRE) > cpg_inst->async_window) {
+		__atomic_sub_fetch (&cpg_inst->async_inflight, 1, __ATOMIC_RELEASE);
+		error = CS_ERR_TRY_AGAIN;
+		goto error_exit;
+	}
+
 	qb_ipcc_fc_enable_max_set(cpg_inst->c,  2);
 	error = qb_to_cs_error(qb_ipcc_sendv(cpg_inst->c, iov, iov_len + 1));
 	qb_ipcc_fc_enable_max_set(cpg_inst->c,  1);
 
+	if (cpg_inst->async_window != 0 && error != CS_OK) {
+		__atomic_sub_fetch (&cpg_inst->async_inflight, 1, __ATOMIC_RELEASE);
+	}
+
+error_exit:
+	hdb_handle_put (&cpg_handle_t_db, handle);
+
+	return (error);
+}
+
+cs_error_t cpg_mcast_async_enable (
+	cpg_handle_t handle,
+	unsigned int window,
+	cpg_mcast_status_fn_t status_fn)
+{
+	cs_error_t error;
+	struct cpg_inst *cpg_inst;
+	struct iovec iov;
+	struct req_lib_cpg_mcast_async_enable req_lib_cpg_mcast_async_enable;
+	struct res_lib_cpg_mcast_async_enable res_lib_cpg_mcast_async_enable;
+
+	if (window == 0) {
+		return (CS_ERR_INVALID_PARAM);
+	}
+
+	error = hdb_error_to_cs (hdb_handle_get (&cpg_handle_t_db, handle, (void *)&cpg_inst));
+	if (error != CS_OK) {
+		return (error);
+	}
+
+	if (cpg_inst->async_window != 0) {
+		error = CS_ERR_EXIST;
+		goto error_exit;
+	}
+
+	req_lib_cpg_mcast_async_enable.header.size = sizeof (struct req_lib_cpg_mcast_async_enable);
+	req_lib_cpg_mcast_async_enable.header.id = MESSAGE_REQ_CPG_MCAST_ASYNC_ENABLE;
+	req_lib_cpg_mcast_async_enable.window = window;
+
+	iov.iov_base = (void *)&req_lib_cpg_mcast_async_enable;
+	iov.iov_len = sizeof (struct req_lib_cpg_mcast_async_enable);
+
+	error = coroipcc_msg_send_reply_receive (cpg_inst->c, &iov, 1,
+		&res_lib_cpg_mcast_async_enable, sizeof (res_lib_cpg_mcast_async_enable));
+	if (error == CS_OK) {
+		error = res_lib_cpg_mcast_async_enable.header.error;
+	}
+	if (error == CS_OK) {
+		cpg_inst->mcast_status_fn = status_fn;
+		cpg_inst->async_window = window;
+	}
+
 error_exit:
 	hdb_handle_put (&cpg_handle_t_db, handle);
 
 	return (error);
 }
 
+/*
+ * Zero bytes aligning the messages of a batch request
+ */
+static const char cpg_mcast_batch_pad[CPG_MCAST_BATCH_ALIGN];
+
+#define CPG_MCAST_BATCH_ITEM_SIZE(len)					\
+	((sizeof (struct cpg_mcast_batch_item) + (len) +		\
+	  CPG_MCAST_BATCH_ALIGN - 1) & ~((size_t)CPG_MCAST_BATCH_ALIGN - 1))
+
+cs_error_t cpg_mcast_joined_batch (
+	cpg_handle_t handle,
+	cpg_guarantee_t guarantee,
+	const struct iovec *msgs,
+	unsigned int msg_count,
+	unsigned int *msgs_sent)
+{
+	cs_error_t error = CS_OK;
+	struct cpg_inst *cpg_inst;
+	struct req_lib_cpg_mcast_batch req_lib_cpg_mcast_batch;
+	struct res_lib_cpg_mcast_batch res_lib_cpg_mcast_batch;
+	struct cpg_mcast_batch_item items[CPG_MCAST_BATCH_MSGS_MAX];
+	struct iovec iov[CPG_MCAST_BATCH_MSGS_MAX * 3 + 1];
+	unsigned int iov_len;
+	unsigned int batch_count;
+	unsigned int sent = 0;
+	size_t req_size;
+	size_t item_size;
+	size_t pad;
+
+	error = hdb_error_to_cs (hdb_handle_get (&cpg_handle_t_db, handle, (void *)&cpg_inst));
+	if (error != CS_OK) {
+		return (error);
+	}
+
+	while (sent < msg_count) {
+		/*
+		 * A message which doesn't fit into a batch request on its own
+		 * is sent the usual way, fragmented
+		 */
+		if (sizeof (struct req_lib_cpg_mcast_batch) +
+		    CPG_MCAST_BATCH_ITEM_SIZE (msgs[sent].iov_len) > cpg_inst->max_msg_size) {
+			error = cpg_mcast_joined (handle, guarantee, &msgs[sent], 1);
+			if (error != CS_OK) {
+				break;
+			}
+			sent++;
+			continue;
+		}
+
+		req_size = sizeof (struct req_lib_cpg_mcast_batch);
+		iov_len = 1;
+		for (batch_count = 0; batch_count < CPG_MCAST_BATCH_MSGS_MAX &&
+		     sent + batch_count < msg_count; batch_count++) {
+
+			item_size = CPG_MCAST_BATCH_ITEM_SIZE (msgs[sent + batch_count].iov_len);
+			if (req_size + item_size > cpg_inst->max_msg_size) {
+				break;
+			}
+			pad = item_size - sizeof (struct cpg_mcast_batch_item) -
+				msgs[sent + batch_count].iov_len;
+
+			items[batch_count].msglen = msgs[sent + batch_count].iov_len;
+			iov[iov_len].iov_base = (void *)&items[batch_count];
+			iov[iov_len].iov_len = sizeof (struct cpg_mcast_batch_item);
+			iov_len++;
+			iov[iov_len] = msgs[sent + batch_count];
+			iov_len++;
+			if (pad) {
+				iov[iov_len].iov_base = (void *)cpg_mcast_batch_pad;
+				iov[iov_len].iov_len = pad;
+				iov_len++;
+			}
+			req_size += item_size;
+		}
+
+		req_lib_cpg_mcast_batch.header.size = req_size;
+		req_lib_cpg_mcast_batch.header.id = MESSAGE_REQ_CPG_MCAST_BATCH;
+		req_lib_cpg_mcast_batch.guarantee = guarantee;
+		req_lib_cpg_mcast_batch.msg_count = batch_count;
+
+		iov[0].iov_base = (void *)&req_lib_cpg_mcast_batch;
+		iov[0].iov_len = sizeof (struct req_lib_cpg_mcast_batch);
+
+		error = coroipcc_msg_send_reply_receive (cpg_inst->c, iov, iov_len,
+			&res_lib_cpg_mcast_batch, sizeof (res_lib_cpg_mcast_batch));
+		if (error != CS_OK) {
+			break;
+		}
+		/*
+		 * Part of a refused request may already be queued, it must
+		 * not be sent again
+		 */
+		if (res_lib_cpg_mcast_batch.msgs_queued < batch_count) {
+			sent += res_lib_cpg_mcast_batch.msgs_queued;
+		} else {
+			sent += batch_count;
+		}
+		error = res_lib_cpg_mcast_batch.header.error;
+		if (error != CS_OK) {
+			break;
+		}
+	}
+
+	if (msgs_sent != NULL) {
+		*msgs_sent = sent;
+	}
+
+	hdb_handle_put (&cpg_handle_t_db, handle);
+
+	return (error);
+}
+
 cs_error_t cpg_iteration_initialize(
 	cpg_handle_t handle,
 	cpg_iteration_type_t iteration_type,
@@ -52,6 +52,7 @@
 
 #include <corosync/quorum.h>
 #include <corosync/ipc_quorum.h>
+#include <corosync/statepage.h>
 
 #include "util.h"
 
@@ -60,6 +61,7 @@ struct quorum_inst {
 	int finalize;
 	const void *context;
 	quorum_callbacks_t callbacks;
+	const struct cs_state_page *state_page;
 };
 
 static void quorum_inst_free (void *inst);
@@ -137,6 +139,7 @@ static void quorum_inst_free (void *inst)
 {
 	struct quorum_inst *quorum_inst = (struct quorum_inst *)inst;
 	qb_ipcc_disconnect(quorum_inst->c);
+	cs_state_page_unmap(quorum_inst->state_page);
 }
 
 cs_error_t quorum_finalize (
@@ -209,6 +212,47 @@ error_exit:
 	return (error);
 }
 
+cs_error_t quorum_getquorate_fast (
+	quorum_handle_t handle,
+	int *quorate)
+{
+	cs_error_t error;
+	struct quorum_inst *quorum_inst;
+	const struct cs_state_page *page;
+	uint32_t seq;
+	uint32_t valid = 0;
+	uint32_t page_quorate = 0;
+	unsigned int i;
+
+	error = hdb_error_to_cs(hdb_handle_get (&quorum_handle_t_db, handle, (void *)&quorum_inst));
+	if (error != CS_OK) {
+		return (error);
+	}
+
+	page = cs_state_page_get (&quorum_inst->state_page);
+	if (page != NULL && cs_state_page_valid (page)) {
+		for (i = 0; i < CS_STATE_PAGE_READ_TRIES; i++) {
+			seq = cs_state_page_read_begin (page);
+			valid = page->quorum_valid;
+			page_quorate = page->quorate;
+			if (!cs_state_page_read_retry (page, seq)) {
+				break;
+			}
+			valid = 0;
+		}
+	}
+
+	(void)hdb_handle_put (&quorum_handle_t_db, handle);
+
+	if (!valid) {
+		return (quorum_getquorate (handle, quorate));
+	}
+
+	*quorate = page_quorate;
+
+	return (CS_OK);
+}
+
 cs_error_t quorum_fd_get (
 	quorum_handle_t handle,
 	int *fd)
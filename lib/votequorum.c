@@ -55,6 +55,7 @@
 
 #include <corosync/votequorum.h>
 #include <corosync/ipc_votequorum.h>
+#include <corosync/statepage.h>
 
 #include "util.h"
 
@@ -63,6 +64,7 @@ struct votequorum_inst {
 	int finalize;
 	void *context;
 	votequorum_callbacks_t callbacks;
+	const struct cs_state_page *state_page;
 };
 
 static void votequorum_inst_free (void *inst);
@@ -114,6 +116,7 @@ static void votequorum_inst_free (void *inst)
 {
 	struct votequorum_inst *vq_inst = (struct votequorum_inst *)inst;
 	qb_ipcc_disconnect(vq_inst->c);
+	cs_state_page_unmap(vq_inst->state_page);
 }
 
 cs_error_t votequorum_finalize (
@@ -199,6 +202,100 @@ error_exit:
 	return (error);
 }
 
+/*
+ * Returns 1 and fills info if the node was found on a consistent page
+ */
+static int votequorum_state_page_info_get (
+	const struct cs_state_page *page,
+	unsigned int nodeid,
+	struct votequorum_info *info)
+{
+	struct cs_state_page_vq_node node;
+	uint32_t seq;
+	uint32_t entries;
+	uint32_t found;
+	uint32_t j;
+	unsigned int i;
+
+	for (i = 0; i < CS_STATE_PAGE_READ_TRIES; i++) {
+		seq = cs_state_page_read_begin (page);
+
+		found = 0;
+		if (page->vq_valid) {
+			if (nodeid == VOTEQUORUM_QDEVICE_NODEID) {
+				nodeid = page->local_nodeid;
+			}
+			entries = page->vq_node_entries;
+			if (entries > CS_STATE_PAGE_NODES_MAX) {
+				entries = CS_STATE_PAGE_NODES_MAX;
+			}
+			for (j = 0; j < entries; j++) {
+				if (page->vq_nodes[j].nodeid == nodeid) {
+					memcpy (&node, &page->vq_nodes[j], sizeof (node));
+					found = 1;
+					break;
+				}
+			}
+			info->qdevice_votes = page->vq_qdevice_votes;
+			memcpy (info->qdevice_name, page->vq_qdevice_name,
+				VOTEQUORUM_QDEVICE_MAX_NAME_LEN);
+		}
+
+		if (!cs_state_page_read_retry (page, seq)) {
+			break;
+		}
+		found = 0;
+	}
+
+	if (!found) {
+		return (0);
+	}
+
+	info->qdevice_name[VOTEQUORUM_QDEVICE_MAX_NAME_LEN - 1] = '\0';
+	info->node_id = node.nodeid;
+	info->node_state = node.state;
+	info->node_votes = node.votes;
+	info->node_expected_votes = node.expected_votes;
+	info->highest_expected = node.highest_expected;
+	info->total_votes = node.total_votes;
+	info->quorum = node.quorum;
+	info->flags = node.flags;
+
+	return (1);
+}
+
+cs_error_t votequorum_getinfo_fast (
+	votequorum_handle_t handle,
+	unsigned int nodeid,
+	struct votequorum_info *info)
+{
+	cs_error_t error;
+	struct votequorum_inst *votequorum_inst;
+	const struct cs_state_page *page;
+	int found = 0;
+
+	error = hdb_error_to_cs(hdb_handle_get (&votequorum_handle_t_db, handle, (void *)&votequorum_inst));
+	if (error != CS_OK) {
+		return (error);
+	}
+
+	page = cs_state_page_get (&votequorum_inst->state_page);
+	if (page != NULL && cs_state_page_valid (page)) {
+		found = votequorum_state_page_info_get (page, nodeid, info);
+	}
+
+	hdb_handle_put (&votequorum_handle_t_db, handle);
+
+	/*
+	 * Unknown nodes are left to the daemon too, so the error is the same
+	 */
+	if (!found) {
+		return (votequorum_getinfo (handle, nodeid, info));
+	}
+
+	return (CS_OK);
+}
+
 cs_error_t votequorum_setexpected (
 	votequorum_handle_t handle,
 	unsigned int expected_votes)
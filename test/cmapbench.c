@@ -0,0 +1,224 @@
+/*
+ * Copyright (c) 2026 Red Hat, Inc.
+ *
+ * All rights reserved.
+ *
+ * This software licensed under BSD license, the text of which follows:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ * - Neither the name of the MontaVista Software, Inc. nor the names of its
+ *   contributors may be used to endorse or promote products derived from this
+ *   software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ * THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Full map dump benchmark
+ *
+ * Dumps the whole cmap the way corosync-cmapctl did before bulk iteration
+ * (cmap_iter_next followed by cmap_get for every key) and with
+ * cmap_iter_next_bulk. Optionally the map is first filled with extra keys
+ * under the cmapbench. prefix, they are removed at the end.
+ */
+
+#include <config.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <sys/time.h>
+
+#include <corosync/corotypes.h>
+#include <corosync/cmap.h>
+
+#define BENCH_PREFIX		"cmapbench."
+#define DEFAULT_KEYS		10000
+#define DEFAULT_ROUNDS		10
+#define VALUE_BUF_LEN		(16 * 1024)
+
+#ifndef timersub
+#define timersub(a, b, result)						\
+	do {								\
+		(result)->tv_sec = (a)->tv_sec - (b)->tv_sec;		\
+		(result)->tv_usec = (a)->tv_usec - (b)->tv_usec;	\
+		if ((result)->tv_usec < 0) {				\
+			--(result)->tv_sec;				\
+			(result)->tv_usec += 1000000;			\
+		}							\
+	} while (0)
+#endif /* timersub */
+
+static char value_buf[VALUE_BUF_LEN];
+
+static void bench_fail (const char *what, cs_error_t err)
+{
+	fprintf (stderr, "%s failed: %s\n", what, cs_strerror (err));
+	exit (1);
+}
+
+static unsigned int dump_single (cmap_handle_t handle)
+{
+	cmap_iter_handle_t iter_handle;
+	char key_name[CMAP_KEYNAME_MAXLEN + 1];
+	size_t value_len;
+	cmap_value_types_t type;
+	unsigned int keys = 0;
+	cs_error_t err;
+
+	err = cmap_iter_init (handle, NULL, &iter_handle);
+	if (err != CS_OK) {
+		bench_fail ("cmap_iter_init", err);
+	}
+
+	while (cmap_iter_next (handle, iter_handle, key_name, &value_len, &type) == CS_OK) {
+		value_len = sizeof (value_buf);
+		if (cmap_get (handle, key_name, value_buf, &value_len, &type) == CS_OK) {
+			keys++;
+		}
+	}
+	cmap_iter_finalize (handle, iter_handle);
+
+	return (keys);
+}
+
+static void dump_bulk_fn (
+	cmap_handle_t handle,
+	const char *key_name,
+	const void *value,
+	size_t value_len,
+	cmap_value_types_t type,
+	void *user_data)
+{
+	unsigned int *keys = user_data;
+
+	if (value_len <= sizeof (value_buf)) {
+		memcpy (value_buf, value, value_len);
+	}
+	*keys += 1;
+}
+
+static unsigned int dump_bulk (cmap_handle_t handle)
+{
+	cmap_iter_handle_t iter_handle;
+	unsigned int keys = 0;
+	cs_error_t err;
+
+	err = cmap_iter_init (handle, NULL, &iter_handle);
+	if (err != CS_OK) {
+		bench_fail ("cmap_iter_init", err);
+	}
+
+	while ((err = cmap_iter_next_bulk (handle, iter_handle, dump_bulk_fn, &keys)) == CS_OK) {
+	}
+	cmap_iter_finalize (handle, iter_handle);
+
+	if (err != CS_ERR_NO_SECTIONS) {
+		bench_fail ("cmap_iter_next_bulk", err);
+	}
+
+	return (keys);
+}
+
+static void dump_benchmark (
+	cmap_handle_t handle,
+	const char *name,
+	unsigned int (*dump_fn)(cmap_handle_t handle),
+	unsigned int rounds)
+{
+	struct timeval tv1, tv2, tv_elapsed;
+	unsigned int keys = 0;
+	unsigned int i;
+	double secs;
+
+	gettimeofday (&tv1, NULL);
+	for (i = 0; i < rounds; i++) {
+		keys += dump_fn (handle);
+	}
+	gettimeofday (&tv2, NULL);
+	timersub (&tv2, &tv1, &tv_elapsed);
+	secs = tv_elapsed.tv_sec + (tv_elapsed.tv_usec / 1000000.0);
+
+	printf ("%-6s %4u dump(s) %10u keys ", name, rounds, keys);
+	printf ("%7.3f Seconds runtime ", secs);
+	printf ("%9.3f ms/dump ", secs * 1000.0 / rounds);
+	printf ("%12.3f keys/s\n", ((double)keys) / secs);
+}
+
+static void fill_keys (cmap_handle_t handle, unsigned int no_keys)
+{
+	char key_name[CMAP_KEYNAME_MAXLEN + 1];
+	unsigned int i;
+	cs_error_t err;
+
+	for (i = 0; i < no_keys; i++) {
+		snprintf (key_name, sizeof (key_name), BENCH_PREFIX "key%u", i);
+		err = cmap_set_uint32 (handle, key_name, i);
+		if (err != CS_OK) {
+			bench_fail ("cmap_set_uint32", err);
+		}
+	}
+}
+
+static void remove_keys (cmap_handle_t handle, unsigned int no_keys)
+{
+	char key_name[CMAP_KEYNAME_MAXLEN + 1];
+	unsigned int i;
+
+	for (i = 0; i < no_keys; i++) {
+		snprintf (key_name, sizeof (key_name), BENCH_PREFIX "key%u", i);
+		(void)cmap_delete (handle, key_name);
+	}
+}
+
+int main (int argc, char *argv[])
+{
+	cmap_handle_t handle;
+	unsigned int no_keys = DEFAULT_KEYS;
+	unsigned int rounds = DEFAULT_ROUNDS;
+	cs_error_t err;
+
+	if (argc > 1) {
+		no_keys = atoi (argv[1]);
+	}
+	if (argc > 2) {
+		rounds = atoi (argv[2]);
+	}
+	if (rounds == 0) {
+		rounds = 1;
+	}
+
+	err = cmap_initialize (&handle);
+	if (err != CS_OK) {
+		bench_fail ("cmap_initialize", err);
+	}
+
+	fill_keys (handle, no_keys);
+
+	dump_benchmark (handle, "single", dump_single, rounds);
+	dump_benchmark (handle, "bulk", dump_bulk, rounds);
+
+	remove_keys (handle, no_keys);
+
+	cmap_finalize (handle);
+
+	return (0);
+}
@@ -0,0 +1,228 @@
+/*
+ * Copyright (c) 2026 Red Hat, Inc.
+ *
+ * All rights reserved.
+ *
+ * This software licensed under BSD license, the text of which follows:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ * - Neither the name of the MontaVista Software, Inc. nor the names of its
+ *   contributors may be used to endorse or promote products derived from this
+ *   software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ * THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Fills the totem new message queue with cpg_mcast_joined_batch and checks
+ * that every message is delivered exactly once and in order, also when
+ * requests are refused with CS_ERR_TRY_AGAIN partway through.
+ */
+
+#include <config.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/uio.h>
+
+#include <corosync/corotypes.h>
+#include <corosync/cpg.h>
+
+#define BATCH_MSGS		256
+#define MSG_SIZE_MAX		65536
+#define DRAIN_TIMEOUT_MS	10000
+
+static unsigned int local_nodeid;
+static uint32_t local_pid;
+
+static uint32_t expected_seq = 0;
+static unsigned int duplicates = 0;
+static unsigned int gaps = 0;
+
+static unsigned char msg_data[BATCH_MSGS][MSG_SIZE_MAX];
+
+static void cpg_deliver_fn (
+	cpg_handle_t handle,
+	const struct cpg_name *group_name,
+	uint32_t nodeid,
+	uint32_t pid,
+	void *msg,
+	size_t msg_len)
+{
+	uint32_t seq;
+
+	if (nodeid != local_nodeid || pid != local_pid || msg_len < sizeof (seq)) {
+		return;
+	}
+
+	memcpy (&seq, msg, sizeof (seq));
+	if (seq < expected_seq) {
+		duplicates++;
+		return;
+	}
+	if (seq > expected_seq) {
+		gaps++;
+	}
+	expected_seq = seq + 1;
+}
+
+static void cpg_confchg_fn (
+	cpg_handle_t handle,
+	const struct cpg_name *group_name,
+	const struct cpg_address *member_list, size_t member_list_entries,
+	const struct cpg_address *left_list, size_t left_list_entries,
+	const struct cpg_address *joined_list, size_t joined_list_entries)
+{
+}
+
+static cpg_callbacks_t callbacks = {
+	cpg_deliver_fn,
+	cpg_confchg_fn
+};
+
+static struct cpg_name group_name = {
+	.value = "cpgbatchfill",
+	.length = 12
+};
+
+static void usage (const char *name)
+{
+	printf ("usage: %s [-n <messages>] [-s <msg_size>]\n", name);
+}
+
+int main (int argc, char *argv[])
+{
+	cpg_handle_t handle;
+	struct iovec iov[BATCH_MSGS];
+	struct pollfd pfd;
+	cs_error_t result;
+	unsigned int msgs_total = 200000;
+	unsigned int msg_size = 1000;
+	unsigned int try_again = 0;
+	unsigned int msgs_sent;
+	unsigned int count;
+	unsigned int i;
+	uint32_t seq = 0;
+	int fd;
+	int opt;
+
+	while ((opt = getopt (argc, argv, "n:s:h")) != -1) {
+		switch (opt) {
+		case 'n':
+			msgs_total = strtoul (optarg, NULL, 0);
+			break;
+		case 's':
+			msg_size = strtoul (optarg, NULL, 0);
+			if (msg_size < sizeof (seq) || msg_size > MSG_SIZE_MAX) {
+				printf ("message size must be %zu to %u\n",
+					sizeof (seq), MSG_SIZE_MAX);
+				exit (1);
+			}
+			break;
+		case 'h':
+		default:
+			usage (argv[0]);
+			exit (1);
+		}
+	}
+
+	local_pid = getpid ();
+
+	result = cpg_initialize (&handle, &callbacks);
+	if (result != CS_OK) {
+		printf ("Couldn't initialize CPG service %d\n", result);
+		exit (1);
+	}
+	result = cpg_local_get (handle, &local_nodeid);
+	if (result != CS_OK) {
+		printf ("cpg_local_get failed with result %d\n", result);
+		exit (1);
+	}
+	result = cpg_join (handle, &group_name);
+	if (result != CS_OK) {
+		printf ("cpg_join failed with result %d\n", result);
+		exit (1);
+	}
+	cpg_fd_get (handle, &fd);
+
+	/*
+	 * Don't dispatch unless refused, so the queue runs full
+	 */
+	while (seq < msgs_total) {
+		count = msgs_total - seq;
+		if (count > BATCH_MSGS) {
+			count = BATCH_MSGS;
+		}
+		for (i = 0; i < count; i++) {
+			uint32_t msg_seq = seq + i;
+
+			memcpy (msg_data[i], &msg_seq, sizeof (msg_seq));
+			iov[i].iov_base = msg_data[i];
+			iov[i].iov_len = msg_size;
+		}
+
+		msgs_sent = 0;
+		result = cpg_mcast_joined_batch (handle, CPG_TYPE_AGREED,
+			iov, count, &msgs_sent);
+		seq += msgs_sent;
+		if (result == CS_ERR_TRY_AGAIN) {
+			try_again++;
+			result = cpg_dispatch (handle, CS_DISPATCH_ALL);
+		}
+		if (result != CS_OK && result != CS_ERR_TRY_AGAIN) {
+			printf ("cpg_mcast_joined_batch failed with result %d\n", result);
+			exit (1);
+		}
+	}
+
+	pfd.fd = fd;
+	pfd.events = POLLIN;
+	while (expected_seq < msgs_total) {
+		if (poll (&pfd, 1, DRAIN_TIMEOUT_MS) <= 0) {
+			break;
+		}
+		result = cpg_dispatch (handle, CS_DISPATCH_ALL);
+		if (result != CS_OK && result != CS_ERR_TRY_AGAIN) {
+			printf ("cpg_dispatch failed with result %d\n", result);
+			exit (1);
+		}
+	}
+
+	printf ("%u messages of %u bytes, queue full %u times, "
+		"delivered %u, duplicates %u, gaps %u\n",
+		msgs_total, msg_size, try_again, expected_seq, duplicates, gaps);
+
+	cpg_finalize (handle);
+
+	if (try_again == 0) {
+		printf ("queue never filled up, try more or larger messages\n");
+	}
+	if (expected_seq != msgs_total || duplicates != 0 || gaps != 0) {
+		printf ("FAIL\n");
+		return (1);
+	}
+	printf ("PASS\n");
+
+	return (0);
+}
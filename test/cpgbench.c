@@ -97,7 +97,21 @@ static void cpg_bm_deliver_fn (
 	write_count++;
 }
 
-static cpg_callbacks_t callbacks = {
+static unsigned int batch_size;
+
+static unsigned int batch_count;
+
+static void cpg_bm_deliver_batch_fn (
+	cpg_handle_t handle_in,
+	const cpg_delivered_msg_t *msgs,
+	unsigned int msg_count)
+{
+	write_count += msg_count;
+	batch_count++;
+}
+
+static cpg_model_v1_data_t model_data = {
+	.model			= CPG_MODEL_V1,
 	.cpg_deliver_fn 	= cpg_bm_deliver_fn,
 	.cpg_confchg_fn		= cpg_bm_confchg_fn
 };
@@ -105,24 +119,47 @@ static cpg_callbacks_t callbacks = {
 #define ONE_MEG 1048576
 static char data[ONE_MEG];
 
+#define SEND_BATCH_MAX 64
+
+static unsigned int send_batch;
+
+static unsigned int async_window;
+
 static void cpg_benchmark (
 	cpg_handle_t handle_in,
 	int write_size)
 {
 	struct timeval tv1, tv2, tv_elapsed;
 	struct iovec iov;
+	struct iovec msgs[SEND_BATCH_MAX];
+	unsigned int sent = 0;
+	unsigned int queued;
+	unsigned int i;
 	unsigned int res;
 
 	alarm_notice = 0;
 	iov.iov_base = data;
 	iov.iov_len = write_size;
+	for (i = 0; i < send_batch; i++) {
+		msgs[i] = iov;
+	}
 
 	write_count = 0;
+	batch_count = 0;
 	alarm (10);
 
 	gettimeofday (&tv1, NULL);
 	do {
-		res = cpg_mcast_joined (handle_in, CPG_TYPE_AGREED, &iov, 1);
+		if (send_batch == 0) {
+			res = cpg_mcast_joined (handle_in, CPG_TYPE_AGREED, &iov, 1);
+		} else {
+			/*
+			 * Resubmit only what the previous call didn't queue
+			 */
+			res = cpg_mcast_joined_batch (handle_in, CPG_TYPE_AGREED,
+				&msgs[sent], send_batch - sent, &queued);
+			sent = (res == CS_OK) ? 0 : sent + queued;
+		}
 	} while (alarm_notice == 0 && (res == CS_OK || res == CS_ERR_TRY_AGAIN));
 	gettimeofday (&tv2, NULL);
 	timersub (&tv2, &tv1, &tv_elapsed);
@@ -133,8 +170,12 @@ static void cpg_benchmark (
 		(tv_elapsed.tv_sec + (tv_elapsed.tv_usec / 1000000.0)));
 	printf ("%9.3f TP/s ",
 		((float)write_count) /  (tv_elapsed.tv_sec + (tv_elapsed.tv_usec / 1000000.0)));
-	printf ("%7.3f MB/s.\n",
+	printf ("%7.3f MB/s",
 		((float)write_count) * ((float)write_size) /  ((tv_elapsed.tv_sec + (tv_elapsed.tv_usec / 1000000.0)) * 1000000.0));
+	if (batch_size > 0 && batch_count > 0) {
+		printf (" %6.2f msgs/batch", ((float)write_count) / batch_count);
+	}
+	printf (".\n");
 }
 
 static void sigalrm_handler (int num)
@@ -149,14 +190,56 @@ static struct cpg_name group_name = {
 
 static void* dispatch_thread (void *arg)
 {
-	cpg_dispatch (handle, CS_DISPATCH_BLOCKING);
+	cs_error_t res;
+
+	if (batch_size == 0) {
+		cpg_dispatch (handle, CS_DISPATCH_BLOCKING);
+		return NULL;
+	}
+
+	do {
+		res = cpg_dispatch_batch (handle, cpg_bm_deliver_batch_fn,
+			batch_size, -1);
+	} while (res == CS_OK || res == CS_ERR_TRY_AGAIN);
 	return NULL;
 }
 
-int main (void) {
+static void usage (const char *cmd)
+{
+	printf ("%s [-a window] [-b batch_size] [-m msgs_per_send]\n", cmd);
+	printf ("  -a  enable async send completion with at most window messages in flight\n");
+	printf ("  -b  dispatch with cpg_dispatch_batch, at most batch_size messages per callback\n");
+	printf ("  -m  send with cpg_mcast_joined_batch, msgs_per_send (1-%d) messages per call\n",
+		SEND_BATCH_MAX);
+}
+
+int main (int argc, char *argv[]) {
 	unsigned int size;
 	int i;
 	unsigned int res;
+	int opt;
+
+	while ((opt = getopt (argc, argv, "a:b:m:h")) != -1) {
+		switch (opt) {
+		case 'a':
+			async_window = atoi (optarg);
+			break;
+		case 'b':
+			batch_size = atoi (optarg);
+			break;
+		case 'm':
+			send_batch = atoi (optarg);
+			if (send_batch < 1 || send_batch > SEND_BATCH_MAX) {
+				usage (argv[0]);
+				exit (1);
+			}
+			break;
+		case 'h':
+		default:
+			usage (argv[0]);
+			exit (1);
+		}
+	}
 
 	qb_log_init("cpgbench", LOG_USER, LOG_EMERG);
 	qb_log_ctl(QB_LOG_SYSLOG, QB_LOG_CONF_ENABLED, QB_FALSE);
@@ -166,11 +249,22 @@ int main (void) {
 
 	size = 64;
 	signal (SIGALRM, sigalrm_handler);
-	res = cpg_initialize (&handle, &callbacks);
+	if (batch_size > 0) {
+		model_data.flags = CPG_MODEL_V1_PACKED_EVENTS;
+	}
+	res = cpg_model_initialize (&handle, CPG_MODEL_V1,
+		(cpg_model_data_t *)&model_data, NULL);
 	if (res != CS_OK) {
-		printf ("cpg_initialize failed with result %d\n", res);
+		printf ("cpg_model_initialize failed with result %d\n", res);
 		exit (1);
 	}
+	if (async_window > 0) {
+		res = cpg_mcast_async_enable (handle, async_window, NULL);
+		if (res != CS_OK) {
+			printf ("cpg_mcast_async_enable failed with result %d\n", res);
+			exit (1);
+		}
+	}
 	pthread_create (&thread, NULL, dispatch_thread, NULL);
 
 	res = cpg_join (handle, &group_name);
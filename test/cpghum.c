@@ -95,6 +95,8 @@ static volatile int stopped;
 static unsigned int flood_start = 64;
 static unsigned int flood_multiplier = 5;
 static unsigned long flood_max = (ONE_MEG - 100);
+static int have_flood_start = 0;
+static int have_flood_max = 0;
 
 // stats
 static unsigned int length_errors=0;
@@ -531,6 +533,9 @@ static void usage(char *cmd)
 	fprintf(stderr, " -m<num>                  cpg_initialise() model. Default 1.\n");
 	fprintf(stderr, " -s                       Also send errors to syslog.\n");
 	fprintf(stderr, " -f, --flood              Flood test CPG (cpgbench). see --flood-* long options\n");
+	fprintf(stderr, " -L, --large              Flood test with messages larger than the maximum atomic\n");
+	fprintf(stderr, "                          size, which libcpg sends as fragments. Sizes start at twice\n");
+	fprintf(stderr, "                          the atomic size and grow up to 20M unless --flood-* is given\n");
 	fprintf(stderr, " -a                       Abort on crc/length/sequence error\n");
 	fprintf(stderr, " -q, --quiet              Quiet. Don't print messages every 10s (see also -p)\n");
 	fprintf(stderr, " -qq                      Very quiet. Don't print stats at the end\n");
@@ -589,6 +594,7 @@ int main (int argc, char *argv[]) {
 	int have_size = 0;
 	int listen_only = 0;
 	int flood = 0;
+	int large = 0;
 	int model = 1;
 	int option_index = 0;
 	struct option long_options[] = {
@@ -600,13 +606,14 @@ int main (int argc, char *argv[]) {
 		{"name",        required_argument, 0, 'n' },
 		{"rtt",         no_argument,       0, 't' },
 		{"flood",       no_argument,       0, 'f' },
+		{"large",       no_argument,       0, 'L' },
 		{"quiet",       no_argument,       0, 'q' },
 		{"listen",      no_argument,       0, 'l' },
 		{"help",        no_argument,       0, '?' },
 		{0,             0,                 0,  0  }
 	};
 
-	while ( (opt = getopt_long(argc, argv, "qlstafMEn:d:r:p:m:w:W:D:",
+	while ( (opt = getopt_long(argc, argv, "qlstafLMEn:d:r:p:m:w:W:D:",
 				   long_options, &option_index)) != -1 ) {
 		switch (opt) {
 			case 0: // Long-only options
@@ -616,6 +623,7 @@ int main (int argc, char *argv[]) {
 					fprintf(stderr, "flood-start value invalid\n");
 					exit(1);
 				}
+				have_flood_start = 1;
 			}
 			if (strcmp(long_options[option_index].name, "flood-mult") == 0) {
 				flood_multiplier = parse_bytes(optarg);
@@ -630,6 +638,7 @@ int main (int argc, char *argv[]) {
 					fprintf(stderr, "flood-max value invalid\n");
 					exit(1);
 				}
+				have_flood_max = 1;
 			}
 			break;
 		case 'w': // Write size in K
@@ -667,6 +676,10 @@ int main (int argc, char *argv[]) {
 		case 'f':
 			flood = 1;
 			break;
+		case 'L':
+			flood = 1;
+			large = 1;
+			break;
 		case 'a':
 			abort_on_error = 1;
 			break;
@@ -770,6 +783,17 @@ int main (int argc, char *argv[]) {
 	}
 	else {
 		cpg_max_atomic_msgsize_get (handle, &maxsize);
+		if (large) {
+			if (!have_size && !have_flood_start) {
+				write_size = maxsize * 2;
+			}
+			if (!have_flood_max) {
+				flood_max = DATASIZE;
+			}
+		}
+		if (flood_max > DATASIZE) {
+			flood_max = DATASIZE;
+		}
 		if (write_size > maxsize) {
 			fprintf(stderr, "INFO: packet size (%d) is larger than the maximum atomic size (%d), libcpg will fragment\n",
 				write_size, maxsize);
@@ -0,0 +1,212 @@
+/*
+ * Copyright (c) 2026 Red Hat, Inc.
+ *
+ * All rights reserved.
+ *
+ * This software licensed under BSD license, the text of which follows:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ * - Neither the name of the MontaVista Software, Inc. nor the names of its
+ *   contributors may be used to endorse or promote products derived from this
+ *   software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ * THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Microbenchmark for exec/cs_queue.h
+ *
+ * Producer threads use the same is_full/item_add pattern as totemsrp_mcast
+ * and a single consumer drains the queue the way orf_token_mcast does.
+ */
+
+#include <config.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <sched.h>
+#include <sys/time.h>
+#include <pthread.h>
+
+#include "../exec/cs_queue.h"
+
+#define QUEUE_ITEMS		16384
+#define DEFAULT_MESSAGES	10000000
+
+#ifndef timersub
+#define timersub(a, b, result)						\
+	do {								\
+		(result)->tv_sec = (a)->tv_sec - (b)->tv_sec;		\
+		(result)->tv_usec = (a)->tv_usec - (b)->tv_usec;	\
+		if ((result)->tv_usec < 0) {				\
+			--(result)->tv_sec;				\
+			(result)->tv_usec += 1000000;			\
+		}							\
+	} while (0)
+#endif /* timersub */
+
+/*
+ * Same size as totemsrp's struct message_item
+ */
+struct bench_item {
+	void *mcast;
+	unsigned int msg_len;
+	unsigned int producer;
+};
+
+static struct cs_queue queue;
+
+static pthread_mutex_t producer_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static unsigned int messages_per_producer;
+
+static int serialize_producers;
+
+static void *producer_thread (void *arg)
+{
+	struct bench_item item;
+	unsigned int i;
+	int full;
+
+	memset (&item, 0, sizeof (item));
+	item.producer = (unsigned int)(uintptr_t)arg;
+
+	for (i = 0; i < messages_per_producer; i++) {
+		item.msg_len = i;
+		do {
+			if (serialize_producers) {
+				pthread_mutex_lock (&producer_mutex);
+			}
+			full = cs_queue_is_full (&queue);
+			if (!full) {
+				cs_queue_item_add (&queue, &item);
+			}
+			if (serialize_producers) {
+				pthread_mutex_unlock (&producer_mutex);
+			}
+			if (full) {
+				sched_yield ();
+			}
+		} while (full);
+	}
+	return (NULL);
+}
+
+static unsigned int consume (unsigned int total, int producers)
+{
+	struct bench_item *item;
+	unsigned int received = 0;
+	unsigned int errors = 0;
+	unsigned int *last_seen;
+
+	last_seen = calloc (producers, sizeof (unsigned int));
+
+	while (received < total) {
+		if (cs_queue_is_empty (&queue)) {
+			continue;
+		}
+		item = (struct bench_item *)cs_queue_item_get (&queue);
+		/*
+		 * Each producer's messages must stay in order
+		 */
+		if (item->msg_len + 1 <= last_seen[item->producer]) {
+			errors++;
+		}
+		last_seen[item->producer] = item->msg_len + 1;
+		cs_queue_item_remove (&queue);
+		received++;
+	}
+	free (last_seen);
+	return (errors);
+}
+
+static void queue_benchmark (
+	const char *name,
+	int mode,
+	int producers,
+	int serialize)
+{
+	struct timeval tv1, tv2, tv_elapsed;
+	pthread_t threads[producers];
+	unsigned int total;
+	unsigned int errors;
+	double secs;
+	int i;
+
+	serialize_producers = serialize;
+	if (cs_queue_init (&queue, QUEUE_ITEMS, sizeof (struct bench_item), mode) != 0) {
+		printf ("cs_queue_init failed\n");
+		exit (1);
+	}
+
+	total = messages_per_producer * producers;
+	gettimeofday (&tv1, NULL);
+	for (i = 0; i < producers; i++) {
+		pthread_create (&threads[i], NULL, producer_thread, (void *)(uintptr_t)i);
+	}
+	errors = consume (total, producers);
+	for (i = 0; i < producers; i++) {
+		pthread_join (threads[i], NULL);
+	}
+	gettimeofday (&tv2, NULL);
+	timersub (&tv2, &tv1, &tv_elapsed);
+	secs = tv_elapsed.tv_sec + (tv_elapsed.tv_usec / 1000000.0);
+
+	printf ("%-6s %2d producer(s) %10u messages ", name, producers, total);
+	printf ("%7.3f Seconds runtime ", secs);
+	printf ("%12.3f msg/s ", ((double)total) / secs);
+	printf ("%u ordering errors\n", errors);
+
+	cs_queue_free (&queue);
+}
+
+int main (int argc, char *argv[])
+{
+	int producers = 4;
+
+	messages_per_producer = DEFAULT_MESSAGES;
+	if (argc > 1) {
+		messages_per_producer = atoi (argv[1]);
+	}
+	if (argc > 2) {
+		producers = atoi (argv[2]);
+	}
+
+	/*
+	 * Single producer, matches totempg threaded mode where all
+	 * producers are serialized by mcast_msg_mutex
+	 */
+	queue_benchmark ("mutex", CS_QUEUE_MUTEX, 1, 0);
+	queue_benchmark ("spsc", CS_QUEUE_SPSC, 1, 0);
+	queue_benchmark ("mpsc", CS_QUEUE_MPSC, 1, 0);
+
+	/*
+	 * Several producers, mutex and SPSC need an external producer lock
+	 * because is_full and item_add are separate calls
+	 */
+	queue_benchmark ("mutex", CS_QUEUE_MUTEX, producers, 1);
+	queue_benchmark ("spsc", CS_QUEUE_SPSC, producers, 1);
+	queue_benchmark ("mpsc", CS_QUEUE_MPSC, producers, 0);
+
+	return (0);
+}
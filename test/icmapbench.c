@@ -0,0 +1,255 @@
+/*
+ * Copyright (c) 2026 Red Hat, Inc.
+ *
+ * All rights reserved.
+ *
+ * This software licensed under BSD license, the text of which follows:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ * - Neither the name of the MontaVista Software, Inc. nor the names of its
+ *   contributors may be used to endorse or promote products derived from this
+ *   software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ * THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Microbenchmark for icmap read-only access checks
+ *
+ * Registers the read-only rules corosync sets at startup and times
+ * icmap_is_key_ro alone and the write path of the cmap service
+ * (icmap_is_key_ro followed by icmap_set for writable keys). The check is
+ * also timed with a linear scan of the same rules, which is how the rules
+ * were matched before they were kept in a trie.
+ */
+
+#include <config.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <sys/time.h>
+
+#include <corosync/corotypes.h>
+#include <corosync/icmap.h>
+
+#define DEFAULT_OPS		10000000
+
+#ifndef timersub
+#define timersub(a, b, result)						\
+	do {								\
+		(result)->tv_sec = (a)->tv_sec - (b)->tv_sec;		\
+		(result)->tv_usec = (a)->tv_usec - (b)->tv_usec;	\
+		if ((result)->tv_usec < 0) {				\
+			--(result)->tv_sec;				\
+			(result)->tv_usec += 1000000;			\
+		}							\
+	} while (0)
+#endif /* timersub */
+
+struct ro_rule {
+	const char *key_name;
+	int prefix;
+};
+
+/*
+ * Rules set by main.c, votequorum.c and totemconfig.c
+ */
+static const struct ro_rule ro_rules[] = {
+	{ "internal_configuration.", 1 },
+	{ "runtime.services.", 1 },
+	{ "runtime.config.", 1 },
+	{ "runtime.totem.", 1 },
+	{ "uidgid.config.", 1 },
+	{ "system.", 1 },
+	{ "nodelist.", 1 },
+	{ "totem.crypto_cipher", 0 },
+	{ "totem.crypto_hash", 0 },
+	{ "totem.keyfile", 0 },
+	{ "totem.key", 0 },
+	{ "totem.secauth", 0 },
+	{ "totem.ip_version", 0 },
+	{ "totem.rrp_mode", 0 },
+	{ "totem.transport", 0 },
+	{ "totem.cluster_name", 0 },
+	{ "totem.netmtu", 0 },
+	{ "totem.threads", 0 },
+	{ "totem.version", 0 },
+	{ "totem.nodeid", 0 },
+	{ "totem.clear_node_high_bit", 0 },
+	{ "config.reload_in_progress", 0 },
+	{ "config.totemconfig_reload_in_progress", 0 },
+	{ "quorum.allow_downscale", 0 },
+	{ "quorum.wait_for_all", 0 },
+	{ "quorum.last_man_standing", 0 },
+	{ "quorum.last_man_standing_window", 0 },
+	{ "quorum.expected_votes_tracking", 0 },
+	{ "quorum.auto_tie_breaker", 0 },
+	{ "quorum.auto_tie_breaker_node", 0 },
+	{ "nodelist.local_node_pos", 0 },
+};
+
+#define RO_RULES	(sizeof (ro_rules) / sizeof (ro_rules[0]))
+
+/*
+ * Keys written by typical cmap clients, mostly writable
+ */
+static const char *bench_keys[] = {
+	"quorum.expected_votes",
+	"quorum.device.votes",
+	"logging.debug",
+	"logging.logger_subsys.QUORUM.debug",
+	"resources.system.memory_used.state",
+	"resources.process.pacemakerd.state",
+	"resources.watchdog_timeout",
+	"totem.token",
+	"totem.token_coefficient",
+	"totem.keyfile",
+	"runtime.config.totem.token",
+	"nodelist.node.0.ring0_addr",
+	"config.reload_in_progress",
+	"myapp.some.rather.long.key.name.used.by.application",
+};
+
+#define BENCH_KEYS	(sizeof (bench_keys) / sizeof (bench_keys[0]))
+
+static int linear_is_key_ro (const char *key_name)
+{
+	size_t i;
+	size_t len;
+
+	for (i = 0; i < RO_RULES; i++) {
+		if (ro_rules[i].prefix) {
+			len = strlen (ro_rules[i].key_name);
+			if (len > strlen (key_name)) {
+				continue;
+			}
+			if (strncmp (ro_rules[i].key_name, key_name, len) == 0) {
+				return (1);
+			}
+		} else {
+			if (strcmp (ro_rules[i].key_name, key_name) == 0) {
+				return (1);
+			}
+		}
+	}
+
+	return (0);
+}
+
+static int icmap_is_key_ro_bool (const char *key_name)
+{
+	return (icmap_is_key_ro (key_name) ? 1 : 0);
+}
+
+static void bench_report (
+	const char *name,
+	unsigned int ops,
+	struct timeval *tv1,
+	struct timeval *tv2)
+{
+	struct timeval tv_elapsed;
+	double secs;
+
+	timersub (tv2, tv1, &tv_elapsed);
+	secs = tv_elapsed.tv_sec + (tv_elapsed.tv_usec / 1000000.0);
+
+	printf ("%-12s %10u ops ", name, ops);
+	printf ("%7.3f Seconds runtime ", secs);
+	printf ("%12.3f ops/s\n", ((double)ops) / secs);
+}
+
+static void check_benchmark (
+	const char *name,
+	int (*is_key_ro_fn)(const char *key_name),
+	unsigned int ops)
+{
+	struct timeval tv1, tv2;
+	unsigned int i;
+	unsigned int ro = 0;
+
+	gettimeofday (&tv1, NULL);
+	for (i = 0; i < ops; i++) {
+		ro += is_key_ro_fn (bench_keys[i % BENCH_KEYS]);
+	}
+	gettimeofday (&tv2, NULL);
+
+	bench_report (name, ops, &tv1, &tv2);
+	if (ro == 0) {
+		printf ("no read-only key found\n");
+	}
+}
+
+static void set_benchmark (unsigned int ops)
+{
+	struct timeval tv1, tv2;
+	unsigned int i;
+	const char *key_name;
+
+	gettimeofday (&tv1, NULL);
+	for (i = 0; i < ops; i++) {
+		key_name = bench_keys[i % BENCH_KEYS];
+		if (!icmap_is_key_ro (key_name)) {
+			icmap_set_uint32 (key_name, i);
+		}
+	}
+	gettimeofday (&tv2, NULL);
+
+	bench_report ("icmap_set", ops, &tv1, &tv2);
+}
+
+int main (int argc, char *argv[])
+{
+	unsigned int ops = DEFAULT_OPS;
+	size_t i;
+
+	if (argc > 1) {
+		ops = atoi (argv[1]);
+	}
+
+	if (icmap_init () != CS_OK) {
+		printf ("icmap_init failed\n");
+		exit (1);
+	}
+
+	for (i = 0; i < RO_RULES; i++) {
+		icmap_set_ro_access (ro_rules[i].key_name, ro_rules[i].prefix, CS_TRUE);
+	}
+	printf ("%u read-only rules\n", icmap_ro_access_count ());
+
+	/*
+	 * Both implementations must agree
+	 */
+	for (i = 0; i < BENCH_KEYS; i++) {
+		if (linear_is_key_ro (bench_keys[i]) != icmap_is_key_ro_bool (bench_keys[i])) {
+			printf ("mismatch for key %s\n", bench_keys[i]);
+			exit (1);
+		}
+	}
+
+	check_benchmark ("linear", linear_is_key_ro, ops);
+	check_benchmark ("trie", icmap_is_key_ro_bool, ops);
+	set_benchmark (ops);
+
+	icmap_fini ();
+
+	return (0);
+}
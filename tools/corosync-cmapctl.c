@@ -48,6 +48,11 @@
 
 #define MAX_TRY_AGAIN 10
 
+/*
+ * Keys of loaded file sent in one request
+ */
+#define LOAD_BATCH_ITEMS 64
+
 enum user_action {
 	ACTION_GET,
 	ACTION_SET,
@@ -411,6 +416,84 @@ static void print_key(cmap_handle_t handle,
 	printf("\n");
 }
 
+/*
+ * Get all keys with two requests, first one returns lengths of values and
+ * second one the values
+ */
+static void get_keys(cmap_handle_t handle, int argc, char *argv[])
+{
+	struct cmap_multi_item *items;
+	cs_error_t err;
+	int i;
+
+	items = calloc(argc, sizeof(*items));
+	if (items == NULL) {
+		fprintf(stderr, "Can't alloc memory\n");
+		exit(EXIT_FAILURE);
+	}
+
+	for (i = 0; i < argc; i++) {
+		items[i].key_name = argv[i];
+	}
+
+	err = cmap_get_multi(handle, items, argc);
+	if (err == CS_OK) {
+		for (i = 0; i < argc; i++) {
+			if (items[i].error != CS_OK) {
+				continue;
+			}
+			/*
+			 * + 1, binary values may be empty
+			 */
+			items[i].value = malloc(items[i].value_len + 1);
+			if (items[i].value == NULL) {
+				fprintf(stderr, "Can't alloc memory\n");
+				exit(EXIT_FAILURE);
+			}
+		}
+		err = cmap_get_multi(handle, items, argc);
+	}
+
+	for (i = 0; i < argc; i++) {
+		if (err != CS_OK) {
+			/*
+			 * corosync doesn't know multi requests
+			 */
+			items[i].error = cmap_get(handle, argv[i], NULL, &items[i].value_len,
+			    &items[i].type);
+			free(items[i].value);
+			items[i].value = NULL;
+		} else if (items[i].error == CS_ERR_INVALID_PARAM && items[i].value != NULL) {
+			/*
+			 * Value grew between requests, print_key gets it again
+			 */
+			items[i].error = cmap_get(handle, argv[i], NULL, &items[i].value_len,
+			    &items[i].type);
+			free(items[i].value);
+			items[i].value = NULL;
+		}
+
+		if (items[i].error == CS_OK) {
+			print_key(handle, argv[i], items[i].value_len, items[i].value, items[i].type);
+		} else {
+			fprintf(stderr, "Can't get key %s. Error %s\n", argv[i], cs_strerror(items[i].error));
+		}
+		free(items[i].value);
+	}
+
+	free(items);
+}
+
+static void print_iter_fn(cmap_handle_t handle,
+		const char *key_name,
+		const void *value,
+		size_t value_len,
+		cmap_value_types_t type,
+		void *user_data)
+{
+	print_key(handle, key_name, value_len, value, type);
+}
+
 static void print_iter(cmap_handle_t handle, const char *prefix)
 {
 	cmap_iter_handle_t iter_handle;
@@ -425,8 +508,17 @@ static void print_iter(cmap_handle_t handle, const char *prefix)
 		exit (EXIT_FAILURE);
 	}
 
-	while ((err = cmap_iter_next(handle, iter_handle, key_name, &value_len, &type)) == CS_OK) {
-		print_key(handle, key_name, value_len, NULL, type);
+	/*
+	 * Fetch keys page by page. Corosync without bulk iteration answers
+	 * with CS_ERR_INVALID_PARAM, continue key by key then.
+	 */
+	while ((err = cmap_iter_next_bulk(handle, iter_handle, print_iter_fn, NULL)) == CS_OK) {
+	}
+
+	if (err == CS_ERR_INVALID_PARAM) {
+		while ((err = cmap_iter_next(handle, iter_handle, key_name, &value_len, &type)) == CS_OK) {
+			print_key(handle, key_name, value_len, NULL, type);
+		}
 	}
 	cmap_iter_finalize(handle, iter_handle);
 }
@@ -547,7 +639,7 @@ static void track_changes(cmap_handle_t handle)
 	} while (poll_res > 0 && !quit);
 }
 
-static cs_error_t set_key_bin(cmap_handle_t handle, const char *key_name, const char *fname)
+static void *read_bin_value(const char *fname, size_t *value_len)
 {
 	FILE *f;
 	char *val;
@@ -555,7 +647,6 @@ static cs_error_t set_key_bin(cmap_handle_t handle, const char *key_name, const
 	size_t size;
 	size_t readed;
 	size_t pos;
-	cs_error_t err;
 
 	if (strcmp(fname, "-") == 0) {
 		f = stdin;
@@ -585,25 +676,34 @@ static cs_error_t set_key_bin(cmap_handle_t handle, const char *key_name, const
 		fclose(f);
 	}
 
-	err = cmap_set(handle, key_name, val, size, CMAP_VALUETYPE_BINARY);
-	free(val);
+	*value_len = size;
 
-	return (err);
+	return (val);
 }
 
-static void set_key(cmap_handle_t handle, const char *key_name, const char *key_type_s, const char *key_value_s)
+/*
+ * Convert value given on command line (or in loaded file) to the binary
+ * form stored in cmap. Returned value is allocated and caller frees it.
+ */
+static void *parse_value(const char *key_type_s, const char *key_value_s,
+		size_t *value_len, cmap_value_types_t *value_type)
 {
 	int64_t i64;
 	uint64_t u64;
 	double dbl;
 	float flt;
-	cs_error_t err = CS_OK;
 	int scanf_res = 0;
+	void *value;
 
 	cmap_value_types_t type;
 
-	if (convert_name_to_type(key_type_s) == -1) {
-		fprintf(stderr, "Unknown type %s\n", key_type_s);
+	if (key_type_s == NULL || convert_name_to_type(key_type_s) == -1) {
+		fprintf(stderr, "Unknown type %s\n", (key_type_s != NULL ? key_type_s : ""));
+		exit (EXIT_FAILURE);
+	}
+
+	if (key_value_s == NULL) {
+		fprintf(stderr, "Missing value of %s type\n", key_type_s);
 		exit (EXIT_FAILURE);
 	}
 
@@ -641,8 +741,29 @@ static void set_key(cmap_handle_t handle, const char *key_name, const char *key_
 		fprintf(stderr, "%s is not valid %s type value\n", key_value_s, key_type_s);
 		exit(EXIT_FAILURE);
 	}
+
+	if (type == CMAP_VALUETYPE_STRING) {
+		value = strdup(key_value_s);
+		*value_len = strlen(key_value_s);
+	} else if (type == CMAP_VALUETYPE_BINARY) {
+		value = read_bin_value(key_value_s, value_len);
+		if (value == NULL) {
+			/*
+			 * Empty file
+			 */
+			value = malloc(1);
+		}
+	} else {
+		value = malloc(sizeof(uint64_t));
+	}
+	if (value == NULL) {
+		fprintf(stderr, "Can't alloc memory\n");
+		exit(EXIT_FAILURE);
+	}
+	*value_type = type;
+
 	/*
-	 * We have parsed value, so insert value
+	 * We have parsed value, so convert it
 	 */
 
 	switch (type) {
@@ -651,24 +772,28 @@ static void set_key(cmap_handle_t handle, const char *key_name, const char *key_
 			fprintf(stderr, "%s is not valid i8 integer\n", key_value_s);
 			exit(EXIT_FAILURE);
 		}
-		err = cmap_set_int8(handle, key_name, i64);
+		*(int8_t *)value = i64;
+		*value_len = sizeof(int8_t);
 		break;
 	case CMAP_VALUETYPE_INT16:
 		if (i64 > INT16_MAX || i64 < INT16_MIN) {
 			fprintf(stderr, "%s is not valid i16 integer\n", key_value_s);
 			exit(EXIT_FAILURE);
 		}
-		err = cmap_set_int16(handle, key_name, i64);
+		*(int16_t *)value = i64;
+		*value_len = sizeof(int16_t);
 		break;
 	case CMAP_VALUETYPE_INT32:
 		if (i64 > INT32_MAX || i64 < INT32_MIN) {
 			fprintf(stderr, "%s is not valid i32 integer\n", key_value_s);
 			exit(EXIT_FAILURE);
 		}
-		err = cmap_set_int32(handle, key_name, i64);
+		*(int32_t *)value = i64;
+		*value_len = sizeof(int32_t);
 		break;
 	case CMAP_VALUETYPE_INT64:
-		err = cmap_set_int64(handle, key_name, i64);
+		*(int64_t *)value = i64;
+		*value_len = sizeof(int64_t);
 		break;
 
 	case CMAP_VALUETYPE_UINT8:
@@ -676,45 +801,168 @@ static void set_key(cmap_handle_t handle, const char *key_name, const char *key_
 			fprintf(stderr, "%s is not valid u8 integer\n", key_value_s);
 			exit(EXIT_FAILURE);
 		}
-		err = cmap_set_uint8(handle, key_name, u64);
+		*(uint8_t *)value = u64;
+		*value_len = sizeof(uint8_t);
 		break;
 	case CMAP_VALUETYPE_UINT16:
 		if (u64 > UINT16_MAX) {
 			fprintf(stderr, "%s is not valid u16 integer\n", key_value_s);
 			exit(EXIT_FAILURE);
 		}
-		err = cmap_set_uint16(handle, key_name, u64);
+		*(uint16_t *)value = u64;
+		*value_len = sizeof(uint16_t);
 		break;
 	case CMAP_VALUETYPE_UINT32:
 		if (u64 > UINT32_MAX) {
 			fprintf(stderr, "%s is not valid u32 integer\n", key_value_s);
 			exit(EXIT_FAILURE);
 		}
-		err = cmap_set_uint32(handle, key_name, u64);
+		*(uint32_t *)value = u64;
+		*value_len = sizeof(uint32_t);
 		break;
 	case CMAP_VALUETYPE_UINT64:
-		err = cmap_set_uint64(handle, key_name, u64);
+		*(uint64_t *)value = u64;
+		*value_len = sizeof(uint64_t);
 		break;
 	case CMAP_VALUETYPE_FLOAT:
-		err = cmap_set_float(handle, key_name, flt);
+		*(float *)value = flt;
+		*value_len = sizeof(float);
 		break;
 	case CMAP_VALUETYPE_DOUBLE:
-		err = cmap_set_double(handle, key_name, dbl);
+		*(double *)value = dbl;
+		*value_len = sizeof(double);
 		break;
 	case CMAP_VALUETYPE_STRING:
-		err = cmap_set_string(handle, key_name, key_value_s);
-		break;
 	case CMAP_VALUETYPE_BINARY:
-		err = set_key_bin(handle, key_name, key_value_s);
 		break;
 	}
 
+	return (value);
+}
+
+static void set_key(cmap_handle_t handle, const char *key_name, const char *key_type_s, const char *key_value_s)
+{
+	cmap_value_types_t type;
+	size_t value_len;
+	void *value;
+	cs_error_t err;
+
+	value = parse_value(key_type_s, key_value_s, &value_len, &type);
+
+	err = cmap_set(handle, key_name, value, value_len, type);
+	free(value);
+
 	if (err != CS_OK) {
 		fprintf (stderr, "Failed to set key %s. Error %s\n", key_name, cs_strerror(err));
 		exit (EXIT_FAILURE);
 	}
 }
 
+/*
+ * Consecutive sets (or deletes) of a loaded file are sent together. A batch
+ * is flushed before an operation of the other kind, so the file is still
+ * applied in order.
+ */
+struct load_batch {
+	struct cmap_multi_item items[LOAD_BATCH_ITEMS];
+	size_t no_items;
+	int is_set;
+};
+
+static void load_batch_flush(cmap_handle_t handle, struct load_batch *batch)
+{
+	cs_error_t err;
+	size_t i;
+	int key_failed = 0;
+
+	if (batch->no_items == 0) {
+		return ;
+	}
+
+	if (batch->is_set) {
+		err = cmap_set_multi(handle, batch->items, batch->no_items);
+	} else {
+		err = cmap_delete_multi(handle, batch->items, batch->no_items);
+	}
+
+	for (i = 0; i < batch->no_items; i++) {
+		if (batch->items[i].error != CS_OK) {
+			key_failed = 1;
+		}
+	}
+
+	if (err != CS_OK && batch->is_set && !key_failed) {
+		/*
+		 * Batch is too big or corosync doesn't know multi requests
+		 */
+		for (i = 0; i < batch->no_items; i++) {
+			batch->items[i].error = cmap_set(handle, batch->items[i].key_name,
+			    batch->items[i].value, batch->items[i].value_len,
+			    batch->items[i].type);
+			if (batch->items[i].error != CS_OK) {
+				break;
+			}
+		}
+	}
+
+	if (err != CS_OK && !batch->is_set) {
+		/*
+		 * Nothing was deleted, delete what can be deleted one by one
+		 */
+		for (i = 0; i < batch->no_items; i++) {
+			batch->items[i].error = cmap_delete(handle, batch->items[i].key_name);
+		}
+	}
+
+	for (i = 0; i < batch->no_items; i++) {
+		if (batch->items[i].error != CS_OK) {
+			if (batch->is_set) {
+				fprintf (stderr, "Failed to set key %s. Error %s\n",
+				    batch->items[i].key_name, cs_strerror(batch->items[i].error));
+			} else {
+				fprintf(stderr, "Can't delete key %s. Error %s\n",
+				    batch->items[i].key_name, cs_strerror(batch->items[i].error));
+			}
+			key_failed = 1;
+		}
+	}
+
+	for (i = 0; i < batch->no_items; i++) {
+		free((char *)batch->items[i].key_name);
+		free(batch->items[i].value);
+	}
+	memset(batch->items, 0, sizeof(batch->items[0]) * batch->no_items);
+	batch->no_items = 0;
+
+	if (batch->is_set && key_failed) {
+		exit (EXIT_FAILURE);
+	}
+}
+
+static void load_batch_add(cmap_handle_t handle, struct load_batch *batch, int is_set,
+		const char *key_name, void *value, size_t value_len, cmap_value_types_t type)
+{
+	struct cmap_multi_item *item;
+
+	if (batch->no_items > 0 && batch->is_set != is_set) {
+		load_batch_flush(handle, batch);
+	}
+	if (batch->no_items == LOAD_BATCH_ITEMS) {
+		load_batch_flush(handle, batch);
+	}
+
+	batch->is_set = is_set;
+	item = &batch->items[batch->no_items++];
+	item->key_name = strdup(key_name);
+	if (item->key_name == NULL) {
+		fprintf(stderr, "Can't alloc memory\n");
+		exit(EXIT_FAILURE);
+	}
+	item->value = value;
+	item->value_len = value_len;
+	item->type = type;
+	item->error = CS_OK;
+}
 
 static void read_in_config_file(cmap_handle_t handle, char * filename)
 {
@@ -726,6 +974,12 @@ static void read_in_config_file(cmap_handle_t handle, char * filename)
 	char *key_name;
 	char *key_type_s;
 	char *key_value_s;
+	struct load_batch batch;
+	cmap_value_types_t type;
+	size_t value_len;
+	void *value;
+
+	memset(&batch, 0, sizeof(batch));
 
 	fh = fopen(filename, "r");
 	if (fh == NULL) {
@@ -766,22 +1020,21 @@ static void read_in_config_file(cmap_handle_t handle, char * filename)
 			key_name++;
 			if (*key_name == '^') {
 				key_name++;
+				load_batch_flush(handle, &batch);
 				delete_with_prefix(handle, key_name);
 			} else {
-				cs_error_t err;
-
-				err = cmap_delete(handle, key_name);
-				if (err != CS_OK) {
-					fprintf(stderr, "Can't delete key %s. Error %s\n", key_name, cs_strerror(err));
-				}
+				load_batch_add(handle, &batch, 0, key_name, NULL, 0, 0);
 			}
 		} else {
 			key_type_s = strtok(NULL, " \n");
 			key_value_s = strtok(NULL, " \n");
-			set_key(handle, key_name, key_type_s, key_value_s);
+			value = parse_value(key_type_s, key_value_s, &value_len, &type);
+			load_batch_add(handle, &batch, 1, key_name, value, value_len, type);
 		}
 	}
 
+	load_batch_flush(handle, &batch);
+
 	fclose (fh);
 }
 
@@ -800,8 +1053,6 @@ int main(int argc, char *argv[])
 	cs_error_t err;
 	cmap_handle_t handle;
 	int i;
-	size_t value_len;
-	cmap_value_types_t type;
 	cmap_map_t map = CMAP_MAP_DEFAULT;
 	int track_prefix;
 	int map_set = 0;
@@ -919,14 +1170,7 @@ int main(int argc, char *argv[])
 		}
 		break;
 	case ACTION_GET:
-		for (i = 0; i < argc; i++) {
-			err = cmap_get(handle, argv[i], NULL, &value_len, &type);
-			if (err == CS_OK) {
-				print_key(handle, argv[i], value_len, NULL, type);
-			} else {
-				fprintf(stderr, "Can't get key %s. Error %s\n", argv[i], cs_strerror(err));
-			}
-		}
+		get_keys(handle, argc, argv);
 		break;
 	case ACTION_DELETE:
 		for (i = 0; i < argc; i++) {